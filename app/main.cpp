@@ -1,10 +1,22 @@
+#include "libps/audio_output.hpp"
+#include "libps/audio_sink.hpp"
+#include "libps/gdb_server.hpp"
+#include "libps/gdb_stub.hpp"
+#include "libps/perf_counters.hpp"
 #include "libps/playstation.hpp"
+#include "libps/spu.hpp"
+#include "libps/symbol_map.hpp"
+#include "libutils/file.hpp"
+#include "libutils/mapped_memory.hpp"
 
 #include <algorithm>
 #include <exception>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
+#include <string>
 
 namespace {
 bool commandLineOptionPresent(int argc, char **argv, const std::string &option) {
@@ -12,6 +24,16 @@ bool commandLineOptionPresent(int argc, char **argv, const std::string &option)
     auto end = argv + argc;
     return std::find(begin, end, option) != end;
 }
+
+std::optional<std::string> commandLineOptionValue(int argc, char **argv, const std::string &option) {
+    auto begin = argv;
+    auto end = argv + argc;
+    auto it = std::find(begin, end, option);
+    if (it == end || it + 1 == end) {
+        return {};
+    }
+    return std::string(*(it + 1));
+}
 }; // namespace
 
 int main(int argc, char **argv) {
@@ -23,12 +45,127 @@ int main(int argc, char **argv) {
 
     spdlog::debug("Hello, Playstation!");
 
+    // Headless audio output. File and null sinks run decoupled from emulation,
+    // the hash sink stays synchronous so it sees every sample.
+    std::unique_ptr<AudioSink> audioSink;
+    HashAudioSink *hashSink = nullptr;
+    if (auto wavPath = commandLineOptionValue(argc, argv, "--audio-wav")) {
+        auto wavSink = std::make_unique<WavAudioSink>(*wavPath, SPU_SAMPLE_RATE);
+        audioSink = std::make_unique<AudioOutput>(std::move(wavSink), AudioOutput::Mode::Drain, SPU_SAMPLE_RATE, SPU_SAMPLE_RATE);
+    } else if (commandLineOptionPresent(argc, argv, "--audio-null")) {
+        constexpr uint32_t deviceRate = 48000;
+        audioSink = std::make_unique<AudioOutput>(std::make_unique<NullAudioSink>(), AudioOutput::Mode::Realtime, SPU_SAMPLE_RATE, deviceRate);
+    } else if (commandLineOptionPresent(argc, argv, "--audio-hash")) {
+        auto sink = std::make_unique<HashAudioSink>();
+        hashSink = sink.get();
+        audioSink = std::move(sink);
+    }
+
+    std::optional<uint64_t> instructionLimit;
+    if (auto instructions = commandLineOptionValue(argc, argv, "--instructions")) {
+        instructionLimit = std::stoull(*instructions);
+    }
+
+    auto biosPath = commandLineOptionValue(argc, argv, "--bios");
+    if (!biosPath) {
+        spdlog::error("No BIOS image given, use --bios <path>");
+        return 1;
+    }
+
+    // Backing of guest memory, before the first buffer is mapped
+    auto mappingPolicy = MappingPolicy();
+    mappingPolicy.hugePages = commandLineOptionPresent(argc, argv, "--huge-pages");
+    mappingPolicy.locked = commandLineOptionPresent(argc, argv, "--lock-memory");
+    if (auto numaNode = commandLineOptionValue(argc, argv, "--numa-node")) {
+        mappingPolicy.numaNode = std::stoi(*numaNode);
+    }
+    MappedBuffer::setPolicy(mappingPolicy);
+
     // try {
         auto ps = Playstation();
         ps.initialize();
-        ps.intializeBios("D:/Programmierung/C++/PSEmulator/files/SCPH-1001.bin");
-        ps.run();
+        ps.intializeBios(*biosPath);
+        ps.setAudioSink(audioSink.get());
+        if (auto exePath = commandLineOptionValue(argc, argv, "--exe")) {
+            ps.loadExecutable(*exePath, commandLineOptionPresent(argc, argv, "--skip-bios"));
+        }
+        ps.setInstructionCacheEnabled(!commandLineOptionPresent(argc, argv, "--no-icache"));
+        ps.setIdleLoopSkipping(!commandLineOptionPresent(argc, argv, "--no-idle-skip"));
+        ps.setCachedInterpreter(commandLineOptionPresent(argc, argv, "--cached-interpreter"));
+        // Blocks translated by earlier runs, an unusable file is rebuilt at exit
+        auto blockCachePath = commandLineOptionValue(argc, argv, "--block-cache");
+        if (blockCachePath && File(*blockCachePath).exists()) {
+            try {
+                ps.loadBlockCache(*blockCachePath);
+            } catch (std::exception &e) {
+                spdlog::warn("[blocks] Ignoring the block cache: {}", e.what());
+            }
+        }
+        // Native kernel functions, and BIOS TTY output on stdout for CI logs
+        ps.biosHle().setEnabled(commandLineOptionPresent(argc, argv, "--hle"));
+        if (commandLineOptionPresent(argc, argv, "--tty")) {
+            ps.biosHle().setTtyStream(&std::cout);
+        }
+        if (commandLineOptionPresent(argc, argv, "--profile")) {
+            ps.enableProfiler();
+        }
+        // Card images are written back in the background while the emulation runs
+        for (uint32_t port = 0; port < SIO_PORT_COUNT; port++) {
+            if (auto cardPath = commandLineOptionValue(argc, argv, fmt::format("--memcard{}", port + 1))) {
+                ps.sio().insertMemoryCard(port, *cardPath);
+            }
+        }
+        if (auto recordPath = commandLineOptionValue(argc, argv, "--record")) {
+            ps.startRecording(*recordPath);
+        } else if (auto replayPath = commandLineOptionValue(argc, argv, "--replay")) {
+            ps.startPlayback(*replayPath);
+        }
+
+        // Debugging session first, the emulation continues after GDB detached
+        auto killed = false;
+        if (auto gdbEndpoint = commandLineOptionValue(argc, argv, "--gdb")) {
+            auto stub = GdbStub(&ps);
+            GdbServer::serve(stub, *gdbEndpoint);
+            killed = stub.killed();
+        }
+        if (!killed) {
+            ps.run(instructionLimit);
+        }
     // } catch (std::exception &e) {
     //    spdlog::error("Unhandled exception occured: {}", e.what());
     // }
-}
\ No newline at end of file
+
+    // Sampled guest hot spots, optionally symbolized from a map file
+    if (commandLineOptionPresent(argc, argv, "--profile")) {
+        auto symbols = SymbolMap();
+        if (auto symbolsPath = commandLineOptionValue(argc, argv, "--symbols")) {
+            symbols.load(*symbolsPath);
+        }
+        size_t count = 20;
+        if (auto top = commandLineOptionValue(argc, argv, "--profile-top")) {
+            count = std::stoul(*top);
+        }
+        ps.reportProfile(count, &symbols);
+    }
+
+    if (auto perfCountersPath = commandLineOptionValue(argc, argv, "--perf-counters")) {
+        if (!PerfCounters::ENABLED) {
+            spdlog::warn("Performance counters are not compiled in, rebuild with -DPS_PERF_COUNTERS=ON");
+        }
+        PerfCounters::writePrometheusFile(ps.perfCounters(), *perfCountersPath);
+    }
+
+    if (ps.replay().mode() == Replay::Mode::Playback) {
+        auto desyncs = ps.replay().desyncs();
+        spdlog::info("[replay] Playback finished, {}", desyncs == 0 ? "no divergence" : fmt::format("{} divergences", desyncs));
+    }
+    ps.replay().stop();
+
+    if (blockCachePath) {
+        ps.saveBlockCache(*blockCachePath);
+    }
+
+    if (hashSink) {
+        spdlog::info("Audio hash {:#018x} over {} frames", hashSink->hash(), hashSink->frames());
+    }
+}
@@ -0,0 +1,121 @@
+#include "audio_output.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+namespace {
+using namespace std::chrono_literals;
+
+// ~185 ms at 44.1 kHz
+constexpr size_t BUFFER_FRAMES = 8192;
+constexpr size_t STAGING_FRAMES = 512;
+constexpr auto PERIOD = 10ms;
+
+// Realtime mode keeps the buffer around this fill level (~46 ms)
+constexpr size_t TARGET_FRAMES = BUFFER_FRAMES / 4;
+// Maximum deviation from the nominal rate, small enough to be inaudible
+constexpr double MAX_ADJUSTMENT = 0.005;
+
+static_assert(sizeof(AudioFrame) == 2 * sizeof(int16_t));
+} // namespace
+
+AudioOutput::AudioOutput(std::unique_ptr<AudioSink> device, Mode mode, uint32_t inputRate, uint32_t outputRate)
+    : _device(std::move(device)),
+      _mode(mode),
+      _outputRate(outputRate),
+      _buffer(BUFFER_FRAMES),
+      _resampler(inputRate, outputRate),
+      _staging(STAGING_FRAMES) {
+    spdlog::debug("Starting audio output ({} Hz -> {} Hz, {})", inputRate, outputRate, mode == Mode::Realtime ? "realtime" : "drain");
+    _thread = std::thread(&AudioOutput::consume, this);
+}
+
+AudioOutput::~AudioOutput() {
+    _running = false;
+    _thread.join();
+
+    auto stats = statistics();
+    spdlog::debug("Stopped audio output ({} overruns, {} underruns)", stats.overruns, stats.underruns);
+}
+
+void AudioOutput::write(const int16_t *samples, size_t frames) {
+    auto pushed = _buffer.push(reinterpret_cast<const AudioFrame *>(samples), frames);
+    if (pushed < frames) {
+        _overruns.fetch_add(frames - pushed, std::memory_order_relaxed);
+    }
+}
+
+AudioOutput::Statistics AudioOutput::statistics() const {
+    return Statistics{_overruns.load(), _underruns.load(), _adjustment.load()};
+}
+
+size_t AudioOutput::render(AudioFrame *output, size_t count) {
+    size_t produced = 0;
+    while (produced < count) {
+        if (_stagingPosition == _stagingSize) {
+            _stagingSize = _buffer.pop(_staging.data(), _staging.size());
+            _stagingPosition = 0;
+            if (_stagingSize == 0) {
+                break;
+            }
+        }
+
+        size_t consumed = 0;
+        produced += _resampler.process(_staging.data() + _stagingPosition, _stagingSize - _stagingPosition, consumed,
+                                       output + produced, count - produced);
+        _stagingPosition += consumed;
+    }
+    return produced;
+}
+
+void AudioOutput::consume() {
+    auto periodFrames = static_cast<size_t>(_outputRate * std::chrono::duration<double>(PERIOD).count());
+    auto output = std::vector<AudioFrame>(periodFrames);
+    auto writeToDevice = [&](size_t frames) {
+        _device->write(reinterpret_cast<const int16_t *>(output.data()), frames);
+    };
+
+    if (_mode == Mode::Drain) {
+        while (true) {
+            // Read the flag before rendering, so nothing written before shutdown is lost.
+            bool running = _running;
+            auto produced = render(output.data(), periodFrames);
+            if (produced > 0) {
+                writeToDevice(produced);
+            } else if (!running) {
+                return;
+            } else {
+                std::this_thread::sleep_for(1ms);
+            }
+        }
+    }
+
+    bool playing = false;
+    auto deadline = std::chrono::steady_clock::now();
+    while (_running) {
+        deadline += PERIOD;
+        std::this_thread::sleep_until(deadline);
+
+        auto fill = _buffer.size();
+        if (!playing) {
+            // Prefill before starting playback
+            playing = fill >= TARGET_FRAMES;
+            std::fill(output.begin(), output.end(), AudioFrame{0, 0});
+            writeToDevice(periodFrames);
+            continue;
+        }
+
+        auto error = (static_cast<double>(fill) - TARGET_FRAMES) / TARGET_FRAMES;
+        auto adjustment = 1.0 + std::clamp(error * MAX_ADJUSTMENT, -MAX_ADJUSTMENT, MAX_ADJUSTMENT);
+        _resampler.setAdjustment(adjustment);
+        _adjustment = adjustment;
+
+        auto produced = render(output.data(), periodFrames);
+        if (produced < periodFrames) {
+            _underruns.fetch_add(1, std::memory_order_relaxed);
+            std::fill(output.begin() + produced, output.end(), AudioFrame{0, 0});
+        }
+        writeToDevice(periodFrames);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "audio_sink.hpp"
+#include "resampler.hpp"
+
+#include "libutils/spsc_ring_buffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Decouples the emulation thread from audio output. The SPU pushes into a
+// lock free ring buffer and never waits; a consumer thread resamples the
+// buffered audio and hands it to the actual device sink.
+//
+// In Realtime mode the consumer pulls frames at the device rate, like a
+// sound card would, and adjusts the resampling ratio slightly to keep the
+// buffer at its target fill level. In Drain mode it forwards everything as
+// fast as it arrives, which is what file sinks want.
+class AudioOutput
+    : public AudioSink {
+public:
+    enum class Mode {
+        Realtime,
+        Drain
+    };
+
+    struct Statistics {
+        uint64_t overruns;
+        uint64_t underruns;
+        double adjustment;
+    };
+
+private:
+    std::unique_ptr<AudioSink> _device;
+    Mode _mode;
+    uint32_t _outputRate;
+
+    SpscRingBuffer<AudioFrame> _buffer;
+    Resampler _resampler;
+
+    // Only touched by the consumer thread
+    std::vector<AudioFrame> _staging;
+    size_t _stagingPosition = 0;
+    size_t _stagingSize = 0;
+
+    std::atomic<bool> _running = true;
+    std::atomic<uint64_t> _overruns = 0;
+    std::atomic<uint64_t> _underruns = 0;
+    std::atomic<double> _adjustment = 1.0;
+    std::thread _thread;
+
+    void consume();
+    size_t render(AudioFrame *output, size_t count);
+
+public:
+    AudioOutput(std::unique_ptr<AudioSink> device, Mode mode, uint32_t inputRate, uint32_t outputRate);
+    AudioOutput(const AudioOutput &) = delete;
+    AudioOutput &operator=(const AudioOutput &) = delete;
+    virtual ~AudioOutput() override;
+
+    // Called from the emulation thread. Frames that do not fit are dropped.
+    virtual void write(const int16_t *samples, size_t frames) override;
+
+    Statistics statistics() const;
+};
@@ -0,0 +1,77 @@
+#include "audio_sink.hpp"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace {
+void writeU32(uint8_t *data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+void writeU16(uint8_t *data, uint16_t value) {
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+}
+} // namespace
+
+WavAudioSink::WavAudioSink(const std::string &path, uint32_t sampleRate)
+    : _sampleRate(sampleRate) {
+    _file = std::fopen(path.c_str(), "wb");
+    if (!_file) {
+        throw std::runtime_error(fmt::format("Could not open wav file {} for writing", path));
+    }
+
+    spdlog::debug("Writing audio to {}", path);
+    writeHeader();
+}
+
+WavAudioSink::~WavAudioSink() {
+    if (_file) {
+        std::fclose(_file);
+    }
+}
+
+// The header is rewritten after every block of samples, so the file stays valid
+// even if the emulator never shuts down cleanly.
+void WavAudioSink::writeHeader() {
+    constexpr uint16_t channels = 2;
+    constexpr uint16_t bitsPerSample = 16;
+    constexpr uint16_t blockAlign = channels * bitsPerSample / 8;
+
+    uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                          'f', 'm', 't', ' ', 0, 0, 0, 0, 0, 0, 0, 0,
+                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                          'd', 'a', 't', 'a', 0, 0, 0, 0};
+    writeU32(header + 4, 36 + _dataBytes);
+    writeU32(header + 16, 16);
+    writeU16(header + 20, 1); // PCM
+    writeU16(header + 22, channels);
+    writeU32(header + 24, _sampleRate);
+    writeU32(header + 28, _sampleRate * blockAlign);
+    writeU16(header + 32, blockAlign);
+    writeU16(header + 34, bitsPerSample);
+    writeU32(header + 40, _dataBytes);
+
+    std::fseek(_file, 0, SEEK_SET);
+    std::fwrite(header, sizeof(header), 1, _file);
+    std::fseek(_file, 0, SEEK_END);
+}
+
+void WavAudioSink::write(const int16_t *samples, size_t frames) {
+    // Wav files are little endian, as are all hosts we run on.
+    auto written = std::fwrite(samples, sizeof(int16_t) * 2, frames, _file);
+    _dataBytes += static_cast<uint32_t>(written * sizeof(int16_t) * 2);
+    writeHeader();
+}
+
+void HashAudioSink::write(const int16_t *samples, size_t frames) {
+    auto bytes = reinterpret_cast<const uint8_t *>(samples);
+    for (size_t i = 0; i < frames * 2 * sizeof(int16_t); i++) {
+        _hash ^= bytes[i];
+        _hash *= 0x100000001b3;
+    }
+    _frames += frames;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Receives interleaved stereo 16 bit samples produced by the SPU.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual void write(const int16_t *samples, size_t frames) = 0;
+};
+
+// Discards all samples.
+class NullAudioSink
+    : public AudioSink {
+public:
+    virtual void write(const int16_t *, size_t) override {}
+};
+
+// Writes all samples into a 16 bit stereo PCM wav file.
+class WavAudioSink
+    : public AudioSink {
+private:
+    std::FILE *_file = nullptr;
+    uint32_t _sampleRate;
+    uint32_t _dataBytes = 0;
+
+    void writeHeader();
+
+public:
+    WavAudioSink(const std::string &path, uint32_t sampleRate);
+    WavAudioSink(const WavAudioSink &) = delete;
+    WavAudioSink &operator=(const WavAudioSink &) = delete;
+    virtual ~WavAudioSink() override;
+
+    virtual void write(const int16_t *samples, size_t frames) override;
+};
+
+// Only keeps a running FNV-1a hash of all samples. Used to compare audio output of headless runs.
+class HashAudioSink
+    : public AudioSink {
+private:
+    uint64_t _hash = 0xcbf29ce484222325;
+    uint64_t _frames = 0;
+
+public:
+    virtual void write(const int16_t *samples, size_t frames) override;
+
+    uint64_t hash() const { return _hash; }
+    uint64_t frames() const { return _frames; }
+};
@@ -1,17 +1,27 @@
 #include "bios.hpp"
 #include "libutils/exception.hpp"
 
+#include <cstring>
 #include <exception>
 #include <fmt/format.h>
 #include <stdexcept>
+#include <utility>
 
 constexpr uint32_t BIOS_SIZE = 512 * 1024;
 
 BIOS::BIOS(const ByteBuffer &buffer)
-    : _data(buffer) {
+    : _data(buffer.size()) {
     if (buffer.size() != BIOS_SIZE) {
         throw std::runtime_error(fmt::format("BIOS buffer does not have the right size ({} vs {})", buffer.size(), BIOS_SIZE));
     }
+    std::memcpy(_data.data(), buffer.data(), buffer.size());
+}
+
+BIOS::BIOS(MappedBuffer data)
+    : _data(std::move(data)) {
+    if (_data.size() != BIOS_SIZE) {
+        throw std::runtime_error(fmt::format("BIOS buffer does not have the right size ({} vs {})", _data.size(), BIOS_SIZE));
+    }
 }
 
 uint32_t BIOS::size() const {
@@ -3,10 +3,11 @@
 #include "memory_region.hpp"
 
 #include "libutils/data.hpp"
+#include "libutils/mapped_memory.hpp"
 
 class BIOS
     : public MemoryRegion {
-    ByteBuffer _data;
+    MappedBuffer _data;
 
     template <typename T>
     T read(uint32_t offset) const {
@@ -16,8 +17,11 @@ class BIOS
 
 public:
     BIOS(const ByteBuffer &buffer);
+    // Takes over a mapping, e.g. a view of a SharedMemory image
+    explicit BIOS(MappedBuffer data);
 
     virtual uint32_t size() const override;
+    virtual uint8_t *data() override { return _data.data(); }
 
     virtual uint8_t u8(uint32_t offset) const override;
     virtual uint16_t u16(uint32_t offset) const override;
@@ -0,0 +1,384 @@
+#include "bios_hle.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+constexpr uint32_t VECTOR_A0 = 0xA0;
+constexpr uint32_t VECTOR_B0 = 0xB0;
+
+// RAM and its mirrors in the physical address space
+constexpr uint32_t RAM_MIRRORS_SIZE = 8 * 1024 * 1024;
+
+namespace {
+const auto V0 = RegisterIndex(2);
+const auto T1 = RegisterIndex(9);
+const auto SP = RegisterIndex(29);
+const auto RA = RegisterIndex(31);
+
+RegisterIndex argumentRegister(uint32_t index) {
+    return RegisterIndex(4 + index);
+}
+
+// Copies front to back like the BIOS loops, overlapping copies repeat the pattern
+void copyForward(uint8_t *dst, const uint8_t *src, uint32_t length) {
+    if (dst <= src || dst >= src + length) {
+        std::memmove(dst, src, length);
+        return;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        dst[i] = src[i];
+    }
+}
+
+int32_t compare(const uint8_t *a, const uint8_t *b, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (a[i] != b[i]) {
+            return a[i] - b[i];
+        }
+    }
+    return 0;
+}
+
+template <typename... Args>
+void appendFormatted(std::string &out, const std::string &spec, Args... args) {
+    auto length = std::snprintf(nullptr, 0, spec.c_str(), args...);
+    if (length <= 0) {
+        return;
+    }
+    auto offset = out.size();
+    out.resize(offset + length + 1);
+    std::snprintf(out.data() + offset, length + 1, spec.c_str(), args...);
+    out.resize(offset + length);
+}
+} // namespace
+
+BiosHle::BiosHle(Memory *memory)
+    : _memory(memory) {}
+
+uint8_t *BiosHle::ramPointer(uint32_t address, uint32_t length) const {
+    auto *ram = _memory->ram();
+    // Host writes would bypass the debugger
+    if (!ram || !ram->data() || !_memory->watchpoints().empty()) {
+        return nullptr;
+    }
+    auto physical = address & 0x1FFFFFFF;
+    if (physical >= RAM_MIRRORS_SIZE) {
+        return nullptr;
+    }
+    auto offset = physical % ram->size();
+    if (length > ram->size() - offset) {
+        return nullptr;
+    }
+    return ram->data() + offset;
+}
+
+void BiosHle::ramWritten(const uint8_t *data, uint32_t length) {
+    _memory->ramWritten(static_cast<uint32_t>(data - _memory->ram()->data()), length);
+}
+
+std::optional<uint32_t> BiosHle::stringLength(uint32_t address) const {
+    const auto *start = ramPointer(address, 1);
+    if (!start) {
+        return {};
+    }
+    auto available = static_cast<uint32_t>(_memory->ram()->data() + _memory->ram()->size() - start);
+    const auto *end = static_cast<const uint8_t *>(std::memchr(start, 0, available));
+    if (!end) {
+        return {};
+    }
+    return static_cast<uint32_t>(end - start);
+}
+
+std::optional<uint32_t> BiosHle::argument(const CpuState &state, uint32_t index) const {
+    if (index < 4) {
+        return state.getRegister(argumentRegister(index));
+    }
+    // Further arguments follow the home area of the register arguments on the stack
+    const auto *slot = ramPointer(state.getRegister(SP) + index * 4, 4);
+    if (!slot) {
+        return {};
+    }
+    uint32_t value;
+    std::memcpy(&value, slot, sizeof(value));
+    return value;
+}
+
+std::optional<std::string> BiosHle::format(const CpuState &state) const {
+    auto formatAddress = state.getRegister(argumentRegister(0));
+    auto length = stringLength(formatAddress);
+    if (!length) {
+        return {};
+    }
+    const auto *text = reinterpret_cast<const char *>(ramPointer(formatAddress, *length));
+
+    std::string out;
+    uint32_t next = 1;
+    for (uint32_t i = 0; i < *length; i++) {
+        if (text[i] != '%') {
+            out += text[i];
+            continue;
+        }
+
+        // Flags, width and precision are handed to snprintf
+        auto spec = std::string("%");
+        i++;
+        while (i < *length && std::strchr("-+ #0", text[i])) {
+            spec += text[i++];
+        }
+        while (i < *length && (std::isdigit(static_cast<unsigned char>(text[i])) || text[i] == '.')) {
+            spec += text[i++];
+        }
+        // Every argument is a 32 bit word, so length modifiers make no difference
+        while (i < *length && (text[i] == 'l' || text[i] == 'h')) {
+            i++;
+        }
+        if (i == *length || spec.size() > 8) {
+            return {};
+        }
+
+        auto conversion = text[i];
+        if (conversion == '%') {
+            out += '%';
+            continue;
+        }
+        if (!std::strchr("diuxXocsp", conversion)) {
+            return {};
+        }
+        auto value = argument(state, next++);
+        if (!value) {
+            return {};
+        }
+
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            appendFormatted(out, spec + 'd', static_cast<int32_t>(*value));
+            break;
+        case 'c':
+            appendFormatted(out, spec + 'c', static_cast<int>(static_cast<uint8_t>(*value)));
+            break;
+        case 's': {
+            auto stringSize = stringLength(*value);
+            if (!stringSize) {
+                return {};
+            }
+            auto string = std::string(reinterpret_cast<const char *>(ramPointer(*value, *stringSize)), *stringSize);
+            appendFormatted(out, spec + 's', string.c_str());
+            break;
+        }
+        case 'p':
+            appendFormatted(out, spec + 'x', *value);
+            break;
+        default:
+            appendFormatted(out, spec + conversion, *value);
+            break;
+        }
+    }
+    return out;
+}
+
+void BiosHle::writeTty(const std::string &text) {
+    if (!_tty) {
+        return;
+    }
+    _tty->write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (text.find('\n') != std::string::npos) {
+        _tty->flush();
+    }
+}
+
+std::optional<uint32_t> BiosHle::call(uint32_t pc, CpuState &state) {
+    auto function = state.getRegister(T1) & 0xFF;
+    // Number of bytes the function worked on
+    std::optional<uint32_t> bytes;
+    switch (pc & 0xFF) {
+    case VECTOR_A0:
+        bytes = callA0(function, state);
+        break;
+    case VECTOR_B0:
+        bytes = callB0(function, state);
+        break;
+    default:
+        break;
+    }
+    if (!bytes) {
+        return {};
+    }
+
+    spdlog::trace("[hle] {:#04x}:{:#04x} returns {:#010x}", pc & 0xFF, function, state.getRegister(V0));
+    _calls++;
+    state.setProgramCounter(state.getRegister(RA));
+    return CALL_CYCLES + *bytes * CYCLES_PER_BYTE;
+}
+
+std::optional<uint32_t> BiosHle::callA0(uint32_t function, CpuState &state) {
+    auto a0 = state.getRegister(argumentRegister(0));
+    auto a1 = state.getRegister(argumentRegister(1));
+    auto a2 = state.getRegister(argumentRegister(2));
+    // Lengths are signed, the BIOS has its own ideas about zero and negative ones
+    auto length = static_cast<int32_t>(a2);
+
+    // putchar is captured even without HLE, the other output functions end up in it
+    if (function == 0x3C) {
+        writeTty(std::string(1, static_cast<char>(a0)));
+        if (!_enabled) {
+            return {};
+        }
+        state.setRegister(V0, a0 & 0xFF);
+        return 0;
+    }
+    if (!_enabled) {
+        return {};
+    }
+
+    switch (function) {
+    case 0x17:   // strcmp(str1, str2)
+    case 0x18: { // strncmp(str1, str2, maxlen)
+        auto first = stringLength(a0);
+        auto second = stringLength(a1);
+        if (a0 == 0 || a1 == 0 || !first || !second) {
+            return {};
+        }
+        auto count = std::min(*first, *second) + 1;
+        if (function == 0x18) {
+            if (length < 0) {
+                return {};
+            }
+            count = std::min<uint32_t>(count, length);
+        }
+        state.setRegister(V0, static_cast<uint32_t>(compare(ramPointer(a0, count), ramPointer(a1, count), count)));
+        return count;
+    }
+    case 0x19: { // strcpy(dst, src)
+        auto size = stringLength(a1);
+        auto *dst = size ? ramPointer(a0, *size + 1) : nullptr;
+        if (a0 == 0 || a1 == 0 || !dst) {
+            return {};
+        }
+        copyForward(dst, ramPointer(a1, *size + 1), *size + 1);
+        ramWritten(dst, *size + 1);
+        state.setRegister(V0, a0);
+        return *size + 1;
+    }
+    case 0x1B: { // strlen(src)
+        auto size = stringLength(a0);
+        if (a0 == 0 || !size) {
+            return {};
+        }
+        state.setRegister(V0, *size);
+        return *size;
+    }
+    case 0x25: // toupper(char)
+        state.setRegister(V0, static_cast<uint32_t>(std::toupper(static_cast<uint8_t>(a0))));
+        return 0;
+    case 0x26: // tolower(char)
+        state.setRegister(V0, static_cast<uint32_t>(std::tolower(static_cast<uint8_t>(a0))));
+        return 0;
+    case 0x27: { // bcopy(src, dst, len)
+        auto *src = ramPointer(a0, a2);
+        auto *dst = ramPointer(a1, a2);
+        if (a0 == 0 || a1 == 0 || length <= 0 || !src || !dst) {
+            return {};
+        }
+        copyForward(dst, src, a2);
+        ramWritten(dst, a2);
+        return a2;
+    }
+    case 0x28: { // bzero(dst, len)
+        auto *dst = ramPointer(a0, a2);
+        if (a0 == 0 || length <= 0 || !dst) {
+            return {};
+        }
+        std::memset(dst, 0, a2);
+        ramWritten(dst, a2);
+        state.setRegister(V0, a0);
+        return a2;
+    }
+    case 0x29:   // bcmp(ptr1, ptr2, len)
+    case 0x2D: { // memcmp(src1, src2, len)
+        auto *first = ramPointer(a0, a2);
+        auto *second = ramPointer(a1, a2);
+        if (a0 == 0 || a1 == 0 || length <= 0 || !first || !second) {
+            return {};
+        }
+        state.setRegister(V0, static_cast<uint32_t>(compare(first, second, a2)));
+        return a2;
+    }
+    case 0x2A:   // memcpy(dst, src, len)
+    case 0x2C: { // memmove(dst, src, len)
+        auto *dst = ramPointer(a0, a2);
+        auto *src = ramPointer(a1, a2);
+        if (a0 == 0 || a1 == 0 || length <= 0 || !dst || !src) {
+            return {};
+        }
+        if (function == 0x2A) {
+            copyForward(dst, src, a2);
+        } else {
+            std::memmove(dst, src, a2);
+        }
+        ramWritten(dst, a2);
+        state.setRegister(V0, a0);
+        return a2;
+    }
+    case 0x2B: { // memset(dst, fillbyte, len)
+        auto *dst = ramPointer(a0, a2);
+        if (a0 == 0 || length <= 0 || !dst) {
+            return {};
+        }
+        std::memset(dst, static_cast<uint8_t>(a1), a2);
+        ramWritten(dst, a2);
+        state.setRegister(V0, a0);
+        return a2;
+    }
+    case 0x2E: { // memchr(src, scanbyte, len)
+        auto *src = ramPointer(a0, a2);
+        if (a0 == 0 || length <= 0 || !src) {
+            return {};
+        }
+        const auto *found = static_cast<const uint8_t *>(std::memchr(src, static_cast<uint8_t>(a1), a2));
+        state.setRegister(V0, found ? a0 + static_cast<uint32_t>(found - src) : 0);
+        return found ? static_cast<uint32_t>(found - src) + 1 : a2;
+    }
+    case 0x3E: // puts(src)
+        return callB0(0x3F, state);
+    case 0x3F: { // printf(txt, param1, param2, ...)
+        auto text = format(state);
+        if (!text) {
+            return {};
+        }
+        writeTty(*text);
+        state.setRegister(V0, static_cast<uint32_t>(text->size()));
+        return static_cast<uint32_t>(text->size());
+    }
+    default:
+        return {};
+    }
+}
+
+std::optional<uint32_t> BiosHle::callB0(uint32_t function, CpuState &state) {
+    auto a0 = state.getRegister(argumentRegister(0));
+    switch (function) {
+    case 0x3D: // std_out_putchar(char)
+        writeTty(std::string(1, static_cast<char>(a0)));
+        if (!_enabled) {
+            return {};
+        }
+        state.setRegister(V0, a0 & 0xFF);
+        return 0;
+    case 0x3F: { // std_out_puts(src)
+        auto size = stringLength(a0);
+        if (!_enabled || a0 == 0 || !size) {
+            return {};
+        }
+        writeTty(std::string(reinterpret_cast<const char *>(ramPointer(a0, *size)), *size));
+        state.setRegister(V0, *size);
+        return *size;
+    }
+    default:
+        return {};
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cpustate.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+
+class Memory;
+
+// High level emulation of BIOS kernel functions. Programs call the kernel by jumping
+// to 0xA0, 0xB0 or 0xC0 with the function number in $t1. When enabled, the memory and
+// string functions and the TTY output functions run natively on host RAM and return
+// to $ra; everything else, and calls whose arguments are not plain RAM, fall back to
+// the BIOS code. TTY output is captured to a host stream with or without HLE.
+class BiosHle {
+public:
+    // Approximate guest cost of a native call, so timing stays in the right ballpark
+    static constexpr uint32_t CALL_CYCLES = 20;
+    static constexpr uint32_t CYCLES_PER_BYTE = 4;
+
+private:
+    Memory *_memory;
+    bool _enabled = false;
+    std::ostream *_tty = nullptr;
+    uint64_t _calls = 0;
+
+    uint8_t *ramPointer(uint32_t address, uint32_t length) const;
+    // Reports a host write through a ramPointer() to the code write protection
+    void ramWritten(const uint8_t *data, uint32_t length);
+    std::optional<uint32_t> stringLength(uint32_t address) const;
+    std::optional<uint32_t> argument(const CpuState &state, uint32_t index) const;
+    std::optional<std::string> format(const CpuState &state) const;
+    void writeTty(const std::string &text);
+
+    // Return the number of bytes processed if the call ran natively
+    std::optional<uint32_t> callA0(uint32_t function, CpuState &state);
+    std::optional<uint32_t> callB0(uint32_t function, CpuState &state);
+
+public:
+    explicit BiosHle(Memory *memory);
+
+    static bool isKernelCall(uint32_t pc) {
+        auto address = pc & 0x1FFFFFFF;
+        return address == 0xA0 || address == 0xB0 || address == 0xC0;
+    }
+
+    void setEnabled(bool enabled) { _enabled = enabled; }
+    bool enabled() const { return _enabled; }
+    // Receives putchar, puts and printf output, may be null
+    void setTtyStream(std::ostream *tty) { _tty = tty; }
+    std::ostream *ttyStream() const { return _tty; }
+    // True if kernel calls have to be looked at
+    bool active() const { return _enabled || _tty; }
+    // Number of calls that ran natively
+    uint64_t calls() const { return _calls; }
+
+    // Called with the CPU at a kernel call vector and all loads applied. Returns the
+    // cycles taken if the call ran natively, the result is in $v0 then.
+    std::optional<uint32_t> call(uint32_t pc, CpuState &state);
+};
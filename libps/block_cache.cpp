@@ -0,0 +1,82 @@
+#include "block_cache.hpp"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+const BlockIr::Block *BlockCache::translate(uint32_t address, const CodeWindow &window, Memory &memory) {
+    // A block never leaves its page, so protecting the page of its address covers it
+    if (window.segment != MemorySegment::BIOS && !memory.protectCode(address)) {
+        return nullptr;
+    }
+
+    auto &block = _blocks[address];
+    if (!block) {
+        auto stored = _file ? _file->block(address, window.page) : std::nullopt;
+        if (stored) {
+            block = std::make_unique<BlockIr::Block>(std::move(*stored));
+            _loaded++;
+        } else {
+            block = std::make_unique<BlockIr::Block>(BlockIr::translate(address, window.page));
+            spdlog::trace("[blocks] translated {} instructions at {:#010x}", block->code.size(), address);
+        }
+        if (window.segment != MemorySegment::BIOS) {
+            auto ramPage = (address & 0x1FFFFFFF) >> MEMORY_PAGE_SHIFT;
+            if (ramPage >= _ramPages.size()) {
+                _ramPages.resize(ramPage + 1);
+            }
+            _ramPages[ramPage].push_back(address);
+        }
+    }
+    _lookup[slot(address)] = block.get();
+    return block.get();
+}
+
+void BlockCache::codeWritten(uint32_t offset, uint32_t size) {
+    if (size == 0 || _ramPages.empty()) {
+        return;
+    }
+    auto first = offset >> MEMORY_PAGE_SHIFT;
+    auto last = std::min<size_t>((offset + size - 1) >> MEMORY_PAGE_SHIFT, _ramPages.size() - 1);
+    for (size_t ramPage = first; ramPage <= last; ramPage++) {
+        for (auto address : _ramPages[ramPage]) {
+            auto it = _blocks.find(address);
+            if (it == _blocks.end()) {
+                continue;
+            }
+            if (_lookup[slot(address)] == it->second.get()) {
+                _lookup[slot(address)] = nullptr;
+            }
+            _dropped.push_back(std::move(it->second));
+            _blocks.erase(it);
+            _invalidated = true;
+        }
+        _ramPages[ramPage].clear();
+    }
+}
+
+void BlockCache::reset() {
+    _blocks.clear();
+    _lookup = {};
+    _ramPages.clear();
+    _dropped.clear();
+    _invalidated = false;
+    _loaded = 0;
+}
+
+void BlockCache::save(const std::string &path, uint64_t biosHash) const {
+    std::vector<const BlockIr::Block *> blocks;
+    for (const auto &[address, block] : _blocks) {
+        blocks.push_back(block.get());
+    }
+    // Code this run did not get to stays in the file
+    std::vector<BlockIr::Block> stored;
+    if (_file) {
+        stored = _file->blocks();
+        for (const auto &block : stored) {
+            if (_blocks.find(block.address) == _blocks.end()) {
+                blocks.push_back(&block);
+            }
+        }
+    }
+    BlockCacheFile::write(path, biosHash, blocks);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "block_cache_file.hpp"
+#include "block_ir.hpp"
+#include "memory.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Translated blocks by address for the cached interpreter. Blocks in RAM protect
+// their page, see Memory::protectCode(), and are dropped when it is written. Code
+// in other writable memory, i.e. the scratchpad, is not cached. Blocks that are
+// not cached yet come from the BlockCacheFile if one is loaded.
+class BlockCache {
+public:
+    static constexpr uint32_t LOOKUP_ENTRIES = 4096;
+
+private:
+    std::unordered_map<uint32_t, std::unique_ptr<BlockIr::Block>> _blocks;
+    // Direct mapped in front of _blocks
+    std::array<const BlockIr::Block *, LOOKUP_ENTRIES> _lookup = {};
+    // Addresses of the blocks in each RAM page
+    std::vector<std::vector<uint32_t>> _ramPages;
+    // Dropped while one of them may still run, freed by collect()
+    std::vector<std::unique_ptr<BlockIr::Block>> _dropped;
+    bool _invalidated = false;
+    std::shared_ptr<const BlockCacheFile> _file;
+    // Blocks taken from _file
+    size_t _loaded = 0;
+
+    static uint32_t slot(uint32_t address) { return (address >> 2) & (LOOKUP_ENTRIES - 1); }
+    const BlockIr::Block *translate(uint32_t address, const CodeWindow &window, Memory &memory);
+
+public:
+    // Block at address, null if it cannot be cached. The window is the one of
+    // address and has a page.
+    const BlockIr::Block *block(uint32_t address, const CodeWindow &window, Memory &memory) {
+        const auto *block = _lookup[slot(address)];
+        if (block && block->address == address) {
+            return block;
+        }
+        return translate(address, window, memory);
+    }
+
+    // Drops the blocks in the RAM range, see ICodeWriteListener
+    void codeWritten(uint32_t offset, uint32_t size);
+    // Tells once if blocks were dropped since the last call
+    bool takeInvalidated() {
+        auto invalidated = _invalidated;
+        _invalidated = false;
+        return invalidated;
+    }
+    // Frees the dropped blocks, none of them may be running
+    void collect() { _dropped.clear(); }
+    // Drops the cached blocks, the file stays
+    void reset();
+    size_t size() const { return _blocks.size(); }
+
+    void setFile(std::shared_ptr<const BlockCacheFile> file) { _file = std::move(file); }
+    size_t loaded() const { return _loaded; }
+    // Writes the cached blocks and those of the file that were not used to path,
+    // see BlockCacheFile::write()
+    void save(const std::string &path, uint64_t biosHash) const;
+};
@@ -0,0 +1,138 @@
+#include "block_cache_file.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<BlockIr::Instruction>, "Instructions are stored as they are in memory");
+
+BlockCacheFile::BlockCacheFile(const std::string &path, uint64_t biosHash) : _file(path) {
+    Header header;
+    if (_file.size() < sizeof(header) || std::memcmp(_file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(fmt::format("{} is not a block cache", path));
+    }
+    std::memcpy(&header, _file.data(), sizeof(header));
+    if (header.version != VERSION || header.instructionSize != sizeof(BlockIr::Instruction)) {
+        throw std::runtime_error(fmt::format("Unsupported block cache version {} in {}", header.version, path));
+    }
+    if (header.biosHash != biosHash) {
+        throw std::runtime_error(fmt::format("Block cache {} belongs to another BIOS", path));
+    }
+
+    auto codeOffset = sizeof(Header) + static_cast<size_t>(header.blockCount) * sizeof(Entry);
+    if (_file.size() < codeOffset || (_file.size() - codeOffset) % sizeof(BlockIr::Instruction) != 0) {
+        throw std::runtime_error(fmt::format("Block cache {} is truncated", path));
+    }
+    // The mapping is page aligned and the header and entries keep the alignment
+    _entries = reinterpret_cast<const Entry *>(_file.data() + sizeof(Header));
+    _blockCount = header.blockCount;
+    _code = reinterpret_cast<const BlockIr::Instruction *>(_file.data() + codeOffset);
+    _instructionCount = (_file.size() - codeOffset) / sizeof(BlockIr::Instruction);
+    spdlog::info("[blocks] {} translated blocks in {}", _blockCount, path);
+}
+
+const BlockCacheFile::Entry *BlockCacheFile::find(uint32_t address) const {
+    const auto *end = _entries + _blockCount;
+    const auto *entry = std::lower_bound(_entries, end, address,
+                                         [](const Entry &entry, uint32_t address) { return entry.address < address; });
+    if (entry == end || entry->address != address) {
+        return nullptr;
+    }
+    // Entries are only checked when used, a damaged one is ignored
+    if (entry->count == 0 || entry->count > BlockIr::MAX_BLOCK_INSTRUCTIONS || entry->first > _instructionCount ||
+        entry->count > _instructionCount - entry->first) {
+        return nullptr;
+    }
+    return entry;
+}
+
+std::optional<BlockIr::Block> BlockCacheFile::block(uint32_t address, const uint8_t *page) const {
+    const auto *entry = find(address);
+    if (!entry) {
+        return std::nullopt;
+    }
+    // Blocks do not leave their page, and the same code at the same address
+    // translates to the same block
+    auto offset = address & MEMORY_PAGE_MASK;
+    auto size = entry->count * sizeof(uint32_t);
+    if (offset + size > MEMORY_PAGE_SIZE || hash(page + offset, size) != entry->codeHash) {
+        return std::nullopt;
+    }
+    return BlockIr::Block{address, {_code + entry->first, _code + entry->first + entry->count}};
+}
+
+std::vector<BlockIr::Block> BlockCacheFile::blocks() const {
+    std::vector<BlockIr::Block> blocks;
+    for (size_t i = 0; i < _blockCount; i++) {
+        if (const auto *entry = find(_entries[i].address)) {
+            blocks.push_back(BlockIr::Block{entry->address, {_code + entry->first, _code + entry->first + entry->count}});
+        }
+    }
+    return blocks;
+}
+
+uint64_t BlockCacheFile::hash(const uint8_t *data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+uint64_t BlockCacheFile::codeHash(const BlockIr::Block &block) {
+    // The raw opcodes are the code bytes of the block
+    auto result = hash(nullptr, 0);
+    for (const auto &instruction : block.code) {
+        uint8_t bytes[sizeof(instruction.raw)];
+        std::memcpy(bytes, &instruction.raw, sizeof(bytes));
+        result = hash(bytes, sizeof(bytes), result);
+    }
+    return result;
+}
+
+void BlockCacheFile::write(const std::string &path, uint64_t biosHash, const std::vector<const BlockIr::Block *> &blocks) {
+    auto sorted = blocks;
+    std::sort(sorted.begin(), sorted.end(), [](const auto *a, const auto *b) { return a->address < b->address; });
+
+    auto header = Header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.instructionSize = sizeof(BlockIr::Instruction);
+    header.biosHash = biosHash;
+    header.blockCount = static_cast<uint32_t>(sorted.size());
+
+    std::vector<Entry> entries;
+    uint32_t first = 0;
+    for (const auto *block : sorted) {
+        entries.push_back(Entry{block->address, static_cast<uint32_t>(block->code.size()), codeHash(*block), first, 0});
+        first += static_cast<uint32_t>(block->code.size());
+    }
+
+    // Other runs may write the same file, the rename replaces it as a whole
+    auto temporary = fmt::format("{}.{:08x}.tmp", path, std::random_device()());
+    {
+        auto file = std::ofstream(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error(fmt::format("Error creating block cache {}", temporary));
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+        for (const auto *block : sorted) {
+            file.write(reinterpret_cast<const char *>(block->code.data()),
+                       static_cast<std::streamsize>(block->code.size() * sizeof(BlockIr::Instruction)));
+        }
+        if (!file.flush()) {
+            std::filesystem::remove(temporary);
+            throw std::runtime_error(fmt::format("Error writing block cache {}", temporary));
+        }
+    }
+    std::filesystem::rename(temporary, path);
+    spdlog::info("[blocks] Saved {} translated blocks to {}", sorted.size(), path);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "block_ir.hpp"
+#include "libutils/mapped_memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Translated blocks kept on disk between runs, so a cold start does not translate
+// the BIOS and the game again. A file belongs to one BIOS image and every block
+// to the code it was translated from: BlockCache looks a block up on its first
+// execution and uses it only if the code at its address still hashes the same.
+//
+//   header:  "PSBC" u16 version u16 instruction size u64 BIOS hash u32 block count u32 reserved
+//   index:   per block u32 address u32 instruction count u64 code hash u32 first instruction u32 reserved,
+//            sorted by address
+//   code:    BlockIr::Instruction records
+//
+// The file is mapped and read in place, integers are in host byte order. Bump
+// VERSION whenever the IR or its passes change what a translation yields.
+class BlockCacheFile {
+public:
+    static constexpr char MAGIC[4] = {'P', 'S', 'B', 'C'};
+    static constexpr uint16_t VERSION = 1;
+
+private:
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint16_t instructionSize;
+        uint64_t biosHash;
+        uint32_t blockCount;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        uint32_t address;
+        uint32_t count;
+        uint64_t codeHash;
+        uint32_t first;
+        uint32_t reserved;
+    };
+
+    MappedFile _file;
+    const Entry *_entries = nullptr;
+    size_t _blockCount = 0;
+    const BlockIr::Instruction *_code = nullptr;
+    size_t _instructionCount = 0;
+
+    const Entry *find(uint32_t address) const;
+    static uint64_t codeHash(const BlockIr::Block &block);
+
+public:
+    // Throws when the file cannot be read, is not a block cache of this version or
+    // belongs to another BIOS
+    BlockCacheFile(const std::string &path, uint64_t biosHash);
+
+    // The stored block at address if the code in page, the host memory of its
+    // page, is the one it was translated from
+    std::optional<BlockIr::Block> block(uint32_t address, const uint8_t *page) const;
+    // Every stored block, whether its code is still there or not
+    std::vector<BlockIr::Block> blocks() const;
+    size_t size() const { return _blockCount; }
+
+    // FNV-1a, over the BIOS image for the file and over code for the blocks
+    static uint64_t hash(const uint8_t *data, size_t size, uint64_t hash = 0xCBF29CE484222325);
+    // Writes the blocks to path through a temporary file, so concurrent runs never
+    // see half of a file. Throws when it cannot be written.
+    static void write(const std::string &path, uint64_t biosHash, const std::vector<const BlockIr::Block *> &blocks);
+};
@@ -0,0 +1,247 @@
+#include "block_ir.hpp"
+#include "memory.hpp"
+#include "opcode.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace BlockIr {
+
+namespace {
+constexpr uint32_t ZERO_REGISTER = 1;
+
+uint32_t bit(uint8_t index) {
+    return 1u << index;
+}
+
+bool isAlu(Op op) {
+    return op >= Op::Constant && op <= Op::ShiftRightArithmeticVariable;
+}
+
+bool isLoad(Op op) {
+    return op >= Op::LoadByte && op <= Op::LoadWord;
+}
+
+// Jumps and branches, a block ends after their delay slot
+bool isBranch(uint32_t raw) {
+    auto opcode = Opcode(raw);
+    switch (opcode.instruction()) {
+    case 0x00: {
+        auto subfunction = opcode.subfunction();
+        return subfunction == 0x08 || subfunction == 0x09; // jr, jalr
+    }
+    case 0x01: // bcond
+    case 0x02: // j
+    case 0x03: // jal
+    case 0x04: // beq
+    case 0x05: // bne
+    case 0x06: // blez
+    case 0x07: // bgtz
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Fills a load delay slot, i.e. the loads and mfc0, mfc2 and cfc2
+bool mayLoad(const Instruction &instruction) {
+    if (isLoad(instruction.op)) {
+        return true;
+    }
+    if (instruction.op != Op::Generic) {
+        return false;
+    }
+    auto primary = instruction.raw >> 26;
+    return primary == 0x10 || primary == 0x12 || (primary >= 0x20 && primary <= 0x27);
+}
+
+// Registers an instruction may read. For the handlers these are the register
+// fields, which covers every instruction that reads general purpose registers.
+uint32_t reads(const Instruction &instruction) {
+    switch (instruction.op) {
+    case Op::Generic:
+        return bit(instruction.rs) | bit(instruction.rt);
+    case Op::Nop:
+    case Op::Constant:
+        return 0;
+    case Op::AddImmediate:
+    case Op::AndImmediate:
+    case Op::OrImmediate:
+    case Op::XorImmediate:
+    case Op::SetLessThanImmediate:
+    case Op::SetLessThanImmediateUnsigned:
+        return bit(instruction.rs);
+    case Op::ShiftLeft:
+    case Op::ShiftRightLogical:
+    case Op::ShiftRightArithmetic:
+        return bit(instruction.rt);
+    case Op::LoadByte:
+    case Op::LoadByteUnsigned:
+    case Op::LoadHalf:
+    case Op::LoadHalfUnsigned:
+    case Op::LoadWord:
+        return (instruction.flags & Flags::ConstantAddress) ? 0 : bit(instruction.rs);
+    default:
+        return bit(instruction.rs) | bit(instruction.rt);
+    }
+}
+
+// Registers an instruction may write, right away or through a delay slot
+uint32_t writes(const Instruction &instruction) {
+    if (instruction.op == Op::Nop) {
+        return 0;
+    }
+    if (isAlu(instruction.op)) {
+        return bit(instruction.rd);
+    }
+    if (isLoad(instruction.op)) {
+        return bit(instruction.rt);
+    }
+    // jal and the bcond link variants write $ra
+    return bit(instruction.rt) | bit((instruction.raw >> 11) & 0x1F) | bit(31);
+}
+
+Instruction decodeInstruction(uint32_t raw) {
+    auto opcode = Opcode(raw);
+    auto instruction = Instruction{};
+    instruction.raw = raw;
+    instruction.rs = opcode.rs().index();
+    instruction.rt = opcode.rt().index();
+
+    auto simple = [&instruction](Op op, uint8_t rd, uint32_t imm) {
+        instruction.op = op;
+        instruction.rd = rd;
+        instruction.imm = imm;
+        return instruction;
+    };
+    auto rd = opcode.rd().index();
+    auto rt = instruction.rt;
+    auto signedImm = static_cast<uint32_t>(static_cast<int32_t>(opcode.imm16signed()));
+
+    switch (opcode.instruction()) {
+    case 0x00:
+        switch (opcode.subfunction()) {
+        case 0x00: return simple(Op::ShiftLeft, rd, opcode.imm5());
+        case 0x02: return simple(Op::ShiftRightLogical, rd, opcode.imm5());
+        case 0x03: return simple(Op::ShiftRightArithmetic, rd, opcode.imm5());
+        case 0x04: return simple(Op::ShiftLeftVariable, rd, 0);
+        case 0x06: return simple(Op::ShiftRightLogicalVariable, rd, 0);
+        case 0x07: return simple(Op::ShiftRightArithmeticVariable, rd, 0);
+        case 0x21: return simple(Op::Add, rd, 0);
+        case 0x23: return simple(Op::Subtract, rd, 0);
+        case 0x24: return simple(Op::And, rd, 0);
+        case 0x25: return simple(Op::Or, rd, 0);
+        case 0x26: return simple(Op::Xor, rd, 0);
+        case 0x27: return simple(Op::Nor, rd, 0);
+        case 0x2A: return simple(Op::SetLessThan, rd, 0);
+        case 0x2B: return simple(Op::SetLessThanUnsigned, rd, 0);
+        default: return instruction;
+        }
+    case 0x09: return simple(Op::AddImmediate, rt, signedImm);
+    case 0x0A: return simple(Op::SetLessThanImmediate, rt, signedImm);
+    // The immediate is sign extended but compared unsigned
+    case 0x0B: return simple(Op::SetLessThanImmediateUnsigned, rt, signedImm);
+    case 0x0C: return simple(Op::AndImmediate, rt, opcode.imm16());
+    case 0x0D: return simple(Op::OrImmediate, rt, opcode.imm16());
+    case 0x0E: return simple(Op::XorImmediate, rt, opcode.imm16());
+    case 0x0F: return simple(Op::Constant, rt, static_cast<uint32_t>(opcode.imm16()) << 16);
+    case 0x20: return simple(Op::LoadByte, 0, signedImm);
+    case 0x21: return simple(Op::LoadHalf, 0, signedImm);
+    case 0x23: return simple(Op::LoadWord, 0, signedImm);
+    case 0x24: return simple(Op::LoadByteUnsigned, 0, signedImm);
+    case 0x25: return simple(Op::LoadHalfUnsigned, 0, signedImm);
+    default: return instruction;
+    }
+}
+} // namespace
+
+Block decode(uint32_t address, const uint8_t *page) {
+    auto block = Block{address, {}};
+    auto pageEnd = (address & ~MEMORY_PAGE_MASK) + MEMORY_PAGE_SIZE;
+    auto delaySlot = false;
+    for (auto pc = address; pc != pageEnd && block.code.size() < MAX_BLOCK_INSTRUCTIONS; pc += 4) {
+        auto physical = pc & 0x1FFFFFFF;
+        if (pc != address && (physical == 0xA0 || physical == 0xB0 || physical == 0xC0)) {
+            break;
+        }
+
+        uint32_t raw;
+        std::memcpy(&raw, page + (pc & MEMORY_PAGE_MASK), sizeof(raw));
+        block.code.push_back(decodeInstruction(raw));
+        if (delaySlot) {
+            break;
+        }
+        delaySlot = isBranch(raw);
+    }
+    return block;
+}
+
+void propagateConstants(Block &block) {
+    auto known = ZERO_REGISTER;
+    auto values = std::array<uint32_t, 32>{};
+    for (auto &instruction : block.code) {
+        if (isAlu(instruction.op) && (reads(instruction) & ~known) == 0) {
+            instruction.imm = evaluate(instruction.op, values[instruction.rs], values[instruction.rt], instruction.imm);
+            instruction.op = Op::Constant;
+        }
+        if (isLoad(instruction.op) && (known & bit(instruction.rs)) && !(instruction.flags & Flags::ConstantAddress)) {
+            instruction.imm += values[instruction.rs];
+            instruction.flags |= Flags::ConstantAddress;
+        }
+
+        known &= ~writes(instruction);
+        if (instruction.op == Op::Constant) {
+            known |= bit(instruction.rd);
+            values[instruction.rd] = instruction.imm;
+        }
+        known |= ZERO_REGISTER;
+        values[0] = 0;
+    }
+}
+
+void eliminateZeroWrites(Block &block) {
+    for (auto &instruction : block.code) {
+        // Loads to $0 still access memory and may fault
+        if (isAlu(instruction.op) && instruction.rd == 0) {
+            instruction.op = Op::Nop;
+        }
+    }
+}
+
+void resolveDelaySlots(Block &block) {
+    auto &code = block.code;
+    for (size_t i = 0; i < code.size(); i++) {
+        auto &instruction = code[i];
+        instruction.flags &= Flags::ConstantAddress;
+
+        // Whatever ran before the block may have left a load or a branch pending
+        auto previousLoads = i == 0 || mayLoad(code[i - 1]);
+        auto previousBranches = i == 0 || (code[i - 1].op == Op::Generic && isBranch(code[i - 1].raw));
+        if (previousLoads && isAlu(instruction.op)) {
+            instruction.flags |= Flags::CancelsLoad;
+        }
+        if (previousLoads || mayLoad(instruction)) {
+            instruction.flags |= Flags::RetireLoads;
+        }
+        if (previousBranches || (instruction.op == Op::Generic && isBranch(instruction.raw))) {
+            instruction.flags |= Flags::RetireBranch;
+        }
+
+        // The first instruction may be a delay slot that leaves the block, the
+        // load has to wait for the branch target then
+        if (isLoad(instruction.op) && i != 0 && i + 1 < code.size() &&
+            !(reads(code[i + 1]) & bit(instruction.rt))) {
+            instruction.flags |= Flags::LoadResolvable;
+        }
+    }
+}
+
+Block translate(uint32_t address, const uint8_t *page) {
+    auto block = decode(address, page);
+    propagateConstants(block);
+    eliminateZeroWrites(block);
+    resolveDelaySlots(block);
+    return block;
+}
+
+} // namespace BlockIr
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Intermediate representation of a basic block between the decoded MIPS code and
+// the backend that executes it, currently the cached interpreter in CPU. A block
+// runs from its address to the delay slot of the first jump or branch, or to the
+// end of its page. Instructions without an operation of their own run through the
+// regular opcode handlers, the passes turn the rest into cheaper operations.
+namespace BlockIr {
+
+constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+enum class Op : uint8_t {
+    // Runs the handler of the raw opcode
+    Generic,
+    // No effect, e.g. a nop or an ALU operation on $0
+    Nop,
+    // rd = imm, the result was known at translation time
+    Constant,
+    // rd = rs op imm
+    AddImmediate,
+    AndImmediate,
+    OrImmediate,
+    XorImmediate,
+    SetLessThanImmediate,
+    SetLessThanImmediateUnsigned,
+    // rd = rs op rt
+    Add,
+    Subtract,
+    And,
+    Or,
+    Xor,
+    Nor,
+    SetLessThan,
+    SetLessThanUnsigned,
+    // rd = rt shifted by imm
+    ShiftLeft,
+    ShiftRightLogical,
+    ShiftRightArithmetic,
+    // rd = rt shifted by rs
+    ShiftLeftVariable,
+    ShiftRightLogicalVariable,
+    ShiftRightArithmeticVariable,
+    // rt = memory at rs + imm, misaligned addresses go through the handler
+    LoadByte,
+    LoadByteUnsigned,
+    LoadHalf,
+    LoadHalfUnsigned,
+    LoadWord,
+};
+
+namespace Flags {
+enum : uint8_t {
+    // A load of the previous instruction may still be pending for rd
+    CancelsLoad = 1 << 0,
+    // A load delay slot may be filled when the instruction retires
+    RetireLoads = 1 << 1,
+    // A branch may be pending when the instruction retires
+    RetireBranch = 1 << 2,
+    // The load address is imm, rs was known at translation time
+    ConstantAddress = 1 << 3,
+    // The next instruction of the block does not read the loaded register, so the
+    // load can be written right away if that instruction runs right after it
+    LoadResolvable = 1 << 4,
+};
+} // namespace Flags
+
+struct Instruction {
+    Op op = Op::Generic;
+    uint8_t flags = 0;
+    // Register numbers, the destination is in rd for every operation but loads
+    uint8_t rd = 0;
+    uint8_t rs = 0;
+    uint8_t rt = 0;
+    // Sign extended immediate, shift amount, constant result or load address
+    uint32_t imm = 0;
+    uint32_t raw = 0;
+};
+
+struct Block {
+    uint32_t address = 0;
+    std::vector<Instruction> code;
+};
+
+// Result of an ALU operation, s and t are the values of rs and rt. Matches the
+// handlers in OpcodeImplementationCpu.
+constexpr uint32_t evaluate(Op op, uint32_t s, uint32_t t, uint32_t imm) {
+    switch (op) {
+    case Op::Constant: return imm;
+    case Op::AddImmediate: return s + imm;
+    case Op::AndImmediate: return s & imm;
+    case Op::OrImmediate: return s | imm;
+    case Op::XorImmediate: return s ^ imm;
+    case Op::SetLessThanImmediate: return static_cast<int32_t>(s) < static_cast<int32_t>(imm) ? 1 : 0;
+    case Op::SetLessThanImmediateUnsigned: return s < imm ? 1 : 0;
+    case Op::Add: return s + t;
+    case Op::Subtract: return s - t;
+    case Op::And: return s & t;
+    case Op::Or: return s | t;
+    case Op::Xor: return s ^ t;
+    case Op::Nor: return ~(s | t);
+    case Op::SetLessThan: return static_cast<int32_t>(s) < static_cast<int32_t>(t) ? 1 : 0;
+    case Op::SetLessThanUnsigned: return s < t ? 1 : 0;
+    case Op::ShiftLeft: return t << imm;
+    case Op::ShiftRightLogical: return t >> imm;
+    case Op::ShiftRightArithmetic: return static_cast<uint32_t>(static_cast<int32_t>(t) >> imm);
+    case Op::ShiftLeftVariable: return t << (s & 0x1F);
+    case Op::ShiftRightLogicalVariable: return t >> (s & 0x1F);
+    case Op::ShiftRightArithmeticVariable: return static_cast<uint32_t>(static_cast<int32_t>(t) >> (s & 0x1F));
+    default: return 0;
+    }
+}
+
+// Decodes the block at address, page is the host memory of its page. The BIOS
+// HLE may run the kernel call vectors natively, so a block does not run into one.
+Block decode(uint32_t address, const uint8_t *page);
+// Folds operations whose inputs are known, e.g. the lui/ori pairs that build
+// addresses, and computes the addresses of loads from a known base
+void propagateConstants(Block &block);
+// ALU operations that write $0 do nothing
+void eliminateZeroWrites(Block &block);
+// Works out where load and branch delay slots can be pending, so the backend
+// only keeps track of them where they are, and which loads can be written right
+// away because the next instruction does not see the difference
+void resolveDelaySlots(Block &block);
+// All of the above
+Block translate(uint32_t address, const uint8_t *page);
+
+} // namespace BlockIr
@@ -0,0 +1,48 @@
+#include "breakpoints.hpp"
+
+#include <algorithm>
+
+Breakpoints::Breakpoints()
+    : _pageBits(PAGE_COUNT / 64) {
+}
+
+void Breakpoints::updatePage(uint32_t index) {
+    auto first = std::lower_bound(_addresses.begin(), _addresses.end(), index << MEMORY_PAGE_SHIFT);
+    auto used = first != _addresses.end() && page(*first) == index;
+
+    auto mask = uint64_t(1) << (index & 63);
+    if (used) {
+        _pageBits[index >> 6] |= mask;
+    } else {
+        _pageBits[index >> 6] &= ~mask;
+    }
+}
+
+void Breakpoints::add(uint32_t address) {
+    address &= PHYSICAL_MASK;
+    auto it = std::lower_bound(_addresses.begin(), _addresses.end(), address);
+    if (it == _addresses.end() || *it != address) {
+        _addresses.insert(it, address);
+    }
+    updatePage(page(address));
+}
+
+bool Breakpoints::remove(uint32_t address) {
+    address &= PHYSICAL_MASK;
+    auto it = std::lower_bound(_addresses.begin(), _addresses.end(), address);
+    if (it == _addresses.end() || *it != address) {
+        return false;
+    }
+    _addresses.erase(it);
+    updatePage(page(address));
+    return true;
+}
+
+void Breakpoints::clear() {
+    _addresses.clear();
+    std::fill(_pageBits.begin(), _pageBits.end(), 0);
+}
+
+bool Breakpoints::contains(uint32_t address) const {
+    return std::binary_search(_addresses.begin(), _addresses.end(), address & PHYSICAL_MASK);
+}
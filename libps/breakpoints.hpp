@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory.hpp"
+
+// Execution breakpoints by physical address, so every mirror of an address breaks.
+// Each 4 KiB page has a bit telling whether it holds any breakpoint. Code in pages
+// without breakpoints only pays for that bit test, the address list is searched
+// when the bit is set.
+class Breakpoints {
+public:
+    static constexpr uint32_t PHYSICAL_MASK = 0x1FFFFFFF;
+    static constexpr uint32_t PAGE_COUNT = (PHYSICAL_MASK + 1) >> MEMORY_PAGE_SHIFT;
+
+private:
+    std::vector<uint64_t> _pageBits;
+    // Sorted physical addresses
+    std::vector<uint32_t> _addresses;
+
+    static uint32_t page(uint32_t address) { return (address & PHYSICAL_MASK) >> MEMORY_PAGE_SHIFT; }
+    void updatePage(uint32_t page);
+
+public:
+    Breakpoints();
+
+    void add(uint32_t address);
+    // Returns false if there was no breakpoint at the address
+    bool remove(uint32_t address);
+    void clear();
+
+    bool pageHasBreakpoints(uint32_t address) const {
+        auto index = page(address);
+        return (_pageBits[index >> 6] >> (index & 63)) & 1;
+    }
+
+    bool contains(uint32_t address) const;
+    size_t size() const { return _addresses.size(); }
+};
@@ -0,0 +1,47 @@
+#include "controller.hpp"
+#include "replay.hpp"
+
+#include <spdlog/spdlog.h>
+
+Controller::Controller(uint8_t port, Replay *replay)
+    : _port(port),
+      _replay(replay) {}
+
+void Controller::save(Snapshot &snapshot) const {
+    snapshot = Snapshot{_latched, _step};
+}
+
+void Controller::restore(const Snapshot &snapshot) {
+    _latched = snapshot.latched;
+    _step = snapshot.step;
+}
+
+void Controller::select() {
+    _step = 0;
+}
+
+SioResponse Controller::transfer(uint8_t value, uint64_t cycle) {
+    switch (_step++) {
+    case 0:
+        return SioResponse{0xFF, value == ADDRESS};
+    case 1: {
+        if (value != COMMAND_READ) {
+            spdlog::debug("[pad] unsupported command {:#04x}", value);
+            return SioResponse{0xFF, false};
+        }
+
+        uint16_t pressed = _pressed.load(std::memory_order_relaxed);
+        _latched = _replay ? static_cast<uint16_t>(_replay->input(InputSource::Controller, _port, cycle, pressed)) : pressed;
+        return SioResponse{static_cast<uint8_t>(ID), true};
+    }
+    case 2:
+        return SioResponse{static_cast<uint8_t>(ID >> 8), true};
+    // Buttons are active low
+    case 3:
+        return SioResponse{static_cast<uint8_t>(~_latched), true};
+    case 4:
+        return SioResponse{static_cast<uint8_t>(~_latched >> 8), false};
+    default:
+        return SioResponse{0xFF, false};
+    }
+}
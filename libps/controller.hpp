@@ -0,0 +1,63 @@
+#pragma once
+
+#include "sio_device.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+class Replay;
+
+// Digital pad (SCPH-1080)
+class Controller
+    : public SioDevice {
+public:
+    enum Button : uint16_t {
+        Select = (1 << 0),
+        Start = (1 << 3),
+        Up = (1 << 4),
+        Right = (1 << 5),
+        Down = (1 << 6),
+        Left = (1 << 7),
+        L2 = (1 << 8),
+        R2 = (1 << 9),
+        L1 = (1 << 10),
+        R1 = (1 << 11),
+        Triangle = (1 << 12),
+        Circle = (1 << 13),
+        Cross = (1 << 14),
+        Square = (1 << 15)
+    };
+
+    static constexpr uint8_t ADDRESS = 0x01;
+    static constexpr uint8_t COMMAND_READ = 0x42;
+    static constexpr uint16_t ID = 0x5A41;
+
+private:
+    uint8_t _port;
+    Replay *_replay;
+
+    // Written by the frontend, Button bits of the pressed buttons
+    std::atomic<uint16_t> _pressed = 0;
+    // Sampled once per poll, so all bytes of a poll report the same state
+    uint16_t _latched = 0;
+    uint8_t _step = 0;
+
+public:
+    // Poll in progress for a save state, the pressed buttons are input and not part of it
+    struct Snapshot {
+        uint16_t latched;
+        uint8_t step;
+    };
+
+    // The replay may be null
+    Controller(uint8_t port, Replay *replay);
+
+    // Thread safe
+    void setPressed(uint16_t buttons) { _pressed.store(buttons, std::memory_order_relaxed); }
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    virtual void select() override;
+    virtual SioResponse transfer(uint8_t value, uint64_t cycle) override;
+};
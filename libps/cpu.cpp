@@ -1,26 +1,79 @@
 #include "cpu.hpp"
 #include "libutils/memory_utils.hpp"
-#include "libutils/platform.hpp"
 #include "opcode.hpp"
 #include "opcode_cop0.hpp"
+#include "opcode_cop2.hpp"
 #include "opcode_cpu.hpp"
+#include "timing.hpp"
 
 #include <algorithm>
 #include <cstring>
 #include <fmt/format.h>
 
+// Upper seven bits of a COP2 command (cop2 with bit 25 set)
+constexpr uint32_t GTE_COMMAND_PREFIX = 0x25;
+
 void CPU::setMemory(Memory *memory) {
     _memory = memory;
+    _memory->setWatchpointListener(this);
+    _memory->setCodeWriteListener(this);
 }
 
 void CPU::initializeState() {
     _cpuState.initialize();
+    _gte.reset();
+    _instructionCache.reset();
+    _idleLoops.reset();
+    _idleLoopHit = false;
+    _blockCache.reset();
+    _cycles = 0;
+    _blockCycles = 0;
+    _multiplyDivideReady = 0;
+    _debugStop = {};
+    _resumeAddress = {};
 }
 
 const CpuState *CPU::getCpuState() const {
     return &_cpuState;
 }
 
+CpuState *CPU::getCpuState() {
+    return &_cpuState;
+}
+
+void CPU::setInstructionCacheEnabled(bool enabled) {
+    _instructionCacheEnabled = enabled;
+}
+
+const InstructionCache *CPU::getInstructionCache() const {
+    return &_instructionCache;
+}
+
+void CPU::setBiosHle(BiosHle *biosHle) {
+    _biosHle = biosHle;
+}
+
+void CPU::setIdleLoopDetection(bool enabled) {
+    _idleLoopDetection = enabled;
+}
+
+bool CPU::takeIdleLoop() {
+    auto hit = _idleLoopHit;
+    _idleLoopHit = false;
+    return hit;
+}
+
+void CPU::setCachedInterpreter(bool enabled) {
+    _cachedInterpreter = enabled;
+    if (!enabled) {
+        _blockCache.reset();
+    }
+}
+
+void CPU::skipCycles(uint32_t cycles) {
+    _cycles += cycles;
+}
+
 /*
 Primary opcode field (Bit 26..31)
 
@@ -47,254 +100,662 @@ Secondary opcode field (Bit 0..5) (when Primary opcode = 00h)
 */
 
 void CPU::decodeAndExecute(Opcode opcode) {
-    auto instruction = opcode.instruction();
-    spdlog::trace("[decode] instruction {0:#04x} ({0:#08b})", instruction);
+    spdlog::trace("[decode] instruction {0:#04x} ({0:#08b})", opcode.instruction());
 
-    IOpcodeCpuCallbacks *opcodeCpuCallbacks = this;
+    PS_PERF_COUNT(_perfCounters.opcodes[opcode.instruction()]++);
+    (this->*PRIMARY_HANDLERS[opcode.instruction()])(opcode);
+}
 
-    auto cacheIsolation = (_cpuState.getRegisterCop0(Cop0Registers::SR) & Cop0Registers::IsolateCache) > 0;
+void CPU::execute_reserved(Opcode opcode) {
+    spdlog::warn("Reserved instruction {0:#010x} at address {1:#010x}", opcode.raw(), opcode.address());
+    raiseException(ExceptionCause::ReservedInstruction);
+}
 
-    switch (instruction) {
+#include "opcode_table.inc"
 
-    case 0x00: {
-        auto subfunction = opcode.subfunction();
-        spdlog::trace("[decode] subfunction {0:#04x} ({0:#08b})", subfunction);
-        switch (subfunction) {
-        case 0x00:
-            OpcodeImplementationCpu::sll(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+// With the cache isolated stores do not reach memory. The BIOS uses this to flush
+// the instruction cache, so the addressed line is invalidated.
+void CPU::isolatedStore(Opcode opcode) {
+    auto rs = opcode.rs();
+    auto imm = static_cast<int16_t>(opcode.imm16());
 
-        case 0x08:
-            OpcodeImplementationCpu::jr(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+    uint32_t address = _cpuState.getRegister(rs) + imm;
+    spdlog::trace("[icache] invalidate line at {:#010x}", address);
+    _instructionCache.invalidate(address);
+}
 
-        case 0x09:
-            OpcodeImplementationCpu::jalr(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+uint32_t CPU::cachedFetchCycles(uint32_t pc, uint32_t fetchCycles) {
+    if (_instructionCacheEnabled &&
+        InstructionCache::cached(pc) &&
+        (_memory->cacheControl() & CacheControl::CodeCacheEnable)) {
+        // A miss fills the line from the fetched word to its end
+        auto wordsFilled = 4 - ((pc >> 2) & 3);
+        return _instructionCache.fetch(pc) ? 0 : fetchCycles * wordsFilled;
+    }
+    return fetchCycles;
+}
 
-        case 0x20:
-            OpcodeImplementationCpu::add(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+bool CPU::biosHleCall(uint32_t pc) {
+    if (!_biosHle || !_biosHle->active() || !BiosHle::isKernelCall(pc)) {
+        return false;
+    }
+    // The delay slot of the call may have loaded an argument. The loads only land
+    // early if the call runs natively, the BIOS code has to see them in their slots.
+    auto state = _cpuState;
+    for (size_t slot = 0; slot < 2; slot++) {
+        auto &load = state.pendingLoad(slot);
+        if (load.valid) {
+            state.setRegister(load.index, load.value);
+            load.valid = false;
+        }
+    }
+    auto cycles = _biosHle->call(pc, state);
+    if (!cycles) {
+        return false;
+    }
+    _cpuState = state;
+    _blockCycles += *cycles;
+    return true;
+}
 
-        case 0x21:
-            OpcodeImplementationCpu::addu(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+bool CPU::fetchAddressError(uint32_t pc) {
+    if (pc % sizeof(uint32_t) == 0) {
+        return false;
+    }
+    // Only a jump gets here, the fault is taken on the fetch of its target
+    _instructionAddress = pc;
+    raiseAddressError(ExceptionCause::AddressErrorLoad, pc);
+    _blockCycles += Timing::INSTRUCTION_CYCLES;
+    moveAndApplyLoadDelaySlots();
+    return true;
+}
 
-        case 0x24:
-            OpcodeImplementationCpu::and(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+bool CPU::idleLoop(uint32_t target) {
+    // The delay slot of the closing branch was the last instruction
+    auto delaySlot = _instructionAddress;
+    if (target > delaySlot || delaySlot - target > IdleLoopDetector::MAX_LOOP_INSTRUCTIONS * 4) {
+        return false;
+    }
+    // Watched loads have to be executed to stop
+    if (!_memory->watchpoints().empty() || !_idleLoops.idle(target, delaySlot - 4, _cpuState, *_memory)) {
+        return false;
+    }
+    spdlog::trace("[idle] polling loop at {:#010x}", target);
+    _idleLoopHit = true;
+    return true;
+}
 
-        case 0x25:
-            OpcodeImplementationCpu::or_(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+bool CPU::step() {
+    auto pc = _cpuState.getProgramCounter();
+    if (biosHleCall(pc)) {
+        _blockCycles += Timing::INSTRUCTION_CYCLES;
+        return true;
+    }
+    if (fetchAddressError(pc)) {
+        return true;
+    }
+    auto rawOpcode = _memory->u32(pc);
+    auto fetchCycles = cachedFetchCycles(pc, _memory->takeAccessCycles());
 
-        case 0x2b:
-            OpcodeImplementationCpu::sltu(opcode, &_cpuState, opcodeCpuCallbacks);
-            return;
+    auto opcode = Opcode(rawOpcode);
+    opcode.setAddress(pc);
+    _instructionAddress = pc;
+    _exceptionRaised = false;
+    _cpuState.incrementProgramCounter();
+
+    spdlog::trace("[decode] raw {:#010x} at {:#010x}", opcode.raw(), pc);
+    decodeAndExecute(opcode);
+
+    _blockCycles += Timing::INSTRUCTION_CYCLES + fetchCycles + _memory->takeAccessCycles();
+
+    moveAndApplyLoadDelaySlots();
+    return moveAndApplyBranchDelaySlots() || _exceptionRaised || _debugStop.has_value();
+}
 
-        default:
-            spdlog::error("Unhandled subfunction {0:#04x} at address {1:#010x}", subfunction, opcode.address());
-            throw OpcodeNotImplemented();
-            return;
+BlockResult CPU::runBlock(uint32_t maxInstructions) {
+    auto result = BlockResult{0, 0};
+    while (result.instructions < maxInstructions) {
+        if (stopsInPage(_cpuState.getProgramCounter()) && breakpointHit()) {
+            break;
+        }
+        result.instructions++;
+        if (step()) {
+            break;
         }
     }
 
-    case 0x01:
-        OpcodeImplementationCpu::bcond(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+    result.cycles = _blockCycles;
+    _cycles += _blockCycles;
+    _blockCycles = 0;
+    return result;
+}
 
-    case 0x02:
-        OpcodeImplementationCpu::j(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+// GCC and Clang can take the address of a label, so every handler ends in its own
+// indirect jump to the next one. Other compilers dispatch through a switch.
+#if defined(__GNUC__)
+#define PS_THREADED_DISPATCH
+#endif
+
+namespace {
+// Primary opcode, or 64 + subfunction for SPECIAL instructions
+uint32_t dispatchIndex(Opcode opcode) {
+    auto primary = opcode.instruction();
+    return primary == 0 ? 64 + opcode.subfunction() : primary;
+}
+} // namespace
 
-    case 0x03:
-        OpcodeImplementationCpu::jal(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+BlockResult CPU::run(uint32_t maxInstructions) {
+    // The program counter may have been changed from outside since the last call
+    _lastBranchTarget = ~0u;
+    return _cachedInterpreter ? runCached(maxInstructions) : interpret(maxInstructions);
+}
 
-    case 0x04:
-        OpcodeImplementationCpu::beq(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+BlockResult CPU::interpret(uint32_t maxInstructions) {
+    uint32_t instructions = 0;
+    auto opcode = Opcode(0);
+    _exceptionRaised = false;
+
+    // Host page of the program counter, refreshed when execution leaves it
+    auto windowBase = ~0u;
+    auto window = CodeWindow{};
+    auto breakpointsInPage = false;
+    // The kernel call vectors are in the first page of RAM
+    auto kernelCallPage = false;
+
+    auto fetch = [&]() {
+        if (instructions == maxInstructions || _exceptionRaised || _debugStop) {
+            return false;
+        }
 
-    case 0x05:
-        OpcodeImplementationCpu::bne(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        auto pc = _cpuState.getProgramCounter();
+        if ((pc & ~MEMORY_PAGE_MASK) != windowBase) {
+            windowBase = pc & ~MEMORY_PAGE_MASK;
+            window = _memory->codeWindow(pc);
+            breakpointsInPage = stopsInPage(pc);
+            kernelCallPage = _biosHle && (windowBase & 0x1FFFFFFF) == 0;
+        }
+        if (breakpointsInPage && breakpointHit()) {
+            return false;
+        }
+        if (kernelCallPage && biosHleCall(pc)) {
+            // A nop stands in for the native call and execution continues at $ra
+            _blockCycles += Timing::INSTRUCTION_CYCLES;
+            opcode = Opcode(0);
+            opcode.setAddress(pc);
+            _instructionAddress = pc;
+            instructions++;
+            return true;
+        }
+        if (fetchAddressError(pc)) {
+            instructions++;
+            return false;
+        }
 
-    case 0x06:
-        OpcodeImplementationCpu::blez(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        uint32_t raw;
+        uint32_t fetchCycles;
+        if (window.page) {
+            std::memcpy(&raw, window.page + (pc & MEMORY_PAGE_MASK), sizeof(raw));
+            fetchCycles = window.accessTimes->word;
+            PS_PERF_COUNT(_memory->countFetch(window.segment));
+        } else {
+            raw = _memory->u32(pc);
+            fetchCycles = _memory->takeAccessCycles();
+        }
 
-    case 0x07:
-        OpcodeImplementationCpu::bgtz(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        _blockCycles += Timing::INSTRUCTION_CYCLES + cachedFetchCycles(pc, fetchCycles);
+        opcode = Opcode(raw);
+        opcode.setAddress(pc);
+        _instructionAddress = pc;
+        _cpuState.incrementProgramCounter();
+        instructions++;
+        PS_PERF_COUNT(_perfCounters.opcodes[opcode.instruction()]++);
+        return true;
+    };
+
+    auto retire = [&]() {
+        _blockCycles += _memory->takeAccessCycles();
+        moveAndApplyLoadDelaySlots();
+        if (moveAndApplyBranchDelaySlots() && _idleLoopDetection) {
+            auto target = _cpuState.getProgramCounter();
+            if (target == _lastBranchTarget && idleLoop(target)) {
+                // Ends the run at the loop start, the caller skips ahead to the next event
+                maxInstructions = instructions;
+            }
+            _lastBranchTarget = target;
+        }
+    };
+
+#ifdef PS_THREADED_DISPATCH
+#define PS_DISPATCH_LABEL(index, handler) &&dispatch_##index,
+    static void *const LABELS[128] = {PS_DISPATCH_OPCODES(PS_DISPATCH_LABEL)};
+#undef PS_DISPATCH_LABEL
+
+#define PS_DISPATCH_NEXT()                   \
+    if (!fetch()) {                          \
+        goto done;                           \
+    }                                        \
+    goto *LABELS[dispatchIndex(opcode)]
+
+    PS_DISPATCH_NEXT();
+
+#define PS_DISPATCH_HANDLER(index, handler) \
+    dispatch_##index:                       \
+    handler(opcode);                        \
+    retire();                               \
+    PS_DISPATCH_NEXT();
+    PS_DISPATCH_OPCODES(PS_DISPATCH_HANDLER)
+#undef PS_DISPATCH_HANDLER
+#undef PS_DISPATCH_NEXT
+
+done:
+#else
+    while (fetch()) {
+        switch (dispatchIndex(opcode)) {
+#define PS_DISPATCH_CASE(index, handler) \
+    case index:                          \
+        handler(opcode);                 \
+        break;
+            PS_DISPATCH_OPCODES(PS_DISPATCH_CASE)
+#undef PS_DISPATCH_CASE
+        }
+        retire();
+    }
+#endif
 
-    case 0x08:
-        OpcodeImplementationCpu::addi(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+    auto result = BlockResult{instructions, _blockCycles};
+    _cycles += _blockCycles;
+    _blockCycles = 0;
+    return result;
+}
 
-    case 0x09:
-        OpcodeImplementationCpu::addiu(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+// Same bookkeeping per instruction as interpret(), but the code is decoded once per
+// block. Delay slots are only looked at where BlockIr found that one can be pending.
+BlockResult CPU::runCached(uint32_t maxInstructions) {
+    uint32_t instructions = 0;
+    _exceptionRaised = false;
+    // Blocks dropped by the last run are not running anymore
+    _blockCache.collect();
+    _blockCache.takeInvalidated();
+
+    auto retireBranch = [&]() {
+        if (!moveAndApplyBranchDelaySlots()) {
+            return false;
+        }
+        if (_idleLoopDetection) {
+            auto target = _cpuState.getProgramCounter();
+            if (target == _lastBranchTarget && idleLoop(target)) {
+                // Ends the run at the loop start, the caller skips ahead to the next event
+                maxInstructions = instructions;
+            }
+            _lastBranchTarget = target;
+        }
+        return true;
+    };
+
+    while (instructions < maxInstructions && !_exceptionRaised && !_debugStop) {
+        auto pc = _cpuState.getProgramCounter();
+        auto breakpointsInPage = stopsInPage(pc);
+        if (breakpointsInPage && breakpointHit()) {
+            break;
+        }
+        // The kernel call vectors are in the first page of RAM
+        if (_biosHle && (pc & ~MEMORY_PAGE_MASK & 0x1FFFFFFF) == 0 && biosHleCall(pc)) {
+            // A nop stands in for the native call and execution continues at $ra
+            _blockCycles += Timing::INSTRUCTION_CYCLES;
+            _instructionAddress = pc;
+            instructions++;
+            _blockCycles += _memory->takeAccessCycles();
+            moveAndApplyLoadDelaySlots();
+            retireBranch();
+            continue;
+        }
 
-    case 0x0C:
-        OpcodeImplementationCpu::andi(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        if (fetchAddressError(pc)) {
+            instructions++;
+            break;
+        }
 
-    case 0x0D:
-        OpcodeImplementationCpu::ori(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        auto window = _memory->codeWindow(pc);
+        const auto *block = window.page ? _blockCache.block(pc, window, *_memory) : nullptr;
+        if (!block) {
+            // Fetched and executed one by one like interpret() does
+            uint32_t raw;
+            uint32_t fetchCycles;
+            if (window.page) {
+                std::memcpy(&raw, window.page + (pc & MEMORY_PAGE_MASK), sizeof(raw));
+                fetchCycles = window.accessTimes->word;
+                PS_PERF_COUNT(_memory->countFetch(window.segment));
+            } else {
+                raw = _memory->u32(pc);
+                fetchCycles = _memory->takeAccessCycles();
+            }
+            _blockCycles += Timing::INSTRUCTION_CYCLES + cachedFetchCycles(pc, fetchCycles);
+            auto opcode = Opcode(raw);
+            opcode.setAddress(pc);
+            _instructionAddress = pc;
+            _cpuState.incrementProgramCounter();
+            instructions++;
+            decodeAndExecute(opcode);
+            _blockCycles += _memory->takeAccessCycles();
+            moveAndApplyLoadDelaySlots();
+            retireBranch();
+            continue;
+        }
 
-    case 0x0F:
-        OpcodeImplementationCpu::lui(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+        // A load is written right away if the instruction after it runs next
+        auto resolveLoads = !breakpointsInPage;
+        auto load = [&](const BlockIr::Instruction &instruction, uint32_t value) {
+            const auto &pending = _cpuState.pendingLoad(0);
+            if ((instruction.flags & BlockIr::Flags::LoadResolvable) && resolveLoads && instructions != maxInstructions &&
+                !_debugStop && !(pending.valid && pending.index == instruction.rt)) {
+                _cpuState.setRegister(instruction.rt, value);
+            } else {
+                addLoadDelaySlot(LoadDelaySlot(instruction.rt, value));
+            }
+        };
+        auto loadAddress = [this](const BlockIr::Instruction &instruction) {
+            return (instruction.flags & BlockIr::Flags::ConstantAddress) ? instruction.imm : _cpuState.getRegister(instruction.rs) + instruction.imm;
+        };
+        auto write = [this](const BlockIr::Instruction &instruction, uint32_t value) {
+            _cpuState.setRegister(instruction.rd, value);
+            if (instruction.flags & BlockIr::Flags::CancelsLoad) {
+                invalidateLoadDelaySlot(instruction.rd);
+            }
+        };
+
+        const auto &code = block->code;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (i != 0 && (instructions == maxInstructions || _exceptionRaised || _debugStop || (breakpointsInPage && breakpointHit()))) {
+                break;
+            }
+            const auto &instruction = code[i];
+            pc = block->address + static_cast<uint32_t>(i) * 4;
+            _blockCycles += Timing::INSTRUCTION_CYCLES + cachedFetchCycles(pc, window.accessTimes->word);
+            _instructionAddress = pc;
+            _cpuState.incrementProgramCounter();
+            instructions++;
+            PS_PERF_COUNT(_memory->countFetch(window.segment));
+
+            auto generic = [&]() {
+                auto opcode = Opcode(instruction.raw);
+                opcode.setAddress(pc);
+                decodeAndExecute(opcode);
+            };
+            auto invalidated = false;
+            auto s = [&]() { return _cpuState.getRegister(instruction.rs); };
+            auto t = [&]() { return _cpuState.getRegister(instruction.rt); };
+
+            switch (instruction.op) {
+            case BlockIr::Op::Generic:
+                generic();
+                // The instruction may have written the code of the block
+                invalidated = _blockCache.takeInvalidated();
+                break;
+            case BlockIr::Op::Nop:
+                PS_PERF_COUNT(_perfCounters.opcodes[instruction.raw >> 26]++);
+                break;
+#define PS_BLOCK_ALU(op, a, b)                                                             \
+    case BlockIr::Op::op:                                                                  \
+        PS_PERF_COUNT(_perfCounters.opcodes[instruction.raw >> 26]++);                      \
+        write(instruction, BlockIr::evaluate(BlockIr::Op::op, a, b, instruction.imm)); \
+        break;
+                PS_BLOCK_ALU(Constant, 0, 0)
+                PS_BLOCK_ALU(AddImmediate, s(), 0)
+                PS_BLOCK_ALU(AndImmediate, s(), 0)
+                PS_BLOCK_ALU(OrImmediate, s(), 0)
+                PS_BLOCK_ALU(XorImmediate, s(), 0)
+                PS_BLOCK_ALU(SetLessThanImmediate, s(), 0)
+                PS_BLOCK_ALU(SetLessThanImmediateUnsigned, s(), 0)
+                PS_BLOCK_ALU(Add, s(), t())
+                PS_BLOCK_ALU(Subtract, s(), t())
+                PS_BLOCK_ALU(And, s(), t())
+                PS_BLOCK_ALU(Or, s(), t())
+                PS_BLOCK_ALU(Xor, s(), t())
+                PS_BLOCK_ALU(Nor, s(), t())
+                PS_BLOCK_ALU(SetLessThan, s(), t())
+                PS_BLOCK_ALU(SetLessThanUnsigned, s(), t())
+                PS_BLOCK_ALU(ShiftLeft, 0, t())
+                PS_BLOCK_ALU(ShiftRightLogical, 0, t())
+                PS_BLOCK_ALU(ShiftRightArithmetic, 0, t())
+                PS_BLOCK_ALU(ShiftLeftVariable, s(), t())
+                PS_BLOCK_ALU(ShiftRightLogicalVariable, s(), t())
+                PS_BLOCK_ALU(ShiftRightArithmeticVariable, s(), t())
+#undef PS_BLOCK_ALU
+#define PS_BLOCK_LOAD(op, alignment, read)                                  \
+    case BlockIr::Op::op: {                                                  \
+        auto address = loadAddress(instruction);                            \
+        if (address & (alignment - 1)) {                                    \
+            /* The handler raises the address error */                      \
+            generic();                                                      \
+            break;                                                          \
+        }                                                                   \
+        PS_PERF_COUNT(_perfCounters.opcodes[instruction.raw >> 26]++);      \
+        load(instruction, read);                                            \
+        break;                                                              \
+    }
+                PS_BLOCK_LOAD(LoadByte, 1, static_cast<uint32_t>(static_cast<int8_t>(_memory->u8(address))))
+                PS_BLOCK_LOAD(LoadByteUnsigned, 1, static_cast<uint32_t>(_memory->u8(address)))
+                PS_BLOCK_LOAD(LoadHalf, 2, static_cast<uint32_t>(static_cast<int16_t>(_memory->u16(address))))
+                PS_BLOCK_LOAD(LoadHalfUnsigned, 2, static_cast<uint32_t>(_memory->u16(address)))
+                PS_BLOCK_LOAD(LoadWord, 4, _memory->u32(address))
+#undef PS_BLOCK_LOAD
+            }
+
+            _blockCycles += _memory->takeAccessCycles();
+            if (instruction.flags & BlockIr::Flags::RetireLoads) {
+                moveAndApplyLoadDelaySlots();
+            }
+            if (((instruction.flags & BlockIr::Flags::RetireBranch) && retireBranch()) || invalidated) {
+                break;
+            }
+        }
+    }
 
-    case 0x10:
-        decodeAndExecuteCop0(opcode);
-        return;
+    auto result = BlockResult{instructions, _blockCycles};
+    _cycles += _blockCycles;
+    _blockCycles = 0;
+    return result;
+}
 
-    case 0x20:
-        OpcodeImplementationCpu::lb(opcode, &_cpuState, _memory, opcodeCpuCallbacks);
-        return;
+uint64_t CPU::cycles() const {
+    return _cycles + _blockCycles;
+}
 
-    case 0x23:
-        OpcodeImplementationCpu::lw(opcode, &_cpuState, _memory, opcodeCpuCallbacks);
-        return;
+void CPU::save(Snapshot &snapshot) const {
+    snapshot.cpuState = _cpuState;
+    snapshot.gte = _gte;
+    snapshot.instructionCache = _instructionCache;
+    snapshot.cycles = cycles();
+    snapshot.multiplyDivideReady = _multiplyDivideReady;
+}
 
-    case 0x24:
-        OpcodeImplementationCpu::lbu(opcode, &_cpuState, _memory, opcodeCpuCallbacks);
-        return;
+void CPU::restore(const Snapshot &snapshot) {
+    _cpuState = snapshot.cpuState;
+    _gte = snapshot.gte;
+    _instructionCache = snapshot.instructionCache;
+    _cycles = snapshot.cycles;
+    _blockCycles = 0;
+    _multiplyDivideReady = snapshot.multiplyDivideReady;
+    _idleLoopHit = false;
+    _debugStop = {};
+    _resumeAddress = {};
+}
 
-    case 0x28: {
-        if (cacheIsolation) {
-            spdlog::warn("Ignoring sb instruction because IsolateCache flag is set in Cop0 SR.");
-            return;
+bool CPU::breakpointHit() {
+    auto pc = _cpuState.getProgramCounter();
+    if (_breakpoints.contains(pc)) {
+        if (_resumeAddress != pc) {
+            spdlog::debug("[debug] breakpoint at {:#010x}", pc);
+            _debugStop = DebugStop{DebugStop::Reason::Breakpoint, pc, WatchpointType::Access};
+            return true;
         }
-
-        OpcodeImplementationCpu::sb(opcode, &_cpuState, _memory);
-        return;
+        _resumeAddress = {};
     }
-
-    case 0x29: {
-        if (cacheIsolation) {
-            spdlog::warn("Ignoring sh instruction because IsolateCache flag is set in Cop0 SR.");
-            return;
-        }
-
-        OpcodeImplementationCpu::sh(opcode, &_cpuState, _memory);
-        return;
+    // After a user breakpoint at the same address was resumed
+    if (_hookAddress == (pc & Breakpoints::PHYSICAL_MASK)) {
+        _debugStop = DebugStop{DebugStop::Reason::Hook, pc, WatchpointType::Access};
+        return true;
     }
+    return false;
+}
 
-    case 0x2B: {
-        if (cacheIsolation) {
-            spdlog::warn("Ignoring sw instruction because IsolateCache flag is set in Cop0 SR.");
-            return;
-        }
+void CPU::setExecutionHook(std::optional<uint32_t> address) {
+    _hookAddress = address;
+    if (_hookAddress) {
+        *_hookAddress &= Breakpoints::PHYSICAL_MASK;
+    }
+}
 
-        OpcodeImplementationCpu::sw(opcode, &_cpuState, _memory);
-        return;
+void CPU::resume() {
+    auto pc = _cpuState.getProgramCounter();
+    _debugStop = {};
+    _resumeAddress = {};
+    if (_breakpoints.contains(pc)) {
+        _resumeAddress = pc;
     }
+}
 
-    default: {
-        spdlog::error("Unhandled opcode {0:#010x}, instruction {1:#04x} at address {2:#010x}", opcode.raw(), opcode.instruction(), opcode.address());
-        throw OpcodeNotImplemented();
+void CPU::watchpointHit(const Watchpoint &watchpoint, uint32_t address, bool /* write */) {
+    if (!_debugStop) {
+        _debugStop = DebugStop{DebugStop::Reason::Watchpoint, address, watchpoint.type};
     }
+}
 
-    } // switch (instruction)
+void CPU::codeWritten(uint32_t offset, uint32_t size) {
+    _idleLoops.codeWritten(offset, size);
+    _blockCache.codeWritten(offset, size);
 }
 
-void CPU::decodeAndExecuteCop0(Opcode opcode) {
-    auto cop_opcode = opcode.cop_opcode();
+void CPU::moveAndApplyLoadDelaySlots() {
+    auto &first = _cpuState.pendingLoad(0);
+    auto &second = _cpuState.pendingLoad(1);
+    if (first.valid) {
+        spdlog::trace("Applying load delay slot value {:010x} for register {}", first.value, first.index);
+        _cpuState.setRegister(first.index, first.value);
+    }
 
-    IOpcodeCpuCallbacks *opcodeCpuCallbacks = this;
+    first = second;
+    second.valid = false;
+}
 
-    switch (cop_opcode) {
+bool CPU::moveAndApplyBranchDelaySlots() {
+    auto &first = _cpuState.pendingBranch(0);
+    auto &second = _cpuState.pendingBranch(1);
+    auto applied = first.valid;
+    if (applied) {
+        spdlog::trace("Applying branch delay slot with address {:010x}", first.target);
+        _cpuState.setProgramCounter(first.target);
+    }
 
-    case 0x00:
-        OpcodeImplementationCop0::mfc0(opcode, &_cpuState, opcodeCpuCallbacks);
-        return;
+    first = second;
+    second.valid = false;
+    return applied;
+}
 
-    case 0x04:
-        OpcodeImplementationCop0::mtc0(opcode, &_cpuState, opcodeCpuCallbacks);
+void CPU::invalidateLoadDelaySlot(RegisterIndex index) {
+    auto &first = _cpuState.pendingLoad(0);
+    if (!first.valid || first.index != index.index()) {
         return;
+    }
 
-    default:
-        spdlog::error("Unhandled cop0 opcode {0:#04x} at address {1:#010x}", cop_opcode, opcode.address());
-        throw OpcodeNotImplemented();
-
-    } // switch (cop_opcode)
+    spdlog::trace("Invalidated load delay slot for register {}", index);
+    PS_PERF_COUNT(_perfCounters.loadDelayInvalidations++);
+    first.valid = false;
 }
 
-std::vector<uint32_t> BREAKPOINTS = {
-};
-
-void CPU::step() {
-    auto pc = _cpuState.getProgramCounter();
-    auto rawOpcode = _memory->u32(pc);
-    auto opcode = Opcode(rawOpcode);
-    opcode.setAddress(pc);
-    _cpuState.incrementProgramCounter();
-
-    auto breakpointHit = std::any_of(BREAKPOINTS.begin(), BREAKPOINTS.end(), [&](auto x) {
-        return x == opcode.address();
-    });
-
-    if (breakpointHit) {
-        platform::debuggerBreak();
+uint32_t CPU::getRegisterIncludingLoadDelay(RegisterIndex index) {
+    const auto &first = _cpuState.pendingLoad(0);
+    if (first.valid && first.index == index.index()) {
+        return first.value;
     }
+    return _cpuState.getRegister(index);
+}
 
-    spdlog::trace("[decode] raw {:#010x} at {:#010x}", opcode.raw(), pc);
-    decodeAndExecute(opcode);
+void CPU::addLoadDelaySlot(LoadDelaySlot slot) {
+    _cpuState.pendingLoad(1) = PendingLoad{slot.value, slot.index.index(), true};
+}
 
-    moveAndApplyLoadDelaySlots();
-    moveAndApplyBranchDelaySlots();
+void CPU::addBranchDelaySlot(BranchDelaySlot slot) {
+    _cpuState.pendingBranch(1) = PendingBranch{slot.address, true};
 }
 
-void CPU::moveAndApplyLoadDelaySlots() {
-    auto first = _loadDelaySlots[0];
-    if (first) {
-        spdlog::trace("Applying load delay slot value {:010x} for register {}", first->value, first->index);
-        _cpuState.setRegister(first->index, first->value);
-        _loadDelaySlots[0] = {};
-    }
+void CPU::startMultiplyDivide(uint32_t cycles) {
+    _multiplyDivideReady = this->cycles() + cycles;
+}
 
-    auto second = _loadDelaySlots[1];
-    if (second) {
-        _loadDelaySlots[0] = second;
-        _loadDelaySlots[1] = {};
+void CPU::waitMultiplyDivide() {
+    auto now = cycles();
+    if (now < _multiplyDivideReady) {
+        _blockCycles += static_cast<uint32_t>(_multiplyDivideReady - now);
     }
 }
 
-void CPU::moveAndApplyBranchDelaySlots() {
-    auto first = _branchDelaySlots[0];
-    if (first) {
-        spdlog::trace("Applying branch delay slot with address {:010x}", first->address);
-        _cpuState.setProgramCounter(first->address);
-        _branchDelaySlots[0] = {};
+bool CPU::setInterruptLine(bool asserted) {
+    auto cause = _cpuState.getRegisterCop0(Cop0Registers::CAUSE) & ~Cop0Registers::HardwareInterrupt;
+    if (asserted) {
+        cause |= Cop0Registers::HardwareInterrupt;
     }
+    _cpuState.setRegisterCop0Unchecked(Cop0Registers::CAUSE, cause);
 
-    auto second = _branchDelaySlots[1];
-    if (second) {
-        _branchDelaySlots[0] = second;
-        _branchDelaySlots[1] = {};
+    auto sr = _cpuState.getRegisterCop0(Cop0Registers::SR);
+    if (!(sr & Cop0Registers::InterruptEnable) || !(sr & cause & Cop0Registers::InterruptsPending)) {
+        return false;
     }
-}
 
-void CPU::invalidateLoadDelaySlot(RegisterIndex index) {
-    if (!_loadDelaySlots[0]) {
-        return;
+    // The hardware executes a GTE command before taking the interrupt and the BIOS
+    // handler skips it on return, so the interrupt has to wait one instruction
+    auto pc = _cpuState.getProgramCounter();
+    auto window = _memory->codeWindow(pc);
+    if (window.page) {
+        uint32_t raw;
+        std::memcpy(&raw, window.page + (pc & MEMORY_PAGE_MASK), sizeof(raw));
+        if ((raw >> 25) == GTE_COMMAND_PREFIX) {
+            return false;
+        }
     }
 
-    if (_loadDelaySlots[0]->index != index) {
-        return;
-    }
+    _instructionAddress = pc;
+    enterException(ExceptionCause::Interrupt, 0);
+    return true;
+}
 
-    spdlog::trace("Invalidated load delay slot for register {}", index);
-    _loadDelaySlots[0] = {};
+void CPU::raiseException(ExceptionCause cause) {
+    enterException(cause, 0);
 }
 
-void CPU::addLoadDelaySlot(LoadDelaySlot slot) {
-    _loadDelaySlots[1] = slot;
+void CPU::raiseAddressError(ExceptionCause cause, uint32_t address) {
+    _cpuState.setRegisterCop0Unchecked(Cop0Registers::BadVaddr, address);
+    enterException(cause, 0);
 }
 
-void CPU::addBranchDelaySlot(BranchDelaySlot slot) {
-    _branchDelaySlots[1] = slot;
-}
\ No newline at end of file
+void CPU::raiseCoprocessorUnusable(uint8_t coprocessor) {
+    enterException(ExceptionCause::CoprocessorUnusable, coprocessor);
+}
+
+void CPU::enterException(ExceptionCause cause, uint8_t coprocessor) {
+    auto sr = _cpuState.getRegisterCop0(Cop0Registers::SR);
+    auto causeRegister = _cpuState.getRegisterCop0(Cop0Registers::CAUSE) & (Cop0Registers::SoftwareInterrupts | Cop0Registers::HardwareInterrupt);
+    causeRegister |= static_cast<uint32_t>(cause) << 2;
+    causeRegister |= static_cast<uint32_t>(coprocessor) << 28;
+
+    // In a branch delay slot EPC points to the branch so it is executed again
+    auto epc = _instructionAddress;
+    if (_cpuState.pendingBranch(0).valid) {
+        epc -= 4;
+        causeRegister |= Cop0Registers::BranchDelay;
+    }
+
+    spdlog::debug("[exception] cause {:#04x} at {:#010x}", static_cast<uint8_t>(cause), _instructionAddress);
+
+    _cpuState.setRegisterCop0Unchecked(Cop0Registers::CAUSE, causeRegister);
+    _cpuState.setRegisterCop0Unchecked(Cop0Registers::EPC, epc);
+
+    // Push the interrupt enable/user mode stack
+    _cpuState.setRegisterCop0Unchecked(Cop0Registers::SR, (sr & ~0x3Fu) | ((sr << 2) & 0x3F));
+
+    auto vector = (sr & Cop0Registers::BootExceptionVectors) ? 0xBFC00180 : 0x80000080;
+    _cpuState.setProgramCounter(vector);
+    _cpuState.pendingBranch(0).valid = false;
+    _cpuState.pendingBranch(1).valid = false;
+    _exceptionRaised = true;
+}
@@ -4,37 +4,190 @@
 #include <optional>
 #include <vector>
 
+#include "bios_hle.hpp"
+#include "block_cache.hpp"
+#include "breakpoints.hpp"
 #include "cpustate.hpp"
+#include "gte.hpp"
+#include "idle_loop.hpp"
+#include "instruction_cache.hpp"
 #include "loaddelayslot.hpp"
 #include "branchdelayslot.hpp"
 #include "memory.hpp"
 #include "opcode.hpp"
+#include "perf_counters.hpp"
+
+struct BlockResult {
+    uint32_t instructions;
+    uint32_t cycles;
+};
+
+// Why execution stopped for the debugger
+struct DebugStop {
+    enum class Reason : uint8_t {
+        Breakpoint,
+        Watchpoint,
+        // The execution hook, see CPU::setExecutionHook()
+        Hook
+    };
+
+    Reason reason;
+    // Program counter of the breakpoint or the accessed address
+    uint32_t address;
+    WatchpointType watchpointType;
+};
 
 class CPU
-    : public IOpcodeCpuCallbacks {
+    : public IOpcodeCpuCallbacks,
+      public IWatchpointListener,
+      public ICodeWriteListener {
 private:
+    // Registers and pending loads and branches, see CpuState for its layout
     CpuState _cpuState = {};
+
+    // Per instruction bookkeeping
     Memory *_memory = nullptr;
+    // Cycles are collected per basic block and committed to _cycles when it ends
+    uint32_t _blockCycles = 0;
+    // Address of the instruction being executed, EPC is derived from it
+    uint32_t _instructionAddress = 0;
+    bool _exceptionRaised = false;
+    bool _instructionCacheEnabled = true;
+    std::optional<DebugStop> _debugStop;
 
-    std::optional<LoadDelaySlot> _loadDelaySlots[2];
-    std::optional<BranchDelaySlot> _branchDelaySlots[2];
+    // Cold state, the GTE is only used by cop2 instructions
+    Gte _gte = {};
+    uint64_t _cycles = 0;
+    uint64_t _multiplyDivideReady = 0;
+    Breakpoints _breakpoints;
+    // Breakpoint at which execution was resumed, it is not hit again right away
+    std::optional<uint32_t> _resumeAddress;
+    // Physical address of the execution hook, apart from the debugger's breakpoints
+    std::optional<uint32_t> _hookAddress;
+    InstructionCache _instructionCache;
+    BiosHle *_biosHle = nullptr;
+    IdleLoopDetector _idleLoops;
+    bool _idleLoopDetection = true;
+    bool _idleLoopHit = false;
+    // Target of the last taken branch in run(), a loop is looked at when it repeats
+    uint32_t _lastBranchTarget = ~0u;
+    BlockCache _blockCache;
+    bool _cachedInterpreter = false;
+
+#ifdef PS_PERF_COUNTERS
+    PerfCounters::CpuCounters _perfCounters;
+#endif
 
     void moveAndApplyLoadDelaySlots();
-    void moveAndApplyBranchDelaySlots();
+    bool moveAndApplyBranchDelaySlots();
+    void isolatedStore(Opcode opcode);
+    void enterException(ExceptionCause cause, uint8_t coprocessor);
+    // Whether a breakpoint or the execution hook may be hit in the page of pc
+    bool stopsInPage(uint32_t pc) const {
+        return _breakpoints.pageHasBreakpoints(pc) ||
+               (_hookAddress && ((pc & Breakpoints::PHYSICAL_MASK) >> MEMORY_PAGE_SHIFT) == (*_hookAddress >> MEMORY_PAGE_SHIFT));
+    }
+    // Checks the breakpoints and the execution hook at the program counter
+    bool breakpointHit();
+    // Runs a kernel call natively if the HLE covers it, the CPU is at $ra then
+    bool biosHleCall(uint32_t pc);
+    // Raises the address error of fetching from a pc that is not word aligned
+    bool fetchAddressError(uint32_t pc);
+    uint32_t cachedFetchCycles(uint32_t pc, uint32_t fetchCycles);
+    // Called when a branch jumped to target twice in a row
+    bool idleLoop(uint32_t target);
+    // The two backends of run()
+    BlockResult interpret(uint32_t maxInstructions);
+    BlockResult runCached(uint32_t maxInstructions);
+
+    bool cacheIsolated() const {
+        return (_cpuState.getRegisterCop0(Cop0Registers::SR) & Cop0Registers::IsolateCache) != 0;
+    }
+
+    bool cop2Usable() const {
+        return (_cpuState.getRegisterCop0(Cop0Registers::SR) & Cop0Registers::Cop2Enable) != 0;
+    }
+
+    // Dispatch thunks and tables, see scripts/create_opcode_table.py
+#include "opcode_handlers.inc"
 
 public:
+    // Registers and everything else that affects execution, for a save state.
+    // Breakpoints are not part of it, restoring one clears a debug stop.
+    struct Snapshot {
+        CpuState cpuState;
+        Gte gte;
+        InstructionCache instructionCache;
+        uint64_t cycles;
+        uint64_t multiplyDivideReady;
+    };
+
     CPU() = default;
 
     void setMemory(Memory *memory);
 
     void initializeState();
     const CpuState *getCpuState() const;
+    CpuState *getCpuState();
+
+    void setInstructionCacheEnabled(bool enabled);
+    // Kernel calls are looked at while the HLE is active, may be null
+    void setBiosHle(BiosHle *biosHle);
+    const InstructionCache *getInstructionCache() const;
+    // run() returns early when it enters a loop that only polls memory, see
+    // IdleLoopDetector. takeIdleLoop() tells if that happened since the last call.
+    void setIdleLoopDetection(bool enabled);
+    bool takeIdleLoop();
+    // run() executes blocks translated once through BlockIr instead of decoding
+    // every instruction again. Off by default, the results are the same.
+    void setCachedInterpreter(bool enabled);
+    BlockCache &blockCache() { return _blockCache; }
+    const BlockCache &blockCache() const { return _blockCache; }
+    // Credits cycles the CPU spent waiting without executing them
+    void skipCycles(uint32_t cycles);
 
     void decodeAndExecute(Opcode opcode);
-    void decodeAndExecuteCop0(Opcode opcode);
-    void step();
+    // Returns true if the instruction ended a basic block
+    bool step();
+    // Executes instructions until a jump or branch is taken or the limit is reached
+    BlockResult runBlock(uint32_t maxInstructions);
+    // Executes instructions through the threaded dispatch loop until the limit is
+    // reached, an exception is raised or the debugger stops execution
+    BlockResult run(uint32_t maxInstructions);
+    uint64_t cycles() const;
+
+    // Only between two calls of run() or step()
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    Breakpoints &breakpoints() { return _breakpoints; }
+    // Stops execution like a breakpoint with DebugStop::Reason::Hook when address,
+    // or one of its mirrors, is reached. For the emulator itself, e.g. to start an
+    // executable, so the debugger can neither see nor remove it.
+    void setExecutionHook(std::optional<uint32_t> address);
+    const std::optional<DebugStop> &debugStop() const { return _debugStop; }
+    // Clears the debug stop, a breakpoint at the current address is stepped over
+    void resume();
+    // Sets the hardware interrupt line (CAUSE bit 10) between two instructions and
+    // enters the exception handler if SR enables the interrupt. Returns true then.
+    bool setInterruptLine(bool asserted);
+    // True if the next instruction is the delay slot of a taken branch
+    bool inBranchDelaySlot() const { return _cpuState.pendingBranch(0).valid; }
+
+#ifdef PS_PERF_COUNTERS
+    const PerfCounters::CpuCounters &perfCounters() const { return _perfCounters; }
+#endif
 
     virtual void invalidateLoadDelaySlot(RegisterIndex index) override;
     virtual void addLoadDelaySlot(LoadDelaySlot slot) override;
     virtual void addBranchDelaySlot(BranchDelaySlot slot) override;
+    virtual void startMultiplyDivide(uint32_t cycles) override;
+    virtual void waitMultiplyDivide() override;
+    virtual uint32_t getRegisterIncludingLoadDelay(RegisterIndex index) override;
+    virtual void raiseException(ExceptionCause cause) override;
+    virtual void raiseAddressError(ExceptionCause cause, uint32_t address) override;
+    virtual void raiseCoprocessorUnusable(uint8_t coprocessor) override;
+
+    virtual void watchpointHit(const Watchpoint &watchpoint, uint32_t address, bool write) override;
+    virtual void codeWritten(uint32_t offset, uint32_t size) override;
 };
\ No newline at end of file
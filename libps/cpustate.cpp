@@ -2,6 +2,7 @@
 #include "libutils/exception.hpp"
 
 #include <algorithm>
+#include <cstddef>
 #include <spdlog/spdlog.h>
 
 std::ostream &operator<<(std::ostream &os, const RegisterIndex &ri) {
@@ -9,51 +10,70 @@ std::ostream &operator<<(std::ostream &os, const RegisterIndex &ri) {
 }
 
 void CpuState::initialize() {
+    static_assert(offsetof(CpuState, _pc) == PC_OFFSET);
+    static_assert(offsetof(CpuState, _hi) == HI_OFFSET);
+    static_assert(offsetof(CpuState, _lo) == LO_OFFSET);
+    static_assert(offsetof(CpuState, _pendingLoads) == PENDING_LOADS_OFFSET);
+    static_assert(offsetof(CpuState, _pendingBranches) == PENDING_BRANCHES_OFFSET);
+    static_assert(offsetof(CpuState, _registers) == REGISTERS_OFFSET);
+    static_assert(offsetof(CpuState, _registersCop0) == COP0_REGISTERS_OFFSET);
+
     // Start at BIOS segment
     _pc = 0xBFC00000;
+    std::fill(std::begin(_pendingLoads), std::end(_pendingLoads), PendingLoad{});
+    std::fill(std::begin(_pendingBranches), std::end(_pendingBranches), PendingBranch{});
 
     std::fill(std::begin(_registers) + 1, std::end(_registers), 0xDEADBEEF);
     _registers[0] = 0;
+    _hi = 0xDEADBEEF;
+    _lo = 0xDEADBEEF;
 
     std::fill(std::begin(_registersCop0) + 1, std::end(_registersCop0), 0xDEADBEEF);
-    setRegisterCop0(Cop0Registers::SR, 0);
-}
-
-void CpuState::incrementProgramCounter() {
-    _pc += sizeof(uint32_t);
+    setRegisterCop0Unchecked(Cop0Registers::SR, 0);
+    setRegisterCop0Unchecked(Cop0Registers::CAUSE, 0);
+    setRegisterCop0Unchecked(Cop0Registers::EPC, 0);
+    setRegisterCop0Unchecked(Cop0Registers::BadVaddr, 0);
+    // R3000A
+    setRegisterCop0Unchecked(Cop0Registers::PRID, 0x00000002);
 }
 
-void CpuState::setProgramCounter(uint32_t value) {
-    _pc = value;
-}
+void CpuState::setRegisterCop0(RegisterIndex index, uint32_t value) {
+    switch (index.index()) {
+    // Breakpoint registers (BPC, BDA, JUMPDEST, DCIC, BDAM, BPCM)
+    case 3:
+    case 5:
+    case 6:
+    case 7:
+    case 9:
+    case 11:
+    case 12:
+        break;
 
-uint32_t CpuState::getProgramCounter() const {
-    return _pc;
-}
+    case 13:
+        // Only the software interrupt bits are writable
+        value = (_registersCop0[index.index()] & ~Cop0Registers::SoftwareInterrupts) |
+                (value & Cop0Registers::SoftwareInterrupts);
+        break;
 
-void CpuState::setRegister(RegisterIndex index, uint32_t value) {
-    if (index.index() == 0) {
-        spdlog::trace("[reg] ignore set $0");
+    // BadVaddr, EPC and PRID are read-only
+    case 8:
+    case 14:
+    case 15:
+        spdlog::trace("[reg] ignore write to read-only cop0_${}", index);
         return;
-    }
 
-    spdlog::trace("[reg] write ${} = {:#010x}", index, value);
-    _registers[index.index()] = value;
-}
+    default:
+        if (value != 0) {
+            spdlog::error("Program tried to write to cop0 register {} and write was not handled.", index);
+            throw NotImplemented();
+        }
+        break;
+    }
 
-uint32_t CpuState::getRegister(RegisterIndex index) const {
-    auto value = _registers[index.index()];
-    spdlog::trace("[reg] read ${} = {:#010x}", index, value);
-    return value;
+    setRegisterCop0Unchecked(index, value);
 }
 
-void CpuState::setRegisterCop0(RegisterIndex index, uint32_t value) {
-    if (index != Cop0Registers::SR &&
-        value != 0) {
-        spdlog::error("Program tried to write to cop0 register {} and write was not handled.", index);
-        throw NotImplemented();
-    }
-
+void CpuState::setRegisterCop0Unchecked(RegisterIndex index, uint32_t value) {
     spdlog::trace("[reg] write cop0_${} = {:#010x}", index, value);
     _registersCop0[index.index()] = value;
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <compare>
 // Must be included to make custom operator<< implementations for spdlog.
 #include <spdlog/fmt/ostr.h>
+#include <spdlog/spdlog.h>
 
 struct RegisterIndex {
 private:
@@ -15,30 +17,126 @@ public:
     auto operator<=>(const RegisterIndex &) const = default;
 };
 std::ostream &operator<<(std::ostream &os, const RegisterIndex &ri);
+#if FMT_VERSION >= 90000
+// fmt 9 no longer formats types through operator<< implicitly
+template <>
+struct fmt::formatter<RegisterIndex> : fmt::ostream_formatter {};
+#endif
 
 namespace Cop0Registers {
+const RegisterIndex BadVaddr = RegisterIndex(8);
 const RegisterIndex SR = RegisterIndex(12);
+const RegisterIndex CAUSE = RegisterIndex(13);
+const RegisterIndex EPC = RegisterIndex(14);
+const RegisterIndex PRID = RegisterIndex(15);
 
 enum Cop0StatusRegisterFlags : uint32_t {
-    IsolateCache = (1 << 16)
+    InterruptEnable = (1 << 0),
+    InterruptMask = 0xFF00,
+    IsolateCache = (1 << 16),
+    BootExceptionVectors = (1 << 22),
+    Cop2Enable = (1 << 30)
+};
+
+enum Cop0CauseRegisterFlags : uint32_t {
+    SoftwareInterrupts = 0x300,
+    HardwareInterrupt = (1 << 10),
+    InterruptsPending = 0xFF00,
+    BranchDelay = (1u << 31)
 };
 }; // namespace Cop0Registers
 
-class CpuState {
+// Exception codes stored in bits 2..6 of the CAUSE register
+enum class ExceptionCause : uint8_t {
+    Interrupt = 0x00,
+    AddressErrorLoad = 0x04,
+    AddressErrorStore = 0x05,
+    Syscall = 0x08,
+    Breakpoint = 0x09,
+    ReservedInstruction = 0x0A,
+    CoprocessorUnusable = 0x0B,
+    Overflow = 0x0C
+};
+
+// Load waiting in the load delay slot
+struct PendingLoad {
+    uint32_t value;
+    uint8_t index;
+    bool valid;
+};
+
+// Jump target waiting for the branch delay slot
+struct PendingBranch {
+    uint32_t target;
+    bool valid;
+};
+
+// Register state of the CPU. Everything an instruction touches is packed into the
+// first three cache lines: the control state into the first one, the general purpose
+// registers into the next two. COP0 follows on lines of its own. Generated code can
+// address all of it at fixed offsets from the start of the object.
+class alignas(64) CpuState {
+public:
+    static constexpr size_t PC_OFFSET = 0;
+    static constexpr size_t HI_OFFSET = 4;
+    static constexpr size_t LO_OFFSET = 8;
+    static constexpr size_t PENDING_LOADS_OFFSET = 12;
+    static constexpr size_t PENDING_BRANCHES_OFFSET = 28;
+    static constexpr size_t REGISTERS_OFFSET = 64;
+    static constexpr size_t COP0_REGISTERS_OFFSET = 192;
+
+private:
+    // Cache line 0
     uint32_t _pc;
-    uint32_t _registers[32];
-    uint32_t _registersCop0[32];
+    uint32_t _hi;
+    uint32_t _lo;
+    // Slot 0 is applied after the current instruction, slot 1 after the next one
+    PendingLoad _pendingLoads[2];
+    PendingBranch _pendingBranches[2];
+
+    // Cache lines 1 and 2
+    alignas(64) uint32_t _registers[32];
+
+    // Cold
+    alignas(64) uint32_t _registersCop0[32];
 
 public:
     void initialize();
 
-    void incrementProgramCounter();
-    void setProgramCounter(uint32_t value);
-    uint32_t getProgramCounter() const;
+    // Register accessors are inline, they are used by nearly every instruction
+    void incrementProgramCounter() { _pc += sizeof(uint32_t); }
+    void setProgramCounter(uint32_t value) { _pc = value; }
+    uint32_t getProgramCounter() const { return _pc; }
+
+    void setRegister(RegisterIndex index, uint32_t value) {
+        if (index.index() == 0) {
+            spdlog::trace("[reg] ignore set $0");
+            return;
+        }
 
-    void setRegister(RegisterIndex index, uint32_t value);
-    uint32_t getRegister(RegisterIndex index) const;
+        spdlog::trace("[reg] write ${} = {:#010x}", index, value);
+        _registers[index.index()] = value;
+    }
 
+    uint32_t getRegister(RegisterIndex index) const {
+        auto value = _registers[index.index()];
+        spdlog::trace("[reg] read ${} = {:#010x}", index, value);
+        return value;
+    }
+
+    void setHi(uint32_t value) { _hi = value; }
+    uint32_t getHi() const { return _hi; }
+    void setLo(uint32_t value) { _lo = value; }
+    uint32_t getLo() const { return _lo; }
+
+    PendingLoad &pendingLoad(size_t slot) { return _pendingLoads[slot]; }
+    const PendingLoad &pendingLoad(size_t slot) const { return _pendingLoads[slot]; }
+    PendingBranch &pendingBranch(size_t slot) { return _pendingBranches[slot]; }
+    const PendingBranch &pendingBranch(size_t slot) const { return _pendingBranches[slot]; }
+
+    // Writes as done by mtc0, read-only registers and bits are left untouched
     void setRegisterCop0(RegisterIndex index, uint32_t value);
+    // Writes without any checks, used when entering an exception
+    void setRegisterCop0Unchecked(RegisterIndex index, uint32_t value);
     uint32_t getRegisterCop0(RegisterIndex index) const ;
-};
\ No newline at end of file
+};
@@ -0,0 +1,149 @@
+#include "disassembler.hpp"
+
+#include <fmt/format.h>
+
+namespace {
+// Mnemonics and operand formats, see scripts/create_opcode_table.py
+#include "opcode_info.inc"
+
+struct Fields {
+    uint32_t raw;
+    uint32_t address;
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t rd;
+    uint8_t shamt;
+    uint16_t imm;
+    int16_t simm;
+
+    explicit Fields(uint32_t raw, uint32_t address)
+        : raw(raw),
+          address(address),
+          rs((raw >> 21) & 0x1F),
+          rt((raw >> 16) & 0x1F),
+          rd((raw >> 11) & 0x1F),
+          shamt((raw >> 6) & 0x1F),
+          imm(raw & 0xFFFF),
+          simm(static_cast<int16_t>(raw & 0xFFFF)) {
+    }
+
+    uint32_t branchTarget() const {
+        return address + 4 + (static_cast<uint32_t>(simm) << 2);
+    }
+};
+
+// Signed offsets are printed as "-0x10" instead of a two's complement value
+struct SignedHex {
+    int32_t value;
+};
+} // namespace
+
+template <>
+struct fmt::formatter<SignedHex> : fmt::formatter<uint32_t> {
+    template <typename FormatContext>
+    auto format(SignedHex value, FormatContext &context) const {
+        auto magnitude = value.value < 0 ? 0u - static_cast<uint32_t>(value.value) : static_cast<uint32_t>(value.value);
+        return fmt::format_to(context.out(), "{}{:#x}", value.value < 0 ? "-" : "", magnitude);
+    }
+};
+
+namespace {
+const OpcodeInfo &lookup(const Fields &f) {
+    static constexpr OpcodeInfo ILLEGAL = {"illegal", OperandFormat::Illegal};
+
+    auto primary = f.raw >> 26;
+    switch (primary) {
+    case 0x00:
+        return SPECIAL_INFO[f.raw & 0x3F];
+    case 0x10:
+        // Only rfe is defined among the cop0 commands
+        if (f.rs >= 0x10 && (f.raw & 0x3F) != 0x10) {
+            return ILLEGAL;
+        }
+        return COP0_INFO[f.rs];
+    case 0x12:
+        return COP2_INFO[f.rs];
+    default:
+        return PRIMARY_INFO[primary];
+    }
+}
+
+template <typename... Args>
+size_t write(char *buffer, size_t size, fmt::format_string<Args...> format, Args &&...args) {
+    auto result = fmt::format_to_n(buffer, size - 1, format, std::forward<Args>(args)...);
+    auto length = static_cast<size_t>(result.out - buffer);
+    buffer[length] = '\0';
+    return length;
+}
+} // namespace
+
+size_t Disassembler::disassemble(uint32_t raw, uint32_t address, char *buffer, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    if (raw == 0) {
+        return write(buffer, size, "nop");
+    }
+
+    auto f = Fields(raw, address);
+    const auto &info = lookup(f);
+    auto mnemonic = info.mnemonic;
+    auto coprocessor = (raw >> 26) & 0x03;
+
+    switch (info.operands) {
+    case OperandFormat::Illegal:
+        break;
+    case OperandFormat::None:
+        return write(buffer, size, "{}", mnemonic);
+    case OperandFormat::RdRsRt:
+        return write(buffer, size, "{} ${}, ${}, ${}", mnemonic, f.rd, f.rs, f.rt);
+    case OperandFormat::RdRtShamt:
+        return write(buffer, size, "{} ${}, ${}, {}", mnemonic, f.rd, f.rt, f.shamt);
+    case OperandFormat::RdRtRs:
+        return write(buffer, size, "{} ${}, ${}, ${}", mnemonic, f.rd, f.rt, f.rs);
+    case OperandFormat::Rs:
+        return write(buffer, size, "{} ${}", mnemonic, f.rs);
+    case OperandFormat::Rd:
+        return write(buffer, size, "{} ${}", mnemonic, f.rd);
+    case OperandFormat::RdRs:
+        return write(buffer, size, "{} ${}, ${}", mnemonic, f.rd, f.rs);
+    case OperandFormat::RsRt:
+        return write(buffer, size, "{} ${}, ${}", mnemonic, f.rs, f.rt);
+    case OperandFormat::RtRsImmediate:
+        return write(buffer, size, "{} ${}, ${}, {}", mnemonic, f.rt, f.rs, SignedHex{f.simm});
+    case OperandFormat::RtRsImmediateUnsigned:
+        return write(buffer, size, "{} ${}, ${}, {:#x}", mnemonic, f.rt, f.rs, f.imm);
+    case OperandFormat::RtImmediate:
+        return write(buffer, size, "{} ${}, {:#x}", mnemonic, f.rt, f.imm);
+    case OperandFormat::RsRtBranch:
+        return write(buffer, size, "{} ${}, ${}, {:#010x}", mnemonic, f.rs, f.rt, f.branchTarget());
+    case OperandFormat::RsBranch:
+        if (raw >> 26 == 0x01) {
+            // BcondZ, decoded like the CPU does
+            auto greaterOrEqual = (f.rt & 0x01) != 0;
+            auto link = (f.rt & 0x1E) == 0x10;
+            return write(buffer, size, "b{}z{} ${}, {:#010x}", greaterOrEqual ? "ge" : "lt", link ? "al" : "", f.rs, f.branchTarget());
+        }
+        return write(buffer, size, "{} ${}, {:#010x}", mnemonic, f.rs, f.branchTarget());
+    case OperandFormat::Jump:
+        return write(buffer, size, "{} {:#010x}", mnemonic, ((address + 4) & 0xF0000000) | ((raw & 0x03FFFFFF) << 2));
+    case OperandFormat::Memory:
+        return write(buffer, size, "{} ${}, {}(${})", mnemonic, f.rt, SignedHex{f.simm}, f.rs);
+    case OperandFormat::CoprocessorMemory:
+        return write(buffer, size, "{} cop{}_${}, {}(${})", mnemonic, coprocessor, f.rt, SignedHex{f.simm}, f.rs);
+    case OperandFormat::Code:
+        return write(buffer, size, "{} {:#x}", mnemonic, (raw >> 6) & 0xFFFFF);
+    case OperandFormat::Coprocessor:
+        return write(buffer, size, "{} {:#x}", mnemonic, raw & 0x1FFFFFF);
+    case OperandFormat::RtCop0:
+        return write(buffer, size, "{} ${}, cop0_${}", mnemonic, f.rt, f.rd);
+    case OperandFormat::RtCop2Data:
+        return write(buffer, size, "{} ${}, cop2_${}", mnemonic, f.rt, f.rd);
+    case OperandFormat::RtCop2Control:
+        return write(buffer, size, "{} ${}, cop2c_${}", mnemonic, f.rt, f.rd);
+    case OperandFormat::Cop2Command:
+        return write(buffer, size, "{} {:#x}", GTE_COMMAND_NAMES[raw & 0x3F], raw & 0x1FFFFFF);
+    }
+    return write(buffer, size, "illegal {:#010x}", raw);
+}
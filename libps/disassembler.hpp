@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Disassembler {
+// Enough for the longest instruction, e.g. "bgezal $31, 0x80001234"
+constexpr size_t MAX_LENGTH = 48;
+
+// Writes the disassembly of the instruction at address into buffer without allocating.
+// The output is truncated to size - 1 characters and always null terminated.
+// Returns the number of characters written.
+size_t disassemble(uint32_t raw, uint32_t address, char *buffer, size_t size);
+}; // namespace Disassembler
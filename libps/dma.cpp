@@ -0,0 +1,231 @@
+#include "dma.hpp"
+#include "interrupt_controller.hpp"
+#include "mdec.hpp"
+#include "memory.hpp"
+
+#include <spdlog/spdlog.h>
+
+constexpr uint32_t CHANNEL_REGISTERS_SIZE = 0x10;
+constexpr uint32_t ADDRESS_OFFSET = 0x0;
+constexpr uint32_t BLOCK_CONTROL_OFFSET = 0x4;
+constexpr uint32_t CHANNEL_CONTROL_OFFSET = 0x8;
+constexpr uint32_t CONTROL_OFFSET = 0x70;
+constexpr uint32_t INTERRUPT_OFFSET = 0x74;
+
+constexpr uint32_t ADDRESS_MASK = 0xFFFFFF;
+constexpr uint32_t CHANNEL_CONTROL_MASK = 0x71770703;
+// Writable DICR bits, the channel flags are acknowledged by writing ones
+constexpr uint32_t INTERRUPT_WRITE_MASK = 0x00FF803F;
+// End of the ordering table written by the OTC channel
+constexpr uint32_t ORDERING_TABLE_END = 0xFFFFFF;
+
+namespace {
+enum class SyncMode : uint8_t {
+    Manual = 0,
+    Request = 1,
+    LinkedList = 2
+};
+
+SyncMode syncMode(uint32_t control) {
+    return static_cast<SyncMode>((control & Dma::SyncModeMask) >> 9);
+}
+} // namespace
+
+Dma::Dma(Memory *memory, InterruptController *interruptController, Mdec *mdec)
+    : _memory(memory),
+      _interruptController(interruptController),
+      _mdec(mdec) {
+    _mdec->setOutputReadyCallback([this]() {
+        if (busy(Channel::MdecOut)) {
+            run(Channel::MdecOut);
+        }
+    });
+}
+
+void Dma::save(Snapshot &snapshot) const {
+    snapshot.channels = _channels;
+    snapshot.control = _control;
+    snapshot.interrupt = _interrupt;
+}
+
+void Dma::restore(const Snapshot &snapshot) {
+    _channels = snapshot.channels;
+    _control = snapshot.control;
+    _interrupt = snapshot.interrupt;
+}
+
+bool Dma::busy(Channel channel) const {
+    return (_channels[static_cast<size_t>(channel)].control & Start) != 0;
+}
+
+bool Dma::enabled(Channel channel) const {
+    return (_control & (8u << (static_cast<uint32_t>(channel) * 4))) != 0;
+}
+
+uint32_t Dma::wordCount(const ChannelState &state) const {
+    auto blockSize = state.blockControl & 0xFFFF;
+    if (syncMode(state.control) == SyncMode::Manual) {
+        return blockSize == 0 ? 0x10000 : blockSize;
+    }
+    return blockSize * (state.blockControl >> 16);
+}
+
+void Dma::run(Channel channel) {
+    auto &state = _channels[static_cast<size_t>(channel)];
+    if (!enabled(channel) || !(state.control & Start)) {
+        return;
+    }
+    // Manual transfers wait for the trigger bit
+    if (syncMode(state.control) == SyncMode::Manual && !(state.control & Trigger)) {
+        return;
+    }
+    if (channel == Channel::MdecOut && !_mdec->outputAvailable()) {
+        return;
+    }
+
+    auto *ram = _memory->ram();
+    auto ramMask = ram->size() - 1;
+    auto step = (state.control & Backwards) ? uint32_t(-4) : uint32_t(4);
+    auto address = state.address;
+    auto count = wordCount(state);
+    spdlog::trace("[dma] channel {} {} words at {:#08x}", static_cast<uint32_t>(channel), count, address);
+
+    switch (channel) {
+    case Channel::MdecIn:
+        for (uint32_t i = 0; i < count; i++, address += step) {
+            _mdec->writeData(ram->u32(address & ramMask & ~3u));
+        }
+        break;
+    case Channel::MdecOut:
+        for (uint32_t i = 0; i < count; i++, address += step) {
+            ram->u32Write(address & ramMask & ~3u, _mdec->readData());
+            _memory->ramWritten(address & ramMask & ~3u, sizeof(uint32_t));
+        }
+        break;
+    case Channel::Otc:
+        // Empty ordering table, every entry links to the one below it
+        for (uint32_t i = 0; i < count; i++, address -= 4) {
+            auto value = i == count - 1 ? ORDERING_TABLE_END : (address - 4) & ADDRESS_MASK;
+            ram->u32Write(address & ramMask & ~3u, value);
+            _memory->ramWritten(address & ramMask & ~3u, sizeof(uint32_t));
+        }
+        break;
+    default:
+        spdlog::debug("[dma] channel {} has no device, {} words dropped", static_cast<uint32_t>(channel), count);
+        break;
+    }
+
+    if (syncMode(state.control) == SyncMode::Request) {
+        state.address = address & ADDRESS_MASK;
+        state.blockControl &= 0xFFFF;
+    }
+    finish(channel);
+}
+
+void Dma::finish(Channel channel) {
+    auto index = static_cast<uint32_t>(channel);
+    _channels[index].control &= ~(Start | Trigger);
+    if (_interrupt & (1u << (16 + index))) {
+        _interrupt |= 1u << (24 + index);
+        updateInterrupt();
+    }
+}
+
+void Dma::updateInterrupt() {
+    auto wasSet = (_interrupt & MasterFlag) != 0;
+    auto flagged = ((_interrupt & ChannelEnableMask) << 8) & _interrupt & ChannelFlagMask;
+    auto set = (_interrupt & ForceInterrupt) || ((_interrupt & MasterEnable) && flagged);
+    _interrupt = set ? _interrupt | MasterFlag : _interrupt & ~MasterFlag;
+    if (set && !wasSet) {
+        _interruptController->request(Interrupt::Dma);
+    }
+}
+
+uint32_t Dma::readRegister(uint32_t offset) const {
+    if (offset == CONTROL_OFFSET) {
+        return _control;
+    }
+    if (offset == INTERRUPT_OFFSET) {
+        return _interrupt;
+    }
+    auto index = offset / CHANNEL_REGISTERS_SIZE;
+    if (index >= DMA_CHANNEL_COUNT) {
+        spdlog::warn("[dma] read from unknown register {:#04x}", offset);
+        return 0;
+    }
+    const auto &state = _channels[index];
+    switch (offset % CHANNEL_REGISTERS_SIZE) {
+    case ADDRESS_OFFSET:
+        return state.address;
+    case BLOCK_CONTROL_OFFSET:
+        return state.blockControl;
+    case CHANNEL_CONTROL_OFFSET:
+        return state.control;
+    default:
+        return 0;
+    }
+}
+
+void Dma::writeRegister(uint32_t offset, uint32_t value) {
+    if (offset == CONTROL_OFFSET) {
+        _control = value;
+        return;
+    }
+    if (offset == INTERRUPT_OFFSET) {
+        auto flags = _interrupt & ChannelFlagMask & ~(value & ChannelFlagMask);
+        _interrupt = flags | (value & INTERRUPT_WRITE_MASK) | (_interrupt & MasterFlag);
+        updateInterrupt();
+        return;
+    }
+    auto index = offset / CHANNEL_REGISTERS_SIZE;
+    if (index >= DMA_CHANNEL_COUNT) {
+        spdlog::warn("[dma] write {:#x} to unknown register {:#04x}", value, offset);
+        return;
+    }
+    auto &state = _channels[index];
+    switch (offset % CHANNEL_REGISTERS_SIZE) {
+    case ADDRESS_OFFSET:
+        state.address = value & ADDRESS_MASK;
+        return;
+    case BLOCK_CONTROL_OFFSET:
+        state.blockControl = value;
+        return;
+    case CHANNEL_CONTROL_OFFSET: {
+        auto channel = static_cast<Channel>(index);
+        // The OTC channel always runs backwards to RAM
+        state.control = channel == Channel::Otc ? (value & (Start | Trigger)) | Backwards : value & CHANNEL_CONTROL_MASK;
+        run(channel);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+uint32_t Dma::size() const {
+    return DMA_REGISTERS_SIZE;
+}
+
+uint8_t Dma::u8(uint32_t offset) const {
+    return static_cast<uint8_t>(readRegister(offset & ~3u) >> ((offset & 3) * 8));
+}
+uint16_t Dma::u16(uint32_t offset) const {
+    return static_cast<uint16_t>(readRegister(offset & ~3u) >> ((offset & 2) * 8));
+}
+uint32_t Dma::u32(uint32_t offset) const {
+    return readRegister(offset & ~3u);
+}
+
+void Dma::u8Write(uint32_t offset, uint8_t value) {
+    auto aligned = offset & ~3u;
+    auto shift = (offset & 3) * 8;
+    writeRegister(aligned, (readRegister(aligned) & ~(0xFFu << shift)) | (static_cast<uint32_t>(value) << shift));
+}
+void Dma::u16Write(uint32_t offset, uint16_t value) {
+    auto aligned = offset & ~3u;
+    auto shift = (offset & 2) * 8;
+    writeRegister(aligned, (readRegister(aligned) & ~(0xFFFFu << shift)) | (static_cast<uint32_t>(value) << shift));
+}
+void Dma::u32Write(uint32_t offset, uint32_t value) {
+    writeRegister(offset & ~3u, value);
+}
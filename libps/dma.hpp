@@ -0,0 +1,98 @@
+#pragma once
+
+#include "memory_region.hpp"
+
+#include <array>
+#include <cstdint>
+
+class InterruptController;
+class Mdec;
+class Memory;
+
+// Offset of the DMA registers inside the hw register segment (0x1F801080)
+constexpr uint32_t DMA_REGISTERS_OFFSET = 0x080;
+constexpr uint32_t DMA_REGISTERS_SIZE = 0x80;
+constexpr uint32_t DMA_CHANNEL_COUNT = 7;
+
+// DMA controller. Transfers run in one go when a channel starts, a channel whose
+// device has no data yet (MDEC out) stays busy until the device signals it. Channels
+// without an emulated device complete without moving data.
+class Dma
+    : public MemoryRegion {
+public:
+    enum class Channel : uint8_t {
+        MdecIn = 0,
+        MdecOut = 1,
+        Gpu = 2,
+        Cdrom = 3,
+        Spu = 4,
+        Pio = 5,
+        Otc = 6
+    };
+
+    // Bits of a channel's CHCR
+    enum ChannelControl : uint32_t {
+        FromRam = (1 << 0),
+        Backwards = (1 << 1),
+        SyncModeMask = (3 << 9),
+        Start = (1 << 24),
+        Trigger = (1 << 28)
+    };
+
+    // Bits of DICR
+    enum InterruptControl : uint32_t {
+        ForceInterrupt = (1 << 15),
+        ChannelEnableMask = (0x7F << 16),
+        MasterEnable = (1 << 23),
+        ChannelFlagMask = (0x7F << 24),
+        MasterFlag = (1u << 31)
+    };
+
+private:
+    struct ChannelState {
+        uint32_t address = 0;
+        uint32_t blockControl = 0;
+        uint32_t control = 0;
+    };
+
+    Memory *_memory;
+    InterruptController *_interruptController;
+    Mdec *_mdec;
+
+    std::array<ChannelState, DMA_CHANNEL_COUNT> _channels;
+    uint32_t _control = 0x07654321;
+    uint32_t _interrupt = 0;
+
+    bool enabled(Channel channel) const;
+    uint32_t wordCount(const ChannelState &state) const;
+    void run(Channel channel);
+    void finish(Channel channel);
+    void updateInterrupt();
+
+    uint32_t readRegister(uint32_t offset) const;
+    void writeRegister(uint32_t offset, uint32_t value);
+
+public:
+    struct Snapshot {
+        std::array<ChannelState, DMA_CHANNEL_COUNT> channels;
+        uint32_t control;
+        uint32_t interrupt;
+    };
+
+    Dma(Memory *memory, InterruptController *interruptController, Mdec *mdec);
+
+    bool busy(Channel channel) const;
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    virtual uint32_t size() const override;
+
+    virtual uint8_t u8(uint32_t offset) const override;
+    virtual uint16_t u16(uint32_t offset) const override;
+    virtual uint32_t u32(uint32_t offset) const override;
+
+    virtual void u8Write(uint32_t offset, uint8_t value) override;
+    virtual void u16Write(uint32_t offset, uint16_t value) override;
+    virtual void u32Write(uint32_t offset, uint32_t value) override;
+};
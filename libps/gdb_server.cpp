@@ -0,0 +1,267 @@
+#include "gdb_server.hpp"
+#include "gdb_stub.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+constexpr char INTERRUPT = 0x03;
+
+// Writing to a socket the peer closed must not raise SIGPIPE, that would end the emulator
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+namespace {
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle INVALID_HANDLE = INVALID_SOCKET;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+
+bool readable(SocketHandle socket) {
+    auto descriptor = WSAPOLLFD{socket, POLLRDNORM, 0};
+    return WSAPoll(&descriptor, 1, 0) > 0;
+}
+#else
+using SocketHandle = int;
+constexpr SocketHandle INVALID_HANDLE = -1;
+
+void closeSocket(SocketHandle socket) {
+    close(socket);
+}
+
+bool readable(SocketHandle socket) {
+    auto descriptor = pollfd{socket, POLLIN, 0};
+    return poll(&descriptor, 1, 0) > 0;
+}
+#endif
+
+SocketHandle listenOn(const std::string &endpoint) {
+#ifdef _WIN32
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+
+    SocketHandle listener = INVALID_HANDLE;
+    if (endpoint.starts_with("unix:")) {
+#ifdef _WIN32
+        throw std::runtime_error("Unix domain sockets are not supported on this platform");
+#else
+        auto path = endpoint.substr(5);
+        auto address = sockaddr_un{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error(fmt::format("Socket path {} is too long", path));
+        }
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        unlink(path.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == INVALID_HANDLE) {
+            throw std::runtime_error(fmt::format("Could not create a socket for {}", endpoint));
+        }
+        if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            closeSocket(listener);
+            throw std::runtime_error(fmt::format("Could not bind to {}", endpoint));
+        }
+#endif
+    } else {
+        uint16_t port = 0;
+        auto [last, error] = std::from_chars(endpoint.data(), endpoint.data() + endpoint.size(), port);
+        if (error != std::errc() || last != endpoint.data() + endpoint.size()) {
+            throw std::runtime_error(fmt::format("Invalid GDB endpoint {}, expected a port or unix:<path>", endpoint));
+        }
+
+        auto address = sockaddr_in{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == INVALID_HANDLE) {
+            throw std::runtime_error(fmt::format("Could not create a socket for port {}", endpoint));
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+        if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            closeSocket(listener);
+            throw std::runtime_error(fmt::format("Could not bind to port {}", endpoint));
+        }
+    }
+
+    if (listen(listener, 1) != 0) {
+        closeSocket(listener);
+        throw std::runtime_error(fmt::format("Could not listen on {}", endpoint));
+    }
+    return listener;
+}
+
+class Connection {
+private:
+    SocketHandle _socket;
+    std::string _received;
+    bool _interrupted = false;
+    bool _closed = false;
+
+    bool receive() {
+        char buffer[1024];
+        auto length = recv(_socket, buffer, sizeof(buffer), 0);
+        if (length <= 0) {
+            _closed = true;
+            return false;
+        }
+        for (auto c : std::string_view(buffer, length)) {
+            // The interrupt is sent outside of any packet
+            if (c == INTERRUPT) {
+                _interrupted = true;
+            } else {
+                _received.push_back(c);
+            }
+        }
+        return true;
+    }
+
+    // Removes the first complete packet from the received data, acknowledging it
+    std::optional<std::string> takePacket() {
+        auto start = _received.find('$');
+        if (start == std::string::npos) {
+            _received.clear();
+            return {};
+        }
+        auto end = _received.find('#', start);
+        if (end == std::string::npos || end + 3 > _received.size()) {
+            _received.erase(0, start);
+            return {};
+        }
+
+        auto payload = _received.substr(start + 1, end - start - 1);
+        auto checksum = _received.substr(end + 1, 2);
+        _received.erase(0, end + 3);
+
+        uint8_t expected = 0;
+        auto [last, error] = std::from_chars(checksum.data(), checksum.data() + checksum.size(), expected, 16);
+        if (error != std::errc() || expected != GdbStub::checksum(payload)) {
+            spdlog::warn("[gdb] checksum mismatch in packet {}", payload);
+            send("-");
+            return {};
+        }
+        send("+");
+        return payload;
+    }
+
+public:
+    explicit Connection(SocketHandle socket)
+        : _socket(socket) {
+#ifdef SO_NOSIGPIPE
+        int noSignal = 1;
+        setsockopt(_socket, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+    }
+    ~Connection() { closeSocket(_socket); }
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    // Writes all of the data, a failed write closes the connection
+    void send(std::string_view data) {
+        while (!_closed && !data.empty()) {
+            auto sent = ::send(_socket, data.data(), static_cast<int>(data.size()), SEND_FLAGS);
+            if (sent <= 0) {
+                spdlog::warn("[gdb] sending to the debugger failed");
+                _closed = true;
+                return;
+            }
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+    }
+
+    bool closed() const { return _closed; }
+
+    // Blocks until a packet arrives, returns nothing if the connection was closed
+    std::optional<std::string> nextPacket() {
+        while (!_closed) {
+            if (auto packet = takePacket()) {
+                // An interrupt while stopped has nothing left to interrupt
+                _interrupted = false;
+                return packet;
+            }
+            if (!receive()) {
+                return {};
+            }
+        }
+        return {};
+    }
+
+    // Checks for an interrupt without blocking, a closed connection shows as readable
+    bool takeInterrupt() {
+        while (!_interrupted && !_closed && readable(_socket)) {
+            if (!receive()) {
+                break;
+            }
+        }
+        return std::exchange(_interrupted, false);
+    }
+};
+} // namespace
+
+void GdbServer::serve(GdbStub &stub, const std::string &endpoint) {
+    auto listener = listenOn(endpoint);
+    spdlog::info("[gdb] waiting for connection on {}", endpoint);
+
+    auto socket = accept(listener, nullptr, nullptr);
+    closeSocket(listener);
+    if (socket == INVALID_HANDLE) {
+        throw std::runtime_error("Accepting the debugger connection failed");
+    }
+    spdlog::info("[gdb] debugger connected");
+
+    auto connection = Connection(socket);
+    auto disconnected = [&stub]() {
+        spdlog::info("[gdb] connection closed");
+        stub.detach();
+    };
+    // A target running on behalf of a debugger that went away is left to run on its own
+    stub.setInterruptCheck([&connection, &disconnected]() {
+        auto interrupted = connection.takeInterrupt();
+        if (connection.closed()) {
+            disconnected();
+            return true;
+        }
+        return interrupted;
+    });
+
+    while (stub.attached()) {
+        auto packet = connection.nextPacket();
+        if (!packet) {
+            disconnected();
+            break;
+        }
+
+        auto reply = stub.handlePacket(*packet);
+        if (!stub.killed() && !connection.closed()) {
+            connection.send(GdbStub::frame(reply));
+        }
+    }
+    stub.setInterruptCheck({});
+}
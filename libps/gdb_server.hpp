@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+class GdbStub;
+
+namespace GdbServer {
+// Waits for GDB to connect and handles its packets until it detaches, kills the
+// target or drops the connection. The endpoint is a TCP port on the loopback
+// interface ("2345") or a Unix domain socket ("unix:/tmp/ps.sock").
+void serve(GdbStub &stub, const std::string &endpoint);
+}; // namespace GdbServer
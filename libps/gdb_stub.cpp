@@ -0,0 +1,381 @@
+#include "gdb_stub.hpp"
+#include "playstation.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fmt/format.h>
+#include <iterator>
+#include <spdlog/spdlog.h>
+
+// Largest packet GDB may send, in characters (hex in qSupported)
+constexpr size_t MAX_PACKET_SIZE = 0x1000;
+constexpr uint32_t MAX_MEMORY_TRANSFER = MAX_PACKET_SIZE / 2 - 16;
+
+namespace GdbRegisters {
+enum : uint32_t {
+    Sr = 32,
+    Lo = 33,
+    Hi = 34,
+    BadVaddr = 35,
+    Cause = 36,
+    Pc = 37
+};
+}; // namespace GdbRegisters
+
+namespace {
+std::optional<uint32_t> parseHex(std::string_view text) {
+    uint32_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+        return {};
+    }
+    return value;
+}
+
+// Returns the text up to the separator and removes it including the separator
+std::string_view nextField(std::string_view &text, char separator) {
+    auto end = text.find(separator);
+    auto field = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+    return field;
+}
+
+// Registers are sent in target byte order
+void appendRegister(std::string &out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        fmt::format_to(std::back_inserter(out), "{:02x}", (value >> (i * 8)) & 0xFF);
+    }
+}
+
+std::optional<uint32_t> parseRegister(std::string_view text) {
+    if (text.size() != 8) {
+        return {};
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        auto byte = parseHex(text.substr(i * 2, 2));
+        if (!byte) {
+            return {};
+        }
+        value |= *byte << (i * 8);
+    }
+    return value;
+}
+} // namespace
+
+GdbStub::GdbStub(Playstation *playstation)
+    : _playstation(playstation) {
+}
+
+void GdbStub::setInterruptCheck(std::function<bool()> interruptRequested) {
+    _interruptRequested = std::move(interruptRequested);
+}
+
+uint8_t GdbStub::checksum(std::string_view payload) {
+    uint8_t sum = 0;
+    for (auto c : payload) {
+        sum += static_cast<uint8_t>(c);
+    }
+    return sum;
+}
+
+std::string GdbStub::frame(std::string_view payload) {
+    return fmt::format("${}#{:02x}", payload, checksum(payload));
+}
+
+std::string GdbStub::handlePacket(std::string_view packet) {
+    spdlog::trace("[gdb] <- {}", packet);
+    if (packet.empty()) {
+        return "";
+    }
+
+    auto arguments = packet.substr(1);
+    switch (packet[0]) {
+    case '?':
+        return stopReply();
+    case 'g':
+        return readRegisters();
+    case 'G':
+        return writeRegisters(arguments);
+    case 'p':
+        return readSingleRegister(arguments);
+    case 'P':
+        return writeSingleRegister(arguments);
+    case 'm':
+        return readMemory(arguments);
+    case 'M':
+        return writeMemory(arguments);
+    case 'c':
+        return continueExecution(arguments);
+    case 's':
+        return stepExecution(arguments);
+    case 'Z':
+        return updateBreakpoint(arguments, true);
+    case 'z':
+        return updateBreakpoint(arguments, false);
+    case 'H':
+    case 'T':
+        // There is only one thread
+        return "OK";
+    case 'D':
+        detach();
+        return "OK";
+    case 'k':
+        _attached = false;
+        _killed = true;
+        return "";
+    case 'q':
+        return query(packet);
+    default:
+        return "";
+    }
+}
+
+void GdbStub::detach() {
+    auto &cpu = _playstation->cpu();
+    cpu.breakpoints().clear();
+    _playstation->memory().clearWatchpoints();
+    cpu.resume();
+    _attached = false;
+}
+
+std::string GdbStub::query(std::string_view packet) {
+    if (packet.starts_with("qSupported")) {
+        return fmt::format("PacketSize={:x}", MAX_PACKET_SIZE);
+    }
+    if (packet == "qAttached") {
+        return "1";
+    }
+    if (packet == "qC") {
+        return "QC1";
+    }
+    if (packet == "qfThreadInfo") {
+        return "m1";
+    }
+    if (packet == "qsThreadInfo") {
+        return "l";
+    }
+    return "";
+}
+
+std::string GdbStub::stopReply() {
+    const auto &stop = _playstation->cpu().debugStop();
+    if (!stop || stop->reason != DebugStop::Reason::Watchpoint) {
+        return "S05";
+    }
+
+    auto kind = "awatch";
+    if (stop->watchpointType == WatchpointType::Write) {
+        kind = "watch";
+    } else if (stop->watchpointType == WatchpointType::Read) {
+        kind = "rwatch";
+    }
+    return fmt::format("T05{}:{:08x};", kind, stop->address);
+}
+
+std::optional<uint32_t> GdbStub::readRegister(uint32_t index) {
+    const auto *state = _playstation->cpu().getCpuState();
+    if (index < 32) {
+        return state->getRegister(RegisterIndex(static_cast<uint8_t>(index)));
+    }
+
+    switch (index) {
+    case GdbRegisters::Sr:
+        return state->getRegisterCop0(Cop0Registers::SR);
+    case GdbRegisters::Lo:
+        return state->getLo();
+    case GdbRegisters::Hi:
+        return state->getHi();
+    case GdbRegisters::BadVaddr:
+        return state->getRegisterCop0(Cop0Registers::BadVaddr);
+    case GdbRegisters::Cause:
+        return state->getRegisterCop0(Cop0Registers::CAUSE);
+    case GdbRegisters::Pc:
+        return state->getProgramCounter();
+    default:
+        // There is no floating point unit
+        return index < REGISTER_COUNT ? std::optional<uint32_t>(0) : std::nullopt;
+    }
+}
+
+bool GdbStub::writeRegister(uint32_t index, uint32_t value) {
+    auto *state = _playstation->cpu().getCpuState();
+    if (index < 32) {
+        state->setRegister(RegisterIndex(static_cast<uint8_t>(index)), value);
+        return true;
+    }
+
+    switch (index) {
+    case GdbRegisters::Sr:
+        state->setRegisterCop0Unchecked(Cop0Registers::SR, value);
+        return true;
+    case GdbRegisters::Lo:
+        state->setLo(value);
+        return true;
+    case GdbRegisters::Hi:
+        state->setHi(value);
+        return true;
+    case GdbRegisters::BadVaddr:
+        state->setRegisterCop0Unchecked(Cop0Registers::BadVaddr, value);
+        return true;
+    case GdbRegisters::Cause:
+        state->setRegisterCop0Unchecked(Cop0Registers::CAUSE, value);
+        return true;
+    case GdbRegisters::Pc:
+        state->setProgramCounter(value);
+        return true;
+    default:
+        return index < REGISTER_COUNT;
+    }
+}
+
+std::string GdbStub::readRegisters() {
+    std::string out;
+    for (uint32_t i = 0; i < REGISTER_COUNT; i++) {
+        appendRegister(out, *readRegister(i));
+    }
+    return out;
+}
+
+std::string GdbStub::writeRegisters(std::string_view arguments) {
+    for (uint32_t i = 0; i < REGISTER_COUNT && arguments.size() >= 8; i++) {
+        auto value = parseRegister(arguments.substr(0, 8));
+        if (!value) {
+            return "E01";
+        }
+        writeRegister(i, *value);
+        arguments.remove_prefix(8);
+    }
+    return "OK";
+}
+
+std::string GdbStub::readSingleRegister(std::string_view arguments) {
+    auto index = parseHex(arguments);
+    auto value = index ? readRegister(*index) : std::nullopt;
+    if (!value) {
+        return "E01";
+    }
+
+    std::string out;
+    appendRegister(out, *value);
+    return out;
+}
+
+std::string GdbStub::writeSingleRegister(std::string_view arguments) {
+    auto index = parseHex(nextField(arguments, '='));
+    auto value = parseRegister(arguments);
+    if (!index || !value || !writeRegister(*index, *value)) {
+        return "E01";
+    }
+    return "OK";
+}
+
+std::string GdbStub::readMemory(std::string_view arguments) {
+    auto address = parseHex(nextField(arguments, ','));
+    auto length = parseHex(arguments);
+    if (!address || !length) {
+        return "E01";
+    }
+
+    std::string out;
+    auto &memory = _playstation->memory();
+    for (uint32_t i = 0; i < std::min(*length, MAX_MEMORY_TRANSFER); i++) {
+        auto value = memory.debugRead(*address + i);
+        if (!value) {
+            break;
+        }
+        fmt::format_to(std::back_inserter(out), "{:02x}", *value);
+    }
+    // A partial read is fine, only nothing at all is an error
+    if (out.empty() && *length > 0) {
+        return "E14";
+    }
+    return out;
+}
+
+std::string GdbStub::writeMemory(std::string_view arguments) {
+    auto address = parseHex(nextField(arguments, ','));
+    auto length = parseHex(nextField(arguments, ':'));
+    if (!address || !length || arguments.size() != *length * 2) {
+        return "E01";
+    }
+
+    auto &memory = _playstation->memory();
+    for (uint32_t i = 0; i < *length; i++) {
+        auto value = parseHex(arguments.substr(i * 2, 2));
+        if (!value || !memory.debugWrite(*address + i, static_cast<uint8_t>(*value))) {
+            return "E14";
+        }
+    }
+    return "OK";
+}
+
+std::string GdbStub::continueExecution(std::string_view arguments) {
+    auto &cpu = _playstation->cpu();
+    if (auto address = parseHex(arguments)) {
+        cpu.getCpuState()->setProgramCounter(*address);
+    }
+
+    cpu.resume();
+    while (true) {
+        _playstation->execute(INTERRUPT_CHECK_INTERVAL);
+        if (cpu.debugStop()) {
+            return stopReply();
+        }
+        if (_interruptRequested && _interruptRequested()) {
+            // The check detaches when the connection is gone, there is nobody to reply to
+            if (!_attached) {
+                return "";
+            }
+            spdlog::debug("[gdb] interrupted at {:#010x}", cpu.getCpuState()->getProgramCounter());
+            return "S02";
+        }
+    }
+}
+
+std::string GdbStub::stepExecution(std::string_view arguments) {
+    auto &cpu = _playstation->cpu();
+    if (auto address = parseHex(arguments)) {
+        cpu.getCpuState()->setProgramCounter(*address);
+    }
+
+    cpu.resume();
+    _playstation->step();
+    return stopReply();
+}
+
+std::string GdbStub::updateBreakpoint(std::string_view arguments, bool insert) {
+    auto type = parseHex(nextField(arguments, ','));
+    auto address = parseHex(nextField(arguments, ','));
+    auto kind = parseHex(nextField(arguments, ';'));
+    if (!type || !address || !kind) {
+        return "E01";
+    }
+
+    auto &breakpoints = _playstation->cpu().breakpoints();
+    switch (*type) {
+    case 0:
+    case 1:
+        // Software and hardware breakpoints are the same thing here
+        if (insert) {
+            breakpoints.add(*address);
+        } else {
+            breakpoints.remove(*address);
+        }
+        return "OK";
+    case 2:
+    case 3:
+    case 4: {
+        constexpr WatchpointType TYPES[] = {WatchpointType::Write, WatchpointType::Read, WatchpointType::Access};
+        auto watchpoint = Watchpoint{*address, *kind, TYPES[*type - 2]};
+        if (insert) {
+            _playstation->memory().addWatchpoint(watchpoint);
+        } else {
+            _playstation->memory().removeWatchpoint(watchpoint);
+        }
+        return "OK";
+    }
+    default:
+        return "";
+    }
+}
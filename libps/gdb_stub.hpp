@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class Playstation;
+
+// Commands of the GDB Remote Serial Protocol. Packets are passed in and returned
+// without their framing, GdbServer takes care of the connection.
+class GdbStub {
+public:
+    // Register layout of GDB's mips target: 32 general purpose registers, sr, lo, hi,
+    // badvaddr, cause, pc, 32 floating point registers, fcsr and fir
+    static constexpr uint32_t REGISTER_COUNT = 72;
+    // Instructions executed between checks for an interrupt while continuing
+    static constexpr uint64_t INTERRUPT_CHECK_INTERVAL = 100000;
+
+private:
+    Playstation *_playstation;
+    std::function<bool()> _interruptRequested;
+    bool _attached = true;
+    bool _killed = false;
+
+    std::optional<uint32_t> readRegister(uint32_t index);
+    bool writeRegister(uint32_t index, uint32_t value);
+
+    std::string stopReply();
+    std::string readRegisters();
+    std::string writeRegisters(std::string_view arguments);
+    std::string readSingleRegister(std::string_view arguments);
+    std::string writeSingleRegister(std::string_view arguments);
+    std::string readMemory(std::string_view arguments);
+    std::string writeMemory(std::string_view arguments);
+    std::string continueExecution(std::string_view arguments);
+    std::string stepExecution(std::string_view arguments);
+    std::string updateBreakpoint(std::string_view arguments, bool insert);
+    std::string query(std::string_view packet);
+
+public:
+    explicit GdbStub(Playstation *playstation);
+
+    // Polled while the target runs, returning true stops it. The check may detach()
+    // when the connection to GDB is gone, continuing then ends without a stop reply.
+    void setInterruptCheck(std::function<bool()> interruptRequested);
+
+    // Returns the reply, an empty reply tells GDB the packet is not supported
+    std::string handlePacket(std::string_view packet);
+
+    // Removes all breakpoints and watchpoints and lets the target run on its own
+    void detach();
+
+    // Cleared when GDB detaches or kills the target
+    bool attached() const { return _attached; }
+    bool killed() const { return _killed; }
+
+    // Modulo 256 sum of the payload characters
+    static uint8_t checksum(std::string_view payload);
+    // Adds the leading $ and the checksum
+    static std::string frame(std::string_view payload);
+};
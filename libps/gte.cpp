@@ -0,0 +1,768 @@
+#include "gte.hpp"
+#include "gte_math.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+// Reciprocal table used by the RTPS/RTPT division.
+constexpr std::array<uint8_t, 0x101> UNR_TABLE = [] {
+    std::array<uint8_t, 0x101> table = {};
+    for (int i = 0; i < 0x101; i++) {
+        table[i] = static_cast<uint8_t>(std::max(0, (0x40000 / (i + 0x100) + 1) / 2 - 0x101));
+    }
+    return table;
+}();
+
+constexpr int64_t MAC_MAX = (int64_t(1) << 43) - 1;
+constexpr int64_t MAC_MIN = -(int64_t(1) << 43);
+
+constexpr uint32_t MAC_POSITIVE_FLAGS[4] = {GteFlags::MAC0Positive, GteFlags::MAC1Positive, GteFlags::MAC2Positive, GteFlags::MAC3Positive};
+constexpr uint32_t MAC_NEGATIVE_FLAGS[4] = {GteFlags::MAC0Negative, GteFlags::MAC1Negative, GteFlags::MAC2Negative, GteFlags::MAC3Negative};
+constexpr uint32_t IR_FLAGS[4] = {GteFlags::IR0Saturated, GteFlags::IR1Saturated, GteFlags::IR2Saturated, GteFlags::IR3Saturated};
+
+uint32_t pack16(int16_t low, int16_t high) {
+    return static_cast<uint16_t>(low) | (static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16);
+}
+
+uint32_t signExtend16(int16_t value) {
+    return static_cast<uint32_t>(static_cast<int32_t>(value));
+}
+
+void unpack16(uint32_t value, int16_t &low, int16_t &high) {
+    low = static_cast<int16_t>(value);
+    high = static_cast<int16_t>(value >> 16);
+}
+
+} // namespace
+
+void Gte::reset() {
+    *this = Gte();
+}
+
+int64_t Gte::checkMac(int index, int64_t value) {
+    if (value > MAC_MAX) {
+        _flag |= MAC_POSITIVE_FLAGS[index];
+    } else if (value < MAC_MIN) {
+        _flag |= MAC_NEGATIVE_FLAGS[index];
+    }
+
+    // The accumulators are 44 bits wide and wrap around
+    return (value << 20) >> 20;
+}
+
+void Gte::setMac0(int64_t value) {
+    if (value > INT32_MAX) {
+        _flag |= GteFlags::MAC0Positive;
+    } else if (value < INT32_MIN) {
+        _flag |= GteFlags::MAC0Negative;
+    }
+
+    _mac[0] = static_cast<int32_t>(value);
+}
+
+int16_t Gte::saturateIr(int index, int64_t value, bool lm) {
+    int64_t min = lm ? 0 : -0x8000;
+    if (value < min || value > 0x7FFF) {
+        _flag |= IR_FLAGS[index];
+    }
+
+    return static_cast<int16_t>(std::clamp<int64_t>(value, min, 0x7FFF));
+}
+
+void Gte::setIr(int index, int64_t value, bool lm) {
+    _ir[index] = saturateIr(index, value, lm);
+}
+
+void Gte::setIr0(int64_t value) {
+    if (value < 0 || value > 0x1000) {
+        _flag |= GteFlags::IR0Saturated;
+    }
+
+    _ir[0] = static_cast<int16_t>(std::clamp<int64_t>(value, 0, 0x1000));
+}
+
+void Gte::setMacAndIr(int index, int64_t value, int shift, bool lm) {
+    _mac[index] = static_cast<int32_t>(checkMac(index, value) >> shift);
+    setIr(index, _mac[index], lm);
+}
+
+void Gte::pushScreenXY(int64_t x, int64_t y) {
+    if (x < -0x400 || x > 0x3FF) {
+        _flag |= GteFlags::SX2Saturated;
+    }
+    if (y < -0x400 || y > 0x3FF) {
+        _flag |= GteFlags::SY2Saturated;
+    }
+
+    std::memmove(_sxy[0], _sxy[1], sizeof(_sxy[0]) * 2);
+    _sxy[2][0] = static_cast<int16_t>(std::clamp<int64_t>(x, -0x400, 0x3FF));
+    _sxy[2][1] = static_cast<int16_t>(std::clamp<int64_t>(y, -0x400, 0x3FF));
+}
+
+void Gte::pushScreenZ(int64_t value) {
+    if (value < 0 || value > 0xFFFF) {
+        _flag |= GteFlags::SZ3OTZSaturated;
+    }
+
+    _sz[0] = _sz[1];
+    _sz[1] = _sz[2];
+    _sz[2] = _sz[3];
+    _sz[3] = static_cast<uint16_t>(std::clamp<int64_t>(value, 0, 0xFFFF));
+}
+
+void Gte::pushColor() {
+    constexpr uint32_t COLOR_FLAGS[3] = {GteFlags::ColorRSaturated, GteFlags::ColorGSaturated, GteFlags::ColorBSaturated};
+
+    uint32_t color = static_cast<uint32_t>(_rgbc[3]) << 24;
+    for (int i = 0; i < 3; i++) {
+        auto component = _mac[i + 1] >> 4;
+        if (component < 0 || component > 0xFF) {
+            _flag |= COLOR_FLAGS[i];
+        }
+        color |= static_cast<uint32_t>(std::clamp(component, 0, 0xFF)) << (i * 8);
+    }
+
+    _rgb[0] = _rgb[1];
+    _rgb[1] = _rgb[2];
+    _rgb[2] = color;
+}
+
+// Unsigned Newton-Raphson division H / SZ3 as done by the hardware.
+uint32_t Gte::divide() {
+    auto sz3 = _sz[3];
+    if (_projectionDistance >= sz3 * 2) {
+        _flag |= GteFlags::DivideOverflow;
+        return 0x1FFFF;
+    }
+
+    auto shift = std::countl_zero(sz3);
+    int64_t n = static_cast<int64_t>(_projectionDistance) << shift;
+    int64_t d = static_cast<int64_t>(sz3) << shift;
+    int64_t u = UNR_TABLE[(d - 0x7FC0) >> 7] + 0x101;
+    d = (0x2000080 - d * u) >> 8;
+    d = (0x0000080 + d * u) >> 8;
+    return static_cast<uint32_t>(std::min<int64_t>(0x1FFFF, (n * d + 0x8000) >> 16));
+}
+
+void Gte::multiplyMatrixVector(const int16_t *matrix, const int16_t *vector, const int32_t *translation, int shift, bool lm) {
+    int32_t products[9];
+    GteMath::matrixVectorProducts(matrix, vector, products);
+
+    for (int row = 0; row < 3; row++) {
+        int64_t value = translation ? static_cast<int64_t>(translation[row]) << 12 : 0;
+        for (int column = 0; column < 3; column++) {
+            value = checkMac(row + 1, value + products[row * 3 + column]);
+        }
+        setMacAndIr(row + 1, value, shift, lm);
+    }
+}
+
+// [MAC1..3] = MAC + (FC - MAC) * IR0, the far color is saturated without lm.
+void Gte::interpolateColor(int64_t red, int64_t green, int64_t blue, int shift, bool lm) {
+    int64_t colors[3] = {red, green, blue};
+
+    for (int i = 0; i < 3; i++) {
+        auto difference = checkMac(i + 1, (static_cast<int64_t>(_farColor[i]) << 12) - colors[i]) >> shift;
+        setIr(i + 1, difference, false);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        setMacAndIr(i + 1, static_cast<int64_t>(_ir[i + 1]) * _ir[0] + colors[i], shift, lm);
+    }
+}
+
+// [MAC1..3] = [R * IR1, G * IR2, B * IR3] SHL 4, optionally followed by the depth queue.
+void Gte::applyColor(int shift, bool lm, bool depthQueue) {
+    int64_t colors[3];
+    for (int i = 0; i < 3; i++) {
+        colors[i] = (static_cast<int64_t>(_rgbc[i]) * _ir[i + 1]) << 4;
+    }
+
+    if (depthQueue) {
+        interpolateColor(colors[0], colors[1], colors[2], shift, lm);
+    } else {
+        for (int i = 0; i < 3; i++) {
+            setMacAndIr(i + 1, colors[i], shift, lm);
+        }
+    }
+}
+
+void Gte::rtp(int vertex, int shift, bool lm, bool last) {
+    int32_t products[9];
+    GteMath::matrixVectorProducts(_rotation, _vectors[vertex], products);
+
+    int64_t values[3];
+    for (int row = 0; row < 3; row++) {
+        values[row] = static_cast<int64_t>(_translation[row]) << 12;
+        for (int column = 0; column < 3; column++) {
+            values[row] = checkMac(row + 1, values[row] + products[row * 3 + column]);
+        }
+        _mac[row + 1] = static_cast<int32_t>(values[row] >> shift);
+    }
+
+    setIr(1, _mac[1], lm);
+    setIr(2, _mac[2], lm);
+
+    // With sf=0 the IR3 saturation flag is based on MAC3 SAR 12 instead of the stored value
+    if (shift == 12) {
+        setIr(3, _mac[3], lm);
+    } else {
+        auto z = values[2] >> 12;
+        if (z < -0x8000 || z > 0x7FFF) {
+            _flag |= GteFlags::IR3Saturated;
+        }
+        _ir[3] = static_cast<int16_t>(std::clamp<int64_t>(_mac[3], lm ? 0 : -0x8000, 0x7FFF));
+    }
+
+    pushScreenZ(values[2] >> 12);
+
+    int64_t quotient = divide();
+    int64_t x = quotient * _ir[1] + _screenOffsetX;
+    setMac0(x);
+    int64_t y = quotient * _ir[2] + _screenOffsetY;
+    setMac0(y);
+    pushScreenXY(x >> 16, y >> 16);
+
+    if (last) {
+        int64_t depth = quotient * _depthQueueA + _depthQueueB;
+        setMac0(depth);
+        setIr0(depth >> 12);
+    }
+}
+
+void Gte::nclip() {
+    int64_t x0 = _sxy[0][0], y0 = _sxy[0][1];
+    int64_t x1 = _sxy[1][0], y1 = _sxy[1][1];
+    int64_t x2 = _sxy[2][0], y2 = _sxy[2][1];
+    setMac0(x0 * y1 + x1 * y2 + x2 * y0 - x0 * y2 - x1 * y0 - x2 * y1);
+}
+
+// Cross product of IR with the diagonal of the rotation matrix.
+void Gte::outerProduct(int shift, bool lm) {
+    int64_t d1 = _rotation[0], d2 = _rotation[4], d3 = _rotation[8];
+    int64_t ir1 = _ir[1], ir2 = _ir[2], ir3 = _ir[3];
+
+    setMacAndIr(1, ir3 * d2 - ir2 * d3, shift, lm);
+    setMacAndIr(2, ir1 * d3 - ir3 * d1, shift, lm);
+    setMacAndIr(3, ir2 * d1 - ir1 * d2, shift, lm);
+}
+
+void Gte::mvmva(uint32_t command, int shift, bool lm) {
+    auto matrixSelect = (command >> 17) & 3;
+    auto vectorSelect = (command >> 15) & 3;
+    auto translationSelect = (command >> 13) & 3;
+
+    int16_t garbage[9];
+    const int16_t *matrix;
+    switch (matrixSelect) {
+    case 0:
+        matrix = _rotation;
+        break;
+    case 1:
+        matrix = _light;
+        break;
+    case 2:
+        matrix = _lightColor;
+        break;
+    default: {
+        // Selecting the reserved matrix yields a mix of unrelated registers
+        auto red = static_cast<int16_t>(_rgbc[0] << 4);
+        int16_t values[9] = {
+            static_cast<int16_t>(-red), red, _ir[0],
+            _rotation[2], _rotation[2], _rotation[2],
+            _rotation[4], _rotation[4], _rotation[4]};
+        std::memcpy(garbage, values, sizeof(garbage));
+        matrix = garbage;
+        break;
+    }
+    }
+
+    int16_t ir[3] = {_ir[1], _ir[2], _ir[3]};
+    const int16_t *vector = vectorSelect == 3 ? ir : _vectors[vectorSelect];
+
+    const int32_t *translation = nullptr;
+    switch (translationSelect) {
+    case 0:
+        translation = _translation;
+        break;
+    case 1:
+        translation = _backgroundColor;
+        break;
+    case 2:
+        translation = _farColor;
+        break;
+    }
+
+    if (translationSelect != 2) {
+        multiplyMatrixVector(matrix, vector, translation, shift, lm);
+        return;
+    }
+
+    // With the far color as translation the first column is only used to compute
+    // the flags, the result is made of the last two columns.
+    int32_t products[9];
+    GteMath::matrixVectorProducts(matrix, vector, products);
+    for (int row = 0; row < 3; row++) {
+        auto broken = checkMac(row + 1, (static_cast<int64_t>(_farColor[row]) << 12) + products[row * 3]);
+        saturateIr(row + 1, broken >> shift, false);
+
+        int64_t value = checkMac(row + 1, products[row * 3 + 1]);
+        value = checkMac(row + 1, value + products[row * 3 + 2]);
+        setMacAndIr(row + 1, value, shift, lm);
+    }
+}
+
+void Gte::normalColor(int vertex, int shift, bool lm, bool color, bool depthQueue) {
+    multiplyMatrixVector(_light, _vectors[vertex], nullptr, shift, lm);
+    colorColor(shift, lm, color, depthQueue);
+}
+
+// [IR1..3] = BK + LCM * IR, optionally followed by applying the color of RGBC.
+void Gte::colorColor(int shift, bool lm, bool color, bool depthQueue) {
+    int16_t ir[3] = {_ir[1], _ir[2], _ir[3]};
+    multiplyMatrixVector(_lightColor, ir, _backgroundColor, shift, lm);
+
+    if (color) {
+        applyColor(shift, lm, depthQueue);
+    }
+    pushColor();
+}
+
+void Gte::depthQueueColor(uint32_t color, int shift, bool lm) {
+    int64_t colors[3];
+    for (int i = 0; i < 3; i++) {
+        colors[i] = static_cast<int64_t>((color >> (i * 8)) & 0xFF) << 16;
+    }
+
+    interpolateColor(colors[0], colors[1], colors[2], shift, lm);
+    pushColor();
+}
+
+void Gte::depthQueueLight(int shift, bool lm) {
+    applyColor(shift, lm, true);
+    pushColor();
+}
+
+void Gte::interpolate(int shift, bool lm) {
+    interpolateColor(static_cast<int64_t>(_ir[1]) << 12, static_cast<int64_t>(_ir[2]) << 12, static_cast<int64_t>(_ir[3]) << 12, shift, lm);
+    pushColor();
+}
+
+void Gte::square(int shift, bool lm) {
+    for (int i = 1; i <= 3; i++) {
+        setMacAndIr(i, static_cast<int64_t>(_ir[i]) * _ir[i], shift, lm);
+    }
+}
+
+void Gte::averageZ(int16_t scale, int count) {
+    int64_t sum = 0;
+    for (int i = 4 - count; i < 4; i++) {
+        sum += _sz[i];
+    }
+
+    int64_t value = static_cast<int64_t>(scale) * sum;
+    setMac0(value);
+
+    value >>= 12;
+    if (value < 0 || value > 0xFFFF) {
+        _flag |= GteFlags::SZ3OTZSaturated;
+    }
+    _otz = static_cast<uint16_t>(std::clamp<int64_t>(value, 0, 0xFFFF));
+}
+
+void Gte::generalPurpose(int shift, bool lm, bool accumulate) {
+    for (int i = 1; i <= 3; i++) {
+        int64_t value = accumulate ? static_cast<int64_t>(_mac[i]) << shift : 0;
+        setMacAndIr(i, value + static_cast<int64_t>(_ir[0]) * _ir[i], shift, lm);
+    }
+    pushColor();
+}
+
+void Gte::execute(uint32_t command) {
+    _flag = 0;
+
+    auto shift = (command & (1 << 19)) ? 12 : 0;
+    auto lm = (command & (1 << 10)) != 0;
+
+    switch (command & 0x3F) {
+    case 0x01: // RTPS
+        rtp(0, shift, lm, true);
+        break;
+
+    case 0x06: // NCLIP
+        nclip();
+        break;
+
+    case 0x0C: // OP
+        outerProduct(shift, lm);
+        break;
+
+    case 0x10: // DPCS
+        depthQueueColor(_rgbc[0] | (_rgbc[1] << 8) | (_rgbc[2] << 16), shift, lm);
+        break;
+
+    case 0x11: // INTPL
+        interpolate(shift, lm);
+        break;
+
+    case 0x12: // MVMVA
+        mvmva(command, shift, lm);
+        break;
+
+    case 0x13: // NCDS
+        normalColor(0, shift, lm, true, true);
+        break;
+
+    case 0x14: // CDP
+        colorColor(shift, lm, true, true);
+        break;
+
+    case 0x16: // NCDT
+        for (int i = 0; i < 3; i++) {
+            normalColor(i, shift, lm, true, true);
+        }
+        break;
+
+    case 0x1B: // NCCS
+        normalColor(0, shift, lm, true, false);
+        break;
+
+    case 0x1C: // CC
+        colorColor(shift, lm, true, false);
+        break;
+
+    case 0x1E: // NCS
+        normalColor(0, shift, lm, false, false);
+        break;
+
+    case 0x20: // NCT
+        for (int i = 0; i < 3; i++) {
+            normalColor(i, shift, lm, false, false);
+        }
+        break;
+
+    case 0x28: // SQR
+        square(shift, lm);
+        break;
+
+    case 0x29: // DCPL
+        depthQueueLight(shift, lm);
+        break;
+
+    case 0x2A: // DPCT
+        for (int i = 0; i < 3; i++) {
+            depthQueueColor(_rgb[0], shift, lm);
+        }
+        break;
+
+    case 0x2D: // AVSZ3
+        averageZ(_zScale3, 3);
+        break;
+
+    case 0x2E: // AVSZ4
+        averageZ(_zScale4, 4);
+        break;
+
+    case 0x30: // RTPT
+        rtp(0, shift, lm, false);
+        rtp(1, shift, lm, false);
+        rtp(2, shift, lm, true);
+        break;
+
+    case 0x3D: // GPF
+        generalPurpose(shift, lm, false);
+        break;
+
+    case 0x3E: // GPL
+        generalPurpose(shift, lm, true);
+        break;
+
+    case 0x3F: // NCCT
+        for (int i = 0; i < 3; i++) {
+            normalColor(i, shift, lm, true, false);
+        }
+        break;
+
+    default:
+        spdlog::warn("[gte] unknown command {:#010x}", command);
+        break;
+    }
+
+    if (_flag & GteFlags::ErrorMask) {
+        _flag |= GteFlags::Error;
+    }
+}
+
+uint32_t Gte::getDataRegister(RegisterIndex index) const {
+    auto i = index.index();
+    switch (i) {
+    case 0:
+    case 2:
+    case 4:
+        return pack16(_vectors[i / 2][0], _vectors[i / 2][1]);
+    case 1:
+    case 3:
+    case 5:
+        return signExtend16(_vectors[i / 2][2]);
+    case 6:
+        return _rgbc[0] | (_rgbc[1] << 8) | (_rgbc[2] << 16) | (static_cast<uint32_t>(_rgbc[3]) << 24);
+    case 7:
+        return _otz;
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        return signExtend16(_ir[i - 8]);
+    case 12:
+    case 13:
+    case 14:
+        return pack16(_sxy[i - 12][0], _sxy[i - 12][1]);
+    case 15:
+        // SXYP mirrors SXY2 on reads
+        return pack16(_sxy[2][0], _sxy[2][1]);
+    case 16:
+    case 17:
+    case 18:
+    case 19:
+        return _sz[i - 16];
+    case 20:
+    case 21:
+    case 22:
+        return _rgb[i - 20];
+    case 23:
+        return _res1;
+    case 24:
+    case 25:
+    case 26:
+    case 27:
+        return static_cast<uint32_t>(_mac[i - 24]);
+    case 28:
+    case 29: {
+        // IRGB/ORGB read back the saturated 5:5:5 color of IR1..3
+        uint32_t value = 0;
+        for (int component = 0; component < 3; component++) {
+            value |= static_cast<uint32_t>(std::clamp(_ir[component + 1] >> 7, 0, 0x1F)) << (component * 5);
+        }
+        return value;
+    }
+    case 30:
+        return _lzcs;
+    case 31: {
+        // Counts leading ones for negative values and leading zeros otherwise
+        auto value = static_cast<int32_t>(_lzcs) < 0 ? ~_lzcs : _lzcs;
+        return static_cast<uint32_t>(std::countl_zero(value));
+    }
+    }
+
+    return 0;
+}
+
+void Gte::setDataRegister(RegisterIndex index, uint32_t value) {
+    auto i = index.index();
+    switch (i) {
+    case 0:
+    case 2:
+    case 4:
+        unpack16(value, _vectors[i / 2][0], _vectors[i / 2][1]);
+        break;
+    case 1:
+    case 3:
+    case 5:
+        _vectors[i / 2][2] = static_cast<int16_t>(value);
+        break;
+    case 6:
+        for (int byte = 0; byte < 4; byte++) {
+            _rgbc[byte] = static_cast<uint8_t>(value >> (byte * 8));
+        }
+        break;
+    case 7:
+        _otz = static_cast<uint16_t>(value);
+        break;
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        _ir[i - 8] = static_cast<int16_t>(value);
+        break;
+    case 12:
+    case 13:
+    case 14:
+        unpack16(value, _sxy[i - 12][0], _sxy[i - 12][1]);
+        break;
+    case 15:
+        // Writing SXYP pushes a new entry onto the screen coordinate FIFO
+        std::memmove(_sxy[0], _sxy[1], sizeof(_sxy[0]) * 2);
+        unpack16(value, _sxy[2][0], _sxy[2][1]);
+        break;
+    case 16:
+    case 17:
+    case 18:
+    case 19:
+        _sz[i - 16] = static_cast<uint16_t>(value);
+        break;
+    case 20:
+    case 21:
+    case 22:
+        _rgb[i - 20] = value;
+        break;
+    case 23:
+        _res1 = value;
+        break;
+    case 24:
+    case 25:
+    case 26:
+    case 27:
+        _mac[i - 24] = static_cast<int32_t>(value);
+        break;
+    case 28:
+        for (int component = 0; component < 3; component++) {
+            _ir[component + 1] = static_cast<int16_t>(((value >> (component * 5)) & 0x1F) << 7);
+        }
+        break;
+    case 29:
+    case 31:
+        // Read only
+        break;
+    case 30:
+        _lzcs = value;
+        break;
+    }
+}
+
+uint32_t Gte::getControlRegister(RegisterIndex index) const {
+    auto i = index.index();
+    switch (i) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+        return pack16(_rotation[i * 2], _rotation[i * 2 + 1]);
+    case 4:
+        return signExtend16(_rotation[8]);
+    case 5:
+    case 6:
+    case 7:
+        return static_cast<uint32_t>(_translation[i - 5]);
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        return pack16(_light[(i - 8) * 2], _light[(i - 8) * 2 + 1]);
+    case 12:
+        return signExtend16(_light[8]);
+    case 13:
+    case 14:
+    case 15:
+        return static_cast<uint32_t>(_backgroundColor[i - 13]);
+    case 16:
+    case 17:
+    case 18:
+    case 19:
+        return pack16(_lightColor[(i - 16) * 2], _lightColor[(i - 16) * 2 + 1]);
+    case 20:
+        return signExtend16(_lightColor[8]);
+    case 21:
+    case 22:
+    case 23:
+        return static_cast<uint32_t>(_farColor[i - 21]);
+    case 24:
+        return static_cast<uint32_t>(_screenOffsetX);
+    case 25:
+        return static_cast<uint32_t>(_screenOffsetY);
+    case 26:
+        // H is unsigned but reads back sign extended
+        return signExtend16(static_cast<int16_t>(_projectionDistance));
+    case 27:
+        return signExtend16(_depthQueueA);
+    case 28:
+        return static_cast<uint32_t>(_depthQueueB);
+    case 29:
+        return signExtend16(_zScale3);
+    case 30:
+        return signExtend16(_zScale4);
+    case 31:
+        return _flag;
+    }
+
+    return 0;
+}
+
+void Gte::setControlRegister(RegisterIndex index, uint32_t value) {
+    auto i = index.index();
+    switch (i) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+        unpack16(value, _rotation[i * 2], _rotation[i * 2 + 1]);
+        break;
+    case 4:
+        _rotation[8] = static_cast<int16_t>(value);
+        break;
+    case 5:
+    case 6:
+    case 7:
+        _translation[i - 5] = static_cast<int32_t>(value);
+        break;
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        unpack16(value, _light[(i - 8) * 2], _light[(i - 8) * 2 + 1]);
+        break;
+    case 12:
+        _light[8] = static_cast<int16_t>(value);
+        break;
+    case 13:
+    case 14:
+    case 15:
+        _backgroundColor[i - 13] = static_cast<int32_t>(value);
+        break;
+    case 16:
+    case 17:
+    case 18:
+    case 19:
+        unpack16(value, _lightColor[(i - 16) * 2], _lightColor[(i - 16) * 2 + 1]);
+        break;
+    case 20:
+        _lightColor[8] = static_cast<int16_t>(value);
+        break;
+    case 21:
+    case 22:
+    case 23:
+        _farColor[i - 21] = static_cast<int32_t>(value);
+        break;
+    case 24:
+        _screenOffsetX = static_cast<int32_t>(value);
+        break;
+    case 25:
+        _screenOffsetY = static_cast<int32_t>(value);
+        break;
+    case 26:
+        _projectionDistance = static_cast<uint16_t>(value);
+        break;
+    case 27:
+        _depthQueueA = static_cast<int16_t>(value);
+        break;
+    case 28:
+        _depthQueueB = static_cast<int32_t>(value);
+        break;
+    case 29:
+        _zScale3 = static_cast<int16_t>(value);
+        break;
+    case 30:
+        _zScale4 = static_cast<int16_t>(value);
+        break;
+    case 31:
+        _flag = value & GteFlags::WriteMask;
+        if (_flag & GteFlags::ErrorMask) {
+            _flag |= GteFlags::Error;
+        }
+        break;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "cpustate.hpp"
+
+#include <cstdint>
+
+// Geometry Transformation Engine (cop2).
+// Register layout and command semantics follow the nocash psx specs.
+class Gte {
+private:
+    // Data registers (cop2r0..31)
+    int16_t _vectors[3][3];
+    uint8_t _rgbc[4];
+    uint16_t _otz;
+    int16_t _ir[4];
+    int16_t _sxy[3][2];
+    uint16_t _sz[4];
+    uint32_t _rgb[3];
+    uint32_t _res1;
+    int32_t _mac[4];
+    uint32_t _lzcs;
+
+    // Control registers (cop2r32..63), matrices are stored row major
+    int16_t _rotation[9];
+    int32_t _translation[3];
+    int16_t _light[9];
+    int32_t _backgroundColor[3];
+    int16_t _lightColor[9];
+    int32_t _farColor[3];
+    int32_t _screenOffsetX;
+    int32_t _screenOffsetY;
+    uint16_t _projectionDistance;
+    int16_t _depthQueueA;
+    int32_t _depthQueueB;
+    int16_t _zScale3;
+    int16_t _zScale4;
+    uint32_t _flag;
+
+    int64_t checkMac(int index, int64_t value);
+    void setMac0(int64_t value);
+    int16_t saturateIr(int index, int64_t value, bool lm);
+    void setIr(int index, int64_t value, bool lm);
+    void setIr0(int64_t value);
+    void setMacAndIr(int index, int64_t value, int shift, bool lm);
+
+    void pushScreenXY(int64_t x, int64_t y);
+    void pushScreenZ(int64_t value);
+    void pushColor();
+    uint32_t divide();
+
+    void multiplyMatrixVector(const int16_t *matrix, const int16_t *vector, const int32_t *translation, int shift, bool lm);
+    void interpolateColor(int64_t red, int64_t green, int64_t blue, int shift, bool lm);
+    void applyColor(int shift, bool lm, bool depthQueue);
+
+    void rtp(int vertex, int shift, bool lm, bool last);
+    void nclip();
+    void outerProduct(int shift, bool lm);
+    void mvmva(uint32_t command, int shift, bool lm);
+    void normalColor(int vertex, int shift, bool lm, bool color, bool depthQueue);
+    void colorColor(int shift, bool lm, bool color, bool depthQueue);
+    void depthQueueColor(uint32_t color, int shift, bool lm);
+    void depthQueueLight(int shift, bool lm);
+    void interpolate(int shift, bool lm);
+    void square(int shift, bool lm);
+    void averageZ(int16_t scale, int count);
+    void generalPurpose(int shift, bool lm, bool accumulate);
+
+public:
+    void reset();
+
+    uint32_t getDataRegister(RegisterIndex index) const;
+    void setDataRegister(RegisterIndex index, uint32_t value);
+
+    uint32_t getControlRegister(RegisterIndex index) const;
+    void setControlRegister(RegisterIndex index, uint32_t value);
+
+    void execute(uint32_t command);
+};
+
+namespace GteFlags {
+enum : uint32_t {
+    IR0Saturated = 1 << 12,
+    SY2Saturated = 1 << 13,
+    SX2Saturated = 1 << 14,
+    MAC0Negative = 1 << 15,
+    MAC0Positive = 1 << 16,
+    DivideOverflow = 1 << 17,
+    SZ3OTZSaturated = 1 << 18,
+    ColorBSaturated = 1 << 19,
+    ColorGSaturated = 1 << 20,
+    ColorRSaturated = 1 << 21,
+    IR3Saturated = 1 << 22,
+    IR2Saturated = 1 << 23,
+    IR1Saturated = 1 << 24,
+    MAC3Negative = 1 << 25,
+    MAC2Negative = 1 << 26,
+    MAC1Negative = 1 << 27,
+    MAC3Positive = 1 << 28,
+    MAC2Positive = 1 << 29,
+    MAC1Positive = 1 << 30,
+    Error = 1u << 31,
+
+    ErrorMask = 0x7F87E000,
+    WriteMask = 0x7FFFF000
+};
+} // namespace GteFlags
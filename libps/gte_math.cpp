@@ -0,0 +1,30 @@
+#include "gte_math.hpp"
+#include "libutils/simd.hpp"
+
+namespace GteMath {
+
+void matrixVectorProductsScalar(const int16_t *matrix, const int16_t *vector, int32_t *out) {
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            out[row * 3 + column] = static_cast<int32_t>(matrix[row * 3 + column]) * vector[column];
+        }
+    }
+}
+
+void matrixVectorProducts(const int16_t *matrix, const int16_t *vector, int32_t *out) {
+#ifdef PS_SIMD_SSE2
+    // Elements 0..7 in one vector, the ninth one is done separately.
+    auto m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(matrix));
+    auto v = _mm_setr_epi16(vector[0], vector[1], vector[2], vector[0], vector[1], vector[2], vector[0], vector[1]);
+
+    auto lo = _mm_mullo_epi16(m, v);
+    auto hi = _mm_mulhi_epi16(m, v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_unpackhi_epi16(lo, hi));
+    out[8] = static_cast<int32_t>(matrix[8]) * vector[2];
+#else
+    matrixVectorProductsScalar(matrix, vector, out);
+#endif
+}
+
+} // namespace GteMath
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Fixed point kernels of the GTE. Only the 16x16 bit products are computed
+// here (vectorized with SSE2 when available). Accumulating them is left to
+// the caller, because the hardware checks for 44 bit overflow after every
+// single addition and those flags have to stay bit exact.
+namespace GteMath {
+
+// out[row * 3 + column] = matrix[row * 3 + column] * vector[column]
+void matrixVectorProducts(const int16_t *matrix, const int16_t *vector, int32_t *out);
+void matrixVectorProductsScalar(const int16_t *matrix, const int16_t *vector, int32_t *out);
+
+} // namespace GteMath
@@ -0,0 +1,259 @@
+#include "idle_loop.hpp"
+#include "memory.hpp"
+#include "opcode.hpp"
+
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+constexpr uint32_t PHYSICAL_ADDRESS_MASK = 0x1FFFFFFF;
+
+namespace {
+enum class Kind : uint8_t {
+    Unsupported,
+    Alu,
+    Load,
+    Branch
+};
+
+struct Decoded {
+    Kind kind = Kind::Unsupported;
+    // Bit mask of the registers read
+    uint32_t sources = 0;
+    uint8_t destination = 0;
+    uint32_t loadSize = 0;
+};
+
+uint32_t bit(RegisterIndex index) {
+    return 1u << index.index();
+}
+
+// Only instructions without side effects besides their destination register
+Decoded decode(uint32_t raw) {
+    auto opcode = Opcode(raw);
+    auto rs = opcode.rs();
+    auto rt = opcode.rt();
+    switch (opcode.instruction()) {
+    case 0x00:
+        switch (opcode.subfunction()) {
+        case 0x00: // sll
+        case 0x02: // srl
+        case 0x03: // sra
+            return {Kind::Alu, bit(rt), opcode.rd().index()};
+        case 0x04: // sllv
+        case 0x06: // srlv
+        case 0x07: // srav
+        case 0x21: // addu
+        case 0x23: // subu
+        case 0x24: // and
+        case 0x25: // or
+        case 0x26: // xor
+        case 0x27: // nor
+        case 0x2A: // slt
+        case 0x2B: // sltu
+            return {Kind::Alu, bit(rs) | bit(rt), opcode.rd().index()};
+        default:
+            return {};
+        }
+    case 0x01: // bltz/bgez, the link variants write $ra
+        if ((opcode.bcond_subfunction() & 0x1E) == 0x10) {
+            return {};
+        }
+        return {Kind::Branch, bit(rs)};
+    case 0x04: // beq
+    case 0x05: // bne
+        return {Kind::Branch, bit(rs) | bit(rt)};
+    case 0x06: // blez
+    case 0x07: // bgtz
+        return {Kind::Branch, bit(rs)};
+    case 0x09: // addiu
+    case 0x0A: // slti
+    case 0x0B: // sltiu
+    case 0x0C: // andi
+    case 0x0D: // ori
+    case 0x0E: // xori
+        return {Kind::Alu, bit(rs), rt.index()};
+    case 0x0F: // lui
+        return {Kind::Alu, 0, rt.index()};
+    case 0x20: // lb
+    case 0x24: // lbu
+        return {Kind::Load, bit(rs), rt.index(), 1};
+    case 0x21: // lh
+    case 0x25: // lhu
+        return {Kind::Load, bit(rs), rt.index(), 2};
+    case 0x23: // lw
+        return {Kind::Load, bit(rs), rt.index(), 4};
+    default:
+        return {};
+    }
+}
+} // namespace
+
+bool IdleLoopDetector::pollable(uint32_t address, uint32_t size, Memory &memory) {
+    if (address & (size - 1)) {
+        return false;
+    }
+    auto segment = memory.getSegmentForAddress(address);
+    if (!segment) {
+        return false;
+    }
+    switch (segment->region) {
+    case MemorySegment::RAM:
+    case MemorySegment::SCRATCHPAD:
+    case MemorySegment::BIOS:
+        return true;
+    case MemorySegment::HW_REGISTERS:
+        return Memory::readIsPure(segment->offset);
+    default:
+        return false;
+    }
+}
+
+bool IdleLoopDetector::analyze(const Loop &loop) {
+    uint32_t writtenInLoop = 0;
+    for (uint32_t i = 0; i < loop.count; i++) {
+        auto decoded = decode(loop.code[i]);
+        // One branch closes the loop, the delay slot comes after it
+        auto isBranch = i == loop.count - 2;
+        if (decoded.kind == Kind::Unsupported || (decoded.kind == Kind::Branch) != isBranch) {
+            return false;
+        }
+        if (decoded.kind != Kind::Branch) {
+            writtenInLoop |= 1u << decoded.destination;
+        }
+    }
+    writtenInLoop &= ~1u;
+
+    // Registers written in the loop must be written before they are read in the
+    // same iteration, otherwise a value is carried over like in a counting loop.
+    // A load is not visible to the instruction right after it.
+    uint32_t written = 0;
+    uint32_t pendingLoad = 0;
+    for (uint32_t i = 0; i < loop.count; i++) {
+        auto decoded = decode(loop.code[i]);
+        auto carried = decoded.sources & writtenInLoop & (~written | pendingLoad);
+        if (carried) {
+            return false;
+        }
+        pendingLoad = 0;
+        if (decoded.kind == Kind::Load) {
+            pendingLoad = 1u << decoded.destination;
+        }
+        if (decoded.kind != Kind::Branch) {
+            written |= 1u << decoded.destination;
+        }
+    }
+    return true;
+}
+
+bool IdleLoopDetector::loadsPollable(const Loop &loop, const CpuState &state, Memory &memory) {
+    // Addresses are usually built with lui and an offset in the loop itself, so
+    // those are followed. Registers the loop does not write keep their values.
+    uint32_t values[32];
+    uint32_t known = ~0u;
+    for (uint8_t i = 0; i < 32; i++) {
+        values[i] = state.getRegister(RegisterIndex(i));
+    }
+    for (uint32_t i = 0; i < loop.count; i++) {
+        auto decoded = decode(loop.code[i]);
+        if (decoded.kind != Kind::Branch && decoded.destination != 0) {
+            known &= ~(1u << decoded.destination);
+        }
+    }
+
+    for (uint32_t i = 0; i < loop.count; i++) {
+        auto opcode = Opcode(loop.code[i]);
+        auto decoded = decode(loop.code[i]);
+        auto rs = opcode.rs().index();
+        auto rsKnown = (known >> rs) & 1;
+        auto destination = decoded.destination;
+        if (decoded.kind == Kind::Load) {
+            if (!rsKnown || !pollable(values[rs] + opcode.imm16signed(), decoded.loadSize, memory)) {
+                return false;
+            }
+            continue;
+        }
+        if (decoded.kind != Kind::Alu || destination == 0) {
+            continue;
+        }
+
+        switch (opcode.instruction()) {
+        case 0x09: // addiu
+            values[destination] = values[rs] + opcode.imm16signed();
+            break;
+        case 0x0D: // ori
+            values[destination] = values[rs] | opcode.imm16();
+            break;
+        case 0x0F: // lui
+            values[destination] = static_cast<uint32_t>(opcode.imm16()) << 16;
+            rsKnown = 1;
+            break;
+        default:
+            rsKnown = 0;
+            break;
+        }
+        known = rsKnown ? known | (1u << destination) : known & ~(1u << destination);
+    }
+    return true;
+}
+
+bool IdleLoopDetector::protect(const Loop &loop, Memory &memory) {
+    for (auto address : {loop.target, loop.target + (loop.count - 1) * 4}) {
+        if (memory.codeWindow(address).segment != MemorySegment::BIOS && !memory.protectCode(address)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IdleLoopDetector::idle(uint32_t target, uint32_t branchAddress, const CpuState &state, Memory &memory) {
+    auto count = (branchAddress - target) / 4 + 2;
+    if (count > MAX_LOOP_INSTRUCTIONS + 1) {
+        return false;
+    }
+    // Loops that do work come by on every iteration, they are rejected from the cache
+    auto &loop = _loops[(target >> 2) % CACHE_ENTRIES];
+    auto cached = loop.target == target && loop.branchAddress == branchAddress;
+    if (cached && !loop.polls) {
+        return false;
+    }
+    if (cached && loop.unchanged) {
+        return loadsPollable(loop, state, memory);
+    }
+
+    // Polling loops are read back, so one that was overwritten is analyzed again
+    Loop current;
+    current.target = target;
+    current.branchAddress = branchAddress;
+    current.count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        auto address = target + i * 4;
+        auto window = memory.codeWindow(address);
+        if (!window.page) {
+            return false;
+        }
+        std::memcpy(&current.code[i], window.page + (address & MEMORY_PAGE_MASK), sizeof(uint32_t));
+    }
+    if (!cached || loop.code != current.code) {
+        current.polls = analyze(current);
+        loop = current;
+        spdlog::trace("[idle] loop {:#010x}..{:#010x} {}", target, branchAddress, loop.polls ? "polls" : "does work");
+    }
+    // Polling loops in RAM are read back until their code is protected
+    if (loop.polls) {
+        loop.unchanged = protect(loop, memory);
+    }
+    return loop.polls && loadsPollable(loop, state, memory);
+}
+
+void IdleLoopDetector::codeWritten(uint32_t offset, uint32_t size) {
+    for (auto &loop : _loops) {
+        auto physical = loop.target & PHYSICAL_ADDRESS_MASK;
+        if (loop.unchanged && physical < offset + size && offset < physical + loop.count * 4) {
+            loop.unchanged = false;
+        }
+    }
+}
+
+void IdleLoopDetector::reset() {
+    _loops = {};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cpustate.hpp"
+
+#include <array>
+#include <cstdint>
+
+class Memory;
+
+// Recognizes busy-wait loops that poll memory or a device register until an event
+// changes it. Such a loop is a short backward branch whose body only loads, does
+// register arithmetic and branches, and no register carries a value from one
+// iteration to the next. Every iteration then computes the same result until memory
+// changes, so the emulator can skip ahead to the next event instead of running it.
+class IdleLoopDetector {
+public:
+    // Loop body including the branch, the delay slot comes on top
+    static constexpr uint32_t MAX_LOOP_INSTRUCTIONS = 16;
+    static constexpr uint32_t CACHE_ENTRIES = 256;
+
+private:
+    // Structural verdict of a loop, the loads are checked against the registers on
+    // every hit since their addresses may differ
+    struct Loop {
+        uint32_t target = ~0u;
+        uint32_t branchAddress = ~0u;
+        bool polls = false;
+        // The code is in the BIOS or in protected RAM and need not be read back
+        bool unchanged = false;
+        uint32_t count = 0;
+        std::array<uint32_t, MAX_LOOP_INSTRUCTIONS + 1> code = {};
+    };
+
+    std::array<Loop, CACHE_ENTRIES> _loops;
+
+    // Only loads of addresses without read side effects are allowed
+    static bool pollable(uint32_t address, uint32_t size, Memory &memory);
+    static bool analyze(const Loop &loop);
+    static bool loadsPollable(const Loop &loop, const CpuState &state, Memory &memory);
+    // Protects the code of a loop against writes, returns false if it is not in RAM or the BIOS
+    static bool protect(const Loop &loop, Memory &memory);
+
+public:
+    // Called after the branch at branchAddress jumped back to target twice in a row,
+    // so the CPU is at the start of the loop and ran all of it once. Returns true if
+    // the loop would spin unchanged until memory changes.
+    bool idle(uint32_t target, uint32_t branchAddress, const CpuState &state, Memory &memory);
+    // Loops in the written RAM range are read back again, see ICodeWriteListener
+    void codeWritten(uint32_t offset, uint32_t size);
+    void reset();
+};
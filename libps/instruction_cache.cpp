@@ -0,0 +1,38 @@
+#include "instruction_cache.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr uint32_t TAG_MASK = 0x1FFFF000;
+constexpr uint32_t VALID_MASK = 0xF;
+
+uint32_t lineIndex(uint32_t address) {
+    return (address / ICACHE_LINE_SIZE) % ICACHE_LINES;
+}
+} // namespace
+
+void InstructionCache::reset() {
+    std::fill(std::begin(_tags), std::end(_tags), 0);
+    _hits = 0;
+    _misses = 0;
+}
+
+bool InstructionCache::fetch(uint32_t address) {
+    auto &line = _tags[lineIndex(address)];
+    auto tag = address & TAG_MASK;
+    auto word = (address >> 2) & 3;
+
+    if ((line & TAG_MASK) == tag && (line & (1 << word))) {
+        _hits++;
+        return true;
+    }
+
+    line = tag | (VALID_MASK & ~((1u << word) - 1));
+    _misses++;
+    return false;
+}
+
+void InstructionCache::invalidate(uint32_t address) {
+    _tags[lineIndex(address)] &= ~VALID_MASK;
+}
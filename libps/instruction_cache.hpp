@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+constexpr uint32_t ICACHE_SIZE = 4 * 1024;
+constexpr uint32_t ICACHE_LINE_SIZE = 16;
+constexpr uint32_t ICACHE_LINES = ICACHE_SIZE / ICACHE_LINE_SIZE;
+
+// Direct mapped 4 KiB instruction cache with 16 byte lines. Only the tags are
+// modelled, instructions are still fetched from memory. The tag array is used
+// to tell hits from misses so fetches can be charged accordingly.
+class InstructionCache {
+private:
+    // Physical address bits 28..12 of the cached line and one valid bit per word (bits 0..3)
+    uint32_t _tags[ICACHE_LINES] = {};
+
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+
+public:
+    void reset();
+
+    // Returns true if the word at the address was cached. On a miss the line is
+    // filled from the requested word up to the end of the line, as the hardware does.
+    bool fetch(uint32_t address);
+
+    void invalidate(uint32_t address);
+
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+
+    // Only KUSEG and KSEG0 go through the cache
+    static bool cached(uint32_t address) { return address < 0xA0000000; }
+};
@@ -0,0 +1,63 @@
+#include "interrupt_controller.hpp"
+
+#include <spdlog/spdlog.h>
+
+constexpr uint32_t STATUS_OFFSET = 0x0;
+constexpr uint32_t MASK_OFFSET = 0x4;
+
+void InterruptController::request(Interrupt interrupt) {
+    spdlog::trace("[irq] request {}", static_cast<uint8_t>(interrupt));
+    _status |= 1u << static_cast<uint8_t>(interrupt);
+}
+
+void InterruptController::save(Snapshot &snapshot) const {
+    snapshot = Snapshot{_status, _mask};
+}
+
+void InterruptController::restore(const Snapshot &snapshot) {
+    _status = snapshot.status;
+    _mask = snapshot.mask;
+}
+
+uint32_t InterruptController::readRegister(uint32_t offset) const {
+    return offset == STATUS_OFFSET ? _status : _mask;
+}
+
+void InterruptController::writeRegister(uint32_t offset, uint32_t value) {
+    if (offset == STATUS_OFFSET) {
+        // Writing zero bits acknowledges the interrupts
+        _status &= value;
+    } else {
+        spdlog::trace("[irq] mask = {:#06x}", value & REGISTER_MASK);
+        _mask = value & REGISTER_MASK;
+    }
+}
+
+uint32_t InterruptController::size() const {
+    return INTERRUPT_REGISTERS_SIZE;
+}
+
+uint8_t InterruptController::u8(uint32_t offset) const {
+    return static_cast<uint8_t>(readRegister(offset & ~3u) >> ((offset & 3) * 8));
+}
+uint16_t InterruptController::u16(uint32_t offset) const {
+    return static_cast<uint16_t>(readRegister(offset & ~3u) >> ((offset & 2) * 8));
+}
+uint32_t InterruptController::u32(uint32_t offset) const {
+    return readRegister(offset & ~3u);
+}
+
+// Narrow writes leave the other bits of I_STAT alone, they are not acknowledged
+void InterruptController::u8Write(uint32_t offset, uint8_t value) {
+    auto shift = (offset & 3) * 8;
+    auto current = readRegister(offset & ~3u);
+    writeRegister(offset & ~3u, (current & ~(0xFFu << shift)) | (static_cast<uint32_t>(value) << shift));
+}
+void InterruptController::u16Write(uint32_t offset, uint16_t value) {
+    auto shift = (offset & 2) * 8;
+    auto current = readRegister(offset & ~3u);
+    writeRegister(offset & ~3u, (current & ~(0xFFFFu << shift)) | (static_cast<uint32_t>(value) << shift));
+}
+void InterruptController::u32Write(uint32_t offset, uint32_t value) {
+    writeRegister(offset & ~3u, value);
+}
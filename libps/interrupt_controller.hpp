@@ -0,0 +1,63 @@
+#pragma once
+
+#include "memory_region.hpp"
+
+#include <cstdint>
+
+// Offset of I_STAT and I_MASK inside the hw register segment (0x1F801070)
+constexpr uint32_t INTERRUPT_REGISTERS_OFFSET = 0x070;
+constexpr uint32_t INTERRUPT_REGISTERS_SIZE = 8;
+
+// Bits of I_STAT and I_MASK
+enum class Interrupt : uint8_t {
+    VBlank = 0,
+    Gpu = 1,
+    Cdrom = 2,
+    Dma = 3,
+    Timer0 = 4,
+    Timer1 = 5,
+    Timer2 = 6,
+    ControllerMemoryCard = 7,
+    Sio = 8,
+    Spu = 9,
+    Lightpen = 10
+};
+
+// Collects device interrupt requests into I_STAT. The CPU sees a single hardware
+// interrupt line (CAUSE bit 10) which is asserted while I_STAT & I_MASK is non zero.
+class InterruptController
+    : public MemoryRegion {
+private:
+    static constexpr uint32_t REGISTER_MASK = 0x7FF;
+
+    uint32_t _status = 0;
+    uint32_t _mask = 0;
+
+    uint32_t readRegister(uint32_t offset) const;
+    void writeRegister(uint32_t offset, uint32_t value);
+
+public:
+    struct Snapshot {
+        uint32_t status;
+        uint32_t mask;
+    };
+
+    void request(Interrupt interrupt);
+    bool pending() const { return (_status & _mask) != 0; }
+
+    uint32_t status() const { return _status; }
+    uint32_t mask() const { return _mask; }
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    virtual uint32_t size() const override;
+
+    virtual uint8_t u8(uint32_t offset) const override;
+    virtual uint16_t u16(uint32_t offset) const override;
+    virtual uint32_t u32(uint32_t offset) const override;
+
+    virtual void u8Write(uint32_t offset, uint8_t value) override;
+    virtual void u16Write(uint32_t offset, uint16_t value) override;
+    virtual void u32Write(uint32_t offset, uint32_t value) override;
+};
@@ -0,0 +1,375 @@
+#include "mdec.hpp"
+#include "mdec_dsp.hpp"
+#include "scheduler.hpp"
+#include "libutils/condition_wait.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+constexpr uint32_t DATA_OFFSET = 0x0;
+constexpr uint32_t STATUS_OFFSET = 0x4;
+
+namespace {
+constexpr uint32_t COMMAND_DECODE = 1;
+constexpr uint32_t COMMAND_SET_QUANT_TABLE = 2;
+constexpr uint32_t COMMAND_SET_SCALE_TABLE = 3;
+
+// Bits 25..28 of the decode command are mirrored in status bits 23..26
+constexpr uint32_t COMMAND_FORMAT_MASK = 0x1E000000;
+constexpr uint32_t COMMAND_SET_BIT15 = (1 << 25);
+constexpr uint32_t COMMAND_SIGNED = (1 << 26);
+// Current block while idle, the hardware starts with the chroma blocks
+constexpr uint32_t STATUS_IDLE_BLOCK = (4 << 16);
+
+enum class Depth : uint8_t {
+    Bits4 = 0,
+    Bits8 = 1,
+    Bits24 = 2,
+    Bits15 = 3
+};
+
+Depth depth(uint32_t command) {
+    return static_cast<Depth>((command >> 27) & 3);
+}
+
+// Collects output bytes into little endian words
+class WordWriter {
+private:
+    std::vector<uint32_t> &_words;
+    uint32_t _word = 0;
+    uint32_t _shift = 0;
+
+public:
+    explicit WordWriter(std::vector<uint32_t> &words)
+        : _words(words) {}
+
+    void byte(uint8_t value) {
+        _word |= static_cast<uint32_t>(value) << _shift;
+        _shift += 8;
+        if (_shift == 32) {
+            _words.push_back(_word);
+            _word = 0;
+            _shift = 0;
+        }
+    }
+
+    void halfword(uint16_t value) {
+        byte(static_cast<uint8_t>(value));
+        byte(static_cast<uint8_t>(value >> 8));
+    }
+};
+
+uint8_t monoSample(int16_t value, bool signedOutput) {
+    auto sample = static_cast<uint8_t>(value);
+    return signedOutput ? sample : sample ^ 0x80;
+}
+} // namespace
+
+MdecWorker::MdecWorker() {
+    _thread = std::thread(&MdecWorker::work, this);
+}
+
+MdecWorker::~MdecWorker() {
+    {
+        auto lock = std::lock_guard(_mutex);
+        _running = false;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+void MdecWorker::submit(std::shared_ptr<MdecJob> job) {
+    {
+        auto lock = std::lock_guard(_mutex);
+        _queue.push_back(std::move(job));
+    }
+    _wake.notify_one();
+}
+
+void MdecWorker::wait(MdecJob &job) {
+    auto lock = std::unique_lock(_mutex);
+    conditionWait(_done, lock, [&job]() { return job.done; });
+}
+
+void MdecWorker::work() {
+    auto lock = std::unique_lock(_mutex);
+    while (true) {
+        conditionWait(_wake, lock, [this]() { return !_running || !_queue.empty(); });
+        if (!_running) {
+            return;
+        }
+        auto job = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+
+        decode(*job);
+
+        lock.lock();
+        job->done = true;
+        _done.notify_all();
+    }
+}
+
+void MdecWorker::decode(MdecJob &job) {
+    const auto *data = job.input.data();
+    const auto *end = data + job.input.size();
+    const auto *luma = job.quantTables.data();
+    const auto *chroma = job.quantTables.data() + MdecDsp::BLOCK_SIZE;
+    auto signedOutput = (job.command & COMMAND_SIGNED) != 0;
+    auto bit15 = static_cast<uint16_t>((job.command & COMMAND_SET_BIT15) ? 0x8000 : 0);
+    auto writer = WordWriter(job.output);
+
+    alignas(32) int16_t coefficients[MdecDsp::BLOCK_SIZE];
+    if (depth(job.command) == Depth::Bits4 || depth(job.command) == Depth::Bits8) {
+        // Monochrome output decodes luminance blocks only
+        alignas(32) int16_t block[MdecDsp::BLOCK_SIZE];
+        while (MdecDsp::decodeBlock(data, end, luma, coefficients)) {
+            MdecDsp::idct(coefficients, job.scaleTable.data(), block);
+            for (uint32_t i = 0; i < MdecDsp::BLOCK_SIZE; i++) {
+                auto sample = monoSample(block[i], signedOutput);
+                if (depth(job.command) == Depth::Bits8) {
+                    writer.byte(sample);
+                } else if (i % 2 == 1) {
+                    writer.byte(static_cast<uint8_t>((monoSample(block[i - 1], signedOutput) >> 4) | (sample & 0xF0)));
+                }
+            }
+        }
+        return;
+    }
+
+    // Cr, Cb and the four luminance blocks of a macroblock
+    alignas(32) int16_t blocks[6][MdecDsp::BLOCK_SIZE];
+    uint8_t rgb[MdecDsp::MACROBLOCK_PIXELS * 3];
+    while (true) {
+        for (uint32_t i = 0; i < 6; i++) {
+            if (!MdecDsp::decodeBlock(data, end, i < 2 ? chroma : luma, coefficients)) {
+                return;
+            }
+            MdecDsp::idct(coefficients, job.scaleTable.data(), blocks[i]);
+        }
+        MdecDsp::yuvToRgb(blocks[0], blocks[1], blocks[2], signedOutput, rgb);
+
+        for (uint32_t pixel = 0; pixel < MdecDsp::MACROBLOCK_PIXELS; pixel++) {
+            const auto *components = rgb + pixel * 3;
+            if (depth(job.command) == Depth::Bits24) {
+                writer.byte(components[0]);
+                writer.byte(components[1]);
+                writer.byte(components[2]);
+            } else {
+                writer.halfword(static_cast<uint16_t>(bit15 | (components[0] >> 3) | ((components[1] >> 3) << 5) | ((components[2] >> 3) << 10)));
+            }
+        }
+    }
+}
+
+Mdec::Mdec(Scheduler *scheduler)
+    : _scheduler(scheduler) {
+    _scheduler->setCallback(Scheduler::Event::MdecDecode, [this](uint64_t) { decodeFinished(); });
+}
+
+void Mdec::setOutputReadyCallback(std::function<void()> callback) {
+    _outputReadyCallback = std::move(callback);
+}
+
+void Mdec::reset() {
+    _scheduler->cancel(Scheduler::Event::MdecDecode);
+    // The worker keeps its own reference to a job that is dropped
+    _jobPending = false;
+    _command = 0;
+    _remaining = 0;
+    _job.reset();
+    _outputReady = false;
+    _outputIndex = 0;
+}
+
+void Mdec::writeData(uint32_t value) {
+    if (_remaining == 0) {
+        startCommand(value);
+    } else {
+        writeParameter(value);
+    }
+}
+
+void Mdec::startCommand(uint32_t value) {
+    _command = value;
+    _parameterIndex = 0;
+    switch (value >> 29) {
+    case COMMAND_DECODE:
+        // A new command drops output nobody read
+        _scheduler->cancel(Scheduler::Event::MdecDecode);
+        _outputReady = false;
+        _outputIndex = 0;
+        _jobPending = false;
+        _job = std::make_shared<MdecJob>();
+        _job->command = value;
+        _job->quantTables = _quantTables;
+        _job->scaleTable = _scaleTable;
+        _remaining = value & 0xFFFF;
+        _job->input.reserve(_remaining * 2);
+        break;
+    case COMMAND_SET_QUANT_TABLE:
+        // Luminance table, followed by the chroma table if bit 0 is set
+        _remaining = (value & 1) ? 32 : 16;
+        break;
+    case COMMAND_SET_SCALE_TABLE:
+        _remaining = 32;
+        break;
+    default:
+        spdlog::debug("[mdec] ignoring command {:#010x}", value);
+        _remaining = 0;
+        return;
+    }
+    if (_remaining == 0) {
+        finishCommand();
+    }
+}
+
+void Mdec::writeParameter(uint32_t value) {
+    switch (_command >> 29) {
+    case COMMAND_DECODE:
+        _job->input.push_back(static_cast<uint16_t>(value));
+        _job->input.push_back(static_cast<uint16_t>(value >> 16));
+        break;
+    case COMMAND_SET_QUANT_TABLE:
+        std::memcpy(_quantTables.data() + _parameterIndex * 4, &value, 4);
+        break;
+    case COMMAND_SET_SCALE_TABLE:
+        for (uint32_t i = 0; i < 2; i++) {
+            // Stored divided by 8, the way the IDCT uses it
+            _scaleTable[_parameterIndex * 2 + i] = static_cast<int16_t>(static_cast<int16_t>(value >> (i * 16)) / 8);
+        }
+        break;
+    }
+    _parameterIndex++;
+    if (--_remaining == 0) {
+        finishCommand();
+    }
+}
+
+void Mdec::finishCommand() {
+    if ((_command >> 29) != COMMAND_DECODE) {
+        return;
+    }
+
+    const auto *data = _job->input.data();
+    auto blocks = MdecDsp::countBlocks(data, data + _job->input.size());
+    if (!_worker) {
+        _worker = std::make_unique<MdecWorker>();
+    }
+    _worker->submit(_job);
+    _jobPending = true;
+    _scheduler->scheduleIn(Scheduler::Event::MdecDecode, std::max<uint32_t>(blocks, 1) * CYCLES_PER_BLOCK);
+}
+
+void Mdec::decodeFinished() {
+    _outputReady = true;
+    if (_outputReadyCallback) {
+        _outputReadyCallback();
+    }
+}
+
+void Mdec::finishJob() const {
+    if (_jobPending) {
+        _worker->wait(*_job);
+        _jobPending = false;
+    }
+}
+
+void Mdec::save(Snapshot &snapshot) const {
+    finishJob();
+    snapshot.control = _control;
+    snapshot.command = _command;
+    snapshot.remaining = _remaining;
+    snapshot.parameterIndex = _parameterIndex;
+    snapshot.quantTables = _quantTables;
+    snapshot.scaleTable = _scaleTable;
+    auto receiving = _job && (_command >> 29) == COMMAND_DECODE && _remaining > 0;
+    snapshot.job = receiving ? std::make_shared<MdecJob>(*_job) : _job;
+    snapshot.outputReady = _outputReady;
+    snapshot.outputIndex = _outputIndex;
+}
+
+void Mdec::restore(const Snapshot &snapshot) {
+    _control = snapshot.control;
+    _command = snapshot.command;
+    _remaining = snapshot.remaining;
+    _parameterIndex = snapshot.parameterIndex;
+    _quantTables = snapshot.quantTables;
+    _scaleTable = snapshot.scaleTable;
+    // Jobs in a snapshot are complete, see save()
+    _jobPending = false;
+    // The snapshot may be restored again, so a job being filled is copied once more
+    auto receiving = snapshot.job && (snapshot.command >> 29) == COMMAND_DECODE && snapshot.remaining > 0;
+    _job = receiving ? std::make_shared<MdecJob>(*snapshot.job) : snapshot.job;
+    _outputReady = snapshot.outputReady;
+    _outputIndex = snapshot.outputIndex;
+}
+
+bool Mdec::outputAvailable() const {
+    if (!_outputReady) {
+        return false;
+    }
+    finishJob();
+    return _outputIndex < _job->output.size();
+}
+
+uint32_t Mdec::readData() const {
+    if (!outputAvailable()) {
+        spdlog::debug("[mdec] read without decoded data");
+        return 0;
+    }
+    return _job->output[_outputIndex++];
+}
+
+uint32_t Mdec::status() const {
+    uint32_t status = ((_remaining - 1) & 0xFFFF) | ((_command & COMMAND_FORMAT_MASK) >> 2);
+    auto available = outputAvailable();
+    // A decode command is busy until all its output was read
+    auto draining = _job && _remaining == 0 && (!_outputReady || available);
+    if (!available) {
+        status |= DataOutEmpty | STATUS_IDLE_BLOCK;
+    }
+    if (_remaining > 0 || draining) {
+        status |= CommandBusy;
+    }
+    if ((_control & DataInEnable) && !draining) {
+        status |= DataInRequest;
+    }
+    if ((_control & DataOutEnable) && available) {
+        status |= DataOutRequest;
+    }
+    return status;
+}
+
+uint32_t Mdec::size() const {
+    return MDEC_REGISTERS_SIZE;
+}
+
+uint8_t Mdec::u8(uint32_t offset) const {
+    return static_cast<uint8_t>(u32(offset & ~3u) >> ((offset & 3) * 8));
+}
+uint16_t Mdec::u16(uint32_t offset) const {
+    return static_cast<uint16_t>(u32(offset & ~3u) >> ((offset & 2) * 8));
+}
+uint32_t Mdec::u32(uint32_t offset) const {
+    return offset == DATA_OFFSET ? readData() : status();
+}
+
+void Mdec::u8Write(uint32_t offset, uint8_t value) {
+    u32Write(offset, value);
+}
+void Mdec::u16Write(uint32_t offset, uint16_t value) {
+    u32Write(offset, value);
+}
+void Mdec::u32Write(uint32_t offset, uint32_t value) {
+    if (offset == DATA_OFFSET) {
+        writeData(value);
+        return;
+    }
+    if (value & Reset) {
+        reset();
+    }
+    _control = value & (DataInEnable | DataOutEnable);
+}
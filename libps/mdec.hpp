@@ -0,0 +1,151 @@
+#pragma once
+
+#include "memory_region.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Scheduler;
+
+// Offset of MDEC0/MDEC1 inside the hw register segment (0x1F801820)
+constexpr uint32_t MDEC_REGISTERS_OFFSET = 0x820;
+constexpr uint32_t MDEC_REGISTERS_SIZE = 8;
+
+// Everything a decode command needs, copied so the worker never touches device state
+struct MdecJob {
+    uint32_t command = 0;
+    std::vector<uint16_t> input;
+    std::array<uint8_t, 128> quantTables = {};
+    std::array<int16_t, 64> scaleTable = {};
+
+    // Written by the worker, valid once done is set
+    std::vector<uint32_t> output;
+    bool done = false;
+};
+
+// Decodes macroblocks on a thread of its own. Jobs run in submission order.
+class MdecWorker {
+private:
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::deque<std::shared_ptr<MdecJob>> _queue;
+    bool _running = true;
+    std::thread _thread;
+
+    void work();
+
+public:
+    MdecWorker();
+    MdecWorker(const MdecWorker &) = delete;
+    MdecWorker &operator=(const MdecWorker &) = delete;
+    ~MdecWorker();
+
+    void submit(std::shared_ptr<MdecJob> job);
+    // Blocks until the job is decoded
+    void wait(MdecJob &job);
+
+    // Decodes a job on the calling thread
+    static void decode(MdecJob &job);
+};
+
+// Macroblock decoder, see the nocash psx specs. Parameters arrive through MDEC0 or DMA
+// channel 0 and decoded pixels leave through MDEC0 reads or DMA channel 1. A complete
+// decode command is handed to the worker right away, while the emulated decode time
+// is a scheduler event: the output becomes visible at that cycle, however fast the
+// worker was, so decoding overlaps with emulation and stays deterministic.
+class Mdec
+    : public MemoryRegion {
+public:
+    enum Status : uint32_t {
+        DataOutRequest = (1 << 27),
+        DataInRequest = (1 << 28),
+        CommandBusy = (1 << 29),
+        DataInFull = (1 << 30),
+        DataOutEmpty = (1u << 31)
+    };
+
+    enum Control : uint32_t {
+        DataOutEnable = (1 << 29),
+        DataInEnable = (1 << 30),
+        Reset = (1u << 31)
+    };
+
+    // Emulated decode time of an 8x8 block, including its share of colour conversion
+    static constexpr uint32_t CYCLES_PER_BLOCK = 448;
+
+private:
+    Scheduler *_scheduler;
+    std::unique_ptr<MdecWorker> _worker;
+    std::function<void()> _outputReadyCallback;
+
+    uint32_t _control = 0;
+    uint32_t _command = 0;
+    uint32_t _remaining = 0;
+    uint32_t _parameterIndex = 0;
+
+    std::array<uint8_t, 128> _quantTables = {};
+    std::array<int16_t, 64> _scaleTable = {};
+
+    std::shared_ptr<MdecJob> _job;
+    // The job was handed to _worker and nobody waited for it yet
+    mutable bool _jobPending = false;
+    bool _outputReady = false;
+    mutable uint32_t _outputIndex = 0;
+
+    void startCommand(uint32_t value);
+    void writeParameter(uint32_t value);
+    void finishCommand();
+    void decodeFinished();
+    void reset();
+    // Waits until the worker decoded the current job
+    void finishJob() const;
+    uint32_t status() const;
+
+public:
+    // Device state for a save state. Saving waits for the worker, so a decode job in
+    // it is either complete and never changed again, which lets instances share it,
+    // or still receiving parameters and copied.
+    struct Snapshot {
+        uint32_t control;
+        uint32_t command;
+        uint32_t remaining;
+        uint32_t parameterIndex;
+        std::array<uint8_t, 128> quantTables;
+        std::array<int16_t, 64> scaleTable;
+        std::shared_ptr<MdecJob> job;
+        bool outputReady;
+        uint32_t outputIndex;
+    };
+
+    explicit Mdec(Scheduler *scheduler);
+
+    // Called when decoded data becomes available, i.e. when DMA channel 1 may run
+    void setOutputReadyCallback(std::function<void()> callback);
+
+    // MDEC0 write, a command or one of its parameters
+    void writeData(uint32_t value);
+    // MDEC0 read, the next word of decoded data
+    uint32_t readData() const;
+    bool outputAvailable() const;
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    virtual uint32_t size() const override;
+
+    virtual uint8_t u8(uint32_t offset) const override;
+    virtual uint16_t u16(uint32_t offset) const override;
+    virtual uint32_t u32(uint32_t offset) const override;
+
+    virtual void u8Write(uint32_t offset, uint8_t value) override;
+    virtual void u16Write(uint32_t offset, uint16_t value) override;
+    virtual void u32Write(uint32_t offset, uint32_t value) override;
+};
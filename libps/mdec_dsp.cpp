@@ -0,0 +1,257 @@
+#include "mdec_dsp.hpp"
+#include "libutils/simd.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Natural order index of the n-th coefficient of the run length data
+constexpr uint8_t SCAN_ORDER[MdecDsp::BLOCK_SIZE] = {
+    0, 1, 8, 16, 9, 2, 3, 10,
+    17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63};
+
+// Rounding bias and shift of a pass, the scale table is 1.15 fixed point divided by 8
+constexpr int32_t IDCT_ROUNDING = 0xFFF;
+constexpr int32_t IDCT_SHIFT = 13;
+
+// YUV to RGB factors in 8.8 fixed point
+constexpr int32_t CR_TO_R = 359;
+constexpr int32_t CB_TO_G = -88;
+constexpr int32_t CR_TO_G = -183;
+constexpr int32_t CB_TO_B = 454;
+
+int32_t signed10(uint16_t code) {
+    return static_cast<int16_t>(code << 6) >> 6;
+}
+
+uint32_t runLength(uint16_t code) {
+    return (code >> 10) & 0x3F;
+}
+
+int16_t clampSample(int32_t value) {
+    return static_cast<int16_t>(std::clamp<int32_t>(value, -128, 127));
+}
+
+void idctPassScalar(const int16_t *src, const int16_t *scaleTable, int16_t *dst, bool last) {
+    for (uint32_t y = 0; y < 8; y++) {
+        for (uint32_t x = 0; x < 8; x++) {
+            int32_t sum = 0;
+            for (uint32_t z = 0; z < 8; z++) {
+                sum += src[y + z * 8] * scaleTable[x + z * 8];
+            }
+            sum = (sum + IDCT_ROUNDING) >> IDCT_SHIFT;
+            dst[x + y * 8] = last ? clampSample(sum) : static_cast<int16_t>(std::clamp<int32_t>(sum, INT16_MIN, INT16_MAX));
+        }
+    }
+}
+
+uint8_t outputComponent(int32_t value, bool signedOutput) {
+    auto component = static_cast<uint8_t>(clampSample(value));
+    return signedOutput ? component : component ^ 0x80;
+}
+
+#ifdef PS_SIMD_SSE2
+inline __m128i loadRow(const int16_t *data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+// Scales 8 bit values in int16 lanes by an 8.8 factor, (value * factor) >> 8
+inline __m128i mulFactor(__m128i value, int16_t factor) {
+    return _mm_mulhi_epi16(_mm_slli_epi16(value, 8), _mm_set1_epi16(factor));
+}
+#endif
+
+#if defined(PS_SIMD_AVX2)
+void idctPass(const int16_t *src, const int16_t *scaleTable, int16_t *dst, bool last) {
+    __m256i rows[8];
+    for (uint32_t z = 0; z < 8; z++) {
+        rows[z] = _mm256_cvtepi16_epi32(loadRow(scaleTable + z * 8));
+    }
+    auto rounding = _mm256_set1_epi32(IDCT_ROUNDING);
+    for (uint32_t y = 0; y < 8; y++) {
+        auto sum = _mm256_setzero_si256();
+        for (uint32_t z = 0; z < 8; z++) {
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(src[y + z * 8]), rows[z]));
+        }
+        sum = _mm256_srai_epi32(_mm256_add_epi32(sum, rounding), IDCT_SHIFT);
+        auto packed = _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        if (last) {
+            packed = _mm_min_epi16(_mm_max_epi16(packed, _mm_set1_epi16(-128)), _mm_set1_epi16(127));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + y * 8), packed);
+    }
+}
+#elif defined(PS_SIMD_SSE2)
+void idctPass(const int16_t *src, const int16_t *scaleTable, int16_t *dst, bool last) {
+    __m128i rows[8];
+    for (uint32_t z = 0; z < 8; z++) {
+        rows[z] = loadRow(scaleTable + z * 8);
+    }
+    auto rounding = _mm_set1_epi32(IDCT_ROUNDING);
+    for (uint32_t y = 0; y < 8; y++) {
+        auto sumLow = _mm_setzero_si128();
+        auto sumHigh = _mm_setzero_si128();
+        for (uint32_t z = 0; z < 8; z++) {
+            // Full 32 bit products of the int16 lanes
+            auto coefficient = _mm_set1_epi16(src[y + z * 8]);
+            auto lo = _mm_mullo_epi16(coefficient, rows[z]);
+            auto hi = _mm_mulhi_epi16(coefficient, rows[z]);
+            sumLow = _mm_add_epi32(sumLow, _mm_unpacklo_epi16(lo, hi));
+            sumHigh = _mm_add_epi32(sumHigh, _mm_unpackhi_epi16(lo, hi));
+        }
+        sumLow = _mm_srai_epi32(_mm_add_epi32(sumLow, rounding), IDCT_SHIFT);
+        sumHigh = _mm_srai_epi32(_mm_add_epi32(sumHigh, rounding), IDCT_SHIFT);
+        auto packed = _mm_packs_epi32(sumLow, sumHigh);
+        if (last) {
+            packed = _mm_min_epi16(_mm_max_epi16(packed, _mm_set1_epi16(-128)), _mm_set1_epi16(127));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + y * 8), packed);
+    }
+}
+#endif
+} // namespace
+
+namespace MdecDsp {
+
+bool decodeBlock(const uint16_t *&data, const uint16_t *end, const uint8_t *quantTable, int16_t *block) {
+    while (data < end && *data == END_OF_BLOCK) {
+        data++;
+    }
+    if (data == end) {
+        return false;
+    }
+    std::fill(block, block + BLOCK_SIZE, int16_t(0));
+
+    // The DC coefficient only uses the first quantization table entry
+    auto code = *data++;
+    auto scale = static_cast<int32_t>(runLength(code));
+    auto value = signed10(code) * quantTable[0];
+    uint32_t index = 0;
+    while (true) {
+        // A scale of zero stores the coefficients unquantized and in natural order
+        if (scale == 0) {
+            value = signed10(code) * 2;
+        }
+        value = std::clamp<int32_t>(value, -0x400, 0x3FF);
+        block[scale > 0 ? SCAN_ORDER[index] : index] = static_cast<int16_t>(value);
+
+        if (data == end) {
+            return false;
+        }
+        code = *data++;
+        index += runLength(code) + 1;
+        if (index >= BLOCK_SIZE) {
+            return true;
+        }
+        value = (signed10(code) * quantTable[index] * scale + 4) / 8;
+    }
+}
+
+uint32_t countBlocks(const uint16_t *data, const uint16_t *end) {
+    uint32_t blocks = 0;
+    while (true) {
+        while (data < end && *data == END_OF_BLOCK) {
+            data++;
+        }
+        if (data == end) {
+            return blocks;
+        }
+        data++;
+        uint32_t index = 0;
+        while (index < BLOCK_SIZE) {
+            if (data == end) {
+                return blocks;
+            }
+            index += runLength(*data++) + 1;
+        }
+        blocks++;
+    }
+}
+
+void idctScalar(const int16_t *block, const int16_t *scaleTable, int16_t *out) {
+    int16_t temp[BLOCK_SIZE];
+    idctPassScalar(block, scaleTable, temp, false);
+    idctPassScalar(temp, scaleTable, out, true);
+}
+
+void idct(const int16_t *block, const int16_t *scaleTable, int16_t *out) {
+#ifdef PS_SIMD_SSE2
+    alignas(16) int16_t temp[BLOCK_SIZE];
+    idctPass(block, scaleTable, temp, false);
+    idctPass(temp, scaleTable, out, true);
+#else
+    idctScalar(block, scaleTable, out);
+#endif
+}
+
+void yuvToRgbScalar(const int16_t *cr, const int16_t *cb, const int16_t *y, bool signedOutput, uint8_t *rgb) {
+    for (uint32_t py = 0; py < 16; py++) {
+        for (uint32_t px = 0; px < 16; px++) {
+            auto chroma = (px / 2) + (py / 2) * 8;
+            int32_t red = (cr[chroma] * CR_TO_R) >> 8;
+            int32_t green = ((cb[chroma] * CB_TO_G) >> 8) + ((cr[chroma] * CR_TO_G) >> 8);
+            int32_t blue = (cb[chroma] * CB_TO_B) >> 8;
+
+            auto block = (py / 8) * 2 + px / 8;
+            int32_t luma = y[block * BLOCK_SIZE + (px % 8) + (py % 8) * 8];
+
+            auto *pixel = rgb + (px + py * 16) * 3;
+            pixel[0] = outputComponent(luma + red, signedOutput);
+            pixel[1] = outputComponent(luma + green, signedOutput);
+            pixel[2] = outputComponent(luma + blue, signedOutput);
+        }
+    }
+}
+
+void yuvToRgb(const int16_t *cr, const int16_t *cb, const int16_t *y, bool signedOutput, uint8_t *rgb) {
+#ifdef PS_SIMD_SSE2
+    auto low = _mm_set1_epi16(-128);
+    auto high = _mm_set1_epi16(127);
+    auto bias = _mm_set1_epi8(signedOutput ? 0 : static_cast<char>(0x80));
+    auto component = [&](__m128i luma, __m128i offset) {
+        return _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(luma, offset), low), high);
+    };
+
+    // Eight pixels at a time, one row of a luminance block sharing four chroma samples
+    for (uint32_t py = 0; py < 16; py++) {
+        for (uint32_t half = 0; half < 2; half++) {
+            auto chroma = half * 4 + (py / 2) * 8;
+            auto crRow = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr + chroma));
+            auto cbRow = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb + chroma));
+            crRow = _mm_unpacklo_epi16(crRow, crRow);
+            cbRow = _mm_unpacklo_epi16(cbRow, cbRow);
+
+            auto red = mulFactor(crRow, CR_TO_R);
+            auto green = _mm_add_epi16(mulFactor(cbRow, CB_TO_G), mulFactor(crRow, CR_TO_G));
+            auto blue = mulFactor(cbRow, CB_TO_B);
+
+            auto block = (py / 8) * 2 + half;
+            auto luma = loadRow(y + block * BLOCK_SIZE + (py % 8) * 8);
+
+            auto redGreen = _mm_xor_si128(_mm_packs_epi16(component(luma, red), component(luma, green)), bias);
+            auto blueBytes = _mm_xor_si128(_mm_packs_epi16(component(luma, blue), component(luma, blue)), bias);
+
+            alignas(16) uint8_t components[32];
+            _mm_store_si128(reinterpret_cast<__m128i *>(components), redGreen);
+            _mm_store_si128(reinterpret_cast<__m128i *>(components + 16), blueBytes);
+
+            auto *pixel = rgb + (half * 8 + py * 16) * 3;
+            for (uint32_t i = 0; i < 8; i++) {
+                pixel[i * 3] = components[i];
+                pixel[i * 3 + 1] = components[8 + i];
+                pixel[i * 3 + 2] = components[16 + i];
+            }
+        }
+    }
+#else
+    yuvToRgbScalar(cr, cb, y, signedOutput, rgb);
+#endif
+}
+
+} // namespace MdecDsp
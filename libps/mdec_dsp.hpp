@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Macroblock decoding kernels of the MDEC, following the nocash psx specs. The IDCT
+// and the colour conversion have a scalar reference implementation and are
+// vectorized with SSE2 / AVX2 when available. Both produce bit identical results.
+namespace MdecDsp {
+
+constexpr uint32_t BLOCK_SIZE = 64;
+constexpr uint32_t MACROBLOCK_PIXELS = 16 * 16;
+// Run length code which ends a block, also used as padding between blocks
+constexpr uint16_t END_OF_BLOCK = 0xFE00;
+
+// Run length decodes and dequantizes one block into natural order. Returns false
+// when the data ends before the block is complete.
+bool decodeBlock(const uint16_t *&data, const uint16_t *end, const uint8_t *quantTable, int16_t *block);
+// Same parse without decoding, for the timing of a command
+uint32_t countBlocks(const uint16_t *data, const uint16_t *end);
+
+// Two pass matrix IDCT with the scale table of the "set scale table" command, which
+// has to be divided by 8 already. The output is clamped to signed 8 bit.
+void idct(const int16_t *block, const int16_t *scaleTable, int16_t *out);
+void idctScalar(const int16_t *block, const int16_t *scaleTable, int16_t *out);
+
+// Converts a 16x16 macroblock into RGB888 (R first). cr and cb are 8x8 blocks, y the
+// four 8x8 luminance blocks (top left, top right, bottom left, bottom right), all
+// in the signed 8 bit range of the IDCT output.
+void yuvToRgb(const int16_t *cr, const int16_t *cb, const int16_t *y, bool signedOutput, uint8_t *rgb);
+void yuvToRgbScalar(const int16_t *cr, const int16_t *cb, const int16_t *y, bool signedOutput, uint8_t *rgb);
+
+} // namespace MdecDsp
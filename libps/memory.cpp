@@ -1,18 +1,106 @@
 #include "memory.hpp"
+#include "dma.hpp"
+#include "interrupt_controller.hpp"
+#include "mdec.hpp"
 #include "libutils/platform.hpp"
+#include "ram.hpp"
+#include "sio.hpp"
+#include "spu.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <fmt/format.h>
+#include <iterator>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <utility>
+
+// Memory regions
+constexpr uint32_t RAM_SIZE = 2048 * 1024;
+constexpr uint32_t RAM_KUSEG = 0x00000000;
+constexpr uint32_t RAM_KSEG0 = 0x80000000;
+constexpr uint32_t RAM_KSEG1 = 0xA0000000;
+
+constexpr uint32_t EXPANSION_1_SIZE = 8192 * 1024;
+constexpr uint32_t EXPANSION_1_KUSEG = 0x1F000000;
+constexpr uint32_t EXPANSION_1_KSEG0 = 0x9F000000;
+constexpr uint32_t EXPANSION_1_KSEG1 = 0xBF000000;
+
+constexpr uint32_t BIOS_SIZE = 512 * 1024;
+constexpr uint32_t BIOS_KUSEG = 0x1fc00000;
+constexpr uint32_t BIOS_KSEG0 = 0x9fc00000;
+constexpr uint32_t BIOS_KSEG1 = 0xbfc00000;
+
+constexpr uint32_t SCRATCHPAD_KUSEG = 0x1f800000;
+// Matches the KUSEG and KSEG0 mirrors of the scratchpad, it is not accessible through KSEG1
+constexpr uint32_t SCRATCHPAD_ADDRESS_MASK = 0x7ffffc00;
+
+constexpr uint32_t HW_REGISTERS_KUSEG = 0x1f801000;
+constexpr uint32_t HW_REGISTERS_KSEG0 = 0x9f801000;
+constexpr uint32_t HW_REGISTERS_KSEG1 = 0xbf801000;
+
+constexpr uint32_t MEMORY_CONTROL_SIZE = MEMORY_CONTROL_REGISTER_COUNT * sizeof(uint32_t);
+constexpr uint32_t RAM_SIZE_REGISTER_OFFSET = 0x60;
+
+// Device registers that can be read without side effects, relative to 0x1F801000
+constexpr struct {
+    uint32_t offset;
+    uint32_t size;
+} PURE_READ_REGISTERS[] = {
+    {0x000, 0x024}, // Memory control
+    {0x044, 0x00C}, // SIO status, mode, control and baudrate
+    {0x060, 0x004}, // RAM size
+    {0x070, 0x008}, // I_STAT and I_MASK
+    {0x080, 0x080}, // DMA
+    {0x824, 0x004}, // MDEC status
+    {0xC00, 0x400}, // SPU
+};
+
+// Register values as set up by the BIOS
+constexpr uint32_t MEMORY_CONTROL_DEFAULTS[MEMORY_CONTROL_REGISTER_COUNT] = {
+    0x1f000000, // Expansion 1 base address
+    0x1f802000, // Expansion 2 base address
+    0x0013243f, // Expansion 1 delay/size
+    0x00003022, // Expansion 3 delay/size
+    0x0013243f, // BIOS ROM delay/size
+    0x200931e1, // SPU delay/size
+    0x00020843, // CDROM delay/size
+    0x00070777, // Expansion 2 delay/size
+    0x00031125  // Common delay
+};
+constexpr uint32_t RAM_SIZE_DEFAULT = 0x00000b88;
+
+namespace MemoryControl {
+enum : uint32_t {
+    Expansion1Delay = 2,
+    BiosDelay = 4,
+    SpuDelay = 5,
+    CommonDelay = 8
+};
+}; // namespace MemoryControl
+
+constexpr uint32_t CACHE_CONTROL_SIZE = 512;
+constexpr uint32_t CACHE_CONTROL_KSEG2 = 0xfffe0000;
+constexpr uint32_t CACHE_CONTROL_REGISTER_OFFSET = 0x130;
+
+constexpr uint32_t PHYSICAL_ADDRESS_MASK = 0x1fffffff;
+constexpr uint32_t MIRROR_BASES[] = {0x00000000, 0x80000000, 0xa0000000};
 
 namespace {
 bool addressInRange(uint32_t address, uint32_t base, uint32_t size) {
     return address >= base &&
            address <= (base + size);
 }
+bool rangesOverlap(uint32_t a, uint32_t aSize, uint32_t b, uint32_t bSize) {
+    return a < b + bSize && b < a + aSize;
+}
+bool watches(WatchpointType type, bool write) {
+    auto mask = static_cast<uint8_t>(write ? WatchpointType::Write : WatchpointType::Read);
+    return (static_cast<uint8_t>(type) & mask) != 0;
+}
 template <typename A, typename B>
 constexpr bool sameTypeRemoveQualifier() {
-    return std::is_same<std::remove_cv<A>::type, B>::value;
+    return std::is_same<std::remove_cv_t<A>, B>::value;
 }
 } // namespace
 
@@ -42,12 +130,79 @@ ValueType Memory::read(uint32_t offset, MemoryRegion *memory) {
     }
 }
 
+Memory::Memory()
+    : _scratchpad(std::make_unique<Ram>(SCRATCHPAD_SIZE)),
+      _pageTables(MEMORY_PAGE_COUNT * (2 * sizeof(uint8_t *) + sizeof(uint8_t)), false),
+      _readPages(reinterpret_cast<uint8_t **>(_pageTables.data())),
+      _writePages(_readPages + MEMORY_PAGE_COUNT),
+      _pageTimings(reinterpret_cast<uint8_t *>(_writePages + MEMORY_PAGE_COUNT)),
+      _ramSize(RAM_SIZE_DEFAULT) {
+    _scratchpadData = _scratchpad->data();
+
+    std::copy(std::begin(MEMORY_CONTROL_DEFAULTS), std::end(MEMORY_CONTROL_DEFAULTS), std::begin(_memoryControl));
+    updateAccessTimes();
+
+    // The SPU window is timed by its own delay register whether a SPU is mapped or not
+    for (auto offset = SPU_REGISTERS_OFFSET; offset < SPU_REGISTERS_OFFSET + SPU_REGISTERS_SIZE; offset += sizeof(uint32_t)) {
+        _ioHandlers[offset / sizeof(uint32_t)].timing = AccessTiming::SpuRegisters;
+    }
+    mapIo(&_controlRegisters, 0, MEMORY_CONTROL_SIZE);
+    mapIo(&_controlRegisters, RAM_SIZE_REGISTER_OFFSET, sizeof(uint32_t), RAM_SIZE_REGISTER_OFFSET);
+}
+
+uint32_t Memory::ControlRegisters::size() const {
+    return RAM_SIZE_REGISTER_OFFSET + sizeof(uint32_t);
+}
+
+// Byte and halfword accesses go to the word they are in
+uint32_t Memory::ControlRegisters::read(uint32_t offset) const {
+    auto word = offset / sizeof(uint32_t);
+    if (word == RAM_SIZE_REGISTER_OFFSET / sizeof(uint32_t)) {
+        return _memory._ramSize;
+    }
+    return _memory._memoryControl[word];
+}
+
+void Memory::ControlRegisters::write(uint32_t offset, uint32_t value) {
+    auto word = offset / sizeof(uint32_t);
+    if (word == RAM_SIZE_REGISTER_OFFSET / sizeof(uint32_t)) {
+        _memory._ramSize = value;
+        return;
+    }
+    spdlog::debug("[mem] memory control {:#04x} = {:#010x}", offset, value);
+    _memory._memoryControl[word] = value;
+    _memory.updateAccessTimes();
+}
+
+void Memory::updateAccessTimes() {
+    auto commonDelay = _memoryControl[MemoryControl::CommonDelay];
+
+    _accessTimes[AccessTiming::Uncharged] = {};
+    _accessTimes[AccessTiming::MainRam] = {Timing::RAM_READ_CYCLES, Timing::RAM_READ_CYCLES, Timing::RAM_READ_CYCLES};
+    _accessTimes[AccessTiming::BiosRom] = Timing::calculateAccessTimes(_memoryControl[MemoryControl::BiosDelay], commonDelay);
+    _accessTimes[AccessTiming::Expansion1] = Timing::calculateAccessTimes(_memoryControl[MemoryControl::Expansion1Delay], commonDelay);
+    _accessTimes[AccessTiming::SpuRegisters] = Timing::calculateAccessTimes(_memoryControl[MemoryControl::SpuDelay], commonDelay);
+    _accessTimes[AccessTiming::IoRegisters] = {Timing::IO_READ_CYCLES, Timing::IO_READ_CYCLES, Timing::IO_READ_CYCLES};
+}
+
 template <typename ValueType>
 ValueType Memory::read(uint32_t address) {
     spdlog::trace("[mem] Reading from {:#010x}", address);
 
-    if (address % 4 != 0) {
+    if (address % sizeof(ValueType) != 0) {
         spdlog::warn("Unaligned memory access.");
+    } else if (auto page = _readPages[address >> MEMORY_PAGE_SHIFT]) {
+        auto timing = _pageTimings[address >> MEMORY_PAGE_SHIFT];
+        _accessCycles += _accessTimes[timing].forSize<ValueType>();
+        PS_PERF_COUNT(countRead<ValueType>(timing == AccessTiming::BiosRom ? MemorySegment::BIOS : MemorySegment::RAM));
+        return *reinterpret_cast<const ValueType *>(page + (address & MEMORY_PAGE_MASK));
+    } else if ((address & SCRATCHPAD_ADDRESS_MASK) == SCRATCHPAD_KUSEG && !_scratchpadWatched) {
+        PS_PERF_COUNT(countRead<ValueType>(MemorySegment::SCRATCHPAD));
+        return *reinterpret_cast<const ValueType *>(_scratchpadData + (address & (SCRATCHPAD_SIZE - 1)));
+    }
+
+    if (!_watchpoints.empty()) {
+        checkWatchpoints(address, sizeof(ValueType), false);
     }
 
     auto segmentAndOffset = getSegmentForAddress(address);
@@ -55,19 +210,34 @@ ValueType Memory::read(uint32_t address) {
         spdlog::error("Trying to read from address {:#010x}. No matching memory region found.", address);
         throw NotImplemented();
     }
+    PS_PERF_COUNT(countRead<ValueType>(segmentAndOffset->region));
 
     switch (segmentAndOffset->region) {
     case MemorySegment::RAM:
+        _accessCycles += _accessTimes[AccessTiming::MainRam].forSize<ValueType>();
         return read<ValueType>(segmentAndOffset->offset, _ram.get());
     case MemorySegment::EXPANSION_REGION_1:
+        _accessCycles += _accessTimes[AccessTiming::Expansion1].forSize<ValueType>();
         spdlog::warn("Ignoring write to expansion region 1");
         return 0;
+    case MemorySegment::SCRATCHPAD:
+        return read<ValueType>(segmentAndOffset->offset, _scratchpad.get());
     case MemorySegment::BIOS:
+        _accessCycles += _accessTimes[AccessTiming::BiosRom].forSize<ValueType>();
         return read<ValueType>(segmentAndOffset->offset, _bios.get());
-    case MemorySegment::HW_REGISTERS:
+    case MemorySegment::HW_REGISTERS: {
+        const auto &handler = ioHandler(segmentAndOffset->offset);
+        _accessCycles += _accessTimes[handler.timing].forSize<ValueType>();
+        if (handler.device) {
+            return read<ValueType>(segmentAndOffset->offset - handler.base, handler.device);
+        }
         spdlog::warn("Ignoring read from memory segment hw registers.");
         return 0;
+    }
     case MemorySegment::CACHE_CONTROL:
+        if (segmentAndOffset->offset == CACHE_CONTROL_REGISTER_OFFSET) {
+            return static_cast<ValueType>(_cacheControl);
+        }
         spdlog::warn("Ignoring read from memory segment cache control.");
         return 0;
     default:
@@ -80,8 +250,21 @@ template <typename ValueType>
 void Memory::write(uint32_t address, ValueType value) {
     spdlog::trace("[mem] Writing {:#010x} to {:#010x}", value, address);
 
-    if (address % 4 != 0) {
+    if (address % sizeof(ValueType) != 0) {
         spdlog::warn("Unaligned memory access.");
+    } else if (auto page = _writePages[address >> MEMORY_PAGE_SHIFT]) {
+        // Only RAM is mapped writable
+        PS_PERF_COUNT(countWrite<ValueType>(MemorySegment::RAM));
+        *reinterpret_cast<ValueType *>(page + (address & MEMORY_PAGE_MASK)) = value;
+        return;
+    } else if ((address & SCRATCHPAD_ADDRESS_MASK) == SCRATCHPAD_KUSEG && !_scratchpadWatched) {
+        PS_PERF_COUNT(countWrite<ValueType>(MemorySegment::SCRATCHPAD));
+        *reinterpret_cast<ValueType *>(_scratchpadData + (address & (SCRATCHPAD_SIZE - 1))) = value;
+        return;
+    }
+
+    if (!_watchpoints.empty()) {
+        checkWatchpoints(address, sizeof(ValueType), true);
     }
 
     auto segmentAndOffset = getSegmentForAddress(address);
@@ -89,21 +272,37 @@ void Memory::write(uint32_t address, ValueType value) {
         spdlog::error("Trying to read from address {:#x}. No matching memory region found.", address);
         throw NotImplemented();
     }
+    PS_PERF_COUNT(countWrite<ValueType>(segmentAndOffset->region));
 
     switch (segmentAndOffset->region) {
     case MemorySegment::RAM:
+        ramWritten(segmentAndOffset->offset, sizeof(ValueType));
         write(segmentAndOffset->offset, value, _ram.get());
         return;
     case MemorySegment::EXPANSION_REGION_1:
         spdlog::warn("Ignoring write to expansion region 1");
         return;
+    case MemorySegment::SCRATCHPAD:
+        write(segmentAndOffset->offset, value, _scratchpad.get());
+        return;
     case MemorySegment::BIOS:
         spdlog::warn("Writes to memory segment BIOS are not allowed.");
         return;
-    case MemorySegment::HW_REGISTERS:
+    case MemorySegment::HW_REGISTERS: {
+        const auto &handler = ioHandler(segmentAndOffset->offset);
+        if (handler.device) {
+            write(segmentAndOffset->offset - handler.base, value, handler.device);
+            return;
+        }
         spdlog::warn("Ignoring write to memory segment hw registers.");
         return;
+    }
     case MemorySegment::CACHE_CONTROL:
+        if (segmentAndOffset->offset == CACHE_CONTROL_REGISTER_OFFSET) {
+            spdlog::debug("[mem] cache control = {:#010x}", value);
+            _cacheControl = value;
+            return;
+        }
         spdlog::warn("Ignoring write to memory segment cache control.");
         return;
     default:
@@ -111,14 +310,303 @@ void Memory::write(uint32_t address, ValueType value) {
     }
 }
 
+void Memory::mapPages(MemoryRegion *region, uint32_t base, bool writable, AccessTiming timing) {
+    auto data = region->data();
+    for (uint32_t offset = 0; offset < region->size(); offset += MEMORY_PAGE_SIZE) {
+        auto page = (base + offset) >> MEMORY_PAGE_SHIFT;
+        _readPages[page] = data ? data + offset : nullptr;
+        _writePages[page] = data && writable ? data + offset : nullptr;
+        _pageTimings[page] = timing;
+    }
+    _mappedPages.emplace_back(base >> MEMORY_PAGE_SHIFT, (region->size() + MEMORY_PAGE_MASK) >> MEMORY_PAGE_SHIFT);
+}
+
+bool Memory::protectCode(uint32_t address) {
+    auto segment = getSegmentForAddress(address);
+    if (!segment || segment->region != MemorySegment::RAM || segment->offset >= _codePages.size() * MEMORY_PAGE_SIZE) {
+        return false;
+    }
+    auto page = segment->offset >> MEMORY_PAGE_SHIFT;
+    if (!_codePages[page]) {
+        _codePages[page] = 1;
+        _protectedCodePages++;
+        for (auto base : {RAM_KUSEG, RAM_KSEG0, RAM_KSEG1}) {
+            _writePages[(base >> MEMORY_PAGE_SHIFT) + page] = nullptr;
+        }
+    }
+    return true;
+}
+
+void Memory::unprotectCodePage(uint32_t page) {
+    auto *data = _ram->data() + page * MEMORY_PAGE_SIZE;
+    for (const auto &watchpoint : _watchpoints) {
+        if (watches(watchpoint.type, true) && rangesOverlap(watchpoint.address, watchpoint.length, page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE)) {
+            data = nullptr;
+        }
+    }
+    for (auto base : {RAM_KUSEG, RAM_KSEG0, RAM_KSEG1}) {
+        _writePages[(base >> MEMORY_PAGE_SHIFT) + page] = data;
+    }
+}
+
+void Memory::codeWritten(uint32_t offset, uint32_t size) {
+    if (size == 0 || offset >= _codePages.size() * MEMORY_PAGE_SIZE) {
+        return;
+    }
+    auto first = offset >> MEMORY_PAGE_SHIFT;
+    auto last = std::min<size_t>((offset + size - 1) >> MEMORY_PAGE_SHIFT, _codePages.size() - 1);
+    for (auto page = first; page <= last; page++) {
+        if (!_codePages[page]) {
+            continue;
+        }
+        _codePages[page] = 0;
+        _protectedCodePages--;
+        unprotectCodePage(page);
+        spdlog::trace("[mem] code in RAM page {:#x} was written", page * MEMORY_PAGE_SIZE);
+        if (_codeWriteListener) {
+            _codeWriteListener->codeWritten(page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE);
+        }
+    }
+}
+
+void Memory::updatePageTables() {
+    // Everything outside the mapped ranges was never written
+    for (auto [first, count] : _mappedPages) {
+        std::fill_n(_readPages + first, count, nullptr);
+        std::fill_n(_writePages + first, count, nullptr);
+        std::fill_n(_pageTimings + first, count, AccessTiming::Uncharged);
+    }
+    _mappedPages.clear();
+
+    if (_ram) {
+        for (auto base : {RAM_KUSEG, RAM_KSEG0, RAM_KSEG1}) {
+            mapPages(_ram.get(), base, true, AccessTiming::MainRam);
+        }
+    }
+    if (_bios) {
+        for (auto base : {BIOS_KUSEG, BIOS_KSEG0, BIOS_KSEG1}) {
+            mapPages(_bios.get(), base, false, AccessTiming::BiosRom);
+        }
+    }
+
+    _scratchpadWatched = false;
+    for (const auto &watchpoint : _watchpoints) {
+        _scratchpadWatched |= rangesOverlap(watchpoint.address, watchpoint.length, SCRATCHPAD_KUSEG, SCRATCHPAD_SIZE);
+
+        auto first = watchpoint.address >> MEMORY_PAGE_SHIFT;
+        auto last = (watchpoint.address + watchpoint.length - 1) >> MEMORY_PAGE_SHIFT;
+        for (auto base : MIRROR_BASES) {
+            for (auto page = first; page <= last; page++) {
+                auto index = (base >> MEMORY_PAGE_SHIFT) + page;
+                if (watches(watchpoint.type, false)) {
+                    _readPages[index] = nullptr;
+                }
+                if (watches(watchpoint.type, true)) {
+                    _writePages[index] = nullptr;
+                }
+            }
+        }
+    }
+
+    for (uint32_t page = 0; _protectedCodePages && page < _codePages.size(); page++) {
+        if (_codePages[page]) {
+            for (auto base : {RAM_KUSEG, RAM_KSEG0, RAM_KSEG1}) {
+                _writePages[(base >> MEMORY_PAGE_SHIFT) + page] = nullptr;
+            }
+        }
+    }
+}
+
+void Memory::save(Snapshot &snapshot) const {
+    auto copy = [](ByteBuffer &buffer, MemoryRegion *region) {
+        if (!region || !region->data()) {
+            buffer.clear();
+            return;
+        }
+        buffer.resize(region->size());
+        std::memcpy(buffer.data(), region->data(), buffer.size());
+    };
+    copy(snapshot.ram, _ram.get());
+    copy(snapshot.scratchpad, _scratchpad.get());
+    snapshot.cacheControl = _cacheControl;
+    snapshot.ramSize = _ramSize;
+    snapshot.accessCycles = _accessCycles;
+    std::copy(std::begin(_memoryControl), std::end(_memoryControl), std::begin(snapshot.memoryControl));
+}
+
+void Memory::restore(const Snapshot &snapshot) {
+    auto copy = [](const ByteBuffer &buffer, MemoryRegion *region) {
+        auto mapped = region && region->data();
+        if (buffer.empty() && !mapped) {
+            return;
+        }
+        if (!mapped || buffer.size() != region->size()) {
+            throw std::runtime_error(fmt::format("Save state does not match a memory region of {} bytes", region ? region->size() : 0));
+        }
+        std::memcpy(region->data(), buffer.data(), buffer.size());
+    };
+    if (!snapshot.ram.empty()) {
+        restoreRam(snapshot.ram);
+    }
+    copy(snapshot.scratchpad, _scratchpad.get());
+    _cacheControl = snapshot.cacheControl;
+    _ramSize = snapshot.ramSize;
+    _accessCycles = snapshot.accessCycles;
+    std::copy(std::begin(snapshot.memoryControl), std::end(snapshot.memoryControl), std::begin(_memoryControl));
+    updateAccessTimes();
+}
+
+void Memory::restoreRam(const ByteBuffer &ram) {
+    if (!_ram || !_ram->data() || ram.size() != _ram->size()) {
+        throw std::runtime_error(fmt::format("Save state does not match a memory region of {} bytes", _ram ? _ram->size() : 0));
+    }
+    // Run-ahead restores every frame, code pages the frames did not write keep
+    // their protection and with it the translations made from them
+    auto *data = _ram->data();
+    for (uint32_t offset = 0; offset < ram.size(); offset += MEMORY_PAGE_SIZE) {
+        auto length = std::min<uint32_t>(MEMORY_PAGE_SIZE, static_cast<uint32_t>(ram.size()) - offset);
+        auto page = offset >> MEMORY_PAGE_SHIFT;
+        auto code = page < _codePages.size() && _codePages[page];
+        if (code && std::memcmp(data + offset, ram.data() + offset, length) == 0) {
+            continue;
+        }
+        std::memcpy(data + offset, ram.data() + offset, length);
+        if (code) {
+            codeWritten(offset, length);
+        }
+    }
+}
+
 void Memory::setRam(std::unique_ptr<MemoryRegion> ram) {
     spdlog::debug("Setting RAM memory region ({} bytes).", ram->size());
+    // Code in the old RAM is gone
+    ramWritten(0, static_cast<uint32_t>(_codePages.size() * MEMORY_PAGE_SIZE));
     _ram = std::move(ram);
+    _codePages.assign(_ram->data() ? _ram->size() / MEMORY_PAGE_SIZE : 0, 0);
+    updatePageTables();
+}
+
+void Memory::mapIo(MemoryRegion *device, uint32_t offset, uint32_t size, uint32_t deviceOffset) {
+    if (offset % sizeof(uint32_t) != 0 || size % sizeof(uint32_t) != 0 || offset + size > HW_REGISTERS_SIZE ||
+        deviceOffset % sizeof(uint32_t) != 0 || deviceOffset > offset) {
+        throw std::runtime_error(fmt::format("Invalid hardware register range {:#x}+{:#x}", offset, size));
+    }
+    for (auto word = offset / sizeof(uint32_t); word < (offset + size) / sizeof(uint32_t); word++) {
+        _ioHandlers[word].device = device;
+        _ioHandlers[word].base = offset - deviceOffset;
+    }
+}
+
+void Memory::setSpu(MemoryRegion *spu) {
+    spdlog::debug("Setting SPU register region ({} bytes).", spu->size());
+    mapIo(spu, SPU_REGISTERS_OFFSET, SPU_REGISTERS_SIZE);
+}
+
+void Memory::setSio(MemoryRegion *sio) {
+    spdlog::debug("Setting SIO register region ({} bytes).", sio->size());
+    mapIo(sio, SIO_REGISTERS_OFFSET, SIO_REGISTERS_SIZE);
+}
+
+void Memory::setInterruptController(MemoryRegion *interruptController) {
+    spdlog::debug("Setting interrupt controller region ({} bytes).", interruptController->size());
+    mapIo(interruptController, INTERRUPT_REGISTERS_OFFSET, INTERRUPT_REGISTERS_SIZE);
+}
+
+void Memory::setDma(MemoryRegion *dma) {
+    spdlog::debug("Setting DMA register region ({} bytes).", dma->size());
+    mapIo(dma, DMA_REGISTERS_OFFSET, DMA_REGISTERS_SIZE);
+}
+
+void Memory::setMdec(MemoryRegion *mdec) {
+    spdlog::debug("Setting MDEC register region ({} bytes).", mdec->size());
+    mapIo(mdec, MDEC_REGISTERS_OFFSET, MDEC_REGISTERS_SIZE);
 }
 
 void Memory::setBios(std::unique_ptr<MemoryRegion> bios) {
     spdlog::debug("Setting BIOS memory region ({} bytes).", bios->size());
     _bios = std::move(bios);
+    updatePageTables();
+}
+
+void Memory::setWatchpointListener(IWatchpointListener *listener) {
+    _watchpointListener = listener;
+}
+
+void Memory::addWatchpoint(const Watchpoint &watchpoint) {
+    auto physical = watchpoint;
+    physical.address &= PHYSICAL_ADDRESS_MASK;
+    physical.length = std::max<uint32_t>(physical.length, 1);
+    if (std::find(_watchpoints.begin(), _watchpoints.end(), physical) == _watchpoints.end()) {
+        _watchpoints.push_back(physical);
+        updatePageTables();
+    }
+}
+
+bool Memory::removeWatchpoint(const Watchpoint &watchpoint) {
+    auto physical = watchpoint;
+    physical.address &= PHYSICAL_ADDRESS_MASK;
+    physical.length = std::max<uint32_t>(physical.length, 1);
+    auto it = std::find(_watchpoints.begin(), _watchpoints.end(), physical);
+    if (it == _watchpoints.end()) {
+        return false;
+    }
+    _watchpoints.erase(it);
+    updatePageTables();
+    return true;
+}
+
+void Memory::clearWatchpoints() {
+    if (!_watchpoints.empty()) {
+        _watchpoints.clear();
+        updatePageTables();
+    }
+}
+
+void Memory::checkWatchpoints(uint32_t address, uint32_t size, bool write) {
+    auto physical = address & PHYSICAL_ADDRESS_MASK;
+    for (const auto &watchpoint : _watchpoints) {
+        if (watches(watchpoint.type, write) && rangesOverlap(physical, size, watchpoint.address, watchpoint.length)) {
+            spdlog::debug("[mem] watchpoint hit, {} at {:#010x}", write ? "write" : "read", address);
+            if (_watchpointListener) {
+                _watchpointListener->watchpointHit(watchpoint, address, write);
+            }
+            return;
+        }
+    }
+}
+
+bool Memory::readIsPure(uint32_t offset) {
+    for (const auto &range : PURE_READ_REGISTERS) {
+        if (offset >= range.offset && offset - range.offset < range.size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<uint8_t> Memory::debugRead(uint32_t address) {
+    auto segment = getSegmentForAddress(address);
+    if (!segment || (segment->region == MemorySegment::HW_REGISTERS && !readIsPure(segment->offset))) {
+        return {};
+    }
+
+    auto listener = std::exchange(_watchpointListener, nullptr);
+    auto cycles = _accessCycles;
+    auto value = u8(address);
+    _accessCycles = cycles;
+    _watchpointListener = listener;
+    return value;
+}
+
+bool Memory::debugWrite(uint32_t address, uint8_t value) {
+    if (!getSegmentForAddress(address)) {
+        return false;
+    }
+
+    auto listener = std::exchange(_watchpointListener, nullptr);
+    u8Write(address, value);
+    _watchpointListener = listener;
+    return true;
 }
 
 uint8_t Memory::u8(uint32_t address) {
@@ -141,30 +629,6 @@ void Memory::u32Write(uint32_t address, uint32_t value) {
     write(address, value);
 }
 
-// Memory regions
-constexpr uint32_t RAM_SIZE = 2048 * 1024;
-constexpr uint32_t RAM_KUSEG = 0x00000000;
-constexpr uint32_t RAM_KSEG0 = 0x80000000;
-constexpr uint32_t RAM_KSEG1 = 0xA0000000;
-
-constexpr uint32_t EXPANSION_1_SIZE = 8192 * 1024;
-constexpr uint32_t EXPANSION_1_KUSEG = 0x1F000000;
-constexpr uint32_t EXPANSION_1_KSEG0 = 0x9F000000;
-constexpr uint32_t EXPANSION_1_KSEG1 = 0xBF000000;
-
-constexpr uint32_t BIOS_SIZE = 512 * 1024;
-constexpr uint32_t BIOS_KUSEG = 0x1fc00000;
-constexpr uint32_t BIOS_KSEG0 = 0x9fc00000;
-constexpr uint32_t BIOS_KSEG1 = 0xbfc00000;
-
-constexpr uint32_t HW_REGISTERS_SIZE = 8 * 1024;
-constexpr uint32_t HW_REGISTERS_KUSEG = 0x1f801000;
-constexpr uint32_t HW_REGISTERS_KSEG0 = 0x9f801000;
-constexpr uint32_t HW_REGISTERS_KSEG1 = 0xbf801000;
-
-constexpr uint32_t CACHE_CONTROL_SIZE = 512;
-constexpr uint32_t CACHE_CONTROL_KSEG2 = 0xfffe0000;
-
 // TODO: Make this code nicer and without so much branching!
 // Can we strip away the first few bits to immediatly get the offset?
 std::optional<SegmentAndOffset> Memory::getSegmentForAddress(uint32_t address) {
@@ -198,6 +662,10 @@ std::optional<SegmentAndOffset> Memory::getSegmentForAddress(uint32_t address) {
         return SegmentAndOffset{MemorySegment::BIOS, address - BIOS_KSEG1};
     }
 
+    if ((address & SCRATCHPAD_ADDRESS_MASK) == SCRATCHPAD_KUSEG) {
+        return SegmentAndOffset{MemorySegment::SCRATCHPAD, address & (SCRATCHPAD_SIZE - 1)};
+    }
+
     if (addressInRange(address, HW_REGISTERS_KUSEG, HW_REGISTERS_SIZE)) {
         return SegmentAndOffset{MemorySegment::HW_REGISTERS, address - HW_REGISTERS_KUSEG};
     }
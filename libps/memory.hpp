@@ -1,14 +1,19 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include "bios.hpp"
 #include "memory_region.hpp"
+#include "perf_counters.hpp"
+#include "timing.hpp"
 
 #include "libutils/data.hpp"
+#include "libutils/mapped_memory.hpp"
 
 enum class MemorySegment {
     RAM,
@@ -18,16 +23,192 @@ enum class MemorySegment {
     BIOS,
     CACHE_CONTROL
 };
+static_assert(static_cast<size_t>(MemorySegment::CACHE_CONTROL) + 1 == PerfCounters::SEGMENT_COUNT);
+
+// The bus keeps a page table of host pointers for regions that are plain memory,
+// accesses to all other regions go through the segment lookup.
+constexpr uint32_t MEMORY_PAGE_SHIFT = 12;
+constexpr uint32_t MEMORY_PAGE_SIZE = 1 << MEMORY_PAGE_SHIFT;
+constexpr uint32_t MEMORY_PAGE_MASK = MEMORY_PAGE_SIZE - 1;
+constexpr uint32_t MEMORY_PAGE_COUNT = 1 << (32 - MEMORY_PAGE_SHIFT);
+
+constexpr uint32_t SCRATCHPAD_SIZE = 1024;
+
+namespace CacheControl {
+enum : uint32_t {
+    ScratchpadEnable1 = (1 << 3),
+    ScratchpadEnable2 = (1 << 7),
+    CodeCacheEnable = (1 << 11)
+};
+}; // namespace CacheControl
+
+// Delay/size and base address registers at 0x1F801000..0x1F801020
+constexpr uint32_t MEMORY_CONTROL_REGISTER_COUNT = 9;
+
+// Window of the hardware registers at 0x1F801000, devices are mapped into it by word
+constexpr uint32_t HW_REGISTERS_SIZE = 8 * 1024;
+constexpr uint32_t HW_REGISTERS_WORDS = HW_REGISTERS_SIZE / sizeof(uint32_t);
 
 struct SegmentAndOffset {
     MemorySegment region;
     uint32_t offset;
 };
 
+enum class WatchpointType : uint8_t {
+    Write = 1,
+    Read = 2,
+    Access = Write | Read
+};
+
+struct Watchpoint {
+    // Physical address, all mirrors are watched
+    uint32_t address;
+    uint32_t length;
+    WatchpointType type;
+
+    bool operator==(const Watchpoint &) const = default;
+};
+
+// Host memory behind the page of an instruction fetch, lets the CPU fetch
+// sequential instructions without going through the bus.
+struct CodeWindow {
+    // Null if the page has to be fetched through the bus
+    const uint8_t *page;
+    // Updated in place when the memory control registers change
+    const Timing::AccessTimes *accessTimes;
+    MemorySegment segment;
+};
+
+class IWatchpointListener {
+public:
+    virtual void watchpointHit(const Watchpoint &watchpoint, uint32_t address, bool write) = 0;
+};
+
+// Told when RAM holding guest code that was handed to Memory::protectCode() is
+// written, so code caches can drop what they derived from it
+class ICodeWriteListener {
+public:
+    // The range covers whole RAM pages, they are no longer protected
+    virtual void codeWritten(uint32_t offset, uint32_t size) = 0;
+};
+
 class Memory {
 private:
     std::unique_ptr<MemoryRegion> _ram;
     std::unique_ptr<MemoryRegion> _bios;
+    std::unique_ptr<MemoryRegion> _scratchpad;
+
+    // Indexed by virtual address, so uncached and cached mirrors have their own entries.
+    // The tables are mostly empty and live in lazily backed pages, only the parts that
+    // cover a mapped region take up memory. They are not guest memory, so the mapping
+    // policy does not lock them or place them on huge pages.
+    MappedBuffer _pageTables;
+    uint8_t **_readPages;
+    uint8_t **_writePages;
+    uint8_t *_scratchpadData = nullptr;
+
+    uint32_t _cacheControl = 0;
+
+    enum AccessTiming : uint8_t {
+        Uncharged,
+        MainRam,
+        BiosRom,
+        Expansion1,
+        SpuRegisters,
+        IoRegisters,
+        Count
+    };
+
+    // The memory control and RAM size registers, which belong to the bus itself
+    class ControlRegisters
+        : public MemoryRegion {
+    private:
+        Memory &_memory;
+
+        uint32_t read(uint32_t offset) const;
+        void write(uint32_t offset, uint32_t value);
+
+    public:
+        explicit ControlRegisters(Memory &memory) : _memory(memory) {}
+
+        virtual uint32_t size() const override;
+
+        virtual uint8_t u8(uint32_t offset) const override { return static_cast<uint8_t>(read(offset)); }
+        virtual uint16_t u16(uint32_t offset) const override { return static_cast<uint16_t>(read(offset)); }
+        virtual uint32_t u32(uint32_t offset) const override { return read(offset); }
+
+        virtual void u8Write(uint32_t offset, uint8_t value) override { write(offset, value); }
+        virtual void u16Write(uint32_t offset, uint16_t value) override { write(offset, value); }
+        virtual void u32Write(uint32_t offset, uint32_t value) override { write(offset, value); }
+    };
+
+    // Device behind a word of the hardware register window. Every access to the
+    // window is one lookup and one call through the MemoryRegion of the device.
+    struct IoHandler {
+        // Null for unmapped registers
+        MemoryRegion *device = nullptr;
+        // Subtracted from window offsets, usually the offset of the first register of the device
+        uint32_t base = 0;
+        AccessTiming timing = AccessTiming::IoRegisters;
+    };
+
+    ControlRegisters _controlRegisters{*this};
+    std::array<IoHandler, HW_REGISTERS_WORDS> _ioHandlers;
+    // Past the end of the window, which the segment lookup includes
+    IoHandler _unmappedIo;
+
+    // Access times of mapped pages, indexed like the page tables
+    uint8_t *_pageTimings;
+    // First page and page count of the ranges mapPages() filled in
+    std::vector<std::pair<uint32_t, uint32_t>> _mappedPages;
+    Timing::AccessTimes _accessTimes[AccessTiming::Count];
+    uint32_t _accessCycles = 0;
+
+    uint32_t _memoryControl[MEMORY_CONTROL_REGISTER_COUNT];
+    uint32_t _ramSize;
+
+    // Pages holding a watched address are left out of the page tables, so only the
+    // slow path has to look at the watchpoints.
+    std::vector<Watchpoint> _watchpoints;
+    IWatchpointListener *_watchpointListener = nullptr;
+    bool _scratchpadWatched = false;
+
+    // One flag per RAM page holding protected code. Such pages are left out of the
+    // write page table like watched ones, so stores to data pages pay nothing.
+    std::vector<uint8_t> _codePages;
+    uint32_t _protectedCodePages = 0;
+    ICodeWriteListener *_codeWriteListener = nullptr;
+
+#ifdef PS_PERF_COUNTERS
+    PerfCounters::MemoryCounters _perfCounters;
+
+    template <typename ValueType>
+    void countRead(MemorySegment segment) {
+        auto &counters = _perfCounters.segments[static_cast<size_t>(segment)];
+        counters.reads++;
+        counters.bytesRead += sizeof(ValueType);
+    }
+
+    template <typename ValueType>
+    void countWrite(MemorySegment segment) {
+        auto &counters = _perfCounters.segments[static_cast<size_t>(segment)];
+        counters.writes++;
+        counters.bytesWritten += sizeof(ValueType);
+    }
+#endif
+
+    void mapPages(MemoryRegion *region, uint32_t base, bool writable, AccessTiming timing);
+    void updatePageTables();
+    // Maps the write pointers of a RAM page again unless it is watched
+    void unprotectCodePage(uint32_t page);
+    void codeWritten(uint32_t offset, uint32_t size);
+    // Copies a snapshot into RAM, reporting only the code pages that differ
+    void restoreRam(const ByteBuffer &ram);
+    void updateAccessTimes();
+    void checkWatchpoints(uint32_t address, uint32_t size, bool write);
+    const IoHandler &ioHandler(uint32_t offset) const {
+        return offset < HW_REGISTERS_SIZE ? _ioHandlers[offset / sizeof(uint32_t)] : _unmappedIo;
+    }
 
     template <typename ValueType>
     void write(uint32_t address, ValueType value, MemoryRegion *memory);
@@ -40,10 +221,37 @@ private:
     ValueType read(uint32_t address);
 
 public:
-    Memory() = default;
+    // RAM, scratchpad and the control registers for a save state. The regions are
+    // copied as blocks, the BIOS is read only and not part of it. Restoring a
+    // snapshot with an empty RAM buffer keeps the RAM, see SharedSnapshot.
+    struct Snapshot {
+        ByteBuffer ram;
+        ByteBuffer scratchpad;
+        uint32_t cacheControl;
+        uint32_t ramSize;
+        uint32_t accessCycles;
+        uint32_t memoryControl[MEMORY_CONTROL_REGISTER_COUNT];
+    };
+
+    Memory();
+    // Devices and the page tables point into the bus
+    Memory(const Memory &) = delete;
+    Memory &operator=(const Memory &) = delete;
 
     void setBios(std::unique_ptr<MemoryRegion> bios);
     void setRam(std::unique_ptr<MemoryRegion> ram);
+    // Maps the hardware registers at offset..offset + size of the register window
+    // to device, which sees offsets from its first register. Offset and size are
+    // word aligned, mapping a range again replaces its device.
+    void mapIo(MemoryRegion *device, uint32_t offset, uint32_t size) { mapIo(device, offset, size, 0); }
+    // Same for devices with registers spread over the window, the device sees
+    // deviceOffset for the register at offset
+    void mapIo(MemoryRegion *device, uint32_t offset, uint32_t size, uint32_t deviceOffset);
+    void setSpu(MemoryRegion *spu);
+    void setSio(MemoryRegion *sio);
+    void setInterruptController(MemoryRegion *interruptController);
+    void setDma(MemoryRegion *dma);
+    void setMdec(MemoryRegion *mdec);
 
     // Memory access
     virtual uint8_t u8(uint32_t address);
@@ -54,5 +262,63 @@ public:
     virtual void u16Write(uint32_t address, uint16_t value);
     virtual void u32Write(uint32_t address, uint32_t value);
 
+    uint32_t cacheControl() const { return _cacheControl; }
+    MemoryRegion *ram() { return _ram.get(); }
+    MemoryRegion *bios() { return _bios.get(); }
+
+    // Valid until the page tables change, i.e. a region or watchpoint is set
+    CodeWindow codeWindow(uint32_t address) const {
+        auto index = address >> MEMORY_PAGE_SHIFT;
+        auto timing = _pageTimings[index];
+        auto segment = timing == AccessTiming::BiosRom ? MemorySegment::BIOS : MemorySegment::RAM;
+        return CodeWindow{_readPages[index], &_accessTimes[timing], segment};
+    }
+
+    // Self-modifying code detection. The first write to a RAM page with protected code
+    // clears its protection and tells the listener, the code has to be protected
+    // again once it was looked at anew.
+    void setCodeWriteListener(ICodeWriteListener *listener) { _codeWriteListener = listener; }
+    // Protects the RAM page holding address, returns false if it is not in RAM
+    bool protectCode(uint32_t address);
+    // Reports writes to RAM that bypass the bus, e.g. by DMA or the BIOS HLE
+    void ramWritten(uint32_t offset, uint32_t size) {
+        if (_protectedCodePages) {
+            codeWritten(offset, size);
+        }
+    }
+
+    void setWatchpointListener(IWatchpointListener *listener);
+    void addWatchpoint(const Watchpoint &watchpoint);
+    // Returns false if no such watchpoint was set
+    bool removeWatchpoint(const Watchpoint &watchpoint);
+    void clearWatchpoints();
+    const std::vector<Watchpoint> &watchpoints() const { return _watchpoints; }
+
+    // True if reading the hardware register at offset of the register window has no
+    // side effects. The SIO and MDEC data registers pop their FIFOs, for example.
+    static bool readIsPure(uint32_t offset);
+
+    // Debugger access. Ignores watchpoints, is not charged any cycles and returns
+    // nothing if the address is not mapped or reading it would change a device.
+    std::optional<uint8_t> debugRead(uint32_t address);
+    bool debugWrite(uint32_t address, uint8_t value);
+
+    // Returns the stall cycles of all reads since the last call.
+    uint32_t takeAccessCycles() {
+        auto cycles = _accessCycles;
+        _accessCycles = 0;
+        return cycles;
+    }
+
     std::optional<SegmentAndOffset> getSegmentForAddress(uint32_t address);
+
+    // Buffers in the snapshot are reused if they have the right size already
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+#ifdef PS_PERF_COUNTERS
+    const PerfCounters::MemoryCounters &perfCounters() const { return _perfCounters; }
+    // Instruction fetches through a CodeWindow
+    void countFetch(MemorySegment segment) { countRead<uint32_t>(segment); }
+#endif
 };
@@ -0,0 +1,340 @@
+#include "memory_card.hpp"
+#include "libutils/condition_wait.hpp"
+#include "libutils/file.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+using namespace std::chrono_literals;
+
+// Idle time after the last sector write before a batch is written back
+constexpr auto WRITE_BACK_DELAY = 200ms;
+
+constexpr uint8_t COMMAND_READ = 'R';
+constexpr uint8_t COMMAND_WRITE = 'W';
+constexpr uint8_t COMMAND_IDENTIFY = 'S';
+
+constexpr uint8_t END_GOOD = 'G';
+constexpr uint8_t END_BAD_CHECKSUM = 'N';
+constexpr uint8_t END_BAD_SECTOR = 0xFF;
+
+// Reply to the identify command after its two id bytes
+constexpr uint8_t IDENTIFY_DATA[] = {0x5C, 0x5D, 0x04, 0x00, 0x00, 0x80};
+
+// Directory frames follow the header frame, then the broken sector list
+constexpr uint32_t DIRECTORY_FRAMES = 15;
+constexpr uint32_t BROKEN_SECTOR_FRAMES = 20;
+constexpr uint32_t WRITE_TEST_FRAME = 63;
+constexpr uint8_t DIRECTORY_FREE = 0xA0;
+
+void sealFrame(uint8_t *frame) {
+    uint8_t checksum = 0;
+    for (uint32_t i = 0; i < MEMORY_CARD_SECTOR_SIZE - 1; i++) {
+        checksum ^= frame[i];
+    }
+    frame[MEMORY_CARD_SECTOR_SIZE - 1] = checksum;
+}
+} // namespace
+
+MemoryCardWriter::MemoryCardWriter(std::string path, const std::vector<uint8_t> &image)
+    : _path(std::move(path)),
+      _shadow(image) {
+    _thread = std::thread(&MemoryCardWriter::writeBack, this);
+}
+
+MemoryCardWriter::~MemoryCardWriter() {
+    {
+        auto lock = std::lock_guard(_mutex);
+        _running = false;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+void MemoryCardWriter::submit(uint32_t sector, const uint8_t *data) {
+    {
+        auto lock = std::lock_guard(_mutex);
+        std::memcpy(_shadow.data() + sector * MEMORY_CARD_SECTOR_SIZE, data, MEMORY_CARD_SECTOR_SIZE);
+        _dirty.set(sector);
+        _submissions++;
+    }
+    _wake.notify_one();
+}
+
+void MemoryCardWriter::flush() {
+    auto lock = std::unique_lock(_mutex);
+    _flushRequested = true;
+    _wake.notify_one();
+    conditionWait(_idle, lock, [this]() { return _dirty.none() && !_writing; });
+    _flushRequested = false;
+}
+
+uint64_t MemoryCardWriter::batches() {
+    auto lock = std::lock_guard(_mutex);
+    return _batches;
+}
+
+void MemoryCardWriter::writeBack() {
+    auto lock = std::unique_lock(_mutex);
+    while (true) {
+        // A card nobody writes to sleeps until a sector is submitted
+        conditionWait(_wake, lock, [this]() { return !_running || _dirty.any(); });
+        if (_dirty.none()) {
+            return;
+        }
+
+        // Waits for a period without writes, so the rest of a save ends up in the same batch
+        while (_running && !_flushRequested) {
+            auto seen = _submissions;
+            _wake.wait_for(lock, WRITE_BACK_DELAY, [this, seen]() { return !_running || _flushRequested || _submissions != seen; });
+            if (_submissions == seen) {
+                break;
+            }
+        }
+
+        std::vector<std::pair<uint32_t, std::array<uint8_t, MEMORY_CARD_SECTOR_SIZE>>> batch;
+        for (uint32_t sector = 0; sector < MEMORY_CARD_SECTOR_COUNT; sector++) {
+            if (_dirty.test(sector)) {
+                auto &entry = batch.emplace_back(sector, std::array<uint8_t, MEMORY_CARD_SECTOR_SIZE>{});
+                std::memcpy(entry.second.data(), _shadow.data() + sector * MEMORY_CARD_SECTOR_SIZE, MEMORY_CARD_SECTOR_SIZE);
+            }
+        }
+        _dirty.reset();
+        _writing = true;
+        lock.unlock();
+
+        auto file = std::fstream(_path, std::ios::in | std::ios::out | std::ios::binary);
+        for (const auto &[sector, data] : batch) {
+            file.seekp(sector * MEMORY_CARD_SECTOR_SIZE);
+            file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        }
+        file.flush();
+        if (!file) {
+            spdlog::error("[memcard] Error writing {}", _path);
+        } else {
+            spdlog::debug("[memcard] Wrote {} sectors to {}", batch.size(), _path);
+        }
+
+        lock.lock();
+        _writing = false;
+        _batches++;
+        _idle.notify_all();
+    }
+}
+
+MemoryCard::MemoryCard()
+    : _image(formattedImage()) {}
+
+MemoryCard::MemoryCard(const std::string &path) {
+    auto file = File(path);
+    if (file.exists()) {
+        _image = file.readAll();
+        if (_image.size() != MEMORY_CARD_SIZE) {
+            throw std::runtime_error(fmt::format("Memory card image {} has {} bytes, expected {}", path, _image.size(), MEMORY_CARD_SIZE));
+        }
+    } else {
+        spdlog::info("[memcard] Creating formatted memory card {}", path);
+        _image = formattedImage();
+        auto stream = std::ofstream(path, std::ios::binary | std::ios::trunc);
+        if (!stream.write(reinterpret_cast<const char *>(_image.data()), _image.size())) {
+            throw std::runtime_error(fmt::format("Error creating memory card image {}", path));
+        }
+    }
+
+    _writer = std::make_unique<MemoryCardWriter>(path, _image);
+}
+
+std::vector<uint8_t> MemoryCard::formattedImage() {
+    auto image = std::vector<uint8_t>(MEMORY_CARD_SIZE, 0);
+    auto frame = [&image](uint32_t index) { return image.data() + index * MEMORY_CARD_SECTOR_SIZE; };
+
+    frame(0)[0] = 'M';
+    frame(0)[1] = 'C';
+    sealFrame(frame(0));
+
+    for (uint32_t i = 1; i <= DIRECTORY_FRAMES; i++) {
+        frame(i)[0] = DIRECTORY_FREE;
+        frame(i)[8] = 0xFF;
+        frame(i)[9] = 0xFF;
+        sealFrame(frame(i));
+    }
+    for (uint32_t i = DIRECTORY_FRAMES + 1; i <= DIRECTORY_FRAMES + BROKEN_SECTOR_FRAMES; i++) {
+        std::memset(frame(i), 0xFF, 4);
+        frame(i)[8] = 0xFF;
+        frame(i)[9] = 0xFF;
+        sealFrame(frame(i));
+    }
+
+    std::memcpy(frame(WRITE_TEST_FRAME), frame(0), MEMORY_CARD_SECTOR_SIZE);
+    return image;
+}
+
+void MemoryCard::save(Snapshot &snapshot) const {
+    snapshot.image = _image;
+    snapshot.state = _state;
+    snapshot.flag = _flag;
+    snapshot.command = _command;
+    snapshot.sector = _sector;
+    snapshot.checksum = _checksum;
+    snapshot.checksumValid = _checksumValid;
+    snapshot.previous = _previous;
+    snapshot.index = _index;
+    std::memcpy(snapshot.buffer, _buffer, sizeof(_buffer));
+}
+
+void MemoryCard::restore(const Snapshot &snapshot) {
+    for (uint32_t sector = 0; sector < MEMORY_CARD_SECTOR_COUNT; sector++) {
+        auto offset = sector * MEMORY_CARD_SECTOR_SIZE;
+        const auto *data = snapshot.image.data() + offset;
+        if (std::memcmp(_image.data() + offset, data, MEMORY_CARD_SECTOR_SIZE) == 0) {
+            continue;
+        }
+        std::memcpy(_image.data() + offset, data, MEMORY_CARD_SECTOR_SIZE);
+        if (_writer) {
+            _writer->submit(sector, data);
+        }
+    }
+    _state = snapshot.state;
+    _flag = snapshot.flag;
+    _command = snapshot.command;
+    _sector = snapshot.sector;
+    _checksum = snapshot.checksum;
+    _checksumValid = snapshot.checksumValid;
+    _previous = snapshot.previous;
+    _index = snapshot.index;
+    std::memcpy(_buffer, snapshot.buffer, sizeof(_buffer));
+}
+
+void MemoryCard::select() {
+    _state = State::Address;
+}
+
+uint8_t MemoryCard::endStatus() const {
+    if (!sectorValid()) {
+        return END_BAD_SECTOR;
+    }
+    return _checksumValid ? END_GOOD : END_BAD_CHECKSUM;
+}
+
+SioResponse MemoryCard::transfer(uint8_t value, uint64_t) {
+    switch (_state) {
+    case State::Address:
+        _state = value == ADDRESS ? State::Command : State::Done;
+        return SioResponse{0xFF, value == ADDRESS};
+    case State::Command:
+        _command = value;
+        if (value != COMMAND_READ && value != COMMAND_WRITE && value != COMMAND_IDENTIFY) {
+            spdlog::debug("[memcard] unsupported command {:#04x}", value);
+            _state = State::Done;
+            return SioResponse{_flag, false};
+        }
+        _state = State::IdLow;
+        return SioResponse{_flag, true};
+    case State::IdLow:
+        _state = State::IdHigh;
+        return SioResponse{0x5A, true};
+    case State::IdHigh:
+        _index = 0;
+        _state = _command == COMMAND_IDENTIFY ? State::IdentifyData : State::SectorMsb;
+        return SioResponse{0x5D, true};
+
+    case State::SectorMsb:
+        _sector = static_cast<uint16_t>(value << 8);
+        _checksum = value;
+        _state = State::SectorLsb;
+        return SioResponse{0x00, true};
+    case State::SectorLsb: {
+        auto msb = static_cast<uint8_t>(_sector >> 8);
+        _sector |= value;
+        _checksum ^= value;
+        _previous = value;
+        _index = 0;
+        _state = _command == COMMAND_READ ? State::ReadAck1 : State::WriteData;
+        return SioResponse{msb, true};
+    }
+
+    case State::ReadAck1:
+        _state = State::ReadAck2;
+        return SioResponse{0x5C, true};
+    case State::ReadAck2:
+        _state = State::ReadConfirmMsb;
+        return SioResponse{0x5D, true};
+    case State::ReadConfirmMsb:
+        _state = State::ReadConfirmLsb;
+        return SioResponse{sectorValid() ? static_cast<uint8_t>(_sector >> 8) : uint8_t(0xFF), true};
+    case State::ReadConfirmLsb:
+        // An invalid sector aborts the read after the confirmed address
+        if (!sectorValid()) {
+            _state = State::Done;
+            return SioResponse{0xFF, false};
+        }
+        _state = State::ReadData;
+        return SioResponse{static_cast<uint8_t>(_sector), true};
+    case State::ReadData: {
+        auto data = _image[_sector * MEMORY_CARD_SECTOR_SIZE + _index++];
+        _checksum ^= data;
+        if (_index == MEMORY_CARD_SECTOR_SIZE) {
+            _state = State::ReadChecksum;
+        }
+        return SioResponse{data, true};
+    }
+    case State::ReadChecksum:
+        _state = State::ReadEnd;
+        return SioResponse{_checksum, true};
+    case State::ReadEnd:
+        _state = State::Done;
+        return SioResponse{END_GOOD, false};
+
+    // Written bytes are echoed one byte late
+    case State::WriteData: {
+        auto echo = std::exchange(_previous, value);
+        _buffer[_index++] = value;
+        _checksum ^= value;
+        if (_index == MEMORY_CARD_SECTOR_SIZE) {
+            _state = State::WriteChecksum;
+        }
+        return SioResponse{echo, true};
+    }
+    case State::WriteChecksum:
+        _checksumValid = value == _checksum;
+        _state = State::WriteAck1;
+        return SioResponse{std::exchange(_previous, value), true};
+    case State::WriteAck1:
+        _state = State::WriteAck2;
+        return SioResponse{0x5C, true};
+    case State::WriteAck2:
+        _state = State::WriteEnd;
+        return SioResponse{0x5D, true};
+    case State::WriteEnd: {
+        auto status = endStatus();
+        if (status == END_GOOD) {
+            std::memcpy(_image.data() + _sector * MEMORY_CARD_SECTOR_SIZE, _buffer, MEMORY_CARD_SECTOR_SIZE);
+            if (_writer) {
+                _writer->submit(_sector, _buffer);
+            }
+            _flag &= ~FLAG_NOT_WRITTEN;
+        }
+        _state = State::Done;
+        return SioResponse{status, false};
+    }
+
+    case State::IdentifyData: {
+        auto data = IDENTIFY_DATA[_index++];
+        auto last = _index == sizeof(IDENTIFY_DATA);
+        if (last) {
+            _state = State::Done;
+        }
+        return SioResponse{data, !last};
+    }
+
+    case State::Done:
+        break;
+    }
+    return SioResponse{0xFF, false};
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "sio_device.hpp"
+
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t MEMORY_CARD_SECTOR_SIZE = 128;
+constexpr uint32_t MEMORY_CARD_SECTOR_COUNT = 1024;
+constexpr uint32_t MEMORY_CARD_SIZE = MEMORY_CARD_SECTOR_SIZE * MEMORY_CARD_SECTOR_COUNT;
+
+// Writes memory card sectors back to the image file on a thread of its own. The
+// emulation thread only copies a written sector into the shadow image and marks it
+// dirty; the writer waits until the card was idle for a moment, so the many sector
+// writes of a single save end up in one batch, and never blocks emulation on I/O.
+class MemoryCardWriter {
+private:
+    std::string _path;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::vector<uint8_t> _shadow;
+    std::bitset<MEMORY_CARD_SECTOR_COUNT> _dirty;
+    uint64_t _submissions = 0;
+    bool _writing = false;
+    bool _flushRequested = false;
+    bool _running = true;
+    uint64_t _batches = 0;
+    std::thread _thread;
+
+    void writeBack();
+
+public:
+    MemoryCardWriter(std::string path, const std::vector<uint8_t> &image);
+    MemoryCardWriter(const MemoryCardWriter &) = delete;
+    MemoryCardWriter &operator=(const MemoryCardWriter &) = delete;
+    // Writes the remaining dirty sectors
+    ~MemoryCardWriter();
+
+    void submit(uint32_t sector, const uint8_t *data);
+    // Blocks until all submitted sectors are written
+    void flush();
+    // Number of batches written so far
+    uint64_t batches();
+};
+
+// Memory card protocol on top of a 128 KiB image, see the nocash psx specs
+class MemoryCard
+    : public SioDevice {
+public:
+    static constexpr uint8_t ADDRESS = 0x81;
+
+    // FLAG byte, set until the first write to the card
+    static constexpr uint8_t FLAG_NOT_WRITTEN = 0x08;
+
+private:
+    enum class State : uint8_t {
+        Address,
+        Command,
+        IdLow,
+        IdHigh,
+        SectorMsb,
+        SectorLsb,
+        ReadAck1,
+        ReadAck2,
+        ReadConfirmMsb,
+        ReadConfirmLsb,
+        ReadData,
+        ReadChecksum,
+        ReadEnd,
+        WriteData,
+        WriteChecksum,
+        WriteAck1,
+        WriteAck2,
+        WriteEnd,
+        IdentifyData,
+        Done
+    };
+
+    std::vector<uint8_t> _image;
+    std::unique_ptr<MemoryCardWriter> _writer;
+
+    State _state = State::Address;
+    uint8_t _flag = FLAG_NOT_WRITTEN;
+    uint8_t _command = 0;
+    uint16_t _sector = 0;
+    uint8_t _checksum = 0;
+    bool _checksumValid = false;
+    uint8_t _previous = 0;
+    uint32_t _index = 0;
+    uint8_t _buffer[MEMORY_CARD_SECTOR_SIZE] = {};
+
+    bool sectorValid() const { return _sector < MEMORY_CARD_SECTOR_COUNT; }
+    uint8_t endStatus() const;
+
+public:
+    // Image and protocol state for a save state
+    struct Snapshot {
+        std::vector<uint8_t> image;
+        State state;
+        uint8_t flag;
+        uint8_t command;
+        uint16_t sector;
+        uint8_t checksum;
+        bool checksumValid;
+        uint8_t previous;
+        uint32_t index;
+        uint8_t buffer[MEMORY_CARD_SECTOR_SIZE];
+    };
+
+    // Formatted card which is not backed by a file
+    MemoryCard();
+    // Loads the image at path, or creates a formatted one if the file does not exist
+    explicit MemoryCard(const std::string &path);
+
+    const std::vector<uint8_t> &image() const { return _image; }
+    // Null unless the card is backed by a file
+    MemoryCardWriter *writer() { return _writer.get(); }
+
+    void save(Snapshot &snapshot) const;
+    // Sectors that differ from the snapshot are written back to the image file again
+    void restore(const Snapshot &snapshot);
+
+    virtual void select() override;
+    virtual SioResponse transfer(uint8_t value, uint64_t cycle) override;
+
+    static std::vector<uint8_t> formattedImage();
+};
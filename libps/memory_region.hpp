@@ -16,6 +16,10 @@ public:
     virtual void u16Write(uint32_t offset, uint16_t value) = 0;
     virtual void u32Write(uint32_t offset, uint32_t value) = 0;
 
+    // Backing storage for regions that are plain memory, used to map them into
+    // the page table of the bus. Regions with side effects return nullptr.
+    virtual uint8_t *data() { return nullptr; }
+
     template <typename T>
     bool checkAccess(uint32_t offset) const {
         if (offset + sizeof(T) < size()) {
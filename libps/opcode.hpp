@@ -15,42 +15,43 @@ private:
     uint32_t _address;
 
 public:
-    Opcode(uint32_t opcode);
+    Opcode(uint32_t opcode)
+        : _opcode(opcode) {}
 
     void setAddress(uint32_t address) { _address = address; }
     uint32_t address() const { return _address; }
 
-    uint32_t raw();
+    uint32_t raw() { return _opcode; }
 
     // Get bits 31..26
-    uint8_t instruction();
+    uint8_t instruction() { return _opcode >> 26; }
 
     // Get bits 20..16
-    RegisterIndex rt();
+    RegisterIndex rt() { return RegisterIndex((_opcode >> 16) & 0x1F); }
 
     // Get bits 25..21
-    RegisterIndex rs();
+    RegisterIndex rs() { return RegisterIndex((_opcode >> 21) & 0x1F); }
 
     // Get bits 15..11
-    RegisterIndex rd();
+    RegisterIndex rd() { return RegisterIndex((_opcode >> 11) & 0x1F); }
 
     // Get bits 15..0
-    uint16_t imm16();
-    int16_t imm16signed();
+    uint16_t imm16() { return _opcode & 0xFFFF; }
+    int16_t imm16signed() { return static_cast<int16_t>(imm16()); }
 
     // Get bits 10..6
-    uint8_t imm5();
+    uint8_t imm5() { return (_opcode >> 6) & 0x1F; }
 
     // Get bits 25..0
-    uint32_t imm26();
+    uint32_t imm26() { return _opcode & 0x03FFFFFF; }
 
     // Gets bits 5..0
-    uint8_t subfunction();
+    uint8_t subfunction() { return _opcode & 0x3F; }
 
     // Get bits 25..21
-    uint8_t cop_opcode();
+    uint8_t cop_opcode() { return (_opcode >> 21) & 0x1F; }
 
-    uint8_t bcond_subfunction();
+    uint8_t bcond_subfunction() { return (_opcode >> 16) & 0x1F; }
 
     static Opcode NOP() { return Opcode(0); }
 };
@@ -60,4 +61,17 @@ public:
     virtual void invalidateLoadDelaySlot(RegisterIndex index) = 0;
     virtual void addLoadDelaySlot(LoadDelaySlot slot) = 0;
     virtual void addBranchDelaySlot(BranchDelaySlot slot) = 0;
+
+    // HI/LO are written by the multiply/divide unit after the given number of cycles
+    virtual void startMultiplyDivide(uint32_t cycles) = 0;
+    // Stalls until the result of the last multiply/divide is available
+    virtual void waitMultiplyDivide() = 0;
+
+    // Returns the register value with a pending load already applied, LWL/LWR merge with it
+    virtual uint32_t getRegisterIncludingLoadDelay(RegisterIndex index) = 0;
+
+    // The current instruction is aborted and execution continues at the exception vector
+    virtual void raiseException(ExceptionCause cause) = 0;
+    virtual void raiseAddressError(ExceptionCause cause, uint32_t address) = 0;
+    virtual void raiseCoprocessorUnusable(uint8_t coprocessor) = 0;
 };
\ No newline at end of file
@@ -21,3 +21,11 @@ void OpcodeImplementationCop0::mtc0(Opcode opcode, CpuState *cpuState, IOpcodeCp
     // TODO: Are there load delay slots on the cop0?
     // cpuCallbacks->invalidateLoadDelaySlot(rd);
 }
+
+// Return from exception pops the interrupt enable/user mode stack in SR
+void OpcodeImplementationCop0::rfe(Opcode, CpuState *cpuState, IOpcodeCpuCallbacks *) {
+    spdlog::trace("[opcode] rfe");
+
+    auto sr = cpuState->getRegisterCop0(Cop0Registers::SR);
+    cpuState->setRegisterCop0(Cop0Registers::SR, (sr & ~0x0Fu) | ((sr >> 2) & 0x0F));
+}
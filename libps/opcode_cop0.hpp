@@ -6,4 +6,5 @@
 namespace OpcodeImplementationCop0 {
 void mfc0(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void mtc0(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void rfe(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 };
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "opcode_cop2.hpp"
+
+#include <spdlog/spdlog.h>
+
+void OpcodeImplementationCop2::mfc2(Opcode opcode, CpuState *, Gte *gte, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] mfc2 ${}, cop2_${}", rt, rd);
+
+    auto value = gte->getDataRegister(rd);
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
+void OpcodeImplementationCop2::cfc2(Opcode opcode, CpuState *, Gte *gte, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] cfc2 ${}, cop2c_${}", rt, rd);
+
+    auto value = gte->getControlRegister(rd);
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
+void OpcodeImplementationCop2::mtc2(Opcode opcode, CpuState *cpuState, Gte *gte) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] mtc2 ${}, cop2_${}", rt, rd);
+
+    gte->setDataRegister(rd, cpuState->getRegister(rt));
+}
+
+void OpcodeImplementationCop2::ctc2(Opcode opcode, CpuState *cpuState, Gte *gte) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] ctc2 ${}, cop2c_${}", rt, rd);
+
+    gte->setControlRegister(rd, cpuState->getRegister(rt));
+}
+
+void OpcodeImplementationCop2::lwc2(Opcode opcode, CpuState *cpuState, Gte *gte, Memory *memory) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = static_cast<int16_t>(opcode.imm16());
+
+    spdlog::trace("[opcode] lwc2 cop2_${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    gte->setDataRegister(rt, memory->u32(address));
+}
+
+void OpcodeImplementationCop2::swc2(Opcode opcode, CpuState *cpuState, Gte *gte, Memory *memory) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = static_cast<int16_t>(opcode.imm16());
+
+    spdlog::trace("[opcode] swc2 cop2_${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    memory->u32Write(address, gte->getDataRegister(rt));
+}
+
+void OpcodeImplementationCop2::cop2(Opcode opcode, Gte *gte) {
+    auto command = opcode.raw() & 0x1FFFFFF;
+
+    spdlog::trace("[opcode] cop2 {:#09x}", command);
+
+    gte->execute(command);
+}
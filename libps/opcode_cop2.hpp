@@ -0,0 +1,15 @@
+#pragma once
+
+#include "cpustate.hpp"
+#include "gte.hpp"
+#include "opcode.hpp"
+
+namespace OpcodeImplementationCop2 {
+void mfc2(Opcode opcode, CpuState *cpuState, Gte *gte, IOpcodeCpuCallbacks *cpuCallbacks);
+void cfc2(Opcode opcode, CpuState *cpuState, Gte *gte, IOpcodeCpuCallbacks *cpuCallbacks);
+void mtc2(Opcode opcode, CpuState *cpuState, Gte *gte);
+void ctc2(Opcode opcode, CpuState *cpuState, Gte *gte);
+void lwc2(Opcode opcode, CpuState *cpuState, Gte *gte, Memory *memory);
+void swc2(Opcode opcode, CpuState *cpuState, Gte *gte, Memory *memory);
+void cop2(Opcode opcode, Gte *gte);
+}; // namespace OpcodeImplementationCop2
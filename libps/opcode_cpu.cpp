@@ -2,6 +2,7 @@
 #include "branchdelayslot.hpp"
 #include "libutils/math.hpp"
 #include "loaddelayslot.hpp"
+#include "timing.hpp"
 
 #include <spdlog/spdlog.h>
 
@@ -21,7 +22,7 @@ void OpcodeImplementationCpu::andi(Opcode opcode, CpuState *cpuState, IOpcodeCpu
     auto rs = opcode.rs();
     auto imm = opcode.imm16();
 
-    spdlog::trace("[opcode] ori ${}, ${}, {:#06x}", rt, rs, imm);
+    spdlog::trace("[opcode] andi ${}, ${}, {:#06x}", rt, rs, imm);
 
     uint32_t value = cpuState->getRegister(rs) & imm;
     cpuState->setRegister(rt, value);
@@ -43,7 +44,7 @@ void OpcodeImplementationCpu::ori(Opcode opcode, CpuState *cpuState, IOpcodeCpuC
 void OpcodeImplementationCpu::lbu(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = opcode.imm16();
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] lbu ${}, {:#06x}(${})", rt, imm, rs);
 
@@ -55,7 +56,7 @@ void OpcodeImplementationCpu::lbu(Opcode opcode, CpuState *cpuState, Memory *mem
 void OpcodeImplementationCpu::lb(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = opcode.imm16();
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] lb ${}, {:#06x}(${})", rt, imm, rs);
 
@@ -66,46 +67,131 @@ void OpcodeImplementationCpu::lb(Opcode opcode, CpuState *cpuState, Memory *memo
     cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
 }
 
+void OpcodeImplementationCpu::lhu(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] lhu ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    if (address & 1) {
+        cpuCallbacks->raiseAddressError(ExceptionCause::AddressErrorLoad, address);
+        return;
+    }
+
+    auto value = static_cast<uint32_t>(memory->u16(address));
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
+void OpcodeImplementationCpu::lh(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] lh ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    if (address & 1) {
+        cpuCallbacks->raiseAddressError(ExceptionCause::AddressErrorLoad, address);
+        return;
+    }
+
+    // Sign extend
+    auto value = static_cast<uint32_t>(
+        static_cast<int16_t>(memory->u16(address)));
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
 void OpcodeImplementationCpu::lw(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = opcode.imm16();
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] lw ${}, {:#06x}(${})", rt, imm, rs);
 
     uint32_t address = cpuState->getRegister(rs) + imm;
+    if (address & 3) {
+        cpuCallbacks->raiseAddressError(ExceptionCause::AddressErrorLoad, address);
+        return;
+    }
+
     auto value = memory->u32(address);
     cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
 }
 
-void OpcodeImplementationCpu::sw(Opcode opcode, CpuState *cpuState, Memory *memory) {
+// LWL/LWR load the unaligned word in two halves and merge it into rt, including a
+// load to rt which is still in its delay slot.
+void OpcodeImplementationCpu::lwl(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = static_cast<int16_t>(opcode.imm16());
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] lwl ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    auto word = memory->u32(address & ~3u);
+    auto current = cpuCallbacks->getRegisterIncludingLoadDelay(rt);
+
+    auto shift = (address & 3) * 8;
+    uint32_t value = (current & (0x00FFFFFF >> shift)) | (word << (24 - shift));
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
+void OpcodeImplementationCpu::lwr(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] lwr ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    auto word = memory->u32(address & ~3u);
+    auto current = cpuCallbacks->getRegisterIncludingLoadDelay(rt);
+
+    auto shift = (address & 3) * 8;
+    uint32_t value = (current & (0xFFFFFF00 << (24 - shift))) | (word >> shift);
+    cpuCallbacks->addLoadDelaySlot(LoadDelaySlot(rt, value));
+}
+
+void OpcodeImplementationCpu::sw(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] sw ${}, {:#06x}(${})", rt, imm, rs);
 
     uint32_t address = cpuState->getRegister(rs) + imm;
+    if (address & 3) {
+        cpuCallbacks->raiseAddressError(ExceptionCause::AddressErrorStore, address);
+        return;
+    }
+
     uint32_t value = cpuState->getRegister(rt);
     memory->u32Write(address, value);
 }
 
-void OpcodeImplementationCpu::sh(Opcode opcode, CpuState *cpuState, Memory *memory) {
+void OpcodeImplementationCpu::sh(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = static_cast<int16_t>(opcode.imm16());
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] sh ${}, {:#06x}(${})", rt, imm, rs);
 
     uint32_t address = cpuState->getRegister(rs) + imm;
+    if (address & 1) {
+        cpuCallbacks->raiseAddressError(ExceptionCause::AddressErrorStore, address);
+        return;
+    }
+
     uint16_t value = cpuState->getRegister(rt) & 0xFFFF;
     memory->u16Write(address, value);
 }
 
-void OpcodeImplementationCpu::sb(Opcode opcode, CpuState *cpuState, Memory *memory) {
+void OpcodeImplementationCpu::sb(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
-    auto imm = static_cast<int16_t>(opcode.imm16());
+    auto imm = opcode.imm16signed();
 
     spdlog::trace("[opcode] sb ${}, {:#06x}(${})", rt, imm, rs);
 
@@ -114,6 +200,36 @@ void OpcodeImplementationCpu::sb(Opcode opcode, CpuState *cpuState, Memory *memo
     memory->u8Write(address, value);
 }
 
+void OpcodeImplementationCpu::swl(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] swl ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    auto word = memory->u32(address & ~3u);
+    auto value = cpuState->getRegister(rt);
+
+    auto shift = (address & 3) * 8;
+    memory->u32Write(address & ~3u, (word & (0xFFFFFF00 << shift)) | (value >> (24 - shift)));
+}
+
+void OpcodeImplementationCpu::swr(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] swr ${}, {:#06x}(${})", rt, imm, rs);
+
+    uint32_t address = cpuState->getRegister(rs) + imm;
+    auto word = memory->u32(address & ~3u);
+    auto value = cpuState->getRegister(rt);
+
+    auto shift = (address & 3) * 8;
+    memory->u32Write(address & ~3u, (word & (0x00FFFFFF >> (24 - shift))) | (value << shift));
+}
+
 void OpcodeImplementationCpu::sll(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rd = opcode.rd();
@@ -126,20 +242,80 @@ void OpcodeImplementationCpu::sll(Opcode opcode, CpuState *cpuState, IOpcodeCpuC
     cpuCallbacks->invalidateLoadDelaySlot(rd);
 }
 
+void OpcodeImplementationCpu::srl(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+    auto imm = opcode.imm5();
+
+    spdlog::trace("[opcode] srl ${}, ${}, {:#06x}", rd, rt, imm);
+
+    uint32_t value = cpuState->getRegister(rt) >> imm;
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::sra(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rd = opcode.rd();
+    auto imm = opcode.imm5();
+
+    spdlog::trace("[opcode] sra ${}, ${}, {:#06x}", rd, rt, imm);
+
+    auto value = static_cast<int32_t>(cpuState->getRegister(rt)) >> imm;
+    cpuState->setRegister(rd, static_cast<uint32_t>(value));
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::sllv(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] sllv ${}, ${}, ${}", rd, rt, rs);
+
+    uint32_t value = cpuState->getRegister(rt) << (cpuState->getRegister(rs) & 0x1F);
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::srlv(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] srlv ${}, ${}, ${}", rd, rt, rs);
+
+    uint32_t value = cpuState->getRegister(rt) >> (cpuState->getRegister(rs) & 0x1F);
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::srav(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] srav ${}, ${}, ${}", rd, rt, rs);
+
+    auto value = static_cast<int32_t>(cpuState->getRegister(rt)) >> (cpuState->getRegister(rs) & 0x1F);
+    cpuState->setRegister(rd, static_cast<uint32_t>(value));
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
 void OpcodeImplementationCpu::add(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
     auto rd = opcode.rd();
 
-    spdlog::trace("[opcode] addu ${}, ${}, ${}", rd, rs, rt);
+    spdlog::trace("[opcode] add ${}, ${}, ${}", rd, rs, rt);
 
-    auto value = checked_add_unsigned(cpuState->getRegister(rs), cpuState->getRegister(rt));
+    auto value = checked_add_signed(static_cast<int32_t>(cpuState->getRegister(rs)), static_cast<int32_t>(cpuState->getRegister(rt)));
     if (value) {
-        cpuState->setRegister(rd, *value);
+        cpuState->setRegister(rd, static_cast<uint32_t>(*value));
         cpuCallbacks->invalidateLoadDelaySlot(rd);
     } else {
-        spdlog::error("add overflow at {:#010x}", opcode.address());
-        throw OpcodeError();
+        spdlog::debug("add overflow at {:#010x}", opcode.address());
+        cpuCallbacks->raiseException(ExceptionCause::Overflow);
     }
 }
 
@@ -155,6 +331,35 @@ void OpcodeImplementationCpu::addu(Opcode opcode, CpuState *cpuState, IOpcodeCpu
     cpuCallbacks->invalidateLoadDelaySlot(rd);
 }
 
+void OpcodeImplementationCpu::sub(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] sub ${}, ${}, ${}", rd, rs, rt);
+
+    auto value = checked_sub_signed(static_cast<int32_t>(cpuState->getRegister(rs)), static_cast<int32_t>(cpuState->getRegister(rt)));
+    if (value) {
+        cpuState->setRegister(rd, static_cast<uint32_t>(*value));
+        cpuCallbacks->invalidateLoadDelaySlot(rd);
+    } else {
+        spdlog::debug("sub overflow at {:#010x}", opcode.address());
+        cpuCallbacks->raiseException(ExceptionCause::Overflow);
+    }
+}
+
+void OpcodeImplementationCpu::subu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] subu ${}, ${}, ${}", rd, rs, rt);
+
+    auto value = cpuState->getRegister(rs) - cpuState->getRegister(rt);
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
 void OpcodeImplementationCpu::addi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
@@ -168,8 +373,8 @@ void OpcodeImplementationCpu::addi(Opcode opcode, CpuState *cpuState, IOpcodeCpu
         cpuState->setRegister(rt, static_cast<uint32_t>(*value));
         cpuCallbacks->invalidateLoadDelaySlot(rt);
     } else {
-        spdlog::error("addi overflow at {:#010x}", opcode.address());
-        throw OpcodeError();
+        spdlog::debug("addi overflow at {:#010x}", opcode.address());
+        cpuCallbacks->raiseException(ExceptionCause::Overflow);
     }
 }
 
@@ -185,6 +390,43 @@ void OpcodeImplementationCpu::addiu(Opcode opcode, CpuState *cpuState, IOpcodeCp
     cpuCallbacks->invalidateLoadDelaySlot(rt);
 }
 
+void OpcodeImplementationCpu::slti(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] slti ${}, ${}, {:#07x}", rt, rs, imm);
+
+    auto value = static_cast<int32_t>(cpuState->getRegister(rs)) < imm ? 1 : 0;
+    cpuState->setRegister(rt, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rt);
+}
+
+void OpcodeImplementationCpu::sltiu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16signed();
+
+    spdlog::trace("[opcode] sltiu ${}, ${}, {:#07x}", rt, rs, imm);
+
+    // The immediate is sign extended but compared unsigned
+    auto value = cpuState->getRegister(rs) < static_cast<uint32_t>(imm) ? 1 : 0;
+    cpuState->setRegister(rt, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rt);
+}
+
+void OpcodeImplementationCpu::xori(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto imm = opcode.imm16();
+
+    spdlog::trace("[opcode] xori ${}, ${}, {:#06x}", rt, rs, imm);
+
+    uint32_t value = cpuState->getRegister(rs) ^ imm;
+    cpuState->setRegister(rt, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rt);
+}
+
 void OpcodeImplementationCpu::j(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto imm = opcode.imm26();
 
@@ -205,12 +447,14 @@ void OpcodeImplementationCpu::jalr(Opcode opcode, CpuState *cpuState, IOpcodeCpu
     auto rs = opcode.rs();
     auto rd = opcode.rd();
 
-    // Store return address in $31
+    // Read the target first, rs and rd may be the same register
+    uint32_t address = cpuState->getRegister(rs);
+    spdlog::trace("[opcode] jalr ${}, ${}", rd, rs);
+
+    // Store return address in rd
     auto returnAddress = opcode.address() + 8;
     cpuState->setRegister(rd, returnAddress);
-
-    uint32_t address = cpuState->getRegister(rs);
-    spdlog::trace("[opcode] jr ${}", rs);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
     cpuCallbacks->addBranchDelaySlot(BranchDelaySlot(address));
 }
 
@@ -220,6 +464,7 @@ void OpcodeImplementationCpu::jal(Opcode opcode, CpuState *cpuState, IOpcodeCpuC
     // Store return address in $31
     auto returnAddress = opcode.address() + 8;
     cpuState->setRegister(RegisterIndex(31), returnAddress);
+    cpuCallbacks->invalidateLoadDelaySlot(RegisterIndex(31));
 
     uint32_t address = (cpuState->getProgramCounter() & 0xF0000000) + (imm << 2);
     spdlog::trace("[opcode] jal {:#010x}", address);
@@ -231,14 +476,14 @@ void OpcodeImplementationCpu::or_(Opcode opcode, CpuState *cpuState, IOpcodeCpuC
     auto rs = opcode.rs();
     auto rd = opcode.rd();
 
-    spdlog::trace("[opcode] sll ${}, ${}, ${}", rd, rs, rt);
+    spdlog::trace("[opcode] or ${}, ${}, ${}", rd, rs, rt);
 
     auto value = cpuState->getRegister(rs) | cpuState->getRegister(rt);
     cpuState->setRegister(rd, value);
     cpuCallbacks->invalidateLoadDelaySlot(rd);
 }
 
-void OpcodeImplementationCpu::and(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+void OpcodeImplementationCpu::and_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
     auto rd = opcode.rd();
@@ -250,6 +495,43 @@ void OpcodeImplementationCpu::and(Opcode opcode, CpuState *cpuState, IOpcodeCpuC
     cpuCallbacks->invalidateLoadDelaySlot(rd);
 }
 
+void OpcodeImplementationCpu::xor_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] xor ${}, ${}, ${}", rd, rs, rt);
+
+    auto value = cpuState->getRegister(rs) ^ cpuState->getRegister(rt);
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::nor(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] nor ${}, ${}, ${}", rd, rs, rt);
+
+    auto value = ~(cpuState->getRegister(rs) | cpuState->getRegister(rt));
+    cpuState->setRegister(rd, value);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::slt(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rt = opcode.rt();
+    auto rs = opcode.rs();
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] slt ${}, ${}, ${}", rd, rs, rt);
+
+    auto a = static_cast<int32_t>(cpuState->getRegister(rs));
+    auto b = static_cast<int32_t>(cpuState->getRegister(rt));
+    cpuState->setRegister(rd, a < b ? 1 : 0);
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
 void OpcodeImplementationCpu::sltu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto rt = opcode.rt();
     auto rs = opcode.rs();
@@ -300,7 +582,7 @@ void OpcodeImplementationCpu::bgtz(Opcode opcode, CpuState *cpuState, IOpcodeCpu
 
     spdlog::trace("[opcode] bgtz ${}, {:#06x}", rs, imm);
 
-    if (cpuState->getRegister(rs) > 0) {
+    if (static_cast<int32_t>(cpuState->getRegister(rs)) > 0) {
         branch(imm, opcode, cpuCallbacks);
     }
 }
@@ -311,27 +593,159 @@ void OpcodeImplementationCpu::blez(Opcode opcode, CpuState *cpuState, IOpcodeCpu
 
     spdlog::trace("[opcode] blez ${}, {:#06x}", rs, imm);
 
-    if (cpuState->getRegister(rs) <= 0) {
+    if (static_cast<int32_t>(cpuState->getRegister(rs)) <= 0) {
         branch(imm, opcode, cpuCallbacks);
     }
 }
 
+// BLTZ/BGEZ/BLTZAL/BGEZAL. Only bit 0 and bits 4..1 == 0x10 of rt are decoded, the
+// other encodings are aliases. The link register is written even if not taken.
 void OpcodeImplementationCpu::bcond(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
     auto subfunction = opcode.bcond_subfunction();
     auto rs = opcode.rs();
-    auto imm = opcode.imm16();
+    auto imm = opcode.imm16signed();
 
-    switch (subfunction) {
-    case 0x00: // bltz
-        return;
-    case 0x01: // bgez
-        return;
-    case 0x10: // bltzal
-        return;
-    case 0x11: // bgezal
-        return;
-    default:
-        spdlog::error("Unimplemented bcond subfunction");
-        throw OpcodeError();
+    auto greaterOrEqual = (subfunction & 0x01) != 0;
+    auto link = (subfunction & 0x1E) == 0x10;
+
+    spdlog::trace("[opcode] b{}z{} ${}, {:#06x}", greaterOrEqual ? "ge" : "lt", link ? "al" : "", rs, imm);
+
+    auto value = static_cast<int32_t>(cpuState->getRegister(rs));
+    auto taken = greaterOrEqual ? value >= 0 : value < 0;
+
+    if (link) {
+        cpuState->setRegister(RegisterIndex(31), opcode.address() + 8);
+        cpuCallbacks->invalidateLoadDelaySlot(RegisterIndex(31));
+    }
+
+    if (taken) {
+        branch(imm, opcode, cpuCallbacks);
+    }
+}
+
+void OpcodeImplementationCpu::mult(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rs = opcode.rs();
+    auto rt = opcode.rt();
+
+    spdlog::trace("[opcode] mult ${}, ${}", rs, rt);
+
+    auto a = cpuState->getRegister(rs);
+    auto b = cpuState->getRegister(rt);
+    auto value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(a)) * static_cast<int32_t>(b));
+    cpuState->setHi(static_cast<uint32_t>(value >> 32));
+    cpuState->setLo(static_cast<uint32_t>(value));
+    cpuCallbacks->startMultiplyDivide(Timing::multiplyCycles(a, true));
+}
+
+void OpcodeImplementationCpu::multu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rs = opcode.rs();
+    auto rt = opcode.rt();
+
+    spdlog::trace("[opcode] multu ${}, ${}", rs, rt);
+
+    auto a = cpuState->getRegister(rs);
+    auto b = cpuState->getRegister(rt);
+    auto value = static_cast<uint64_t>(a) * b;
+    cpuState->setHi(static_cast<uint32_t>(value >> 32));
+    cpuState->setLo(static_cast<uint32_t>(value));
+    cpuCallbacks->startMultiplyDivide(Timing::multiplyCycles(a, false));
+}
+
+void OpcodeImplementationCpu::div(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rs = opcode.rs();
+    auto rt = opcode.rt();
+
+    spdlog::trace("[opcode] div ${}, ${}", rs, rt);
+
+    auto numerator = static_cast<int32_t>(cpuState->getRegister(rs));
+    auto denominator = static_cast<int32_t>(cpuState->getRegister(rt));
+
+    if (denominator == 0) {
+        // Division by zero does not trap, the results are well defined
+        cpuState->setHi(static_cast<uint32_t>(numerator));
+        cpuState->setLo(numerator >= 0 ? 0xFFFFFFFF : 1);
+    } else if (numerator == INT32_MIN && denominator == -1) {
+        cpuState->setHi(0);
+        cpuState->setLo(0x80000000);
+    } else {
+        cpuState->setHi(static_cast<uint32_t>(numerator % denominator));
+        cpuState->setLo(static_cast<uint32_t>(numerator / denominator));
     }
-}
\ No newline at end of file
+    cpuCallbacks->startMultiplyDivide(Timing::DIVIDE_CYCLES);
+}
+
+void OpcodeImplementationCpu::divu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rs = opcode.rs();
+    auto rt = opcode.rt();
+
+    spdlog::trace("[opcode] divu ${}, ${}", rs, rt);
+
+    auto numerator = cpuState->getRegister(rs);
+    auto denominator = cpuState->getRegister(rt);
+
+    if (denominator == 0) {
+        cpuState->setHi(numerator);
+        cpuState->setLo(0xFFFFFFFF);
+    } else {
+        cpuState->setHi(numerator % denominator);
+        cpuState->setLo(numerator / denominator);
+    }
+    cpuCallbacks->startMultiplyDivide(Timing::DIVIDE_CYCLES);
+}
+
+void OpcodeImplementationCpu::mfhi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] mfhi ${}", rd);
+
+    cpuCallbacks->waitMultiplyDivide();
+    cpuState->setRegister(rd, cpuState->getHi());
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::mflo(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto rd = opcode.rd();
+
+    spdlog::trace("[opcode] mflo ${}", rd);
+
+    cpuCallbacks->waitMultiplyDivide();
+    cpuState->setRegister(rd, cpuState->getLo());
+    cpuCallbacks->invalidateLoadDelaySlot(rd);
+}
+
+void OpcodeImplementationCpu::mthi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *) {
+    auto rs = opcode.rs();
+
+    spdlog::trace("[opcode] mthi ${}", rs);
+
+    cpuState->setHi(cpuState->getRegister(rs));
+}
+
+void OpcodeImplementationCpu::mtlo(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *) {
+    auto rs = opcode.rs();
+
+    spdlog::trace("[opcode] mtlo ${}", rs);
+
+    cpuState->setLo(cpuState->getRegister(rs));
+}
+
+void OpcodeImplementationCpu::syscall(Opcode opcode, CpuState *, IOpcodeCpuCallbacks *cpuCallbacks) {
+    spdlog::trace("[opcode] syscall {:#07x}", opcode.raw() >> 6 & 0xFFFFF);
+
+    cpuCallbacks->raiseException(ExceptionCause::Syscall);
+}
+
+void OpcodeImplementationCpu::break_(Opcode opcode, CpuState *, IOpcodeCpuCallbacks *cpuCallbacks) {
+    spdlog::trace("[opcode] break {:#07x}", opcode.raw() >> 6 & 0xFFFFF);
+
+    cpuCallbacks->raiseException(ExceptionCause::Breakpoint);
+}
+
+// cop1, cop3 and the load/store instructions of coprocessors 0, 1 and 3 do not exist
+void OpcodeImplementationCpu::coprocessorUnusable(Opcode opcode, CpuState *, IOpcodeCpuCallbacks *cpuCallbacks) {
+    auto coprocessor = opcode.instruction() & 0x03;
+
+    spdlog::debug("[opcode] coprocessor {} unusable at {:#010x}", coprocessor, opcode.address());
+
+    cpuCallbacks->raiseCoprocessorUnusable(coprocessor);
+}
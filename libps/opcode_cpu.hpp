@@ -12,16 +12,45 @@ void add(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void addu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void addi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void addiu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void sub(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void subu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void or_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
-void and(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void and_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void xor_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void nor(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void xori(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void slt(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void sltu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void slti(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void sltiu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+
+void srl(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void sra(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void sllv(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void srlv(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void srav(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+
+void mult(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void multu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void div(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void divu(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void mfhi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void mflo(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void mthi(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void mtlo(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 
 void lbu(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
 void lb(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void lh(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void lhu(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
 void lw(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
-void sw(Opcode opcode, CpuState *cpuState, Memory *memory);
-void sh(Opcode opcode, CpuState *cpuState, Memory *memory);
-void sb(Opcode opcode, CpuState *cpuState, Memory *memory);
+void lwl(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void lwr(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void sw(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void sh(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void sb(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void swl(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
+void swr(Opcode opcode, CpuState *cpuState, Memory *memory, IOpcodeCpuCallbacks *cpuCallbacks);
 
 void j(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void jr(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
@@ -32,4 +61,8 @@ void beq(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void bgtz(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void bcond(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 void blez(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+
+void syscall(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void break_(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
+void coprocessorUnusable(Opcode opcode, CpuState *cpuState, IOpcodeCpuCallbacks *cpuCallbacks);
 }; // namespace OpcodeImplementationCpu
@@ -0,0 +1,58 @@
+#include "perf_counters.hpp"
+
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+// Same order as MemorySegment
+constexpr const char *SEGMENT_NAMES[PerfCounters::SEGMENT_COUNT] = {
+    "ram",
+    "expansion_region_1",
+    "scratchpad",
+    "hw_registers",
+    "bios",
+    "cache_control"};
+
+void header(std::string &out, const char *name, const char *help) {
+    fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} counter\n", name, help, name);
+}
+
+template <typename Getter>
+void segmentMetric(std::string &out, const PerfCounters::Snapshot &snapshot, const char *name, const char *help, Getter getter) {
+    header(out, name, help);
+    for (size_t i = 0; i < PerfCounters::SEGMENT_COUNT; i++) {
+        fmt::format_to(std::back_inserter(out), "{}{{segment=\"{}\"}} {}\n", name, SEGMENT_NAMES[i], getter(snapshot.memory.segments[i]));
+    }
+}
+} // namespace
+
+std::string PerfCounters::prometheusText(const Snapshot &snapshot) {
+    std::string out;
+
+    header(out, "ps_cpu_opcode_executions_total", "Executed instructions by primary opcode.");
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (snapshot.cpu.opcodes[i] != 0) {
+            fmt::format_to(std::back_inserter(out), "ps_cpu_opcode_executions_total{{opcode=\"{:#04x}\"}} {}\n", i, snapshot.cpu.opcodes[i]);
+        }
+    }
+
+    header(out, "ps_cpu_load_delay_invalidations_total", "Pending loads overwritten by the instruction in their delay slot.");
+    fmt::format_to(std::back_inserter(out), "ps_cpu_load_delay_invalidations_total {}\n", snapshot.cpu.loadDelayInvalidations);
+
+    segmentMetric(out, snapshot, "ps_memory_reads_total", "Bus reads by memory segment.", [](const SegmentCounters &c) { return c.reads; });
+    segmentMetric(out, snapshot, "ps_memory_read_bytes_total", "Bytes read by memory segment.", [](const SegmentCounters &c) { return c.bytesRead; });
+    segmentMetric(out, snapshot, "ps_memory_writes_total", "Bus writes by memory segment.", [](const SegmentCounters &c) { return c.writes; });
+    segmentMetric(out, snapshot, "ps_memory_written_bytes_total", "Bytes written by memory segment.", [](const SegmentCounters &c) { return c.bytesWritten; });
+
+    return out;
+}
+
+void PerfCounters::writePrometheusFile(const Snapshot &snapshot, const std::string &path) {
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Error opening file {}", path));
+    }
+    file << prometheusText(snapshot);
+}
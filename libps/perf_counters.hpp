@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Host side performance counters. They only exist when compiled with PS_PERF_COUNTERS
+// (cmake -DPS_PERF_COUNTERS=ON), otherwise PS_PERF_COUNT discards its argument and
+// the counter members are not part of CPU and Memory at all.
+#ifdef PS_PERF_COUNTERS
+#define PS_PERF_COUNT(expression) (expression)
+#else
+#define PS_PERF_COUNT(expression) ((void)0)
+#endif
+
+namespace PerfCounters {
+#ifdef PS_PERF_COUNTERS
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+// Counters of different components are kept on separate cache lines
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t OPCODE_COUNT = 64;
+// Number of MemorySegment values
+constexpr size_t SEGMENT_COUNT = 6;
+
+struct alignas(CACHE_LINE_SIZE) CpuCounters {
+    // Indexed by the primary opcode (bits 31..26)
+    uint64_t opcodes[OPCODE_COUNT] = {};
+    alignas(CACHE_LINE_SIZE) uint64_t loadDelayInvalidations = 0;
+};
+
+struct alignas(CACHE_LINE_SIZE) SegmentCounters {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+};
+
+struct MemoryCounters {
+    // Indexed by MemorySegment
+    SegmentCounters segments[SEGMENT_COUNT];
+};
+
+struct Snapshot {
+    CpuCounters cpu;
+    MemoryCounters memory;
+};
+
+// Prometheus text exposition format
+std::string prometheusText(const Snapshot &snapshot);
+void writePrometheusFile(const Snapshot &snapshot, const std::string &path);
+}; // namespace PerfCounters
@@ -2,17 +2,36 @@
 #include "playstation.hpp"
 #include "libutils/file.hpp"
 #include "ram.hpp"
+#include "timing.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <spdlog/spdlog.h>
 
+// Instructions the CPU runs between device updates
+constexpr uint32_t SLICE_INSTRUCTIONS = 64;
+// The BIOS jumps to the shell here once the kernel is set up
+constexpr uint32_t SHELL_ENTRY_POINT = 0x80030000;
+// Cycles between state hashes in a replay log, one second of emulated time
+constexpr uint64_t CHECKPOINT_INTERVAL_CYCLES = Timing::CPU_CLOCK;
+// Longest skip out of an idle loop. The SPU is ticked once per sample, so a loop
+// polling it or waiting for its interrupt sees the same state it would when running.
+constexpr uint32_t IDLE_SKIP_MAX_CYCLES = SPU_CYCLES_PER_SAMPLE;
+
 void Playstation::initialize()
 {
     _cpu.setMemory(&_memory);
+    _cpu.setBiosHle(&_biosHle);
     _cpu.initializeState();
 
     auto ram = std::make_unique<Ram>();
     _memory.setRam(std::move(ram));
+    _memory.setSpu(&_spu);
+    _memory.setSio(&_sio);
+    _memory.setInterruptController(&_interruptController);
+    _memory.setDma(&_dma);
+    _memory.setMdec(&_mdec);
+    _scheduler.setClock([this]() { return _cpu.cycles(); });
 }
 
 void Playstation::intializeBios(const std::string &path)
@@ -29,9 +48,288 @@ void Playstation::intializeBios(const std::string &path)
     _memory.setBios(std::move(bios));
 }
 
-void Playstation::run()
+void Playstation::loadExecutable(const std::string &path, bool skipBios)
+{
+    auto file = File(path);
+    if (!file.exists()) {
+        throw std::runtime_error(fmt::format("Executable {} does not exist", path));
+    }
+
+    auto data = file.readAll();
+    // Rejects broken files before any emulation happens
+    RomHeader::parse(data);
+
+    if (skipBios) {
+        startExecutable(data);
+        return;
+    }
+    _pendingExecutable = std::move(data);
+    _cpu.setExecutionHook(SHELL_ENTRY_POINT);
+}
+
+void Playstation::startExecutable(const ByteBuffer &data)
+{
+    auto header = RomHeader::parse(data);
+    spdlog::info("Starting executable at {:#010x}, {} bytes of text at {:#010x}", header.pc, header.textSize, header.textAddress);
+
+    auto copy = [this](uint32_t address, uint32_t size, const uint8_t *source) {
+        auto segment = _memory.getSegmentForAddress(address);
+        auto ram = _memory.ram();
+        if (!segment || segment->region != MemorySegment::RAM || segment->offset > ram->size() ||
+            size > ram->size() - segment->offset) {
+            throw std::runtime_error(fmt::format("Executable segment {:#010x}+{:#x} is not in RAM", address, size));
+        }
+        if (source) {
+            std::copy(source, source + size, ram->data() + segment->offset);
+        } else {
+            std::fill_n(ram->data() + segment->offset, size, 0);
+        }
+        _memory.ramWritten(segment->offset, size);
+    };
+    copy(header.textAddress, header.textSize, data.data() + RomHeader::SIZE);
+    if (header.bssSize > 0) {
+        copy(header.bssAddress, header.bssSize, nullptr);
+    }
+
+    auto state = _cpu.getCpuState();
+    state->setProgramCounter(header.pc);
+    state->setRegister(RegisterIndex(28), header.gp);
+    if (header.stackAddress != 0) {
+        state->setRegister(RegisterIndex(29), header.stackAddress + header.stackSize);
+        state->setRegister(RegisterIndex(30), header.stackAddress + header.stackSize);
+    }
+}
+
+bool Playstation::executableHookHit()
+{
+    const auto &stop = _cpu.debugStop();
+    if (!_pendingExecutable || !stop || stop->reason != DebugStop::Reason::Hook) {
+        return false;
+    }
+
+    _cpu.setExecutionHook({});
+    _cpu.resume();
+    startExecutable(*_pendingExecutable);
+    _pendingExecutable.reset();
+    return true;
+}
+
+void Playstation::setAudioSink(AudioSink *sink)
+{
+    _spu.setAudioSink(sink);
+}
+
+void Playstation::setInstructionCacheEnabled(bool enabled)
+{
+    _cpu.setInstructionCacheEnabled(enabled);
+}
+
+void Playstation::setIdleLoopSkipping(bool enabled)
+{
+    _cpu.setIdleLoopDetection(enabled);
+}
+
+void Playstation::setCachedInterpreter(bool enabled)
+{
+    _cpu.setCachedInterpreter(enabled);
+}
+
+void Playstation::loadBlockCache(const std::string &path)
+{
+    _cpu.blockCache().setFile(std::make_shared<const BlockCacheFile>(path, biosHash()));
+}
+
+void Playstation::saveBlockCache(const std::string &path)
+{
+    _cpu.blockCache().save(path, biosHash());
+}
+
+uint64_t Playstation::biosHash()
+{
+    auto *bios = _memory.bios();
+    if (!bios || !bios->data()) {
+        return BlockCacheFile::hash(nullptr, 0);
+    }
+    return BlockCacheFile::hash(bios->data(), bios->size());
+}
+
+void Playstation::enableProfiler()
+{
+    _profiler = std::make_unique<Profiler>();
+}
+
+void Playstation::reportProfile(size_t count, const SymbolMap *symbols)
+{
+    if (_profiler) {
+        _profiler->report(count, &_memory, symbols);
+    }
+}
+
+PerfCounters::Snapshot Playstation::perfCounters() const
+{
+    PerfCounters::Snapshot snapshot;
+#ifdef PS_PERF_COUNTERS
+    snapshot.cpu = _cpu.perfCounters();
+    snapshot.memory = _memory.perfCounters();
+#endif
+    return snapshot;
+}
+
+void Playstation::run(std::optional<uint64_t> instructionLimit)
+{
+    execute(instructionLimit);
+    _spu.flush();
+}
+
+uint64_t Playstation::execute(std::optional<uint64_t> instructionLimit)
+{
+    uint64_t instructions = 0;
+    while (!instructionLimit || instructions < *instructionLimit) {
+        auto maxInstructions = SLICE_INSTRUCTIONS;
+        if (instructionLimit) {
+            maxInstructions = static_cast<uint32_t>(std::min<uint64_t>(maxInstructions, *instructionLimit - instructions));
+        }
+
+        instructions += runSlice(maxInstructions);
+        if (_cpu.debugStop() && !executableHookHit()) {
+            break;
+        }
+    }
+    return instructions;
+}
+
+bool Playstation::runFrame()
+{
+    auto frameEnd = (_cpu.cycles() / Timing::FRAME_CYCLES + 1) * Timing::FRAME_CYCLES;
+    while (_cpu.cycles() < frameEnd) {
+        runSlice(SLICE_INSTRUCTIONS);
+        if (_cpu.debugStop() && !executableHookHit()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t Playstation::runSlice(uint32_t maxInstructions)
+{
+    auto slice = _cpu.run(maxInstructions);
+    auto cycles = slice.cycles;
+    if (_cpu.takeIdleLoop()) {
+        cycles += skipIdleLoop();
+    }
+    updateDevices(cycles);
+
+    if (_profiler) {
+        _profiler->advance(_cpu.getCpuState()->getProgramCounter(), slice.instructions);
+    }
+    if (_replay.active() && _cpu.cycles() >= _nextCheckpoint) {
+        replayCheckpoint();
+    }
+    return slice.instructions;
+}
+
+void Playstation::saveState(SaveState &state) const
+{
+    _cpu.save(state.cpu);
+    _memory.save(state.memory);
+    _scheduler.save(state.scheduler);
+    _interruptController.save(state.interruptController);
+    _spu.save(state.spu);
+    _sio.save(state.sio);
+    _mdec.save(state.mdec);
+    _dma.save(state.dma);
+    state.nextCheckpoint = _nextCheckpoint;
+    state.idleCycles = _idleCycles;
+}
+
+void Playstation::loadState(const SaveState &state)
+{
+    _cpu.restore(state.cpu);
+    _memory.restore(state.memory);
+    _scheduler.restore(state.scheduler);
+    _interruptController.restore(state.interruptController);
+    _spu.restore(state.spu);
+    _sio.restore(state.sio);
+    _mdec.restore(state.mdec);
+    _dma.restore(state.dma);
+    _nextCheckpoint = state.nextCheckpoint;
+    _idleCycles = state.idleCycles;
+}
+
+void Playstation::startRecording(const std::string &path)
+{
+    _replay.startRecording(path);
+    _nextCheckpoint = _cpu.cycles() + CHECKPOINT_INTERVAL_CYCLES;
+}
+
+void Playstation::startPlayback(const std::string &path)
+{
+    _replay.startPlayback(path);
+    _nextCheckpoint = _cpu.cycles() + CHECKPOINT_INTERVAL_CYCLES;
+}
+
+uint64_t Playstation::stateHash() const
+{
+    // FNV-1a over the registers and the cycle count
+    uint64_t hash = 0xCBF29CE484222325;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 0x100000001B3;
+        }
+    };
+
+    const auto *state = _cpu.getCpuState();
+    mix(_cpu.cycles());
+    mix(state->getProgramCounter());
+    mix(state->getHi());
+    mix(state->getLo());
+    for (uint8_t i = 0; i < 32; i++) {
+        mix(state->getRegister(RegisterIndex(i)));
+    }
+    return hash;
+}
+
+void Playstation::replayCheckpoint()
+{
+    auto cycles = _cpu.cycles();
+    _nextCheckpoint = cycles + CHECKPOINT_INTERVAL_CYCLES;
+    _replay.checkpoint(cycles, stateHash());
+}
+
+void Playstation::step()
+{
+    updateDevices(_cpu.runBlock(1).cycles);
+    if (_cpu.debugStop() && executableHookHit()) {
+        return;
+    }
+    while (_cpu.inBranchDelaySlot() && !_cpu.debugStop()) {
+        // Steps over a breakpoint in the delay slot instead of stopping in it
+        _cpu.resume();
+        updateDevices(_cpu.runBlock(1).cycles);
+    }
+}
+
+uint32_t Playstation::skipIdleLoop()
+{
+    // Events that are due or a pending interrupt may end the loop right away
+    auto now = _cpu.cycles();
+    auto until = std::min(_scheduler.nextCycle(), now + IDLE_SKIP_MAX_CYCLES);
+    if (until <= now || _interruptController.pending()) {
+        return 0;
+    }
+    auto cycles = static_cast<uint32_t>(until - now);
+    _cpu.skipCycles(cycles);
+    _idleCycles += cycles;
+    return cycles;
+}
+
+void Playstation::updateDevices(uint32_t cycles)
 {
-    while (true) {
-        _cpu.step();
+    _spu.tick(cycles);
+    _scheduler.run(_cpu.cycles());
+    // Execution stopped for the debugger stays where it is
+    if (!_cpu.debugStop()) {
+        _cpu.setInterruptLine(_interruptController.pending());
     }
 }
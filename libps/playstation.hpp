@@ -1,20 +1,131 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
 
 #include "memory.hpp"
+#include "bios_hle.hpp"
 #include "cpu.hpp"
+#include "dma.hpp"
+#include "interrupt_controller.hpp"
+#include "mdec.hpp"
+#include "perf_counters.hpp"
+#include "profiler.hpp"
+#include "replay.hpp"
+#include "romheader.hpp"
+#include "scheduler.hpp"
+#include "sio.hpp"
+#include "spu.hpp"
+#include "symbol_map.hpp"
+
+// In-memory snapshot of the emulated machine. Taking and restoring one copies plain
+// blocks, nothing is serialized, so a state only fits the Playstation it was taken
+// from. Its buffers are reused, keeping one around makes taking the next one cheap.
+// Debugger state, the profiler, a replay and a pending executable are not part of it.
+struct SaveState {
+    CPU::Snapshot cpu;
+    Memory::Snapshot memory;
+    Scheduler::Snapshot scheduler;
+    InterruptController::Snapshot interruptController;
+    Spu::Snapshot spu;
+    Sio::Snapshot sio;
+    Mdec::Snapshot mdec;
+    Dma::Snapshot dma;
+    uint64_t nextCheckpoint = 0;
+    uint64_t idleCycles = 0;
+};
 
 class Playstation
 {
 private:
     Memory _memory;
     CPU _cpu;
+    Spu _spu;
+    Scheduler _scheduler;
+    InterruptController _interruptController;
+    std::unique_ptr<Profiler> _profiler;
+    Replay _replay;
+    uint64_t _nextCheckpoint = 0;
+    uint64_t _idleCycles = 0;
+    Sio _sio{&_scheduler, &_interruptController, &_replay};
+    Mdec _mdec{&_scheduler};
+    Dma _dma{&_memory, &_interruptController, &_mdec};
+    BiosHle _biosHle{&_memory};
+    // PS-X EXE waiting for the BIOS to reach its shell
+    std::optional<ByteBuffer> _pendingExecutable;
+
+    void replayCheckpoint();
+    void startExecutable(const ByteBuffer &data);
+    // Starts the pending executable if the CPU stopped at the shell entry point
+    bool executableHookHit();
+    // Runs the CPU for up to maxInstructions and updates the devices, returns the
+    // number of executed instructions
+    uint32_t runSlice(uint32_t maxInstructions);
+    // Fast-forwards a CPU that polls in an idle loop, returns the skipped cycles
+    uint32_t skipIdleLoop();
+    // Advances the devices after the CPU ran for cycles and delivers interrupts
+    void updateDevices(uint32_t cycles);
+    // Identifies the BIOS image a block cache file belongs to
+    uint64_t biosHash();
 
 public:
     Playstation() = default;
 
     void initialize();
     void intializeBios(const std::string &path);
-    void run();
-};
\ No newline at end of file
+    // Boots a PS-X EXE. With the BIOS it is started once the BIOS reaches its shell,
+    // so the kernel is set up, otherwise it starts right away and no BIOS code runs.
+    void loadExecutable(const std::string &path, bool skipBios);
+    void setAudioSink(AudioSink *sink);
+    AudioSink *audioSink() const { return _spu.audioSink(); }
+    void setInstructionCacheEnabled(bool enabled);
+    // Skipping of idle loops, on by default
+    void setIdleLoopSkipping(bool enabled);
+    // Runs translated blocks instead of decoding every instruction, see CPU
+    void setCachedInterpreter(bool enabled);
+    // Translated blocks from an earlier run with the same BIOS, see BlockCacheFile.
+    // Load throws when the file is not usable, save when it cannot be written.
+    void loadBlockCache(const std::string &path);
+    void saveBlockCache(const std::string &path);
+    // Cycles skipped in idle loops
+    uint64_t idleCycles() const { return _idleCycles; }
+    void enableProfiler();
+    void reportProfile(size_t count, const SymbolMap *symbols);
+    // Zero unless built with PS_PERF_COUNTERS
+    PerfCounters::Snapshot perfCounters() const;
+    void run(std::optional<uint64_t> instructionLimit = {});
+
+    // Runs until the instruction limit is reached or the CPU stops for the debugger,
+    // returns the number of executed instructions
+    uint64_t execute(std::optional<uint64_t> instructionLimit);
+    // Runs to the end of the current frame, see Timing::FRAME_CYCLES. Returns false
+    // if the CPU stopped for the debugger before.
+    bool runFrame();
+    // Executes one instruction. A taken branch is executed together with its delay
+    // slot, so execution never stops between them.
+    void step();
+
+    // Record or play back the nondeterministic inputs of this run, see Replay
+    void startRecording(const std::string &path);
+    void startPlayback(const std::string &path);
+    // Hash of the CPU state, used to detect where a playback diverges
+    uint64_t stateHash() const;
+
+    void saveState(SaveState &state) const;
+    void loadState(const SaveState &state);
+    // True until the BIOS reached the shell and the executable was started
+    bool executablePending() const { return _pendingExecutable.has_value(); }
+
+    CPU &cpu() { return _cpu; }
+    Sio &sio() { return _sio; }
+    Spu &spu() { return _spu; }
+    InterruptController &interruptController() { return _interruptController; }
+    Scheduler &scheduler() { return _scheduler; }
+    Mdec &mdec() { return _mdec; }
+    Dma &dma() { return _dma; }
+    BiosHle &biosHle() { return _biosHle; }
+    Replay &replay() { return _replay; }
+    Memory &memory() { return _memory; }
+};
@@ -0,0 +1,90 @@
+#include "profiler.hpp"
+#include "disassembler.hpp"
+#include "memory.hpp"
+#include "symbol_map.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <spdlog/spdlog.h>
+
+namespace {
+uint32_t slotIndex(uint32_t address) {
+    // Fibonacci hashing of the word address
+    return ((address >> 2) * 0x9E3779B1u) >> 20;
+}
+static_assert(Profiler::SLOT_COUNT == 1 << (32 - 20));
+
+// Reads the instruction at address without charging the guest or hitting watchpoints
+std::optional<uint32_t> instructionAt(Memory &memory, uint32_t address) {
+    uint32_t raw = 0;
+    for (uint32_t i = 0; i < sizeof(raw); i++) {
+        auto byte = memory.debugRead(address + i);
+        if (!byte) {
+            return {};
+        }
+        raw |= static_cast<uint32_t>(*byte) << (i * 8);
+    }
+    return raw;
+}
+} // namespace
+
+void Profiler::reset() {
+    _slots = {};
+    _countdown = SAMPLE_INTERVAL;
+    _samples = 0;
+    _dropped = 0;
+}
+
+void Profiler::sample(uint32_t address) {
+    _samples++;
+
+    auto index = slotIndex(address);
+    for (uint32_t probe = 0; probe < MAX_PROBES; probe++) {
+        auto &slot = _slots[(index + probe) & (SLOT_COUNT - 1)];
+        if (slot.samples == 0) {
+            slot.address = address;
+        }
+        if (slot.address == address) {
+            slot.samples++;
+            return;
+        }
+    }
+    _dropped++;
+}
+
+std::vector<Profiler::Hotspot> Profiler::top(size_t count) const {
+    std::vector<Hotspot> hotspots;
+    std::copy_if(_slots.begin(), _slots.end(), std::back_inserter(hotspots), [](const Hotspot &slot) {
+        return slot.samples > 0;
+    });
+
+    count = std::min(count, hotspots.size());
+    std::partial_sort(hotspots.begin(), hotspots.begin() + count, hotspots.end(), [](const Hotspot &a, const Hotspot &b) {
+        return a.samples > b.samples || (a.samples == b.samples && a.address < b.address);
+    });
+    hotspots.resize(count);
+    return hotspots;
+}
+
+void Profiler::report(size_t count, Memory *memory, const SymbolMap *symbols) const {
+    spdlog::info("[profiler] {} samples, {} dropped", _samples, _dropped);
+
+    char disassembly[Disassembler::MAX_LENGTH];
+    for (const auto &hotspot : top(count)) {
+        if (auto raw = instructionAt(*memory, hotspot.address)) {
+            Disassembler::disassemble(*raw, hotspot.address, disassembly, sizeof(disassembly));
+        } else {
+            std::strncpy(disassembly, "<unmapped>", sizeof(disassembly));
+        }
+
+        auto percent = 100.0 * hotspot.samples / static_cast<double>(_samples);
+        auto symbol = symbols ? symbols->lookup(hotspot.address) : nullptr;
+        if (symbol) {
+            spdlog::info("[profiler] {:5.1f}% {:#010x} {}+{:#x}: {}", percent, hotspot.address, symbol->name, hotspot.address - symbol->address, disassembly);
+        } else {
+            spdlog::info("[profiler] {:5.1f}% {:#010x}: {}", percent, hotspot.address, disassembly);
+        }
+    }
+}
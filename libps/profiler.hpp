@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Memory;
+class SymbolMap;
+
+// Sampling profiler for guest code. Every SAMPLE_INTERVAL instructions the program
+// counter is counted in a fixed size hash table, so sampling never allocates.
+// Addresses which do not fit into the table are only counted as dropped.
+class Profiler {
+public:
+    static constexpr uint32_t SAMPLE_INTERVAL = 10000;
+    static constexpr uint32_t SLOT_COUNT = 4096;
+    static constexpr uint32_t MAX_PROBES = 16;
+
+    struct Hotspot {
+        uint32_t address;
+        uint32_t samples;
+    };
+
+private:
+    std::array<Hotspot, SLOT_COUNT> _slots = {};
+    int64_t _countdown = SAMPLE_INTERVAL;
+    uint64_t _samples = 0;
+    uint64_t _dropped = 0;
+
+public:
+    void reset();
+
+    // Called after every slice of instructions with the address execution reached
+    void advance(uint32_t address, uint32_t instructions) {
+        _countdown -= instructions;
+        if (_countdown <= 0) {
+            _countdown += SAMPLE_INTERVAL;
+            sample(address);
+        }
+    }
+
+    void sample(uint32_t address);
+
+    uint64_t samples() const { return _samples; }
+    uint64_t dropped() const { return _dropped; }
+
+    // Most sampled addresses, highest first
+    std::vector<Hotspot> top(size_t count) const;
+
+    // Logs the hottest addresses with their disassembly and symbol, symbols may be null
+    void report(size_t count, Memory *memory, const SymbolMap *symbols) const;
+};
@@ -1,12 +1,23 @@
 #include "ram.hpp"
 
+#include <utility>
+
 constexpr uint32_t RAM_SIZE = 2048 * 1024;
 
 Ram::Ram()
-    : _data(RAM_SIZE) {
+    : Ram(RAM_SIZE) {
+}
+
+Ram::Ram(uint32_t sizeInBytes)
+    : _data(sizeInBytes) {
     spdlog::trace("Initialized RAM with size {}", size());
 }
 
+Ram::Ram(MappedBuffer data)
+    : _data(std::move(data)) {
+    spdlog::trace("Initialized RAM with size {} from a mapping", size());
+}
+
 uint32_t Ram::size() const {
     return static_cast<uint32_t>(_data.size());
 }
@@ -1,13 +1,14 @@
 #pragma once
 
-#include "libutils/data.hpp"
+#include "libutils/mapped_memory.hpp"
 #include "memory_region.hpp"
 #include "ram.hpp"
 
 class Ram
     : public MemoryRegion {
 private:
-    ByteBuffer _data;
+    // Pages are backed when they are first touched, see MappedBuffer
+    MappedBuffer _data;
 
     template <typename T>
     T read(uint32_t offset) const {
@@ -23,8 +24,12 @@ private:
 
 public:
     Ram();
+    explicit Ram(uint32_t size);
+    // Takes over a mapping, e.g. a copy-on-write view of a SharedMemory image
+    explicit Ram(MappedBuffer data);
 
     virtual uint32_t size() const;
+    virtual uint8_t *data() override { return _data.data(); }
 
     virtual uint8_t u8(uint32_t offset) const override;
     virtual uint16_t u16(uint32_t offset) const override;
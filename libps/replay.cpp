@@ -0,0 +1,229 @@
+#include "replay.hpp"
+#include "libutils/file.hpp"
+
+#include <cstring>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace {
+void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Returns false when the data ends in the middle of the varint
+bool getVarint(const std::vector<uint8_t> &data, size_t &offset, uint64_t &value) {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (offset >= data.size()) {
+            return false;
+        }
+        auto byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    throw std::runtime_error("Malformed varint in replay log");
+}
+} // namespace
+
+uint8_t Replay::channel(InputSource source, uint8_t port) {
+    return static_cast<uint8_t>(static_cast<uint8_t>(source) << 4 | (port & (PORT_COUNT - 1)));
+}
+
+void Replay::startRecording(const std::string &path) {
+    stop();
+
+    _file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    if (!_file) {
+        throw std::runtime_error(fmt::format("Error creating replay log {}", path));
+    }
+
+    uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    header[4] = static_cast<uint8_t>(VERSION);
+    header[5] = static_cast<uint8_t>(VERSION >> 8);
+    _file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    _file.flush();
+
+    _mode = Mode::Record;
+    spdlog::info("[replay] Recording inputs to {}", path);
+}
+
+void Replay::startPlayback(const std::string &path) {
+    auto file = File(path);
+    if (!file.exists()) {
+        throw std::runtime_error(fmt::format("Replay log {} does not exist", path));
+    }
+    startPlayback(file.readAll());
+    spdlog::info("[replay] Playing back {} records from {}", _records.size(), path);
+}
+
+void Replay::startPlayback(const std::vector<uint8_t> &data) {
+    stop();
+    _records = parse(data);
+    _mode = Mode::Playback;
+}
+
+void Replay::stop() {
+    if (_mode == Mode::Playback && _nextRecord < _records.size()) {
+        spdlog::warn("[replay] Stopped with {} of {} records left", _records.size() - _nextRecord, _records.size());
+    }
+    if (_file.is_open()) {
+        _file.close();
+    }
+
+    _mode = Mode::Off;
+    _records.clear();
+    _nextRecord = 0;
+    _lastCycle = 0;
+    _values = {};
+    _desyncs = 0;
+}
+
+void Replay::append(const Record &record) {
+    std::vector<uint8_t> bytes;
+    bytes.push_back(record.type);
+    putVarint(bytes, record.cycle - _lastCycle);
+    if (record.type == RECORD_INPUT) {
+        bytes.push_back(record.channel);
+        putVarint(bytes, record.value);
+    } else {
+        for (int i = 0; i < 8; i++) {
+            bytes.push_back(static_cast<uint8_t>(record.value >> (i * 8)));
+        }
+    }
+    _lastCycle = record.cycle;
+
+    // Flushed right away so the log survives a crash of the emulator
+    _file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    _file.flush();
+}
+
+bool Replay::advance(uint64_t cycle) {
+    auto skippedCheckpoint = false;
+    while (_nextRecord < _records.size() && _records[_nextRecord].cycle < cycle) {
+        const auto &record = _records[_nextRecord++];
+        if (record.type == RECORD_INPUT) {
+            _values[record.channel] = static_cast<uint32_t>(record.value);
+        } else {
+            skippedCheckpoint = true;
+        }
+    }
+    return !skippedCheckpoint;
+}
+
+uint32_t Replay::input(InputSource source, uint8_t port, uint64_t cycle, uint32_t live) {
+    auto index = channel(source, port);
+    auto &value = _values[index];
+
+    switch (_mode) {
+    case Mode::Off:
+        return live;
+    case Mode::Record:
+        if (value != live) {
+            value = live;
+            append(Record{RECORD_INPUT, cycle, index, live});
+        }
+        return live;
+    case Mode::Playback:
+        if (!advance(cycle)) {
+            _desyncs++;
+        }
+        // Several reads can share a cycle, each one consumes at most its own record
+        if (_nextRecord < _records.size()) {
+            const auto &record = _records[_nextRecord];
+            if (record.type == RECORD_INPUT && record.cycle == cycle && record.channel == index) {
+                value = static_cast<uint32_t>(record.value);
+                _nextRecord++;
+            }
+        }
+        // Inputs read before the recording saw them keep their live value
+        return value.value_or(live);
+    }
+    return live;
+}
+
+bool Replay::checkpoint(uint64_t cycle, uint64_t stateHash) {
+    switch (_mode) {
+    case Mode::Off:
+        return true;
+    case Mode::Record:
+        append(Record{RECORD_CHECKPOINT, cycle, 0, stateHash});
+        return true;
+    case Mode::Playback:
+        break;
+    }
+
+    auto inSync = advance(cycle);
+    if (_nextRecord < _records.size()) {
+        const auto &record = _records[_nextRecord];
+        if (record.type == RECORD_CHECKPOINT && record.cycle == cycle) {
+            _nextRecord++;
+            inSync = inSync && record.value == stateHash;
+        }
+    }
+
+    if (!inSync) {
+        if (_desyncs == 0) {
+            spdlog::error("[replay] Playback diverged from the recording at cycle {}", cycle);
+        }
+        _desyncs++;
+    }
+    return inSync;
+}
+
+std::vector<Replay::Record> Replay::parse(const std::vector<uint8_t> &data) {
+    if (data.size() < HEADER_SIZE || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a replay log");
+    }
+    auto version = static_cast<uint16_t>(data[4] | data[5] << 8);
+    if (version != VERSION) {
+        throw std::runtime_error(fmt::format("Unsupported replay log version {}", version));
+    }
+
+    std::vector<Record> records;
+    uint64_t cycle = 0;
+    size_t offset = HEADER_SIZE;
+    while (offset < data.size()) {
+        Record record = {};
+        record.type = data[offset++];
+
+        uint64_t delta;
+        if (!getVarint(data, offset, delta)) {
+            break;
+        }
+        record.cycle = cycle + delta;
+
+        if (record.type == RECORD_INPUT) {
+            if (offset >= data.size()) {
+                break;
+            }
+            record.channel = data[offset++];
+            if (record.channel >= SOURCE_COUNT * PORT_COUNT) {
+                throw std::runtime_error(fmt::format("Unknown replay input channel {:#04x} at offset {}", record.channel, offset - 1));
+            }
+            if (!getVarint(data, offset, record.value)) {
+                break;
+            }
+        } else if (record.type == RECORD_CHECKPOINT) {
+            if (data.size() - offset < 8) {
+                break;
+            }
+            for (int i = 0; i < 8; i++) {
+                record.value |= static_cast<uint64_t>(data[offset++]) << (i * 8);
+            }
+        } else {
+            throw std::runtime_error(fmt::format("Unknown replay record type {} at offset {}", record.type, offset - 1));
+        }
+
+        cycle = record.cycle;
+        records.push_back(record);
+    }
+    return records;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Sources of input the emulated machine cannot compute itself. Devices read them
+// through Replay::input, which makes their values part of a recording.
+enum class InputSource : uint8_t {
+    Controller = 0,
+    CdTiming = 1,
+};
+
+// Deterministic record and playback of nondeterministic inputs.
+//
+// A recording is an append-only binary file: an 8 byte header followed by records
+// which are written as they happen, so a crashed run leaves a usable log behind.
+// Inputs are only recorded when their value changes, keyed by the CPU cycle count,
+// and the log carries periodic checkpoints with a hash of the CPU state so playback
+// detects the cycle where it stops matching the recording.
+//
+//   header:     "PSRP" u16 version u16 reserved
+//   input:      u8 RECORD_INPUT      varint cycle delta  u8 source << 4 | port  varint value
+//   checkpoint: u8 RECORD_CHECKPOINT varint cycle delta  u64 state hash
+//
+// Cycle deltas are relative to the previous record, integers are little endian.
+class Replay {
+public:
+    enum class Mode {
+        Off,
+        Record,
+        Playback,
+    };
+
+    static constexpr char MAGIC[4] = {'P', 'S', 'R', 'P'};
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr uint8_t RECORD_INPUT = 1;
+    static constexpr uint8_t RECORD_CHECKPOINT = 2;
+    static constexpr size_t SOURCE_COUNT = 2;
+    static constexpr size_t PORT_COUNT = 16;
+
+    struct Record {
+        uint8_t type;
+        uint64_t cycle;
+        uint8_t channel;
+        uint64_t value;
+    };
+
+private:
+    Mode _mode = Mode::Off;
+    std::ofstream _file;
+    std::vector<Record> _records;
+    size_t _nextRecord = 0;
+    uint64_t _lastCycle = 0;
+    std::array<std::optional<uint32_t>, SOURCE_COUNT * PORT_COUNT> _values = {};
+    uint64_t _desyncs = 0;
+
+    static uint8_t channel(InputSource source, uint8_t port);
+    void append(const Record &record);
+    // Applies the recorded inputs before cycle, returns false when a checkpoint had to
+    // be skipped to get there
+    bool advance(uint64_t cycle);
+
+public:
+    // Throws when the file can not be created
+    void startRecording(const std::string &path);
+    // Throws when the file can not be read or is not a recording
+    void startPlayback(const std::string &path);
+    void startPlayback(const std::vector<uint8_t> &data);
+    void stop();
+
+    Mode mode() const { return _mode; }
+    bool active() const { return _mode != Mode::Off; }
+
+    // Returns the value a device has to use for an input read at cycle. Recording logs
+    // live if it changed, playback ignores live and returns the recorded value.
+    uint32_t input(InputSource source, uint8_t port, uint64_t cycle, uint32_t live);
+
+    // Recording logs the state hash, playback compares it with the recorded one.
+    // Returns false when playback diverged from the recording.
+    bool checkpoint(uint64_t cycle, uint64_t stateHash);
+
+    uint64_t desyncs() const { return _desyncs; }
+    // True when playback consumed every record
+    bool finished() const { return _mode == Mode::Playback && _nextRecord == _records.size(); }
+
+    // Decodes a recording, a truncated last record is dropped
+    static std::vector<Record> parse(const std::vector<uint8_t> &data);
+};
@@ -0,0 +1,38 @@
+#include "resampler.hpp"
+
+#include <cmath>
+
+Resampler::Resampler(uint32_t inputRate, uint32_t outputRate)
+    : _baseRatio(static_cast<double>(inputRate) / outputRate) {
+    setAdjustment(1.0);
+}
+
+void Resampler::setAdjustment(double adjustment) {
+    _adjustment = adjustment;
+    _step = static_cast<uint64_t>(std::llround(_baseRatio * adjustment * (1ull << FRACTION_BITS)));
+}
+
+size_t Resampler::process(const AudioFrame *input, size_t inputCount, size_t &consumed, AudioFrame *output, size_t outputCount) {
+    constexpr uint64_t one = 1ull << FRACTION_BITS;
+
+    consumed = 0;
+    size_t produced = 0;
+    while (produced < outputCount) {
+        while (_position >= one) {
+            if (consumed == inputCount) {
+                return produced;
+            }
+            _previous = _next;
+            _next = input[consumed++];
+            _position -= one;
+        }
+
+        auto fraction = static_cast<int64_t>(_position >> (FRACTION_BITS - 16));
+        auto lerp = [&](int32_t a, int32_t b) {
+            return static_cast<int16_t>(a + (((b - a) * fraction) >> 16));
+        };
+        output[produced++] = AudioFrame{lerp(_previous.left, _next.left), lerp(_previous.right, _next.right)};
+        _position += _step;
+    }
+    return produced;
+}
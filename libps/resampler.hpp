@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct AudioFrame {
+    int16_t left;
+    int16_t right;
+};
+
+// Linear interpolating stereo resampler. The ratio can be changed between
+// calls to make up for small drift between producer and consumer clocks.
+class Resampler {
+private:
+    static constexpr uint32_t FRACTION_BITS = 32;
+
+    uint64_t _step;
+    // Starts two frames ahead, so the first output frame is the first input frame
+    uint64_t _position = 2ull << FRACTION_BITS;
+    AudioFrame _previous = {0, 0};
+    AudioFrame _next = {0, 0};
+    double _baseRatio;
+    double _adjustment = 1.0;
+
+public:
+    Resampler(uint32_t inputRate, uint32_t outputRate);
+
+    // 1.0 = nominal rate, > 1.0 consumes input faster
+    void setAdjustment(double adjustment);
+    double adjustment() const { return _adjustment; }
+
+    // Produces up to outputCount frames. Returns the number of frames
+    // written, consumed is set to the number of input frames used.
+    size_t process(const AudioFrame *input, size_t inputCount, size_t &consumed, AudioFrame *output, size_t outputCount);
+};
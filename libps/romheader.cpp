@@ -0,0 +1,32 @@
+#include "romheader.hpp"
+
+#include <cstring>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace {
+uint32_t readWord(const ByteBuffer &data, uint32_t offset) {
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (static_cast<uint32_t>(data[offset + 3]) << 24);
+}
+} // namespace
+
+RomHeader RomHeader::parse(const ByteBuffer &data) {
+    if (data.size() < SIZE || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a PS-X EXE file");
+    }
+
+    RomHeader header;
+    header.pc = readWord(data, 0x10);
+    header.gp = readWord(data, 0x14);
+    header.textAddress = readWord(data, 0x18);
+    header.textSize = readWord(data, 0x1C);
+    header.bssAddress = readWord(data, 0x28);
+    header.bssSize = readWord(data, 0x2C);
+    header.stackAddress = readWord(data, 0x30);
+    header.stackSize = readWord(data, 0x34);
+
+    if (data.size() - SIZE < header.textSize) {
+        throw std::runtime_error(fmt::format("PS-X EXE text segment has {} bytes, the file only {}", header.textSize, data.size() - SIZE));
+    }
+    return header;
+}
@@ -1,6 +1,26 @@
+#pragma once
+
+#include "libutils/data.hpp"
+
 #include <cstdint>
 
+// Header of a PS-X EXE file. The text segment follows the 2 KiB header and is
+// copied to textAddress; the program starts at pc with gp set and, if stackAddress
+// is non zero, sp and fp pointing to stackAddress + stackSize.
 struct RomHeader
 {
+    static constexpr char MAGIC[8] = {'P', 'S', '-', 'X', ' ', 'E', 'X', 'E'};
+    static constexpr uint32_t SIZE = 0x800;
+
+    uint32_t pc;
+    uint32_t gp;
+    uint32_t textAddress;
+    uint32_t textSize;
+    uint32_t bssAddress;
+    uint32_t bssSize;
+    uint32_t stackAddress;
+    uint32_t stackSize;
 
-};
\ No newline at end of file
+    // Throws if the data is not a PS-X EXE or shorter than its text segment
+    static RomHeader parse(const ByteBuffer &data);
+};
@@ -0,0 +1,37 @@
+#include "run_ahead.hpp"
+
+RunAhead::RunAhead(Playstation *playstation, uint32_t frames)
+    : _playstation(playstation),
+      _frames(frames) {}
+
+bool RunAhead::runFrame(const PresentCallback &present) {
+    auto &ps = *_playstation;
+    if (!ps.runFrame()) {
+        return false;
+    }
+    if (_frames == 0 || ps.replay().active() || ps.executablePending()) {
+        if (present) {
+            present(ps);
+        }
+        return true;
+    }
+
+    ps.saveState(_state);
+    auto *sink = ps.audioSink();
+    ps.setAudioSink(nullptr);
+    auto *tty = ps.biosHle().ttyStream();
+    ps.biosHle().setTtyStream(nullptr);
+
+    auto completed = true;
+    for (uint32_t i = 0; i < _frames && completed; i++) {
+        completed = ps.runFrame();
+    }
+    if (completed && present) {
+        present(ps);
+    }
+
+    ps.loadState(_state);
+    ps.setAudioSink(sink);
+    ps.biosHle().setTtyStream(tty);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "playstation.hpp"
+
+#include <cstdint>
+#include <functional>
+
+// Hides frames of input latency by showing the frontend a frame from the future.
+// Every frame runs once for real with the current input and is saved; then the
+// machine runs the given number of frames further with the same input, the last
+// of them is presented and the save state is loaded again. Only the real frames
+// produce audio and TTY output. Run-ahead pauses while a replay is active or an
+// executable waits for the BIOS, neither is part of a save state.
+class RunAhead {
+private:
+    Playstation *_playstation;
+    uint32_t _frames;
+    SaveState _state;
+
+public:
+    // Called at the end of the frame the frontend should show
+    using PresentCallback = std::function<void(Playstation &playstation)>;
+
+    RunAhead(Playstation *playstation, uint32_t frames);
+
+    void setFrames(uint32_t frames) { _frames = frames; }
+    uint32_t frames() const { return _frames; }
+
+    // Runs the next frame, returns false if the CPU stopped for the debugger
+    bool runFrame(const PresentCallback &present);
+};
@@ -0,0 +1,53 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Scheduler::Scheduler() {
+    _cycles.fill(NEVER);
+}
+
+void Scheduler::setClock(std::function<uint64_t()> clock) {
+    _clock = std::move(clock);
+}
+
+void Scheduler::setCallback(Event event, Callback callback) {
+    _callbacks[static_cast<size_t>(event)] = std::move(callback);
+}
+
+void Scheduler::schedule(Event event, uint64_t cycle) {
+    _cycles[static_cast<size_t>(event)] = cycle;
+    _nextCycle = std::min(_nextCycle, cycle);
+}
+
+void Scheduler::cancel(Event event) {
+    _cycles[static_cast<size_t>(event)] = NEVER;
+    updateNextCycle();
+}
+
+void Scheduler::save(Snapshot &snapshot) const {
+    snapshot.cycles = _cycles;
+}
+
+void Scheduler::restore(const Snapshot &snapshot) {
+    _cycles = snapshot.cycles;
+    updateNextCycle();
+}
+
+void Scheduler::updateNextCycle() {
+    _nextCycle = *std::min_element(_cycles.begin(), _cycles.end());
+}
+
+void Scheduler::dispatch(uint64_t cycle) {
+    // Callbacks may schedule further events, which run too if they are already due
+    while (_nextCycle <= cycle) {
+        auto index = static_cast<size_t>(std::min_element(_cycles.begin(), _cycles.end()) - _cycles.begin());
+        auto due = _cycles[index];
+        _cycles[index] = NEVER;
+        updateNextCycle();
+
+        if (_callbacks[index]) {
+            _callbacks[index](due);
+        }
+    }
+}
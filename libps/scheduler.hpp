@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+// Device events at absolute CPU cycles. Every event has a fixed slot, so scheduling
+// never allocates and rescheduling an event replaces its previous time. Events are
+// dispatched between CPU slices, i.e. up to a slice later than their cycle.
+class Scheduler {
+public:
+    enum class Event : uint8_t {
+        SioTransfer,
+        SioAck,
+        MdecDecode,
+        Count
+    };
+
+    static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+    // Receives the cycle the event was scheduled for
+    using Callback = std::function<void(uint64_t cycle)>;
+
+private:
+    static constexpr size_t EVENT_COUNT = static_cast<size_t>(Event::Count);
+
+    std::array<uint64_t, EVENT_COUNT> _cycles;
+    std::array<Callback, EVENT_COUNT> _callbacks;
+    uint64_t _nextCycle = NEVER;
+    std::function<uint64_t()> _clock;
+
+    void updateNextCycle();
+
+public:
+    // Event times for a save state, the callbacks stay as they are
+    struct Snapshot {
+        std::array<uint64_t, EVENT_COUNT> cycles;
+    };
+
+    Scheduler();
+
+    // Source of the current cycle count, usually the CPU
+    void setClock(std::function<uint64_t()> clock);
+    uint64_t now() const { return _clock ? _clock() : 0; }
+
+    void setCallback(Event event, Callback callback);
+    void schedule(Event event, uint64_t cycle);
+    void scheduleIn(Event event, uint64_t cycles) { schedule(event, now() + cycles); }
+    void cancel(Event event);
+    bool scheduled(Event event) const { return _cycles[static_cast<size_t>(event)] != NEVER; }
+
+    uint64_t nextCycle() const { return _nextCycle; }
+
+    // Dispatches all events up to cycle in the order of their cycles
+    void run(uint64_t cycle) {
+        if (cycle >= _nextCycle) {
+            dispatch(cycle);
+        }
+    }
+    void dispatch(uint64_t cycle);
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+};
@@ -0,0 +1,100 @@
+#include "shared_snapshot.hpp"
+#include "bios.hpp"
+#include "ram.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+SharedSnapshot::SharedSnapshot(Playstation &playstation) {
+    if (playstation.executablePending()) {
+        throw std::runtime_error("Cannot share a Playstation while an executable waits for the BIOS");
+    }
+
+    playstation.saveState(_state);
+    // Both RAMs are mapped by the clones, loading the state keeps them
+    _state.memory.ram = {};
+    _state.spu.ram = {};
+
+    auto &memory = playstation.memory();
+    if (auto *ram = memory.ram(); ram && ram->data()) {
+        _ram.emplace(ram->data(), ram->size());
+    }
+    if (auto *bios = memory.bios(); bios && bios->data()) {
+        _bios.emplace(bios->data(), bios->size());
+    }
+    const auto &soundRam = playstation.spu().ram();
+    _soundRam.emplace(soundRam.data(), soundRam.size());
+    spdlog::debug("[snapshot] Shared {} bytes of RAM, {} bytes of sound RAM and {} bytes of BIOS",
+                  _ram ? _ram->size() : 0, _soundRam->size(), _bios ? _bios->size() : 0);
+}
+
+std::unique_ptr<Playstation> SharedSnapshot::clone() const {
+    auto playstation = std::make_unique<Playstation>();
+    playstation->initialize();
+    if (_ram) {
+        playstation->memory().setRam(std::make_unique<Ram>(_ram->mapPrivate()));
+    }
+    if (_bios) {
+        playstation->memory().setBios(std::make_unique<BIOS>(_bios->mapPrivate()));
+    }
+    playstation->spu().setRam(_soundRam->mapPrivate());
+    playstation->loadState(_state);
+    return playstation;
+}
+
+#ifdef _WIN32
+int SharedSnapshot::fork(const std::function<int(Playstation &playstation)> &) const {
+    throw std::runtime_error("Forking instances is not supported on this platform");
+}
+
+int SharedSnapshot::wait(int) {
+    throw std::runtime_error("Forking instances is not supported on this platform");
+}
+#else
+int SharedSnapshot::fork(const std::function<int(Playstation &playstation)> &job) const {
+    // Buffered output would be written by both processes otherwise
+    std::fflush(nullptr);
+    auto pid = ::fork();
+    if (pid < 0) {
+        throw std::runtime_error(fmt::format("fork failed: {}", std::strerror(errno)));
+    }
+    if (pid > 0) {
+        return pid;
+    }
+
+    auto code = FORK_JOB_FAILED;
+    try {
+        auto playstation = clone();
+        code = job(*playstation);
+    } catch (const std::exception &e) {
+        spdlog::error("[snapshot] Forked job failed: {}", e.what());
+    }
+    std::fflush(nullptr);
+    // Skips the destructors and atexit handlers of the parent's objects
+    _exit(code);
+}
+
+int SharedSnapshot::wait(int pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            throw std::runtime_error(fmt::format("waitpid for {} failed: {}", pid, std::strerror(errno)));
+        }
+    }
+    if (!WIFEXITED(status)) {
+        throw std::runtime_error(fmt::format("Forked instance {} did not exit normally", pid));
+    }
+    return WEXITSTATUS(status);
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "playstation.hpp"
+
+#include "libutils/mapped_memory.hpp"
+
+#include <functional>
+#include <memory>
+#include <optional>
+
+// Frozen state of a Playstation that many instances start from, e.g. right after
+// the BIOS booted. RAM, sound RAM and the BIOS image go to shared memory that clones
+// map copy-on-write, so a clone shares the pages of the snapshot and only owns the
+// ones it writes. The registers of the devices are copied from a save state.
+// A clone has the configuration of a new instance: the audio sink, TTY stream, HLE,
+// instruction cache and idle skipping are set up by the caller again, breakpoints,
+// replays and memory cards are not carried over.
+class SharedSnapshot {
+private:
+    SaveState _state;
+    std::optional<SharedMemory> _ram;
+    std::optional<SharedMemory> _bios;
+    std::optional<SharedMemory> _soundRam;
+
+public:
+    // Throws if an executable still waits for the BIOS, it is not part of a save state
+    explicit SharedSnapshot(Playstation &playstation);
+
+    // New instance in this process, ready to run from the snapshot
+    std::unique_ptr<Playstation> clone() const;
+
+    // Result of a job in a forked process that could not run
+    static constexpr int FORK_JOB_FAILED = 125;
+    // Runs job on a clone in a forked child process for isolation, the child exits
+    // with the returned code or FORK_JOB_FAILED if it threw. Parent and child share
+    // the snapshot pages. Only the forking thread exists in the child, so this must
+    // not be called while another thread of the process runs a Playstation. Returns
+    // the process id of the child for wait(). Not available on Windows.
+    int fork(const std::function<int(Playstation &playstation)> &job) const;
+    // Waits for a child started by fork(), returns its exit code
+    static int wait(int pid);
+};
@@ -0,0 +1,274 @@
+#include "sio.hpp"
+#include "interrupt_controller.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+constexpr uint32_t DATA_OFFSET = 0x0;
+constexpr uint32_t STATUS_OFFSET = 0x4;
+constexpr uint32_t MODE_OFFSET = 0x8;
+constexpr uint32_t CONTROL_OFFSET = 0xA;
+constexpr uint32_t BAUD_OFFSET = 0xE;
+
+constexpr uint32_t BITS_PER_TRANSFER = 8;
+
+namespace {
+// JOY_DATA and JOY_STAT are 32 bit wide, the registers after them 16 bit
+uint32_t registerOffset(uint32_t offset) {
+    return offset < MODE_OFFSET ? offset & ~3u : offset & ~1u;
+}
+} // namespace
+
+Sio::Sio(Scheduler *scheduler, InterruptController *interruptController, Replay *replay)
+    : _scheduler(scheduler),
+      _interruptController(interruptController) {
+    for (uint32_t port = 0; port < SIO_PORT_COUNT; port++) {
+        _controllers[port] = std::make_unique<Controller>(static_cast<uint8_t>(port), replay);
+    }
+
+    _scheduler->setCallback(Scheduler::Event::SioTransfer, [this](uint64_t cycle) { transferComplete(cycle); });
+    _scheduler->setCallback(Scheduler::Event::SioAck, [this](uint64_t) { ack(); });
+}
+
+void Sio::save(Snapshot &snapshot) const {
+    snapshot.mode = _mode;
+    snapshot.control = _control;
+    snapshot.baud = _baud;
+    snapshot.txData = _txData;
+    snapshot.transferring = _transferring;
+    snapshot.rxData = _rxData;
+    snapshot.rxNotEmpty = _rxNotEmpty;
+    snapshot.ackLevel = _ackLevel;
+    snapshot.interruptRequest = _interruptRequest;
+    snapshot.deviceAddress = 0;
+    if (_device && _device == _controllers[port()].get()) {
+        snapshot.deviceAddress = Controller::ADDRESS;
+    } else if (_device) {
+        snapshot.deviceAddress = MemoryCard::ADDRESS;
+    }
+    snapshot.addressed = _addressed;
+    for (uint32_t i = 0; i < SIO_PORT_COUNT; i++) {
+        _controllers[i]->save(snapshot.controllers[i]);
+        if (_memoryCards[i]) {
+            _memoryCards[i]->save(snapshot.memoryCards[i]);
+        } else {
+            snapshot.memoryCards[i].image.clear();
+        }
+    }
+}
+
+void Sio::restore(const Snapshot &snapshot) {
+    _mode = snapshot.mode;
+    _control = snapshot.control;
+    _baud = snapshot.baud;
+    _txData = snapshot.txData;
+    _transferring = snapshot.transferring;
+    _rxData = snapshot.rxData;
+    _rxNotEmpty = snapshot.rxNotEmpty;
+    _ackLevel = snapshot.ackLevel;
+    _interruptRequest = snapshot.interruptRequest;
+    _device = nullptr;
+    if (snapshot.deviceAddress == Controller::ADDRESS) {
+        _device = _controllers[port()].get();
+    } else if (snapshot.deviceAddress == MemoryCard::ADDRESS) {
+        _device = _memoryCards[port()].get();
+    }
+    _addressed = snapshot.addressed;
+    for (uint32_t i = 0; i < SIO_PORT_COUNT; i++) {
+        _controllers[i]->restore(snapshot.controllers[i]);
+        if (_memoryCards[i] && snapshot.memoryCards[i].image.size() == MEMORY_CARD_SIZE) {
+            _memoryCards[i]->restore(snapshot.memoryCards[i]);
+        }
+    }
+}
+
+void Sio::insertMemoryCard(uint32_t port, const std::string &path) {
+    insertMemoryCard(port, std::make_unique<MemoryCard>(path));
+}
+
+void Sio::insertMemoryCard(uint32_t port, std::unique_ptr<MemoryCard> card) {
+    _memoryCards[port] = std::move(card);
+}
+
+uint32_t Sio::transferCycles() const {
+    // Baudrate reload factor in the low MODE bits
+    static constexpr uint32_t FACTORS[] = {1, 1, 16, 64};
+    return std::max<uint32_t>(_baud, 1) * FACTORS[_mode & 3] * BITS_PER_TRANSFER;
+}
+
+void Sio::reset() {
+    deselect();
+    _mode = 0;
+    _control = 0;
+    _baud = 0;
+    _rxNotEmpty = false;
+    _interruptRequest = false;
+}
+
+void Sio::deselect() {
+    _scheduler->cancel(Scheduler::Event::SioTransfer);
+    _scheduler->cancel(Scheduler::Event::SioAck);
+    _transferring = false;
+    _ackLevel = false;
+    _device = nullptr;
+    _addressed = false;
+}
+
+void Sio::writeControl(uint16_t value) {
+    if (value & Reset) {
+        reset();
+        return;
+    }
+    if (value & Acknowledge) {
+        _interruptRequest = false;
+    }
+
+    auto wasSelected = (_control & Select) != 0;
+    auto previousPort = port();
+    _control = value & ~(Acknowledge | Reset);
+
+    auto selected = (_control & Select) != 0;
+    if (!selected || port() != previousPort) {
+        deselect();
+    }
+    if (selected && (!wasSelected || port() != previousPort)) {
+        _controllers[port()]->select();
+        if (_memoryCards[port()]) {
+            _memoryCards[port()]->select();
+        }
+    }
+}
+
+void Sio::startTransfer(uint8_t value) {
+    if (!(_control & TxEnable)) {
+        spdlog::debug("[sio] write {:#04x} with transmitter disabled", value);
+        return;
+    }
+
+    _txData = value;
+    _transferring = true;
+    _ackLevel = false;
+    _scheduler->cancel(Scheduler::Event::SioAck);
+    _scheduler->scheduleIn(Scheduler::Event::SioTransfer, transferCycles());
+}
+
+void Sio::transferComplete(uint64_t cycle) {
+    auto response = SioResponse{0xFF, false};
+    if (_control & Select) {
+        // The address byte decides which device of the port takes part
+        if (!_addressed) {
+            _addressed = true;
+            if (_txData == Controller::ADDRESS) {
+                _device = _controllers[port()].get();
+            } else if (_txData == MemoryCard::ADDRESS) {
+                _device = _memoryCards[port()].get();
+            }
+        }
+        if (_device) {
+            response = _device->transfer(_txData, cycle);
+            if (!response.ack) {
+                _device = nullptr;
+            }
+        }
+    }
+    spdlog::trace("[sio] port {} sent {:#04x} received {:#04x}{}", port(), _txData, response.value, response.ack ? " ack" : "");
+
+    _transferring = false;
+    _rxData = response.value;
+    _rxNotEmpty = true;
+    if (response.ack) {
+        _scheduler->schedule(Scheduler::Event::SioAck, cycle + ACK_DELAY_CYCLES);
+    }
+}
+
+void Sio::ack() {
+    _ackLevel = true;
+    if ((_control & AckInterruptEnable) && !_interruptRequest) {
+        _interruptRequest = true;
+        _interruptController->request(Interrupt::ControllerMemoryCard);
+    }
+}
+
+uint32_t Sio::readRegister(uint32_t offset) const {
+    switch (offset) {
+    case DATA_OFFSET: {
+        if (!_rxNotEmpty) {
+            return 0xFF;
+        }
+        _rxNotEmpty = false;
+        return _rxData;
+    }
+    case STATUS_OFFSET: {
+        uint32_t status = TxReady;
+        if (_rxNotEmpty) {
+            status |= RxNotEmpty;
+        }
+        if (!_transferring) {
+            status |= TxFinished;
+        }
+        if (_ackLevel) {
+            status |= AckLevel;
+        }
+        if (_interruptRequest) {
+            status |= InterruptRequest;
+        }
+        return status;
+    }
+    case MODE_OFFSET:
+        return _mode;
+    case CONTROL_OFFSET:
+        return _control;
+    case BAUD_OFFSET:
+        return _baud;
+    default:
+        spdlog::warn("[sio] read from unknown register {:#04x}", offset);
+        return 0;
+    }
+}
+
+void Sio::writeRegister(uint32_t offset, uint32_t value) {
+    switch (offset) {
+    case DATA_OFFSET:
+        startTransfer(static_cast<uint8_t>(value));
+        return;
+    case MODE_OFFSET:
+        _mode = static_cast<uint16_t>(value);
+        return;
+    case CONTROL_OFFSET:
+        writeControl(static_cast<uint16_t>(value));
+        return;
+    case BAUD_OFFSET:
+        _baud = static_cast<uint16_t>(value);
+        return;
+    default:
+        spdlog::warn("[sio] write {:#x} to unknown register {:#04x}", value, offset);
+        return;
+    }
+}
+
+uint32_t Sio::size() const {
+    return SIO_REGISTERS_SIZE;
+}
+
+uint8_t Sio::u8(uint32_t offset) const {
+    auto aligned = registerOffset(offset);
+    return static_cast<uint8_t>(readRegister(aligned) >> ((offset - aligned) * 8));
+}
+uint16_t Sio::u16(uint32_t offset) const {
+    auto aligned = registerOffset(offset);
+    return static_cast<uint16_t>(readRegister(aligned) >> ((offset - aligned) * 8));
+}
+uint32_t Sio::u32(uint32_t offset) const {
+    return readRegister(offset);
+}
+
+void Sio::u8Write(uint32_t offset, uint8_t value) {
+    writeRegister(offset, value);
+}
+void Sio::u16Write(uint32_t offset, uint16_t value) {
+    writeRegister(offset, value);
+}
+void Sio::u32Write(uint32_t offset, uint32_t value) {
+    writeRegister(offset, value);
+}
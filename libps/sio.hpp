@@ -0,0 +1,124 @@
+#pragma once
+
+#include "controller.hpp"
+#include "memory_card.hpp"
+#include "memory_region.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class InterruptController;
+class Replay;
+class Scheduler;
+
+// Offset of the joypad/memory card registers inside the hw register segment (0x1F801040)
+constexpr uint32_t SIO_REGISTERS_OFFSET = 0x040;
+constexpr uint32_t SIO_REGISTERS_SIZE = 0x10;
+constexpr uint32_t SIO_PORT_COUNT = 2;
+
+// Serial interface to the controller ports (SIO0). A byte written to JOY_DATA is
+// shifted out over baud * 8 cycles as a scheduler event; the reply of the selected
+// device is then available in JOY_DATA and an /ACK from the device raises IRQ7 a
+// little later, again as an event.
+class Sio
+    : public MemoryRegion {
+public:
+    enum Status : uint32_t {
+        TxReady = (1 << 0),
+        RxNotEmpty = (1 << 1),
+        TxFinished = (1 << 2),
+        AckLevel = (1 << 7),
+        InterruptRequest = (1 << 9)
+    };
+
+    enum Control : uint16_t {
+        TxEnable = (1 << 0),
+        Select = (1 << 1),
+        Acknowledge = (1 << 4),
+        Reset = (1 << 6),
+        AckInterruptEnable = (1 << 12),
+        PortSelect = (1 << 13)
+    };
+
+    // Delay between the end of a transfer and the /ACK pulse of the device
+    static constexpr uint32_t ACK_DELAY_CYCLES = 338;
+
+private:
+    Scheduler *_scheduler;
+    InterruptController *_interruptController;
+
+    std::array<std::unique_ptr<Controller>, SIO_PORT_COUNT> _controllers;
+    std::array<std::unique_ptr<MemoryCard>, SIO_PORT_COUNT> _memoryCards;
+
+    uint16_t _mode = 0;
+    uint16_t _control = 0;
+    uint16_t _baud = 0;
+
+    uint8_t _txData = 0;
+    bool _transferring = false;
+    // Reading JOY_DATA pops the receive buffer
+    mutable uint8_t _rxData = 0xFF;
+    mutable bool _rxNotEmpty = false;
+    bool _ackLevel = false;
+    bool _interruptRequest = false;
+
+    // Device which answered to the first byte since the port was selected
+    SioDevice *_device = nullptr;
+    bool _addressed = false;
+
+    uint32_t port() const { return (_control & PortSelect) ? 1 : 0; }
+    uint32_t transferCycles() const;
+    void reset();
+    void deselect();
+    void writeControl(uint16_t value);
+    void startTransfer(uint8_t value);
+    void transferComplete(uint64_t cycle);
+    void ack();
+
+    uint32_t readRegister(uint32_t offset) const;
+    void writeRegister(uint32_t offset, uint32_t value);
+
+public:
+    // Registers, transfer and device state for a save state. Cards that were not
+    // inserted when it was taken are left alone when it is restored.
+    struct Snapshot {
+        uint16_t mode;
+        uint16_t control;
+        uint16_t baud;
+        uint8_t txData;
+        bool transferring;
+        uint8_t rxData;
+        bool rxNotEmpty;
+        bool ackLevel;
+        bool interruptRequest;
+        // Address byte of the device in the transfer, zero for none
+        uint8_t deviceAddress;
+        bool addressed;
+        std::array<Controller::Snapshot, SIO_PORT_COUNT> controllers;
+        std::array<MemoryCard::Snapshot, SIO_PORT_COUNT> memoryCards;
+    };
+
+    // The replay may be null
+    Sio(Scheduler *scheduler, InterruptController *interruptController, Replay *replay);
+
+    Controller &controller(uint32_t port) { return *_controllers[port]; }
+    // Inserts a card backed by the image at path, a missing file is created
+    void insertMemoryCard(uint32_t port, const std::string &path);
+    void insertMemoryCard(uint32_t port, std::unique_ptr<MemoryCard> card);
+    MemoryCard *memoryCard(uint32_t port) { return _memoryCards[port].get(); }
+
+    void save(Snapshot &snapshot) const;
+    void restore(const Snapshot &snapshot);
+
+    virtual uint32_t size() const override;
+
+    virtual uint8_t u8(uint32_t offset) const override;
+    virtual uint16_t u16(uint32_t offset) const override;
+    virtual uint32_t u32(uint32_t offset) const override;
+
+    virtual void u8Write(uint32_t offset, uint8_t value) override;
+    virtual void u16Write(uint32_t offset, uint16_t value) override;
+    virtual void u32Write(uint32_t offset, uint32_t value) override;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+struct SioResponse {
+    uint8_t value;
+    // The device pulls /ACK when it wants to receive another byte
+    bool ack;
+};
+
+// Something plugged into a controller port. The first byte after the port is
+// selected addresses the device (0x01 controller, 0x81 memory card), the SIO only
+// forwards bytes to the device which answered to it.
+class SioDevice {
+public:
+    virtual ~SioDevice() = default;
+
+    // The port was selected, a new command starts with the next byte
+    virtual void select() = 0;
+    virtual SioResponse transfer(uint8_t value, uint64_t cycle) = 0;
+};
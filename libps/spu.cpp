@@ -0,0 +1,685 @@
+#include "spu.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+constexpr uint32_t SPU_RAM_MASK = SPU_RAM_SIZE - 1;
+constexpr uint32_t OUTPUT_BUFFER_FRAMES = 1024;
+constexpr uint32_t PITCH_COUNTER_BLOCK_END = SpuDsp::ADPCM_SAMPLES_PER_BLOCK << 12;
+
+// Register offsets, relative to 0x1F801C00
+constexpr uint32_t VOICE_REGISTERS_END = 0x180;
+constexpr uint32_t MAIN_VOLUME_LEFT = 0x180;
+constexpr uint32_t MAIN_VOLUME_RIGHT = 0x182;
+constexpr uint32_t REVERB_VOLUME_LEFT = 0x184;
+constexpr uint32_t REVERB_VOLUME_RIGHT = 0x186;
+constexpr uint32_t KEY_ON_LOW = 0x188;
+constexpr uint32_t KEY_ON_HIGH = 0x18A;
+constexpr uint32_t KEY_OFF_LOW = 0x18C;
+constexpr uint32_t KEY_OFF_HIGH = 0x18E;
+constexpr uint32_t PITCH_MODULATION_LOW = 0x190;
+constexpr uint32_t PITCH_MODULATION_HIGH = 0x192;
+constexpr uint32_t NOISE_ENABLE_LOW = 0x194;
+constexpr uint32_t NOISE_ENABLE_HIGH = 0x196;
+constexpr uint32_t REVERB_ENABLE_LOW = 0x198;
+constexpr uint32_t REVERB_ENABLE_HIGH = 0x19A;
+constexpr uint32_t ENDX_LOW = 0x19C;
+constexpr uint32_t ENDX_HIGH = 0x19E;
+constexpr uint32_t REVERB_BASE = 0x1A2;
+constexpr uint32_t IRQ_ADDRESS = 0x1A4;
+constexpr uint32_t TRANSFER_ADDRESS = 0x1A6;
+constexpr uint32_t TRANSFER_FIFO = 0x1A8;
+constexpr uint32_t CONTROL = 0x1AA;
+constexpr uint32_t STATUS = 0x1AE;
+constexpr uint32_t CURRENT_MAIN_VOLUME_LEFT = 0x1B8;
+constexpr uint32_t CURRENT_MAIN_VOLUME_RIGHT = 0x1BA;
+constexpr uint32_t REVERB_CONFIGURATION = 0x1C0;
+constexpr uint32_t REVERB_CONFIGURATION_END = 0x200;
+constexpr uint32_t CURRENT_VOICE_VOLUME = 0x200;
+constexpr uint32_t CURRENT_VOICE_VOLUME_END = 0x260;
+
+namespace ControlFlags {
+constexpr uint16_t IrqEnable = 1 << 6;
+constexpr uint16_t ReverbEnable = 1 << 7;
+constexpr uint16_t Unmute = 1 << 14;
+constexpr uint16_t Enable = 1 << 15;
+} // namespace ControlFlags
+
+namespace BlockFlags {
+constexpr uint8_t LoopEnd = 1 << 0;
+constexpr uint8_t LoopRepeat = 1 << 1;
+constexpr uint8_t LoopStart = 1 << 2;
+} // namespace BlockFlags
+
+// Indices into the reverb configuration registers
+enum ReverbRegister : uint32_t {
+    dAPF1,
+    dAPF2,
+    vIIR,
+    vCOMB1,
+    vCOMB2,
+    vCOMB3,
+    vCOMB4,
+    vWALL,
+    vAPF1,
+    vAPF2,
+    mLSAME,
+    mRSAME,
+    mLCOMB1,
+    mRCOMB1,
+    mLCOMB2,
+    mRCOMB2,
+    dLSAME,
+    dRSAME,
+    mLDIFF,
+    mRDIFF,
+    mLCOMB3,
+    mRCOMB3,
+    mLCOMB4,
+    mRCOMB4,
+    dLDIFF,
+    dRDIFF,
+    mLAPF1,
+    mRAPF1,
+    mLAPF2,
+    mRAPF2,
+    vLIN,
+    vRIN
+};
+
+int16_t clamp16(int32_t value) {
+    return static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+}
+
+int32_t mul15(int32_t a, int32_t b) {
+    return (a * b) >> 15;
+}
+} // namespace
+
+int16_t Envelope::tick(int16_t level, bool exponential, bool decrease, uint8_t shift, uint8_t step) {
+    if (counter > 0) {
+        counter--;
+        return level;
+    }
+
+    int32_t cycles = 1 << std::max(0, shift - 11);
+    int32_t delta = decrease ? (-8 + step) : (7 - step);
+    delta <<= std::max(0, 11 - shift);
+
+    if (exponential && !decrease && level > 0x6000) {
+        cycles *= 4;
+    }
+    if (exponential && decrease) {
+        delta = (delta * level) >> 15;
+    }
+
+    counter = cycles - 1;
+    return static_cast<int16_t>(std::clamp<int32_t>(level + delta, 0, 0x7FFF));
+}
+
+void VolumeSweep::write(uint16_t value) {
+    raw = value;
+    if (!(raw & 0x8000)) {
+        level = static_cast<int16_t>(raw << 1);
+    }
+}
+
+void VolumeSweep::tick() {
+    if (!(raw & 0x8000)) {
+        return;
+    }
+
+    bool exponential = raw & 0x4000;
+    bool decrease = raw & 0x2000;
+    bool negative = raw & 0x1000;
+    uint8_t shift = (raw >> 2) & 0x1F;
+    uint8_t step = raw & 0x03;
+
+    auto magnitude = static_cast<int16_t>(std::min(std::abs(static_cast<int32_t>(level)), 0x7FFF));
+    magnitude = envelope.tick(magnitude, exponential, decrease, shift, step);
+    level = negative ? static_cast<int16_t>(-magnitude) : magnitude;
+}
+
+Spu::Spu()
+    : _ram(SPU_RAM_SIZE) {
+    _outputBuffer.reserve(OUTPUT_BUFFER_FRAMES * 2);
+    spdlog::trace("Initialized SPU with {} bytes of sound RAM", _ram.size());
+}
+
+void Spu::setRam(MappedBuffer ram) {
+    if (ram.size() != SPU_RAM_SIZE) {
+        throw std::runtime_error(fmt::format("Sound RAM does not have the right size ({} vs {})", ram.size(), SPU_RAM_SIZE));
+    }
+    _ram = std::move(ram);
+}
+
+void Spu::setAudioSink(AudioSink *sink) {
+    flush();
+    _sink = sink;
+}
+
+void Spu::save(Snapshot &snapshot) const {
+    std::copy(std::begin(_voices), std::end(_voices), std::begin(snapshot.voices));
+    snapshot.ram.assign(_ram.data(), _ram.data() + _ram.size());
+    std::copy(std::begin(_registers), std::end(_registers), std::begin(snapshot.registers));
+    snapshot.mainVolumeLeft = _mainVolumeLeft;
+    snapshot.mainVolumeRight = _mainVolumeRight;
+    snapshot.control = _control;
+    snapshot.pitchModulation = _pitchModulation;
+    snapshot.noiseEnable = _noiseEnable;
+    snapshot.reverbEnable = _reverbEnable;
+    snapshot.endx = _endx;
+    snapshot.transferAddress = _transferAddress;
+    snapshot.irqAddress = _irqAddress;
+    snapshot.irqFlag = _irqFlag;
+    snapshot.noiseTimer = _noiseTimer;
+    snapshot.noiseLevel = _noiseLevel;
+    snapshot.reverbBase = _reverbBase;
+    snapshot.reverbCurrentAddress = _reverbCurrentAddress;
+    std::copy(std::begin(_reverbRegisters), std::end(_reverbRegisters), std::begin(snapshot.reverbRegisters));
+    snapshot.reverbLeft = _reverbLeft;
+    snapshot.reverbRight = _reverbRight;
+    snapshot.reverbOddSample = _reverbOddSample;
+    snapshot.lanes = _lanes;
+    snapshot.cycles = _cycles;
+}
+
+void Spu::restore(const Snapshot &snapshot) {
+    std::copy(std::begin(snapshot.voices), std::end(snapshot.voices), std::begin(_voices));
+    if (!snapshot.ram.empty()) {
+        if (snapshot.ram.size() != _ram.size()) {
+            throw std::runtime_error(fmt::format("Save state does not match sound RAM of {} bytes", _ram.size()));
+        }
+        std::memcpy(_ram.data(), snapshot.ram.data(), snapshot.ram.size());
+    }
+    std::copy(std::begin(snapshot.registers), std::end(snapshot.registers), std::begin(_registers));
+    _mainVolumeLeft = snapshot.mainVolumeLeft;
+    _mainVolumeRight = snapshot.mainVolumeRight;
+    _control = snapshot.control;
+    _pitchModulation = snapshot.pitchModulation;
+    _noiseEnable = snapshot.noiseEnable;
+    _reverbEnable = snapshot.reverbEnable;
+    _endx = snapshot.endx;
+    _transferAddress = snapshot.transferAddress;
+    _irqAddress = snapshot.irqAddress;
+    _irqFlag = snapshot.irqFlag;
+    _noiseTimer = snapshot.noiseTimer;
+    _noiseLevel = snapshot.noiseLevel;
+    _reverbBase = snapshot.reverbBase;
+    _reverbCurrentAddress = snapshot.reverbCurrentAddress;
+    std::copy(std::begin(snapshot.reverbRegisters), std::end(snapshot.reverbRegisters), std::begin(_reverbRegisters));
+    _reverbLeft = snapshot.reverbLeft;
+    _reverbRight = snapshot.reverbRight;
+    _reverbOddSample = snapshot.reverbOddSample;
+    _lanes = snapshot.lanes;
+    _cycles = snapshot.cycles;
+    _outputBuffer.clear();
+}
+
+uint32_t Spu::size() const {
+    return SPU_REGISTERS_SIZE;
+}
+
+uint16_t Spu::readRegister(uint32_t offset) const {
+    if (offset < VOICE_REGISTERS_END) {
+        auto &voice = _voices[offset >> 4];
+        if ((offset & 0xF) == 0xC) {
+            return static_cast<uint16_t>(voice.adsrLevel);
+        }
+        return _registers[offset / 2];
+    }
+
+    if (offset >= CURRENT_VOICE_VOLUME && offset < CURRENT_VOICE_VOLUME_END) {
+        auto &voice = _voices[(offset - CURRENT_VOICE_VOLUME) / 4];
+        auto &sweep = (offset & 2) ? voice.volumeRight : voice.volumeLeft;
+        return static_cast<uint16_t>(sweep.level);
+    }
+
+    switch (offset) {
+    case ENDX_LOW:
+        return _endx & 0xFFFF;
+    case ENDX_HIGH:
+        return static_cast<uint16_t>(_endx >> 16);
+    case STATUS: {
+        uint16_t status = _control & 0x3F;
+        status |= _irqFlag ? (1 << 6) : 0;
+        // DMA request mirrors the transfer mode
+        status |= (_control & 0x20) << 2;
+        return status;
+    }
+    case CURRENT_MAIN_VOLUME_LEFT:
+        return static_cast<uint16_t>(_mainVolumeLeft.level);
+    case CURRENT_MAIN_VOLUME_RIGHT:
+        return static_cast<uint16_t>(_mainVolumeRight.level);
+    default:
+        return _registers[offset / 2];
+    }
+}
+
+void Spu::writeVoiceRegister(uint32_t index, uint32_t offset, uint16_t value) {
+    auto &voice = _voices[index];
+    switch (offset) {
+    case 0x0:
+        voice.volumeLeft.write(value);
+        return;
+    case 0x2:
+        voice.volumeRight.write(value);
+        return;
+    case 0x4:
+        voice.pitch = value;
+        return;
+    case 0x6:
+        voice.startAddress = value;
+        return;
+    case 0x8:
+        voice.adsr = (voice.adsr & 0xFFFF0000) | value;
+        return;
+    case 0xA:
+        voice.adsr = (voice.adsr & 0x0000FFFF) | (static_cast<uint32_t>(value) << 16);
+        return;
+    case 0xC:
+        voice.adsrLevel = static_cast<int16_t>(value);
+        return;
+    case 0xE:
+        voice.repeatAddress = value;
+        return;
+    }
+}
+
+void Spu::writeRegister(uint32_t offset, uint16_t value) {
+    spdlog::trace("[spu] write {:#06x} = {:#06x}", offset, value);
+    _registers[offset / 2] = value;
+
+    if (offset < VOICE_REGISTERS_END) {
+        writeVoiceRegister(offset >> 4, offset & 0xF, value);
+        return;
+    }
+
+    if (offset >= REVERB_CONFIGURATION && offset < REVERB_CONFIGURATION_END) {
+        _reverbRegisters[(offset - REVERB_CONFIGURATION) / 2] = value;
+        return;
+    }
+
+    auto setLow = [](uint32_t &target, uint16_t value) { target = (target & 0xFFFF0000) | value; };
+    auto setHigh = [](uint32_t &target, uint16_t value) { target = (target & 0x0000FFFF) | ((value & 0xFF) << 16); };
+
+    switch (offset) {
+    case MAIN_VOLUME_LEFT:
+        _mainVolumeLeft.write(value);
+        return;
+    case MAIN_VOLUME_RIGHT:
+        _mainVolumeRight.write(value);
+        return;
+    case KEY_ON_LOW:
+        keyOn(value);
+        return;
+    case KEY_ON_HIGH:
+        keyOn(static_cast<uint32_t>(value & 0xFF) << 16);
+        return;
+    case KEY_OFF_LOW:
+        keyOff(value);
+        return;
+    case KEY_OFF_HIGH:
+        keyOff(static_cast<uint32_t>(value & 0xFF) << 16);
+        return;
+    case PITCH_MODULATION_LOW:
+        setLow(_pitchModulation, value);
+        return;
+    case PITCH_MODULATION_HIGH:
+        setHigh(_pitchModulation, value);
+        return;
+    case NOISE_ENABLE_LOW:
+        setLow(_noiseEnable, value);
+        return;
+    case NOISE_ENABLE_HIGH:
+        setHigh(_noiseEnable, value);
+        return;
+    case REVERB_ENABLE_LOW:
+        setLow(_reverbEnable, value);
+        return;
+    case REVERB_ENABLE_HIGH:
+        setHigh(_reverbEnable, value);
+        return;
+    case REVERB_BASE:
+        _reverbBase = (value * 8) & SPU_RAM_MASK;
+        _reverbCurrentAddress = _reverbBase;
+        return;
+    case IRQ_ADDRESS:
+        _irqAddress = (value * 8) & SPU_RAM_MASK;
+        return;
+    case TRANSFER_ADDRESS:
+        _transferAddress = (value * 8) & SPU_RAM_MASK;
+        return;
+    case TRANSFER_FIFO:
+        checkIrq(_transferAddress, 2);
+        std::memcpy(_ram.data() + _transferAddress, &value, sizeof(value));
+        _transferAddress = (_transferAddress + 2) & SPU_RAM_MASK;
+        return;
+    case CONTROL:
+        _control = value;
+        if (!(_control & ControlFlags::IrqEnable)) {
+            _irqFlag = false;
+        }
+        return;
+    }
+}
+
+uint8_t Spu::u8(uint32_t offset) const {
+    auto value = readRegister(offset & ~1u);
+    return static_cast<uint8_t>((offset & 1) ? value >> 8 : value);
+}
+uint16_t Spu::u16(uint32_t offset) const {
+    return readRegister(offset & ~1u);
+}
+uint32_t Spu::u32(uint32_t offset) const {
+    return readRegister(offset) | (static_cast<uint32_t>(readRegister(offset + 2)) << 16);
+}
+
+void Spu::u8Write(uint32_t offset, uint8_t value) {
+    auto aligned = offset & ~1u;
+    auto current = _registers[aligned / 2];
+    auto merged = (offset & 1) ? (current & 0x00FF) | (value << 8) : (current & 0xFF00) | value;
+    writeRegister(aligned, static_cast<uint16_t>(merged));
+}
+void Spu::u16Write(uint32_t offset, uint16_t value) {
+    writeRegister(offset & ~1u, value);
+}
+void Spu::u32Write(uint32_t offset, uint32_t value) {
+    writeRegister(offset, value & 0xFFFF);
+    writeRegister(offset + 2, static_cast<uint16_t>(value >> 16));
+}
+
+void Spu::keyOn(uint32_t voices) {
+    for (uint32_t i = 0; i < SPU_VOICE_COUNT; i++) {
+        if (!(voices & (1 << i))) {
+            continue;
+        }
+
+        spdlog::trace("[spu] key on voice {}", i);
+        auto &voice = _voices[i];
+        voice.currentAddress = (voice.startAddress * 8) & SPU_RAM_MASK;
+        voice.pitchCounter = 0;
+        voice.history = {};
+        std::fill(std::begin(voice.samples), std::end(voice.samples), 0);
+        voice.adsrPhase = AdsrPhase::Attack;
+        voice.adsrLevel = 0;
+        voice.adsrEnvelope = {};
+        _endx &= ~(1 << i);
+
+        decodeBlock(voice);
+    }
+}
+
+void Spu::keyOff(uint32_t voices) {
+    for (uint32_t i = 0; i < SPU_VOICE_COUNT; i++) {
+        if ((voices & (1 << i)) && _voices[i].adsrPhase != AdsrPhase::Off) {
+            spdlog::trace("[spu] key off voice {}", i);
+            _voices[i].adsrPhase = AdsrPhase::Release;
+            _voices[i].adsrEnvelope = {};
+        }
+    }
+}
+
+void Spu::checkIrq(uint32_t address, uint32_t size) {
+    if (!(_control & ControlFlags::IrqEnable)) {
+        return;
+    }
+    if (_irqAddress >= address && _irqAddress < address + size) {
+        spdlog::trace("[spu] irq at address {:#07x}", _irqAddress);
+        _irqFlag = true;
+    }
+}
+
+void Spu::decodeBlock(Voice &voice) {
+    constexpr auto history = 3;
+    std::copy(std::end(voice.samples) - history, std::end(voice.samples), std::begin(voice.samples));
+
+    auto block = _ram.data() + voice.currentAddress;
+    SpuDsp::decodeAdpcmBlock(block, voice.samples + history, voice.history);
+
+    voice.blockFlags = block[1];
+    if (voice.blockFlags & BlockFlags::LoopStart) {
+        voice.repeatAddress = static_cast<uint16_t>(voice.currentAddress / 8);
+    }
+    checkIrq(voice.currentAddress, SpuDsp::ADPCM_BLOCK_SIZE);
+}
+
+void Spu::advanceVoice(uint32_t index, int16_t previousOutput) {
+    auto &voice = _voices[index];
+
+    uint32_t step = voice.pitch;
+    if (index > 0 && (_pitchModulation & (1 << index))) {
+        int32_t factor = previousOutput + 0x8000;
+        step = static_cast<uint32_t>((static_cast<int16_t>(voice.pitch) * factor) >> 15) & 0xFFFF;
+    }
+    voice.pitchCounter += std::min<uint32_t>(step, 0x4000);
+
+    if (voice.pitchCounter < PITCH_COUNTER_BLOCK_END) {
+        return;
+    }
+    voice.pitchCounter -= PITCH_COUNTER_BLOCK_END;
+
+    if (voice.blockFlags & BlockFlags::LoopEnd) {
+        _endx |= 1 << index;
+        voice.currentAddress = (voice.repeatAddress * 8) & SPU_RAM_MASK;
+        if (!(voice.blockFlags & BlockFlags::LoopRepeat)) {
+            voice.adsrPhase = AdsrPhase::Off;
+            voice.adsrLevel = 0;
+        }
+    } else {
+        voice.currentAddress = (voice.currentAddress + SpuDsp::ADPCM_BLOCK_SIZE) & SPU_RAM_MASK;
+    }
+
+    decodeBlock(voice);
+}
+
+int16_t Spu::tickAdsr(Voice &voice) {
+    auto adsr = voice.adsr;
+    auto &level = voice.adsrLevel;
+
+    switch (voice.adsrPhase) {
+    case AdsrPhase::Off:
+        return 0;
+
+    case AdsrPhase::Attack:
+        level = voice.adsrEnvelope.tick(level, adsr & 0x8000, false, (adsr >> 10) & 0x1F, (adsr >> 8) & 0x03);
+        if (level == 0x7FFF) {
+            voice.adsrPhase = AdsrPhase::Decay;
+            voice.adsrEnvelope = {};
+        }
+        break;
+
+    case AdsrPhase::Decay: {
+        int32_t sustainLevel = ((adsr & 0x0F) + 1) * 0x800;
+        level = voice.adsrEnvelope.tick(level, true, true, (adsr >> 4) & 0x0F, 0);
+        if (level <= sustainLevel) {
+            voice.adsrPhase = AdsrPhase::Sustain;
+            voice.adsrEnvelope = {};
+        }
+        break;
+    }
+
+    case AdsrPhase::Sustain:
+        level = voice.adsrEnvelope.tick(level, adsr & 0x80000000, adsr & 0x40000000, (adsr >> 24) & 0x1F, (adsr >> 22) & 0x03);
+        break;
+
+    case AdsrPhase::Release:
+        level = voice.adsrEnvelope.tick(level, adsr & 0x200000, true, (adsr >> 16) & 0x1F, 0);
+        if (level == 0) {
+            voice.adsrPhase = AdsrPhase::Off;
+        }
+        break;
+    }
+
+    return level;
+}
+
+void Spu::tickNoise() {
+    auto step = 4 + ((_control >> 8) & 0x03);
+    auto shift = (_control >> 10) & 0x0F;
+
+    _noiseTimer -= step;
+    if (_noiseTimer >= 0) {
+        return;
+    }
+
+    auto level = static_cast<uint16_t>(_noiseLevel);
+    auto parity = ((level >> 15) ^ (level >> 12) ^ (level >> 11) ^ (level >> 10) ^ 1) & 1;
+    _noiseLevel = static_cast<int16_t>((level << 1) | parity);
+
+    _noiseTimer += 0x20000 >> shift;
+    if (_noiseTimer < 0) {
+        _noiseTimer += 0x20000 >> shift;
+    }
+}
+
+int16_t Spu::reverbRead(uint32_t reg, int32_t extra) {
+    auto size = static_cast<int32_t>(SPU_RAM_SIZE - _reverbBase);
+    auto relative = static_cast<int32_t>(_reverbCurrentAddress - _reverbBase) + _reverbRegisters[reg] * 8 + extra;
+    relative = ((relative % size) + size) % size;
+
+    int16_t value;
+    std::memcpy(&value, _ram.data() + ((_reverbBase + relative) & (SPU_RAM_MASK & ~1u)), sizeof(value));
+    return value;
+}
+
+void Spu::reverbWrite(uint32_t reg, int32_t value) {
+    auto size = static_cast<int32_t>(SPU_RAM_SIZE - _reverbBase);
+    auto relative = static_cast<int32_t>(_reverbCurrentAddress - _reverbBase) + _reverbRegisters[reg] * 8;
+    relative %= size;
+
+    auto sample = clamp16(value);
+    std::memcpy(_ram.data() + ((_reverbBase + relative) & (SPU_RAM_MASK & ~1u)), &sample, sizeof(sample));
+}
+
+// See "SPU Reverb Formula" in the nocash psx specs. Runs at 22050 Hz.
+void Spu::processReverb(int32_t inputLeft, int32_t inputRight) {
+    auto v = [&](ReverbRegister reg) -> int32_t { return static_cast<int16_t>(_reverbRegisters[reg]); };
+    auto r = [&](ReverbRegister reg, int32_t extra = 0) -> int32_t { return reverbRead(reg, extra); };
+
+    auto leftIn = mul15(clamp16(inputLeft), v(vLIN));
+    auto rightIn = mul15(clamp16(inputRight), v(vRIN));
+
+    if (_control & ControlFlags::ReverbEnable) {
+        reverbWrite(mLSAME, mul15(leftIn + mul15(r(dLSAME), v(vWALL)) - r(mLSAME, -2), v(vIIR)) + r(mLSAME, -2));
+        reverbWrite(mRSAME, mul15(rightIn + mul15(r(dRSAME), v(vWALL)) - r(mRSAME, -2), v(vIIR)) + r(mRSAME, -2));
+        reverbWrite(mLDIFF, mul15(leftIn + mul15(r(dRDIFF), v(vWALL)) - r(mLDIFF, -2), v(vIIR)) + r(mLDIFF, -2));
+        reverbWrite(mRDIFF, mul15(rightIn + mul15(r(dLDIFF), v(vWALL)) - r(mRDIFF, -2), v(vIIR)) + r(mRDIFF, -2));
+    }
+
+    int32_t leftOut = mul15(v(vCOMB1), r(mLCOMB1)) + mul15(v(vCOMB2), r(mLCOMB2)) + mul15(v(vCOMB3), r(mLCOMB3)) + mul15(v(vCOMB4), r(mLCOMB4));
+    int32_t rightOut = mul15(v(vCOMB1), r(mRCOMB1)) + mul15(v(vCOMB2), r(mRCOMB2)) + mul15(v(vCOMB3), r(mRCOMB3)) + mul15(v(vCOMB4), r(mRCOMB4));
+
+    auto allPass = [&](int32_t sample, ReverbRegister target, ReverbRegister delay, ReverbRegister volume) {
+        auto delayed = r(target, -static_cast<int32_t>(_reverbRegisters[delay]) * 8);
+        sample = clamp16(sample - mul15(v(volume), delayed));
+        if (_control & ControlFlags::ReverbEnable) {
+            reverbWrite(target, sample);
+        }
+        return mul15(sample, v(volume)) + delayed;
+    };
+
+    leftOut = allPass(leftOut, mLAPF1, dAPF1, vAPF1);
+    rightOut = allPass(rightOut, mRAPF1, dAPF1, vAPF1);
+    leftOut = allPass(leftOut, mLAPF2, dAPF2, vAPF2);
+    rightOut = allPass(rightOut, mRAPF2, dAPF2, vAPF2);
+
+    _reverbLeft = clamp16(mul15(clamp16(leftOut), static_cast<int16_t>(_registers[REVERB_VOLUME_LEFT / 2])));
+    _reverbRight = clamp16(mul15(clamp16(rightOut), static_cast<int16_t>(_registers[REVERB_VOLUME_RIGHT / 2])));
+
+    _reverbCurrentAddress = std::max(_reverbBase, (_reverbCurrentAddress + 2) & (SPU_RAM_MASK & ~1u));
+}
+
+void Spu::generateSample() {
+    auto gauss = SpuDsp::gaussTable();
+
+    for (uint32_t i = 0; i < SPU_VOICE_COUNT; i++) {
+        auto &voice = _voices[i];
+        if (voice.adsrPhase == AdsrPhase::Off) {
+            for (int tap = 0; tap < 4; tap++) {
+                _lanes.gauss[tap][i] = 0;
+            }
+            _lanes.envelope[i] = 0;
+            continue;
+        }
+
+        auto index = voice.pitchCounter >> 12;
+        auto fraction = (voice.pitchCounter >> 4) & 0xFF;
+        _lanes.gauss[0][i] = gauss[0x0FF - fraction];
+        _lanes.gauss[1][i] = gauss[0x1FF - fraction];
+        _lanes.gauss[2][i] = gauss[0x100 + fraction];
+        _lanes.gauss[3][i] = gauss[0x000 + fraction];
+        for (int tap = 0; tap < 4; tap++) {
+            _lanes.samples[tap][i] = voice.samples[index + tap];
+        }
+
+        _lanes.envelope[i] = tickAdsr(voice);
+        voice.volumeLeft.tick();
+        voice.volumeRight.tick();
+        _lanes.volumeLeft[i] = voice.volumeLeft.level;
+        _lanes.volumeRight[i] = voice.volumeRight.level;
+        _lanes.reverbMask[i] = (_reverbEnable & (1 << i)) ? -1 : 0;
+    }
+
+    SpuDsp::interpolate(_lanes);
+
+    if (_noiseEnable) {
+        for (uint32_t i = 0; i < SPU_VOICE_COUNT; i++) {
+            if (_noiseEnable & (1 << i)) {
+                _lanes.interpolated[i] = _noiseLevel;
+            }
+        }
+    }
+
+    auto mixed = SpuDsp::mix(_lanes);
+
+    for (uint32_t i = 0; i < SPU_VOICE_COUNT; i++) {
+        if (_voices[i].adsrPhase != AdsrPhase::Off) {
+            advanceVoice(i, i > 0 ? _lanes.output[i - 1] : 0);
+        }
+    }
+    tickNoise();
+
+    if (_reverbOddSample) {
+        processReverb(mixed.reverbLeft, mixed.reverbRight);
+    }
+    _reverbOddSample = !_reverbOddSample;
+
+    _mainVolumeLeft.tick();
+    _mainVolumeRight.tick();
+
+    int16_t left = 0;
+    int16_t right = 0;
+    if ((_control & ControlFlags::Enable) && (_control & ControlFlags::Unmute)) {
+        left = clamp16(mul15(clamp16(mixed.left + _reverbLeft), _mainVolumeLeft.level));
+        right = clamp16(mul15(clamp16(mixed.right + _reverbRight), _mainVolumeRight.level));
+    }
+
+    _outputBuffer.push_back(left);
+    _outputBuffer.push_back(right);
+    if (_outputBuffer.size() >= OUTPUT_BUFFER_FRAMES * 2) {
+        flush();
+    }
+}
+
+void Spu::tick(uint32_t cycles) {
+    _cycles += cycles;
+    while (_cycles >= SPU_CYCLES_PER_SAMPLE) {
+        _cycles -= SPU_CYCLES_PER_SAMPLE;
+        generateSample();
+    }
+}
+
+void Spu::flush() {
+    if (_sink && !_outputBuffer.empty()) {
+        _sink->write(_outputBuffer.data(), _outputBuffer.size() / 2);
+    }
+    _outputBuffer.clear();
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "audio_sink.hpp"
+#include "memory_region.hpp"
+#include "spu_dsp.hpp"
+
+#include "libutils/data.hpp"
+#include "libutils/mapped_memory.hpp"
+
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t SPU_VOICE_COUNT = 24;
+constexpr uint32_t SPU_RAM_SIZE = 512 * 1024;
+constexpr uint32_t SPU_SAMPLE_RATE = 44100;
+// 33.8688 MHz CPU clock / 44100 Hz
+constexpr uint32_t SPU_CYCLES_PER_SAMPLE = 768;
+
+// Offset of the SPU registers inside the hw register segment (0x1F801C00)
+constexpr uint32_t SPU_REGISTERS_OFFSET = 0xC00;
+constexpr uint32_t SPU_REGISTERS_SIZE = 0x400;
+
+// Shared by the ADSR envelope and the volume sweeps.
+struct Envelope {
+    int32_t counter = 0;
+
+    int16_t tick(int16_t level, bool exponential, bool decrease, uint8_t shift, uint8_t step);
+};
+
+struct VolumeSweep {
+    uint16_t raw = 0;
+    int16_t level = 0;
+    Envelope envelope;
+
+    void write(uint16_t value);
+    void tick();
+};
+
+class Spu
+    : public MemoryRegion {
+public:
+    enum class AdsrPhase : uint8_t {
+        Off,
+        Attack,
+        Decay,
+        Sustain,
+        Release
+    };
+
+private:
+    struct Voice {
+        VolumeSweep volumeLeft;
+        VolumeSweep volumeRight;
+        uint16_t pitch = 0;
+        uint16_t startAddress = 0;
+        uint32_t adsr = 0;
+        uint16_t repeatAddress = 0;
+
+        uint32_t currentAddress = 0;
+        uint32_t pitchCounter = 0;
+        uint8_t blockFlags = 0;
+        SpuDsp::AdpcmHistory history;
+        // Last three samples of the previous block followed by the current block
+        int16_t samples[3 + SpuDsp::ADPCM_SAMPLES_PER_BLOCK] = {};
+
+        AdsrPhase adsrPhase = AdsrPhase::Off;
+        int16_t adsrLevel = 0;
+        Envelope adsrEnvelope;
+    };
+
+public:
+    // Emulation state for a save state, the audio output is not part of it.
+    // Restoring one with an empty RAM buffer keeps sound RAM, see SharedSnapshot.
+    struct Snapshot {
+        Voice voices[SPU_VOICE_COUNT];
+        ByteBuffer ram;
+        uint16_t registers[SPU_REGISTERS_SIZE / 2];
+        VolumeSweep mainVolumeLeft;
+        VolumeSweep mainVolumeRight;
+        uint16_t control;
+        uint32_t pitchModulation;
+        uint32_t noiseEnable;
+        uint32_t reverbEnable;
+        uint32_t endx;
+        uint32_t transferAddress;
+        uint32_t irqAddress;
+        bool irqFlag;
+        int32_t noiseTimer;
+        int16_t noiseLevel;
+        uint32_t reverbBase;
+        uint32_t reverbCurrentAddress;
+        uint16_t reverbRegisters[32];
+        int16_t reverbLeft;
+        int16_t reverbRight;
+        bool reverbOddSample;
+        SpuDsp::VoiceLanes lanes;
+        uint32_t cycles;
+    };
+
+private:
+    Voice _voices[SPU_VOICE_COUNT];
+    MappedBuffer _ram;
+
+    // Raw register values for read back
+    uint16_t _registers[SPU_REGISTERS_SIZE / 2] = {};
+
+    VolumeSweep _mainVolumeLeft;
+    VolumeSweep _mainVolumeRight;
+    uint16_t _control = 0;
+    uint32_t _pitchModulation = 0;
+    uint32_t _noiseEnable = 0;
+    uint32_t _reverbEnable = 0;
+    uint32_t _endx = 0;
+    uint32_t _transferAddress = 0;
+    uint32_t _irqAddress = 0;
+    bool _irqFlag = false;
+
+    int32_t _noiseTimer = 0;
+    int16_t _noiseLevel = 1;
+
+    uint32_t _reverbBase = 0;
+    uint32_t _reverbCurrentAddress = 0;
+    uint16_t _reverbRegisters[32] = {};
+    int16_t _reverbLeft = 0;
+    int16_t _reverbRight = 0;
+    bool _reverbOddSample = false;
+
+    SpuDsp::VoiceLanes _lanes = {};
+    uint32_t _cycles = 0;
+
+    AudioSink *_sink = nullptr;
+    std::vector<int16_t> _outputBuffer;
+
+    uint16_t readRegister(uint32_t offset) const;
+    void writeRegister(uint32_t offset, uint16_t value);
+    void writeVoiceRegister(uint32_t voice, uint32_t offset, uint16_t value);
+
+    void keyOn(uint32_t voices);
+    void keyOff(uint32_t voices);
+
+    void decodeBlock(Voice &voice);
+    void advanceVoice(uint32_t index, int16_t previousOutput);
+    int16_t tickAdsr(Voice &voice);
+    void tickNoise();
+    void checkIrq(uint32_t address, uint32_t size);
+
+    int16_t reverbRead(uint32_t offset, int32_t extra = 0);
+    void reverbWrite(uint32_t offset, int32_t value);
+    void processReverb(int32_t inputLeft, int32_t inputRight);
+
+    void generateSample();
+
+public:
+    Spu();
+
+    // Samples not written yet go to the previous sink
+    void setAudioSink(AudioSink *sink);
+    AudioSink *audioSink() const { return _sink; }
+    void tick(uint32_t cycles);
+    void flush();
+
+    AdsrPhase adsrPhase(uint32_t voice) const { return _voices[voice].adsrPhase; }
+    const MappedBuffer &ram() const { return _ram; }
+    // Replaces sound RAM, e.g. with a copy-on-write view of a SharedMemory image
+    void setRam(MappedBuffer ram);
+
+    void save(Snapshot &snapshot) const;
+    // Drops samples that were not written to the sink yet
+    void restore(const Snapshot &snapshot);
+
+    virtual uint32_t size() const override;
+
+    virtual uint8_t u8(uint32_t offset) const override;
+    virtual uint16_t u16(uint32_t offset) const override;
+    virtual uint32_t u32(uint32_t offset) const override;
+
+    virtual void u8Write(uint32_t offset, uint8_t value) override;
+    virtual void u16Write(uint32_t offset, uint16_t value) override;
+    virtual void u32Write(uint32_t offset, uint32_t value) override;
+};
@@ -0,0 +1,311 @@
+#include "spu_dsp.hpp"
+#include "libutils/simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+constexpr int32_t ADPCM_FILTER_POSITIVE[5] = {0, 60, 115, 98, 122};
+constexpr int32_t ADPCM_FILTER_NEGATIVE[5] = {0, 0, -52, -55, -60};
+
+int16_t clamp16(int32_t value) {
+    return static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+}
+
+struct AdpcmHeader {
+    uint8_t shift;
+    uint8_t filter;
+};
+
+AdpcmHeader decodeHeader(const uint8_t *block) {
+    uint8_t shift = block[0] & 0x0F;
+    uint8_t filter = std::min<uint8_t>((block[0] >> 4) & 0x07, 4);
+    // Shift values 13..15 are reserved and behave like 9.
+    if (shift > 12) {
+        shift = 9;
+    }
+    return {shift, filter};
+}
+
+void applyAdpcmFilter(const int16_t *nibbles, int16_t *out, AdpcmHeader header, SpuDsp::AdpcmHistory &history) {
+    auto f0 = ADPCM_FILTER_POSITIVE[header.filter];
+    auto f1 = ADPCM_FILTER_NEGATIVE[header.filter];
+
+    int32_t old = history.old;
+    int32_t older = history.older;
+    for (uint32_t i = 0; i < SpuDsp::ADPCM_SAMPLES_PER_BLOCK; i++) {
+        int32_t sample = nibbles[i] + ((old * f0 + older * f1 + 32) >> 6);
+        out[i] = clamp16(sample);
+        older = old;
+        old = out[i];
+    }
+    history.old = static_cast<int16_t>(old);
+    history.older = static_cast<int16_t>(older);
+}
+
+// The hardware uses a dumped 512 entry table. We compute a gaussian kernel
+// of the same shape at compile time instead, so results are reproducible on
+// every host.
+constexpr double constexprExp(double x) {
+    int halvings = 0;
+    while (x < -0.5) {
+        x /= 2;
+        halvings++;
+    }
+
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= x / n;
+        sum += term;
+    }
+
+    for (int i = 0; i < halvings; i++) {
+        sum *= sum;
+    }
+    return sum;
+}
+
+constexpr std::array<int16_t, 512> createGaussTable() {
+    constexpr double sigma = 0.6;
+    constexpr double unity = 0x7F00;
+
+    std::array<double, 512> raw = {};
+    for (int n = 0; n < 512; n++) {
+        double distance = (511.5 - n) / 256.0;
+        raw[n] = constexprExp(-(distance * distance) / (2 * sigma * sigma));
+    }
+
+    // Normalize every group of weights used together, so the interpolation has unity gain.
+    std::array<int16_t, 512> table = {};
+    for (int i = 0; i < 128; i++) {
+        int group[4] = {i, 0xFF - i, 0x100 + i, 0x1FF - i};
+        double sum = 0;
+        for (auto n : group) {
+            sum += raw[n];
+        }
+        for (auto n : group) {
+            table[n] = static_cast<int16_t>(raw[n] * unity / sum + 0.5);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<int16_t, 512> GAUSS_TABLE = createGaussTable();
+
+#ifdef PS_SIMD_SSE2
+// Full 32 bit products of int16 lanes, shifted right by 15
+inline void mulShift15(__m128i a, __m128i b, __m128i &low, __m128i &high) {
+    auto lo = _mm_mullo_epi16(a, b);
+    auto hi = _mm_mulhi_epi16(a, b);
+    low = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+    high = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+}
+
+inline __m128i loadLanes(const int16_t *data) {
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+inline int32_t horizontalSum(__m128i value) {
+    value = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+    value = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(value);
+}
+#endif
+
+#ifdef PS_SIMD_AVX2
+inline void mulShift15(__m256i a, __m256i b, __m256i &low, __m256i &high) {
+    auto lo = _mm256_mullo_epi16(a, b);
+    auto hi = _mm256_mulhi_epi16(a, b);
+    low = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 15);
+    high = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 15);
+}
+
+inline __m256i loadLanes256(const int16_t *data) {
+    return _mm256_load_si256(reinterpret_cast<const __m256i *>(data));
+}
+
+inline int32_t horizontalSum(__m256i value) {
+    auto sum = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+    return horizontalSum(sum);
+}
+#endif
+} // namespace
+
+namespace SpuDsp {
+
+const int16_t *gaussTable() {
+    return GAUSS_TABLE.data();
+}
+
+void decodeAdpcmBlockScalar(const uint8_t *block, int16_t *out, AdpcmHistory &history) {
+    auto header = decodeHeader(block);
+
+    int16_t nibbles[ADPCM_SAMPLES_PER_BLOCK];
+    for (uint32_t i = 0; i < ADPCM_SAMPLES_PER_BLOCK; i++) {
+        auto byte = block[2 + i / 2];
+        auto nibble = (i % 2 == 0) ? (byte & 0x0F) : (byte >> 4);
+        nibbles[i] = static_cast<int16_t>(static_cast<int16_t>(nibble << 12) >> header.shift);
+    }
+
+    applyAdpcmFilter(nibbles, out, header, history);
+}
+
+void decodeAdpcmBlock(const uint8_t *block, int16_t *out, AdpcmHistory &history) {
+#ifdef PS_SIMD_SSE2
+    auto header = decodeHeader(block);
+
+    // 14 data bytes, padded to a full vector
+    alignas(16) uint8_t data[16] = {};
+    std::memcpy(data, block + 2, 14);
+
+    auto bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(data));
+    auto zero = _mm_setzero_si128();
+    auto lowMask = _mm_set1_epi16(0x000F);
+    auto highMask = _mm_set1_epi16(0x00F0);
+    auto shift = _mm_cvtsi32_si128(header.shift);
+
+    alignas(16) int16_t nibbles[32];
+    auto expand = [&](__m128i words, int16_t *target) {
+        // Low nibble comes first, both end up in the top bits of a 16 bit lane
+        auto low = _mm_slli_epi16(_mm_and_si128(words, lowMask), 12);
+        auto high = _mm_slli_epi16(_mm_and_si128(words, highMask), 8);
+        auto first = _mm_sra_epi16(_mm_unpacklo_epi16(low, high), shift);
+        auto second = _mm_sra_epi16(_mm_unpackhi_epi16(low, high), shift);
+        _mm_store_si128(reinterpret_cast<__m128i *>(target), first);
+        _mm_store_si128(reinterpret_cast<__m128i *>(target + 8), second);
+    };
+    expand(_mm_unpacklo_epi8(bytes, zero), nibbles);
+    expand(_mm_unpackhi_epi8(bytes, zero), nibbles + 16);
+
+    // The prediction filter is recursive, so it stays scalar.
+    applyAdpcmFilter(nibbles, out, header, history);
+#else
+    decodeAdpcmBlockScalar(block, out, history);
+#endif
+}
+
+void interpolateScalar(VoiceLanes &lanes) {
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane++) {
+        int32_t sum = 0;
+        for (int tap = 0; tap < 4; tap++) {
+            sum += (lanes.gauss[tap][lane] * lanes.samples[tap][lane]) >> 15;
+        }
+        lanes.interpolated[lane] = clamp16(sum);
+    }
+}
+
+void interpolate(VoiceLanes &lanes) {
+#if defined(PS_SIMD_AVX2)
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane += 16) {
+        auto sumLow = _mm256_setzero_si256();
+        auto sumHigh = _mm256_setzero_si256();
+        for (int tap = 0; tap < 4; tap++) {
+            __m256i low, high;
+            mulShift15(loadLanes256(&lanes.gauss[tap][lane]), loadLanes256(&lanes.samples[tap][lane]), low, high);
+            sumLow = _mm256_add_epi32(sumLow, low);
+            sumHigh = _mm256_add_epi32(sumHigh, high);
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i *>(&lanes.interpolated[lane]), _mm256_packs_epi32(sumLow, sumHigh));
+    }
+#elif defined(PS_SIMD_SSE2)
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane += 8) {
+        auto sumLow = _mm_setzero_si128();
+        auto sumHigh = _mm_setzero_si128();
+        for (int tap = 0; tap < 4; tap++) {
+            __m128i low, high;
+            mulShift15(loadLanes(&lanes.gauss[tap][lane]), loadLanes(&lanes.samples[tap][lane]), low, high);
+            sumLow = _mm_add_epi32(sumLow, low);
+            sumHigh = _mm_add_epi32(sumHigh, high);
+        }
+        _mm_store_si128(reinterpret_cast<__m128i *>(&lanes.interpolated[lane]), _mm_packs_epi32(sumLow, sumHigh));
+    }
+#else
+    interpolateScalar(lanes);
+#endif
+}
+
+MixResult mixScalar(VoiceLanes &lanes) {
+    MixResult result;
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane++) {
+        auto sample = static_cast<int16_t>((lanes.interpolated[lane] * lanes.envelope[lane]) >> 15);
+        lanes.output[lane] = sample;
+
+        auto left = (sample * lanes.volumeLeft[lane]) >> 15;
+        auto right = (sample * lanes.volumeRight[lane]) >> 15;
+        result.left += left;
+        result.right += right;
+
+        auto reverbSample = static_cast<int16_t>(sample & lanes.reverbMask[lane]);
+        result.reverbLeft += (reverbSample * lanes.volumeLeft[lane]) >> 15;
+        result.reverbRight += (reverbSample * lanes.volumeRight[lane]) >> 15;
+    }
+    return result;
+}
+
+MixResult mix(VoiceLanes &lanes) {
+#if defined(PS_SIMD_AVX2)
+    auto left = _mm256_setzero_si256();
+    auto right = _mm256_setzero_si256();
+    auto reverbLeft = _mm256_setzero_si256();
+    auto reverbRight = _mm256_setzero_si256();
+
+    auto accumulate = [](__m256i &sum, __m256i a, __m256i b) {
+        __m256i low, high;
+        mulShift15(a, b, low, high);
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(low, high));
+    };
+
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane += 16) {
+        __m256i low, high;
+        mulShift15(loadLanes256(&lanes.interpolated[lane]), loadLanes256(&lanes.envelope[lane]), low, high);
+        auto sample = _mm256_packs_epi32(low, high);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(&lanes.output[lane]), sample);
+
+        auto volumeLeft = loadLanes256(&lanes.volumeLeft[lane]);
+        auto volumeRight = loadLanes256(&lanes.volumeRight[lane]);
+        auto reverbSample = _mm256_and_si256(sample, loadLanes256(&lanes.reverbMask[lane]));
+
+        accumulate(left, sample, volumeLeft);
+        accumulate(right, sample, volumeRight);
+        accumulate(reverbLeft, reverbSample, volumeLeft);
+        accumulate(reverbRight, reverbSample, volumeRight);
+    }
+
+    return MixResult{horizontalSum(left), horizontalSum(right), horizontalSum(reverbLeft), horizontalSum(reverbRight)};
+#elif defined(PS_SIMD_SSE2)
+    auto left = _mm_setzero_si128();
+    auto right = _mm_setzero_si128();
+    auto reverbLeft = _mm_setzero_si128();
+    auto reverbRight = _mm_setzero_si128();
+
+    auto accumulate = [](__m128i &sum, __m128i a, __m128i b) {
+        __m128i low, high;
+        mulShift15(a, b, low, high);
+        sum = _mm_add_epi32(sum, _mm_add_epi32(low, high));
+    };
+
+    for (uint32_t lane = 0; lane < VOICE_LANES; lane += 8) {
+        __m128i low, high;
+        mulShift15(loadLanes(&lanes.interpolated[lane]), loadLanes(&lanes.envelope[lane]), low, high);
+        auto sample = _mm_packs_epi32(low, high);
+        _mm_store_si128(reinterpret_cast<__m128i *>(&lanes.output[lane]), sample);
+
+        auto volumeLeft = loadLanes(&lanes.volumeLeft[lane]);
+        auto volumeRight = loadLanes(&lanes.volumeRight[lane]);
+        auto reverbSample = _mm_and_si128(sample, loadLanes(&lanes.reverbMask[lane]));
+
+        accumulate(left, sample, volumeLeft);
+        accumulate(right, sample, volumeRight);
+        accumulate(reverbLeft, reverbSample, volumeLeft);
+        accumulate(reverbRight, reverbSample, volumeRight);
+    }
+
+    return MixResult{horizontalSum(left), horizontalSum(right), horizontalSum(reverbLeft), horizontalSum(reverbRight)};
+#else
+    return mixScalar(lanes);
+#endif
+}
+
+} // namespace SpuDsp
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Sample processing kernels of the SPU. Every kernel has a scalar reference
+// implementation and is vectorized with SSE2 / AVX2 when available. Both
+// produce bit identical results.
+namespace SpuDsp {
+
+constexpr uint32_t ADPCM_BLOCK_SIZE = 16;
+constexpr uint32_t ADPCM_SAMPLES_PER_BLOCK = 28;
+
+// 24 voices padded to a multiple of the widest vector (16 lanes of int16 with AVX2).
+constexpr uint32_t VOICE_LANES = 32;
+
+struct AdpcmHistory {
+    int16_t old = 0;
+    int16_t older = 0;
+};
+
+void decodeAdpcmBlock(const uint8_t *block, int16_t *out, AdpcmHistory &history);
+void decodeAdpcmBlockScalar(const uint8_t *block, int16_t *out, AdpcmHistory &history);
+
+// 512 entry interpolation table, indexed like the hardware table.
+const int16_t *gaussTable();
+
+// Structure of arrays with one lane per voice. Unused lanes must be zero.
+struct VoiceLanes {
+    // Interpolation weights and samples, oldest sample first
+    alignas(32) int16_t gauss[4][VOICE_LANES];
+    alignas(32) int16_t samples[4][VOICE_LANES];
+
+    alignas(32) int16_t interpolated[VOICE_LANES];
+    alignas(32) int16_t envelope[VOICE_LANES];
+    alignas(32) int16_t volumeLeft[VOICE_LANES];
+    alignas(32) int16_t volumeRight[VOICE_LANES];
+    // -1 for voices which feed the reverb unit, 0 otherwise
+    alignas(32) int16_t reverbMask[VOICE_LANES];
+
+    // Voice samples after applying the envelope (used for pitch modulation)
+    alignas(32) int16_t output[VOICE_LANES];
+};
+
+struct MixResult {
+    int32_t left = 0;
+    int32_t right = 0;
+    int32_t reverbLeft = 0;
+    int32_t reverbRight = 0;
+};
+
+// samples x gauss -> interpolated
+void interpolate(VoiceLanes &lanes);
+void interpolateScalar(VoiceLanes &lanes);
+
+// interpolated x envelope -> output, output x volume summed over all voices
+MixResult mix(VoiceLanes &lanes);
+MixResult mixScalar(VoiceLanes &lanes);
+
+} // namespace SpuDsp
@@ -0,0 +1,92 @@
+#include "symbol_map.hpp"
+#include "libutils/file.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace {
+std::string_view nextToken(std::string_view &line) {
+    auto begin = line.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+
+    auto end = line.find_first_of(" \t", begin);
+    auto token = line.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+    line = end == std::string_view::npos ? std::string_view() : line.substr(end);
+    return token;
+}
+
+std::optional<uint32_t> parseAddress(std::string_view token) {
+    if (token.starts_with("0x") || token.starts_with("0X")) {
+        token.remove_prefix(2);
+    }
+    if (token.size() != 8) {
+        return {};
+    }
+
+    uint32_t address = 0;
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), address, 16);
+    if (error != std::errc() || end != token.data() + token.size()) {
+        return {};
+    }
+    return address;
+}
+
+bool isIdentifier(std::string_view token) {
+    if (token.empty() || std::isdigit(static_cast<unsigned char>(token[0]))) {
+        return false;
+    }
+    return std::all_of(token.begin(), token.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+    });
+}
+} // namespace
+
+void SymbolMap::load(const std::string &path) {
+    auto file = File(path);
+    if (!file.exists()) {
+        throw std::runtime_error(fmt::format("Symbol file {} does not exist", path));
+    }
+
+    auto data = file.readAll();
+    parse(std::string_view(reinterpret_cast<const char *>(data.data()), data.size()));
+    spdlog::debug("Loaded {} symbols from {}", _symbols.size(), path);
+}
+
+void SymbolMap::parse(std::string_view text) {
+    while (!text.empty()) {
+        auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        auto address = parseAddress(nextToken(line));
+        auto name = nextToken(line);
+        if (!address || !isIdentifier(name)) {
+            continue;
+        }
+        _symbols.push_back(Symbol{*address, std::string(name)});
+    }
+
+    std::stable_sort(_symbols.begin(), _symbols.end(), [](const Symbol &a, const Symbol &b) {
+        return a.address < b.address;
+    });
+}
+
+const Symbol *SymbolMap::lookup(uint32_t address) const {
+    auto it = std::upper_bound(_symbols.begin(), _symbols.end(), address, [](uint32_t value, const Symbol &symbol) {
+        return value < symbol.address;
+    });
+    if (it == _symbols.begin()) {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
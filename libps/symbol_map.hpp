@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Symbol {
+    uint32_t address;
+    std::string name;
+};
+
+// Guest symbols from a map file. Every line starting with an address followed by a
+// name is used ("80010000 main"), which covers psyq map files and no$psx .sym files.
+class SymbolMap {
+private:
+    // Sorted by address
+    std::vector<Symbol> _symbols;
+
+public:
+    void load(const std::string &path);
+    void parse(std::string_view text);
+
+    size_t size() const { return _symbols.size(); }
+
+    // Closest symbol at or below the address
+    const Symbol *lookup(uint32_t address) const;
+};
@@ -0,0 +1,65 @@
+#include "timing.hpp"
+
+#include <algorithm>
+
+namespace Timing {
+
+AccessTimes calculateAccessTimes(uint32_t delaySize, uint32_t commonDelay) {
+    auto accessTime = static_cast<int32_t>((delaySize >> 4) & 0xF);
+    auto useCom0 = (delaySize & (1 << 8)) != 0;
+    auto useCom2 = (delaySize & (1 << 10)) != 0;
+    auto useCom3 = (delaySize & (1 << 11)) != 0;
+    auto dataBus16Bit = (delaySize & (1 << 12)) != 0;
+
+    auto com0 = static_cast<int32_t>(commonDelay & 0xF);
+    auto com2 = static_cast<int32_t>((commonDelay >> 8) & 0xF);
+    auto com3 = static_cast<int32_t>((commonDelay >> 12) & 0xF);
+
+    int32_t first = 0;
+    int32_t sequential = 0;
+    int32_t minimum = 0;
+    if (useCom0) {
+        first += com0 - 1;
+        sequential += com0 - 1;
+    }
+    if (useCom2) {
+        first += com2;
+        sequential += com2;
+    }
+    if (useCom3) {
+        minimum = com3;
+    }
+    if (first < 6) {
+        first++;
+    }
+
+    first = std::max(first + accessTime + 2, minimum + 6);
+    sequential = std::max(sequential + accessTime + 2, minimum + 2);
+
+    // An 8 bit bus needs one sequential access per additional byte
+    auto halfword = dataBus16Bit ? first : first + sequential;
+    auto word = dataBus16Bit ? first + sequential : first + sequential * 3;
+
+    // The cycle of the instruction itself is already accounted for
+    AccessTimes times;
+    times.byte = static_cast<uint32_t>(std::max(first - 1, 0));
+    times.halfword = static_cast<uint32_t>(std::max(halfword - 1, 0));
+    times.word = static_cast<uint32_t>(std::max(word - 1, 0));
+    return times;
+}
+
+uint32_t multiplyCycles(uint32_t rs, bool isSigned) {
+    if (isSigned && static_cast<int32_t>(rs) < 0) {
+        rs = ~rs;
+    }
+
+    if (rs < 0x800) {
+        return 6;
+    }
+    if (rs < 0x100000) {
+        return 9;
+    }
+    return 13;
+}
+
+}; // namespace Timing
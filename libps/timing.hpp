@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU cycle costs. Memory access times of the external regions follow the
+// nocash psx specs, the remaining values are averages measured on hardware.
+namespace Timing {
+
+constexpr uint32_t CPU_CLOCK = 33868800;
+
+// Video frame at 60 Hz. There is no GPU yet, so frames are this many cycles long.
+constexpr uint32_t FRAME_CYCLES = CPU_CLOCK / 60;
+
+// Every instruction takes one cycle when its operands are ready
+constexpr uint32_t INSTRUCTION_CYCLES = 1;
+
+// Loads from main RAM stall the pipeline, stores are absorbed by the write buffer
+constexpr uint32_t RAM_READ_CYCLES = 5;
+// Registers of devices without a delay register of their own
+constexpr uint32_t IO_READ_CYCLES = 2;
+
+constexpr uint32_t DIVIDE_CYCLES = 36;
+
+struct AccessTimes {
+    uint32_t byte = 0;
+    uint32_t halfword = 0;
+    uint32_t word = 0;
+
+    template <typename T>
+    uint32_t forSize() const {
+        if constexpr (sizeof(T) == 1) {
+            return byte;
+        } else if constexpr (sizeof(T) == 2) {
+            return halfword;
+        } else {
+            return word;
+        }
+    }
+};
+
+// Access times of a region configured through its delay/size register (0x1F801008..0x1F80101C)
+// and the common delay register (0x1F801020).
+AccessTimes calculateAccessTimes(uint32_t delaySize, uint32_t commonDelay);
+
+// The multiplier finishes early when the upper bits of rs are all zeros (or ones for signed values).
+uint32_t multiplyCycles(uint32_t rs, bool isSigned);
+
+}; // namespace Timing
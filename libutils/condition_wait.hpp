@@ -0,0 +1,14 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Blocks on condition until predicate holds, with no timeout. GCC 12 exports the
+// untimed std::condition_variable::wait() as a GLIBCXX_3.4.30 symbol, which older
+// runtimes such as the one the tests run against do not have. A deadline that
+// never comes goes through the inline wait_until() instead and sleeps just as long.
+template <typename Predicate>
+void conditionWait(std::condition_variable &condition, std::unique_lock<std::mutex> &lock, Predicate predicate) {
+    condition.wait_until(lock, std::chrono::steady_clock::time_point::max(), predicate);
+}
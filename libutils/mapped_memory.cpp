@@ -0,0 +1,249 @@
+#include "mapped_memory.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace {
+MappingPolicy mappingPolicy;
+
+[[noreturn]] void throwSystemError(const char *what, size_t size) {
+    throw std::runtime_error(fmt::format("{} of {} bytes failed: {}", what, size, std::strerror(errno)));
+}
+
+#ifndef _WIN32
+// Places and locks a fresh mapping as the policy asks, before anything touched it
+void applyPolicy(void *data, size_t size) {
+#ifdef __linux__
+    if (mappingPolicy.numaNode >= 0) {
+        // mbind() without libnuma, MPOL_PREFERRED falls back to other nodes
+        // instead of failing when the node runs out of memory
+        constexpr int MPOL_PREFERRED = 1;
+        constexpr unsigned long NODE_MASK_BITS = 8 * sizeof(unsigned long);
+        if (static_cast<unsigned long>(mappingPolicy.numaNode) >= NODE_MASK_BITS) {
+            throw std::runtime_error(fmt::format("NUMA node {} is out of range", mappingPolicy.numaNode));
+        }
+        auto nodeMask = 1UL << mappingPolicy.numaNode;
+        if (syscall(SYS_mbind, data, size, MPOL_PREFERRED, &nodeMask, NODE_MASK_BITS, 0) != 0) {
+            throwSystemError("NUMA binding", size);
+        }
+    }
+#endif
+    if (mappingPolicy.locked && mlock(data, size) != 0) {
+        throwSystemError("Locking", size);
+    }
+}
+#endif
+} // namespace
+
+void MappedBuffer::setPolicy(const MappingPolicy &policy) {
+    mappingPolicy = policy;
+}
+
+const MappingPolicy &MappedBuffer::policy() {
+    return mappingPolicy;
+}
+
+MappedBuffer::MappedBuffer(uint8_t *data, size_t size)
+    : _data(data), _size(size), _mapped(size) {
+}
+
+MappedBuffer::MappedBuffer(size_t size, [[maybe_unused]] bool usePolicy)
+    : _size(size) {
+    if (size == 0) {
+        return;
+    }
+#ifdef _WIN32
+    _data = new uint8_t[size]();
+#else
+    _mapped = size;
+#ifdef MADV_HUGEPAGE
+    if (usePolicy && mappingPolicy.hugePages) {
+        _mapped = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        // Over-allocates by one huge page to find an aligned start, the kernel
+        // only uses huge pages for aligned ranges
+        auto reserved = _mapped + HUGE_PAGE_SIZE;
+        auto *area = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED) {
+            throwSystemError("Anonymous mapping", reserved);
+        }
+        auto start = reinterpret_cast<uintptr_t>(area);
+        auto aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (aligned != start) {
+            munmap(area, aligned - start);
+        }
+        munmap(reinterpret_cast<void *>(aligned + _mapped), start + reserved - (aligned + _mapped));
+        _data = reinterpret_cast<uint8_t *>(aligned);
+        // Only advice, kernels without transparent huge pages keep small ones
+        madvise(_data, _mapped, MADV_HUGEPAGE);
+    }
+#endif
+    if (!_data) {
+        auto *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            throwSystemError("Anonymous mapping", size);
+        }
+        _data = static_cast<uint8_t *>(data);
+    }
+    try {
+        if (usePolicy) {
+            applyPolicy(_data, _mapped);
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+#endif
+}
+
+MappedBuffer::~MappedBuffer() {
+    release();
+}
+
+MappedBuffer::MappedBuffer(MappedBuffer &&other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)),
+      _mapped(std::exchange(other._mapped, 0)) {
+}
+
+MappedBuffer &MappedBuffer::operator=(MappedBuffer &&other) noexcept {
+    if (this != &other) {
+        release();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _mapped = std::exchange(other._mapped, 0);
+    }
+    return *this;
+}
+
+void MappedBuffer::release() {
+    if (!_data) {
+        return;
+    }
+#ifdef _WIN32
+    delete[] _data;
+#else
+    munmap(_data, _mapped);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _mapped = 0;
+}
+
+#ifdef __linux__
+SharedMemory::SharedMemory(const uint8_t *data, size_t size)
+    : _size(size) {
+    _fd = memfd_create("ps-shared-memory", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (_fd < 0) {
+        throwSystemError("memfd_create", size);
+    }
+    auto fail = [this, size](const char *what) {
+        auto error = errno;
+        close(_fd);
+        errno = error;
+        throwSystemError(what, size);
+    };
+    if (ftruncate(_fd, static_cast<off_t>(size)) != 0) {
+        fail("ftruncate");
+    }
+    auto *image = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (image == MAP_FAILED) {
+        fail("Shared mapping");
+    }
+    std::memcpy(image, data, size);
+    munmap(image, size);
+    // Nobody can change the image behind the back of its mappings
+    if (fcntl(_fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        fail("Sealing");
+    }
+}
+
+SharedMemory::~SharedMemory() {
+    close(_fd);
+}
+
+MappedBuffer SharedMemory::mapPrivate() const {
+    auto *data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+    if (data == MAP_FAILED) {
+        throwSystemError("Private mapping", _size);
+    }
+    auto buffer = MappedBuffer(static_cast<uint8_t *>(data), _size);
+    applyPolicy(data, _size);
+    return buffer;
+}
+#else
+SharedMemory::SharedMemory(const uint8_t *data, size_t size)
+    : _size(size), _image(size) {
+    std::memcpy(_image.data(), data, size);
+}
+
+SharedMemory::~SharedMemory() = default;
+
+MappedBuffer SharedMemory::mapPrivate() const {
+    auto buffer = MappedBuffer(_size);
+    std::memcpy(buffer.data(), _image.data(), _size);
+    return buffer;
+}
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path) {
+    auto stream = std::ifstream(path, std::ios::binary | std::ios::ate);
+    if (!stream) {
+        throw std::runtime_error(fmt::format("Error opening {}", path));
+    }
+    _size = static_cast<size_t>(stream.tellg());
+    _copy = MappedBuffer(_size);
+    stream.seekg(0, std::ios::beg);
+    if (_size && !stream.read(reinterpret_cast<char *>(_copy.data()), static_cast<std::streamsize>(_size))) {
+        throw std::runtime_error(fmt::format("Error reading {}", path));
+    }
+    _data = _copy.data();
+}
+
+MappedFile::~MappedFile() = default;
+#else
+MappedFile::MappedFile(const std::string &path) {
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("Error opening {}: {}", path, std::strerror(errno)));
+    }
+    struct stat status = {};
+    if (fstat(fd, &status) != 0) {
+        auto error = errno;
+        close(fd);
+        throw std::runtime_error(fmt::format("Error reading {}: {}", path, std::strerror(error)));
+    }
+    _size = static_cast<size_t>(status.st_size);
+    if (_size) {
+        auto *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        auto error = errno;
+        close(fd);
+        if (data == MAP_FAILED) {
+            errno = error;
+            throwSystemError("File mapping", _size);
+        }
+        _data = static_cast<const uint8_t *>(data);
+    } else {
+        close(fd);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (_data) {
+        munmap(const_cast<uint8_t *>(_data), _size);
+    }
+}
+#endif
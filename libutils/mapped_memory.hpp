@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class SharedMemory;
+
+// How the OS backs mapped buffers, see MappedBuffer::setPolicy(). Only Linux
+// honors all of it, elsewhere buffers are plain allocations.
+struct MappingPolicy {
+    // Transparent huge pages for anonymous buffers, which are aligned to and
+    // rounded up to HUGE_PAGE_SIZE. Guest memory is accessed all over the place,
+    // so one TLB entry per 2 MiB instead of per 4 KiB saves a lot of misses.
+    bool hugePages = false;
+    // Keeps the pages resident, they are backed right away then
+    bool locked = false;
+    // Binds the pages to a NUMA node, -1 leaves them to the node of the thread
+    // that first touches them
+    int numaNode = -1;
+};
+
+// Zero filled memory straight from the OS. Pages are only backed once they are
+// touched, so a large buffer that is mostly unused costs little.
+class MappedBuffer {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+private:
+    uint8_t *_data = nullptr;
+    size_t _size = 0;
+    // Length of the mapping, larger than _size when it is made of huge pages
+    size_t _mapped = 0;
+
+    friend class SharedMemory;
+    MappedBuffer(uint8_t *data, size_t size);
+    void release();
+
+public:
+    MappedBuffer() = default;
+    // Throws when the memory cannot be mapped or locked. The policy is meant for
+    // guest memory, host side tables pass usePolicy = false and stay lazily backed.
+    explicit MappedBuffer(size_t size, bool usePolicy = true);
+    ~MappedBuffer();
+
+    MappedBuffer(const MappedBuffer &) = delete;
+    MappedBuffer &operator=(const MappedBuffer &) = delete;
+    MappedBuffer(MappedBuffer &&other) noexcept;
+    MappedBuffer &operator=(MappedBuffer &&other) noexcept;
+
+    uint8_t *data() { return _data; }
+    const uint8_t *data() const { return _data; }
+    size_t size() const { return _size; }
+
+    // Applies to buffers mapped afterwards, including views of a SharedMemory.
+    // Set once at startup, before the emulator allocates its memory.
+    static void setPolicy(const MappingPolicy &policy);
+    static const MappingPolicy &policy();
+};
+
+// Read only image in a sealed memfd. Private mappings of it share its pages until
+// they are written, each written page is copied for that mapping only. Forked
+// processes share the pages as well. Where memfd is not available every mapping
+// is a full copy.
+class SharedMemory {
+private:
+    size_t _size;
+#ifdef __linux__
+    int _fd = -1;
+#else
+    MappedBuffer _image;
+#endif
+
+public:
+    SharedMemory(const uint8_t *data, size_t size);
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    size_t size() const { return _size; }
+    // Writable copy-on-write view of the image
+    MappedBuffer mapPrivate() const;
+};
+
+// Read only view of a whole file. It is mapped where the platform allows, so
+// processes opening the same file share its pages, and read into memory elsewhere.
+class MappedFile {
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    MappedBuffer _copy;
+#endif
+
+public:
+    // Throws when the file cannot be read
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const { return _data; }
+    size_t size() const { return _size; }
+};
@@ -5,5 +5,9 @@
 void platform::debuggerBreak() {
     __debugbreak();
 }
+#else
+#include <csignal>
+void platform::debuggerBreak() {
+    std::raise(SIGTRAP);
+}
 #endif
-
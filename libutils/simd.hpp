@@ -0,0 +1,13 @@
+#pragma once
+
+// Compile time SIMD capability detection.
+// MSVC does not define __SSE2__, but SSE2 is always available on x64.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PS_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define PS_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Lock free ring buffer for exactly one producer and one consumer thread.
+// Neither side ever blocks: push() and pop() transfer as many elements as
+// currently fit / are available and return the count.
+template <typename T>
+class SpscRingBuffer {
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    std::vector<T> _data;
+    size_t _mask;
+
+    // Producer and consumer indices live on separate cache lines, so the two
+    // threads do not invalidate each other's lines on every access.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail = 0;
+
+public:
+    explicit SpscRingBuffer(size_t capacity) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("Ring buffer capacity must be a power of two");
+        }
+        _data.resize(capacity);
+        _mask = capacity - 1;
+    }
+
+    size_t capacity() const { return _data.size(); }
+
+    size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    // Producer side
+    size_t push(const T *values, size_t count) {
+        auto head = _head.load(std::memory_order_relaxed);
+        auto tail = _tail.load(std::memory_order_acquire);
+        count = std::min(count, capacity() - (head - tail));
+
+        for (size_t i = 0; i < count; i++) {
+            _data[(head + i) & _mask] = values[i];
+        }
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+    size_t pop(T *values, size_t count) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        auto head = _head.load(std::memory_order_acquire);
+        count = std::min(count, head - tail);
+
+        for (size_t i = 0; i < count; i++) {
+            values[i] = _data[(tail + i) & _mask];
+        }
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+};
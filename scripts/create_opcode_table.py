@@ -1,24 +1,758 @@
-def main():
+"""Generates the R3000A opcode tables from a single declarative description.
+
+Outputs (relative to the repository root):
+    libps/opcode_handlers.inc   declarations of the CPU dispatch thunks
+    libps/opcode_table.inc      thunk definitions and the dispatch tables
+    libps/opcode_info.inc       mnemonics and operand formats for the disassembler
+    test/opcode_vectors.inc     test vectors computed by the reference model below
+
+Run from anywhere: python3 scripts/create_opcode_table.py
+"""
+
+import os
+import random
+from collections import namedtuple
+
+ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+MASK = 0xFFFFFFFF
+CODE_ADDRESS = 0x80001000
+DATA_ADDRESS = 0x80002000
+EXCEPTION_VECTOR = 0x80000080
+VECTORS_PER_OPCODE = 12
+
+# Exception codes (cop0 CAUSE bits 2..6)
+ADDRESS_ERROR_LOAD = 0x04
+ADDRESS_ERROR_STORE = 0x05
+SYSCALL = 0x08
+BREAKPOINT = 0x09
+RESERVED_INSTRUCTION = 0x0A
+COPROCESSOR_UNUSABLE = 0x0B
+OVERFLOW = 0x0C
+
+SR_COP2_ENABLE = 1 << 30
+
+
+def sext16(value):
+    value &= 0xFFFF
+    return value - 0x10000 if value & 0x8000 else value
+
+
+def sext8(value):
+    value &= 0xFF
+    return value - 0x100 if value & 0x80 else value
+
+
+def signed(value):
+    value &= MASK
+    return value - 0x100000000 if value & 0x80000000 else value
+
+
+class Fields:
+    def __init__(self, raw):
+        self.raw = raw
+        self.rs = (raw >> 21) & 0x1F
+        self.rt = (raw >> 16) & 0x1F
+        self.rd = (raw >> 11) & 0x1F
+        self.shamt = (raw >> 6) & 0x1F
+        self.imm = raw & 0xFFFF
+        self.simm = sext16(raw)
+        self.target = raw & 0x03FFFFFF
+
+
+class Model:
+    """Reference model of a single instruction followed by a nop in its delay slot.
+    A jump to a misaligned address also covers the fetch of its target, which faults."""
+
+    def __init__(self, registers, hi, lo, sr, memory):
+        self.registers = list(registers)
+        self.hi = hi
+        self.lo = lo
+        self.sr = sr
+        self.cause = 0
+        self.badVaddr = 0
+        self.epc = 0
+        self.memory = memory
+        self.pc = CODE_ADDRESS
+        self.load = None
+        self.branchTarget = None
+        self.exception = None
+
+    def r(self, index):
+        return self.registers[index]
+
+    def w(self, index, value):
+        if index != 0:
+            self.registers[index] = value & MASK
+
+    def branch(self, target):
+        self.branchTarget = target & MASK
+
+    def raiseException(self, code, badVaddr=None, coprocessor=0):
+        self.exception = code
+        self.cause = (code << 2) | (coprocessor << 28)
+        self.epc = CODE_ADDRESS
+        if badVaddr is not None:
+            self.badVaddr = badVaddr & MASK
+
+    def checkedAddress(self, address, size, store):
+        address &= MASK
+        if address % size != 0:
+            self.raiseException(ADDRESS_ERROR_STORE if store else ADDRESS_ERROR_LOAD, address)
+            return None
+        assert DATA_ADDRESS <= address < DATA_ADDRESS + 4, hex(address)
+        return address
+
+    def readMemory(self, address, size):
+        shift = (address & 3) * 8
+        return (self.memory >> shift) & ((1 << (size * 8)) - 1)
+
+    def writeMemory(self, address, size, value):
+        shift = (address & 3) * 8
+        mask = ((1 << (size * 8)) - 1) << shift
+        self.memory = (self.memory & ~mask & MASK) | ((value << shift) & mask)
+
+    def finish(self):
+        """Executes the delay slot nop and returns the final program counter."""
+        if self.exception is not None:
+            self.sr = (self.sr & ~0x3F) | ((self.sr << 2) & 0x3F)
+            return EXCEPTION_VECTOR + 4
+        if self.load is not None:
+            self.w(*self.load)
+        if self.branchTarget is not None and self.branchTarget % 4 != 0:
+            # Instructions are fetched from word aligned addresses only
+            self.raiseException(ADDRESS_ERROR_LOAD, self.branchTarget)
+            self.epc = self.branchTarget
+            self.sr = (self.sr & ~0x3F) | ((self.sr << 2) & 0x3F)
+            return EXCEPTION_VECTOR
+        if self.branchTarget is not None:
+            return self.branchTarget
+        return CODE_ADDRESS + 8
+
+
+# --- Instruction semantics of the reference model ----------------------------
+
+def model_add(m, f):
+    value = signed(m.r(f.rs)) + signed(m.r(f.rt))
+    if value > 0x7FFFFFFF or value < -0x80000000:
+        m.raiseException(OVERFLOW)
+    else:
+        m.w(f.rd, value)
+
+
+def model_addi(m, f):
+    value = signed(m.r(f.rs)) + f.simm
+    if value > 0x7FFFFFFF or value < -0x80000000:
+        m.raiseException(OVERFLOW)
+    else:
+        m.w(f.rt, value)
+
+
+def model_sub(m, f):
+    value = signed(m.r(f.rs)) - signed(m.r(f.rt))
+    if value > 0x7FFFFFFF or value < -0x80000000:
+        m.raiseException(OVERFLOW)
+    else:
+        m.w(f.rd, value)
+
+
+def model_div(m, f):
+    numerator = signed(m.r(f.rs))
+    denominator = signed(m.r(f.rt))
+    if denominator == 0:
+        m.hi = numerator & MASK
+        m.lo = 0xFFFFFFFF if numerator >= 0 else 1
+    elif numerator == -0x80000000 and denominator == -1:
+        m.hi = 0
+        m.lo = 0x80000000
+    else:
+        quotient = abs(numerator) // abs(denominator)
+        if (numerator < 0) != (denominator < 0):
+            quotient = -quotient
+        m.lo = quotient & MASK
+        m.hi = (numerator - quotient * denominator) & MASK
+
+
+def model_divu(m, f):
+    numerator = m.r(f.rs)
+    denominator = m.r(f.rt)
+    if denominator == 0:
+        m.hi = numerator
+        m.lo = 0xFFFFFFFF
+    else:
+        m.hi = numerator % denominator
+        m.lo = numerator // denominator
+
+
+def model_mult(m, f):
+    value = (signed(m.r(f.rs)) * signed(m.r(f.rt))) & 0xFFFFFFFFFFFFFFFF
+    m.hi = value >> 32
+    m.lo = value & MASK
+
+
+def model_multu(m, f):
+    value = m.r(f.rs) * m.r(f.rt)
+    m.hi = value >> 32
+    m.lo = value & MASK
+
+
+def model_jalr(m, f):
+    target = m.r(f.rs)
+    m.w(f.rd, CODE_ADDRESS + 8)
+    m.branch(target)
+
+
+def model_bcond(m, f):
+    value = signed(m.r(f.rs))
+    taken = value >= 0 if f.rt & 1 else value < 0
+    if (f.rt & 0x1E) == 0x10:
+        m.w(31, CODE_ADDRESS + 8)
+    if taken:
+        m.branch(CODE_ADDRESS + 4 + (f.simm << 2))
+
+
+def model_branch(condition):
+    def run(m, f):
+        if condition(m, f):
+            m.branch(CODE_ADDRESS + 4 + (f.simm << 2))
+    return run
+
+
+def model_jump(link):
+    def run(m, f):
+        if link:
+            m.w(31, CODE_ADDRESS + 8)
+        m.branch(((CODE_ADDRESS + 4) & 0xF0000000) | (f.target << 2))
+    return run
+
+
+def model_load(size, signExtend):
+    def run(m, f):
+        address = m.checkedAddress(m.r(f.rs) + f.simm, size, False)
+        if address is None:
+            return
+        value = m.readMemory(address, size)
+        if signExtend:
+            value = sext8(value) if size == 1 else sext16(value)
+        m.load = (f.rt, value & MASK)
+    return run
+
+
+def model_store(size):
+    def run(m, f):
+        address = m.checkedAddress(m.r(f.rs) + f.simm, size, True)
+        if address is None:
+            return
+        m.writeMemory(address, size, m.r(f.rt))
+    return run
+
+
+def model_lwl(m, f):
+    address = (m.r(f.rs) + f.simm) & MASK
+    word = m.memory
+    current = m.r(f.rt)
+    shift = address & 3
+    value = (current & (0x00FFFFFF >> (shift * 8))) | ((word << (24 - shift * 8)) & MASK)
+    m.load = (f.rt, value & MASK)
+
+
+def model_lwr(m, f):
+    address = (m.r(f.rs) + f.simm) & MASK
+    word = m.memory
+    current = m.r(f.rt)
+    shift = address & 3
+    value = (current & ((0xFFFFFF00 << ((3 - shift) * 8)) & MASK)) | (word >> (shift * 8))
+    m.load = (f.rt, value & MASK)
+
+
+def model_swl(m, f):
+    address = (m.r(f.rs) + f.simm) & MASK
+    value = m.r(f.rt)
+    shift = address & 3
+    m.memory = (m.memory & ((0xFFFFFF00 << (shift * 8)) & MASK)) | (value >> (24 - shift * 8))
+
+
+def model_swr(m, f):
+    address = (m.r(f.rs) + f.simm) & MASK
+    value = m.r(f.rt)
+    shift = address & 3
+    m.memory = (m.memory & (0x00FFFFFF >> ((3 - shift) * 8))) | ((value << (shift * 8)) & MASK)
+
+
+def model_mfc0(m, f):
+    values = {8: m.badVaddr, 12: m.sr, 13: m.cause, 14: 0, 15: 0x00000002}
+    m.load = (f.rt, values[f.rd])
+
+
+def model_mtc0(m, f):
+    m.sr = m.r(f.rt)
+
 
-    for i in range(0xFF + 1):
-        s = hex(i)
-        print(
-f"""void opcode_{s}(CpuState *state)
-{{
-    spdlog::error("Invalid opcode {s}");
-}}\n""")
+def model_rfe(m, f):
+    m.sr = (m.sr & ~0xF) | ((m.sr >> 2) & 0xF)
 
-    print(     
-"""std::vector<std::function<void(CpuState *)>> initializeOpcodeTable()
-{
-    auto opcodeTable = std::vector<std::function<void(CpuState *)>>(0xFF);""")
 
-    for i in range(0xFF + 1):
-        s = hex(i)
-        print(f"    opcodeTable[{s}] = opcode_{s};")
+def model_exception(code, coprocessor=0):
+    def run(m, f):
+        m.raiseException(code, coprocessor=coprocessor)
+    return run
+
+
+def model_cop2(m, f):
+    # Vectors only cover the unusable case, the GTE has its own tests
+    if not m.sr & SR_COP2_ENABLE:
+        m.raiseException(COPROCESSOR_UNUSABLE, coprocessor=2)
+
+
+def alu(function):
+    def run(m, f):
+        m.w(f.rd, function(m.r(f.rs), m.r(f.rt), f.shamt))
+    return run
+
+
+def alui(function):
+    def run(m, f):
+        m.w(f.rt, function(m.r(f.rs), f))
+    return run
+
+
+# --- Opcode table ------------------------------------------------------------
+
+# group: primary (bits 31..26), special (bits 5..0), cop0/cop2 (bits 25..21)
+# call: implementation and the context it needs, see THUNK_ARGUMENTS
+# operands: operand format of the disassembler
+# flags: store (dropped into the cache when isolated), cop2 (needs SR.CU2)
+Opcode = namedtuple("Opcode", "name group code call operands model flags")
+
+CPU = "OpcodeImplementationCpu"
+COP0 = "OpcodeImplementationCop0"
+COP2 = "OpcodeImplementationCop2"
+
+OPCODES = [
+    Opcode("sll", "special", 0x00, (CPU, "sll", "state,callbacks"), "RdRtShamt", alu(lambda s, t, sa: t << sa), ""),
+    Opcode("srl", "special", 0x02, (CPU, "srl", "state,callbacks"), "RdRtShamt", alu(lambda s, t, sa: t >> sa), ""),
+    Opcode("sra", "special", 0x03, (CPU, "sra", "state,callbacks"), "RdRtShamt", alu(lambda s, t, sa: signed(t) >> sa), ""),
+    Opcode("sllv", "special", 0x04, (CPU, "sllv", "state,callbacks"), "RdRtRs", alu(lambda s, t, sa: t << (s & 0x1F)), ""),
+    Opcode("srlv", "special", 0x06, (CPU, "srlv", "state,callbacks"), "RdRtRs", alu(lambda s, t, sa: t >> (s & 0x1F)), ""),
+    Opcode("srav", "special", 0x07, (CPU, "srav", "state,callbacks"), "RdRtRs", alu(lambda s, t, sa: signed(t) >> (s & 0x1F)), ""),
+    Opcode("jr", "special", 0x08, (CPU, "jr", "state,callbacks"), "Rs", lambda m, f: m.branch(m.r(f.rs)), ""),
+    Opcode("jalr", "special", 0x09, (CPU, "jalr", "state,callbacks"), "RdRs", model_jalr, ""),
+    Opcode("syscall", "special", 0x0C, (CPU, "syscall", "state,callbacks"), "Code", model_exception(SYSCALL), ""),
+    Opcode("break", "special", 0x0D, (CPU, "break_", "state,callbacks"), "Code", model_exception(BREAKPOINT), ""),
+    Opcode("mfhi", "special", 0x10, (CPU, "mfhi", "state,callbacks"), "Rd", lambda m, f: m.w(f.rd, m.hi), ""),
+    Opcode("mthi", "special", 0x11, (CPU, "mthi", "state,callbacks"), "Rs", lambda m, f: setattr(m, "hi", m.r(f.rs)), ""),
+    Opcode("mflo", "special", 0x12, (CPU, "mflo", "state,callbacks"), "Rd", lambda m, f: m.w(f.rd, m.lo), ""),
+    Opcode("mtlo", "special", 0x13, (CPU, "mtlo", "state,callbacks"), "Rs", lambda m, f: setattr(m, "lo", m.r(f.rs)), ""),
+    Opcode("mult", "special", 0x18, (CPU, "mult", "state,callbacks"), "RsRt", model_mult, ""),
+    Opcode("multu", "special", 0x19, (CPU, "multu", "state,callbacks"), "RsRt", model_multu, ""),
+    Opcode("div", "special", 0x1A, (CPU, "div", "state,callbacks"), "RsRt", model_div, ""),
+    Opcode("divu", "special", 0x1B, (CPU, "divu", "state,callbacks"), "RsRt", model_divu, ""),
+    Opcode("add", "special", 0x20, (CPU, "add", "state,callbacks"), "RdRsRt", model_add, ""),
+    Opcode("addu", "special", 0x21, (CPU, "addu", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: s + t), ""),
+    Opcode("sub", "special", 0x22, (CPU, "sub", "state,callbacks"), "RdRsRt", model_sub, ""),
+    Opcode("subu", "special", 0x23, (CPU, "subu", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: s - t), ""),
+    Opcode("and", "special", 0x24, (CPU, "and_", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: s & t), ""),
+    Opcode("or", "special", 0x25, (CPU, "or_", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: s | t), ""),
+    Opcode("xor", "special", 0x26, (CPU, "xor_", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: s ^ t), ""),
+    Opcode("nor", "special", 0x27, (CPU, "nor", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: ~(s | t)), ""),
+    Opcode("slt", "special", 0x2A, (CPU, "slt", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: int(signed(s) < signed(t))), ""),
+    Opcode("sltu", "special", 0x2B, (CPU, "sltu", "state,callbacks"), "RdRsRt", alu(lambda s, t, sa: int(s < t)), ""),
+
+    Opcode("bcond", "primary", 0x01, (CPU, "bcond", "state,callbacks"), "RsBranch", model_bcond, ""),
+    Opcode("j", "primary", 0x02, (CPU, "j", "state,callbacks"), "Jump", model_jump(False), ""),
+    Opcode("jal", "primary", 0x03, (CPU, "jal", "state,callbacks"), "Jump", model_jump(True), ""),
+    Opcode("beq", "primary", 0x04, (CPU, "beq", "state,callbacks"), "RsRtBranch", model_branch(lambda m, f: m.r(f.rs) == m.r(f.rt)), ""),
+    Opcode("bne", "primary", 0x05, (CPU, "bne", "state,callbacks"), "RsRtBranch", model_branch(lambda m, f: m.r(f.rs) != m.r(f.rt)), ""),
+    Opcode("blez", "primary", 0x06, (CPU, "blez", "state,callbacks"), "RsBranch", model_branch(lambda m, f: signed(m.r(f.rs)) <= 0), ""),
+    Opcode("bgtz", "primary", 0x07, (CPU, "bgtz", "state,callbacks"), "RsBranch", model_branch(lambda m, f: signed(m.r(f.rs)) > 0), ""),
+    Opcode("addi", "primary", 0x08, (CPU, "addi", "state,callbacks"), "RtRsImmediate", model_addi, ""),
+    Opcode("addiu", "primary", 0x09, (CPU, "addiu", "state,callbacks"), "RtRsImmediate", alui(lambda s, f: s + f.simm), ""),
+    Opcode("slti", "primary", 0x0A, (CPU, "slti", "state,callbacks"), "RtRsImmediate", alui(lambda s, f: int(signed(s) < f.simm)), ""),
+    Opcode("sltiu", "primary", 0x0B, (CPU, "sltiu", "state,callbacks"), "RtRsImmediate", alui(lambda s, f: int(s < (f.simm & MASK))), ""),
+    Opcode("andi", "primary", 0x0C, (CPU, "andi", "state,callbacks"), "RtRsImmediateUnsigned", alui(lambda s, f: s & f.imm), ""),
+    Opcode("ori", "primary", 0x0D, (CPU, "ori", "state,callbacks"), "RtRsImmediateUnsigned", alui(lambda s, f: s | f.imm), ""),
+    Opcode("xori", "primary", 0x0E, (CPU, "xori", "state,callbacks"), "RtRsImmediateUnsigned", alui(lambda s, f: s ^ f.imm), ""),
+    Opcode("lui", "primary", 0x0F, (CPU, "lui", "state,callbacks"), "RtImmediate", lambda m, f: m.w(f.rt, f.imm << 16), ""),
+    Opcode("cop0", "primary", 0x10, None, "None", None, ""),
+    Opcode("cop1", "primary", 0x11, (CPU, "coprocessorUnusable", "state,callbacks"), "Coprocessor", model_exception(COPROCESSOR_UNUSABLE, 1), ""),
+    Opcode("cop2", "primary", 0x12, None, "None", None, ""),
+    Opcode("cop3", "primary", 0x13, (CPU, "coprocessorUnusable", "state,callbacks"), "Coprocessor", model_exception(COPROCESSOR_UNUSABLE, 3), ""),
+    Opcode("lb", "primary", 0x20, (CPU, "lb", "state,memory,callbacks"), "Memory", model_load(1, True), ""),
+    Opcode("lh", "primary", 0x21, (CPU, "lh", "state,memory,callbacks"), "Memory", model_load(2, True), ""),
+    Opcode("lwl", "primary", 0x22, (CPU, "lwl", "state,memory,callbacks"), "Memory", model_lwl, ""),
+    Opcode("lw", "primary", 0x23, (CPU, "lw", "state,memory,callbacks"), "Memory", model_load(4, False), ""),
+    Opcode("lbu", "primary", 0x24, (CPU, "lbu", "state,memory,callbacks"), "Memory", model_load(1, False), ""),
+    Opcode("lhu", "primary", 0x25, (CPU, "lhu", "state,memory,callbacks"), "Memory", model_load(2, False), ""),
+    Opcode("lwr", "primary", 0x26, (CPU, "lwr", "state,memory,callbacks"), "Memory", model_lwr, ""),
+    Opcode("sb", "primary", 0x28, (CPU, "sb", "state,memory,callbacks"), "Memory", model_store(1), "store"),
+    Opcode("sh", "primary", 0x29, (CPU, "sh", "state,memory,callbacks"), "Memory", model_store(2), "store"),
+    Opcode("swl", "primary", 0x2A, (CPU, "swl", "state,memory,callbacks"), "Memory", model_swl, "store"),
+    Opcode("sw", "primary", 0x2B, (CPU, "sw", "state,memory,callbacks"), "Memory", model_store(4), "store"),
+    Opcode("swr", "primary", 0x2E, (CPU, "swr", "state,memory,callbacks"), "Memory", model_swr, "store"),
+    Opcode("lwc0", "primary", 0x30, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 0), ""),
+    Opcode("lwc1", "primary", 0x31, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 1), ""),
+    Opcode("lwc2", "primary", 0x32, (COP2, "lwc2", "state,gte,memory"), "CoprocessorMemory", model_cop2, "cop2"),
+    Opcode("lwc3", "primary", 0x33, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 3), ""),
+    Opcode("swc0", "primary", 0x38, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 0), ""),
+    Opcode("swc1", "primary", 0x39, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 1), ""),
+    Opcode("swc2", "primary", 0x3A, (COP2, "swc2", "state,gte,memory"), "CoprocessorMemory", model_cop2, "cop2,store"),
+    Opcode("swc3", "primary", 0x3B, (CPU, "coprocessorUnusable", "state,callbacks"), "CoprocessorMemory", model_exception(COPROCESSOR_UNUSABLE, 3), ""),
+
+    Opcode("mfc0", "cop0", 0x00, (COP0, "mfc0", "state,callbacks"), "RtCop0", model_mfc0, ""),
+    Opcode("mtc0", "cop0", 0x04, (COP0, "mtc0", "state,callbacks"), "RtCop0", model_mtc0, ""),
+    Opcode("rfe", "cop0", 0x10, (COP0, "rfe", "state,callbacks"), "None", model_rfe, ""),
+
+    Opcode("mfc2", "cop2", 0x00, (COP2, "mfc2", "state,gte,callbacks"), "RtCop2Data", model_cop2, "cop2"),
+    Opcode("cfc2", "cop2", 0x02, (COP2, "cfc2", "state,gte,callbacks"), "RtCop2Control", model_cop2, "cop2"),
+    Opcode("mtc2", "cop2", 0x04, (COP2, "mtc2", "state,gte"), "RtCop2Data", model_cop2, "cop2"),
+    Opcode("ctc2", "cop2", 0x06, (COP2, "ctc2", "state,gte"), "RtCop2Control", model_cop2, "cop2"),
+    Opcode("gte", "cop2", 0x10, (COP2, "cop2", "gte"), "Cop2Command", model_cop2, "cop2"),
+]
+
+# GTE command names by bits 5..0 of a cop2 command, used by the disassembler
+GTE_COMMANDS = {
+    0x01: "rtps", 0x06: "nclip", 0x0C: "op", 0x10: "dpcs", 0x11: "intpl", 0x12: "mvmva",
+    0x13: "ncds", 0x14: "cdp", 0x16: "ncdt", 0x1B: "nccs", 0x1C: "cc", 0x1E: "ncs",
+    0x20: "nct", 0x28: "sqr", 0x29: "dcpl", 0x2A: "dpct", 0x2D: "avsz3", 0x2E: "avsz4",
+    0x30: "rtpt", 0x3D: "gpf", 0x3E: "gpl", 0x3F: "ncct",
+}
+
+THUNK_ARGUMENTS = {
+    "state": "&_cpuState",
+    "memory": "_memory",
+    "callbacks": "this",
+    "gte": "&_gte",
+}
+
+
+def handler(op):
+    return f"execute_{op.name}"
+
+
+def thunk(op):
+    namespace, function, arguments = op.call
+    argumentList = ", ".join(["opcode"] + [THUNK_ARGUMENTS[a] for a in arguments.split(",")])
+    flags = op.flags.split(",")
+    lines = [f"void CPU::{handler(op)}(Opcode opcode) {{"]
+    if "cop2" in flags:
+        lines += [
+            "    if (!cop2Usable()) {",
+            "        raiseCoprocessorUnusable(2);",
+            "        return;",
+            "    }",
+        ]
+    if "store" in flags:
+        lines += [
+            "    if (cacheIsolated()) {",
+            "        isolatedStore(opcode);",
+            "        return;",
+            "    }",
+        ]
+    lines += [f"    {namespace}::{function}({argumentList});", "}"]
+    return "\n".join(lines)
+
+
+HEADER = "// Generated by scripts/create_opcode_table.py, do not edit."
+
+
+def generate_handlers():
+    lines = [HEADER, ""]
+    for op in OPCODES:
+        if op.call:
+            lines.append(f"void {handler(op)}(Opcode opcode);")
+    lines += [
+        "void execute_special(Opcode opcode);",
+        "void execute_cop0(Opcode opcode);",
+        "void execute_cop2(Opcode opcode);",
+        "void execute_reserved(Opcode opcode);",
+        "",
+        "using OpcodeHandler = void (CPU::*)(Opcode);",
+        "static const OpcodeHandler PRIMARY_HANDLERS[64];",
+        "static const OpcodeHandler SPECIAL_HANDLERS[64];",
+    ]
+    return "\n".join(lines) + "\n"
+
+
+def table_entries(group, default):
+    entries = [default] * 64
+    for op in OPCODES:
+        if op.group == group:
+            entries[op.code] = f"&CPU::{handler(op)}"
+    if group == "primary":
+        entries[0x00] = "&CPU::execute_special"
+        entries[0x10] = "&CPU::execute_cop0"
+        entries[0x12] = "&CPU::execute_cop2"
+    return entries
+
+
+def table(group, default):
+    entries = table_entries(group, default)
+    lines = []
+    for row in range(0, 64, 4):
+        lines.append("    " + ", ".join(entries[row:row + 4]) + ",")
+    return "\n".join(lines)
+
+
+def coprocessor_dispatch(group):
+    lines = [f"void CPU::{handler(Opcode(group, '', 0, None, '', None, ''))}(Opcode opcode) {{"]
+    lines.append("    switch (opcode.cop_opcode()) {")
+    for op in OPCODES:
+        if op.group != group:
+            continue
+        if op.code == 0x10:
+            continue
+        lines += [f"    case {op.code:#04x}:", f"        {handler(op)}(opcode);", "        return;"]
+    lines += ["    }", ""]
+    command = [op for op in OPCODES if op.group == group and op.code == 0x10][0]
+    if group == "cop0":
+        lines += [
+            "    if (opcode.cop_opcode() == 0x10 && opcode.subfunction() == 0x10) {",
+            f"        {handler(command)}(opcode);",
+            "        return;",
+            "    }",
+        ]
+    else:
+        lines += [
+            "    // Bit 25 set means the remaining bits are a GTE command",
+            "    if (opcode.cop_opcode() & 0x10) {",
+            f"        {handler(command)}(opcode);",
+            "        return;",
+            "    }",
+        ]
+    lines += ["", "    execute_reserved(opcode);", "}"]
+    return "\n".join(lines)
+
+
+def dispatch_list():
+    # Primary opcodes followed by the SPECIAL subfunctions, see CPU::run
+    primary = [entry.removeprefix("&CPU::") for entry in table_entries("primary", "&CPU::execute_reserved")]
+    special = [entry.removeprefix("&CPU::") for entry in table_entries("special", "&CPU::execute_reserved")]
+    lines = [
+        "// Handlers indexed by the primary opcode, or 64 + subfunction for SPECIAL,",
+        "// used to build the threaded dispatch in CPU::run. X(index, handler)",
+        "#define PS_DISPATCH_OPCODES(X) \\",
+    ]
+    entries = [f"    X({index}, {name})" for index, name in enumerate(primary + special)]
+    lines += [entry + " \\" for entry in entries[:-1]] + [entries[-1]]
+    return "\n".join(lines)
+
+
+def generate_table():
+    parts = [HEADER]
+    for op in OPCODES:
+        if op.call:
+            parts.append(thunk(op))
+    parts.append("void CPU::execute_special(Opcode opcode) {\n    (this->*SPECIAL_HANDLERS[opcode.subfunction()])(opcode);\n}")
+    parts.append(coprocessor_dispatch("cop0"))
+    parts.append(coprocessor_dispatch("cop2"))
+    parts.append("const CPU::OpcodeHandler CPU::PRIMARY_HANDLERS[64] = {\n" + table("primary", "&CPU::execute_reserved") + "\n};")
+    parts.append("const CPU::OpcodeHandler CPU::SPECIAL_HANDLERS[64] = {\n" + table("special", "&CPU::execute_reserved") + "\n};")
+    parts.append(dispatch_list())
+    return "\n\n".join(parts) + "\n"
+
+
+def info(name, operands):
+    return f'{{"{name}", OperandFormat::{operands}}}'
+
+
+def info_table(group):
+    entries = [info("illegal", "Illegal")] * 64
+    for op in OPCODES:
+        if op.group == group:
+            entries[op.code] = info(op.name, op.operands)
+    return ",\n".join("    " + e for e in entries)
+
+
+def generate_info():
+    operandFormats = sorted({op.operands for op in OPCODES} | {"Illegal"})
+    lines = [HEADER, ""]
+    lines.append("enum class OperandFormat : uint8_t {")
+    lines += [f"    {f}," for f in operandFormats]
+    lines.append("};")
+    lines.append("")
+    lines.append("struct OpcodeInfo {")
+    lines.append("    const char *mnemonic;")
+    lines.append("    OperandFormat operands;")
+    lines.append("};")
+    lines.append("")
+    lines.append("constexpr OpcodeInfo PRIMARY_INFO[64] = {\n" + info_table("primary") + "\n};")
+    lines.append("")
+    lines.append("constexpr OpcodeInfo SPECIAL_INFO[64] = {\n" + info_table("special") + "\n};")
+    lines.append("")
+    for group in ("cop0", "cop2"):
+        lines.append(f"constexpr OpcodeInfo {group.upper()}_INFO[32] = {{")
+        entries = [info("illegal", "Illegal")] * 32
+        for op in OPCODES:
+            if op.group == group and op.code < 0x10:
+                entries[op.code] = info(op.name, op.operands)
+        command = [op for op in OPCODES if op.group == group and op.code == 0x10][0]
+        for code in range(0x10, 0x20):
+            entries[code] = info(command.name, command.operands)
+        lines += [f"    {e}," for e in entries]
+        lines.append("};")
+        lines.append("")
+    lines.append("constexpr const char *GTE_COMMAND_NAMES[64] = {")
+    names = [f'"{GTE_COMMANDS.get(i, "cop2")}"' for i in range(64)]
+    for row in range(0, 64, 8):
+        lines.append("    " + ", ".join(names[row:row + 8]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+# --- Test vectors --------------------------------------------------------------
+
+INTERESTING_VALUES = [0, 1, 2, 0x1F, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0xFFFF8000]
+
+
+def random_value(rng):
+    if rng.random() < 0.3:
+        return rng.choice(INTERESTING_VALUES)
+    return rng.getrandbits(32)
+
+
+def random_register(rng, allowZero=True):
+    if allowZero and rng.random() < 0.1:
+        return 0
+    return rng.randint(1, 31)
+
+
+def encode(op, rng):
+    if op.group == "special":
+        raw = (random_register(rng) << 21) | (random_register(rng) << 16) | (random_register(rng) << 11) | (rng.randint(0, 31) << 6) | op.code
+        if op.name in ("syscall", "break"):
+            raw = (rng.getrandbits(20) << 6) | op.code
+        return raw
+    if op.group == "primary":
+        if op.name == "bcond":
+            rt = rng.choice([0x00, 0x01, 0x10, 0x11, 0x02, 0x03, 0x12, 0x13, 0x1E, 0x1F])
+            return (0x01 << 26) | (random_register(rng) << 21) | (rt << 16) | rng.getrandbits(16)
+        if op.name in ("j", "jal"):
+            return (op.code << 26) | rng.getrandbits(26)
+        return (op.code << 26) | (random_register(rng) << 21) | (random_register(rng) << 16) | rng.getrandbits(16)
+    if op.group == "cop0":
+        if op.name == "rfe":
+            return (0x10 << 26) | (0x10 << 21) | 0x10
+        rd = 12 if op.name == "mtc0" else rng.choice([8, 12, 13, 14, 15])
+        return (0x10 << 26) | (op.code << 21) | (random_register(rng) << 16) | (rd << 11)
+    if op.group == "cop2":
+        if op.code == 0x10:
+            return (0x12 << 26) | (1 << 25) | rng.getrandbits(25)
+        return (0x12 << 26) | (op.code << 21) | (random_register(rng) << 16) | (rng.randint(0, 31) << 11)
+    raise ValueError(op.name)
+
+
+def make_vector(op, rng):
+    raw = encode(op, rng)
+    f = Fields(raw)
+    registers = [0] * 32
+    registers[f.rs] = random_value(rng)
+    registers[f.rt] = random_value(rng)
+    if op.group == "primary" and op.operands == "Memory":
+        # Point the access into the data word, sometimes misaligned
+        if f.rs == 0:
+            f.rs = rng.randint(1, 31)
+            raw = (raw & ~(0x1F << 21)) | (f.rs << 21)
+            f = Fields(raw)
+        registers[f.rs] = (DATA_ADDRESS + rng.randint(0, 3) - f.simm) & MASK
+    registers[0] = 0
+
+    hi = random_value(rng)
+    lo = random_value(rng)
+    memory = rng.getrandbits(32)
+    sr = 0
+    if op.group == "cop0":
+        sr = rng.getrandbits(32) & 0x4040FF3F
+        if op.name == "mtc0":
+            registers[f.rt] = rng.getrandbits(32) & 0x4040FF3F if f.rt else 0
+
+    m = Model(registers, hi, lo, sr, memory)
+    op.model(m, f)
+    pc = m.finish()
+
+    return {
+        "name": op.name,
+        "instruction": raw,
+        "input": [(i, v) for i, v in enumerate(registers) if v],
+        "hi": hi,
+        "lo": lo,
+        "sr": sr,
+        "memory": memory,
+        "output": [(i, v) for i, v in enumerate(m.registers) if v],
+        "expectedHi": m.hi & MASK,
+        "expectedLo": m.lo & MASK,
+        "expectedSr": m.sr & MASK,
+        "expectedMemory": m.memory & MASK,
+        "expectedPc": pc,
+        "expectedCause": m.cause,
+        "expectedBadVaddr": m.badVaddr,
+        "expectedEpc": m.epc,
+    }
+
+
+def registers_initializer(values):
+    assert len(values) <= 4, values
+    values = values + [(0, 0)] * (4 - len(values))
+    return "{" + ", ".join(f"{{{i}, {v:#010x}}}" for i, v in values) + "}"
+
+
+def generate_vectors():
+    rng = random.Random(0x3000A)
+    vectors = []
+    for op in OPCODES:
+        if op.model is None:
+            continue
+        count = 1 if op.name == "rfe" else VECTORS_PER_OPCODE
+        for _ in range(count):
+            vectors.append(make_vector(op, rng))
+
+    # Undefined primary and special opcodes raise a reserved instruction exception
+    for raw in (0x14 << 26, 0x3F << 26, 0x01, 0x28, 0x3F):
+        m = Model([0] * 32, 0, 0, 0, 0)
+        m.raiseException(RESERVED_INSTRUCTION)
+        vectors.append({
+            "name": "reserved", "instruction": raw, "input": [], "hi": 0, "lo": 0, "sr": 0, "memory": 0,
+            "output": [], "expectedHi": 0, "expectedLo": 0, "expectedSr": 0, "expectedMemory": 0,
+            "expectedPc": m.finish(), "expectedCause": m.cause, "expectedBadVaddr": 0, "expectedEpc": m.epc,
+        })
+
+    # A jump into the middle of an instruction faults on the fetch of its target
+    for target in (CODE_ADDRESS + 0x102, CODE_ADDRESS + 0x201):
+        registers = [0] * 32
+        registers[8] = target
+        m = Model(registers, 0, 0, 0, 0)
+        m.branch(target)
+        vectors.append({
+            "name": "jr", "instruction": (8 << 21) | 0x08, "input": [(8, target)], "hi": 0, "lo": 0, "sr": 0, "memory": 0,
+            "output": [(8, target)], "expectedHi": 0, "expectedLo": 0, "expectedSr": 0, "expectedMemory": 0,
+            "expectedPc": m.finish(), "expectedCause": m.cause, "expectedBadVaddr": m.badVaddr, "expectedEpc": m.epc,
+        })
+
+    lines = [HEADER, ""]
+    lines.append(f"constexpr uint32_t OPCODE_TEST_CODE_ADDRESS = {CODE_ADDRESS:#010x};")
+    lines.append(f"constexpr uint32_t OPCODE_TEST_DATA_ADDRESS = {DATA_ADDRESS:#010x};")
+    lines.append("")
+    lines.append("const OpcodeTestVector OPCODE_TEST_VECTORS[] = {")
+    for v in vectors:
+        lines.append(
+            f'    {{"{v["name"]}", {v["instruction"]:#010x}, {registers_initializer(v["input"])}, '
+            f'{v["hi"]:#010x}, {v["lo"]:#010x}, {v["sr"]:#010x}, {v["memory"]:#010x}, '
+            f'{registers_initializer(v["output"])}, '
+            f'{v["expectedHi"]:#010x}, {v["expectedLo"]:#010x}, {v["expectedSr"]:#010x}, {v["expectedMemory"]:#010x}, '
+            f'{v["expectedPc"]:#010x}, {v["expectedCause"]:#010x}, {v["expectedBadVaddr"]:#010x}, {v["expectedEpc"]:#010x}}},')
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def write(path, content):
+    with open(os.path.join(ROOT, path), "w", newline="\n") as file:
+        file.write(content)
+
+
+def main():
+    write("libps/opcode_handlers.inc", generate_handlers())
+    write("libps/opcode_table.inc", generate_table())
+    write("libps/opcode_info.inc", generate_info())
+    write("test/opcode_vectors.inc", generate_vectors())
 
-    print(
-"""    return opcodeTable;
-}""")
 
-main()
\ No newline at end of file
+main()
@@ -0,0 +1,104 @@
+#include "libps/audio_output.hpp"
+#include "libps/resampler.hpp"
+#include "libutils/spsc_ring_buffer.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace {
+class CaptureAudioSink : public AudioSink {
+public:
+    std::vector<int16_t> *samples;
+
+    CaptureAudioSink(std::vector<int16_t> *target)
+        : samples(target) {}
+
+    virtual void write(const int16_t *data, size_t frames) override {
+        samples->insert(samples->end(), data, data + frames * 2);
+    }
+};
+} // namespace
+
+TEST(AudioOutput, testRingBufferWrapsAround) {
+    auto buffer = SpscRingBuffer<int>(4);
+    int values[] = {1, 2, 3, 4, 5, 6};
+    int out[4] = {};
+
+    EXPECT_EQ(buffer.push(values, 3), 3u);
+    EXPECT_EQ(buffer.pop(out, 2), 2u);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[1], 2);
+
+    // Only three more fit, the rest is rejected instead of blocking
+    EXPECT_EQ(buffer.push(values + 3, 3), 3u);
+    EXPECT_EQ(buffer.push(values, 1), 0u);
+    EXPECT_EQ(buffer.size(), 4u);
+
+    EXPECT_EQ(buffer.pop(out, 4), 4u);
+    EXPECT_EQ(out[0], 3);
+    EXPECT_EQ(out[3], 6);
+    EXPECT_EQ(buffer.pop(out, 1), 0u);
+}
+
+TEST(AudioOutput, testResamplerIdentityAtSameRate) {
+    auto resampler = Resampler(44100, 44100);
+
+    std::vector<AudioFrame> input;
+    for (int16_t i = 0; i < 100; i++) {
+        input.push_back(AudioFrame{i, static_cast<int16_t>(-i)});
+    }
+
+    std::vector<AudioFrame> output(100);
+    size_t consumed = 0;
+    auto produced = resampler.process(input.data(), input.size(), consumed, output.data(), output.size());
+
+    // The last input frame is held back until its successor arrives
+    ASSERT_EQ(produced, 99u);
+    EXPECT_EQ(consumed, 100u);
+    for (size_t i = 0; i < produced; i++) {
+        EXPECT_EQ(output[i].left, input[i].left);
+        EXPECT_EQ(output[i].right, input[i].right);
+    }
+}
+
+TEST(AudioOutput, testResamplerAdjustmentChangesConsumption) {
+    std::vector<AudioFrame> input(2000, AudioFrame{100, 100});
+    std::vector<AudioFrame> output(1000);
+
+    auto consumedWith = [&](double adjustment) {
+        auto resampler = Resampler(44100, 44100);
+        resampler.setAdjustment(adjustment);
+        size_t consumed = 0;
+        EXPECT_EQ(resampler.process(input.data(), input.size(), consumed, output.data(), output.size()), 1000u);
+        return consumed;
+    };
+
+    auto nominal = consumedWith(1.0);
+    EXPECT_EQ(consumedWith(1.005), nominal + 4);
+    EXPECT_EQ(consumedWith(0.995), nominal - 5);
+}
+
+TEST(AudioOutput, testDrainModeForwardsEverything) {
+    std::vector<int16_t> captured;
+    auto capture = std::make_unique<CaptureAudioSink>(&captured);
+
+    std::vector<int16_t> samples;
+    for (int i = 0; i < 4000; i++) {
+        samples.push_back(static_cast<int16_t>(i));
+    }
+
+    {
+        auto output = AudioOutput(std::move(capture), AudioOutput::Mode::Drain, 44100, 44100);
+        for (size_t offset = 0; offset < samples.size(); offset += 200) {
+            output.write(samples.data() + offset, 100);
+        }
+        EXPECT_EQ(output.statistics().overruns, 0u);
+    }
+
+    // Everything but the held back last frame arrives, in order
+    ASSERT_EQ(captured.size(), samples.size() - 2);
+    for (size_t i = 0; i < captured.size(); i++) {
+        EXPECT_EQ(captured[i], samples[i]);
+    }
+}
@@ -0,0 +1,162 @@
+#include "test_program.hpp"
+
+#include "libps/playstation.hpp"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace {
+constexpr uint32_t RETURN_ADDRESS = PROGRAM_ADDRESS + 8;
+constexpr uint32_t DATA_ADDRESS = 0x80002000;
+constexpr uint32_t STACK_ADDRESS = 0x80003000;
+
+const auto V0 = RegisterIndex(2);
+const auto A0 = RegisterIndex(4);
+const auto A1 = RegisterIndex(5);
+const auto A2 = RegisterIndex(6);
+const auto A3 = RegisterIndex(7);
+const auto T0 = RegisterIndex(8);
+const auto T1 = RegisterIndex(9);
+const auto SP = RegisterIndex(29);
+
+void writeString(Playstation &ps, uint32_t address, const std::string &text) {
+    for (uint32_t i = 0; i <= text.size(); i++) {
+        ps.memory().u8Write(address + i, i < text.size() ? static_cast<uint8_t>(text[i]) : 0);
+    }
+}
+
+// Prepares a call of function through the given vector, jal and a delay slot which
+// loads the function number into $t1
+void prepareCall(Playstation &ps, uint32_t vector, uint32_t function) {
+    loadProgram(ps, {
+        0x0C000000 | (vector >> 2), // jal vector
+        0x24090000 | function,      // addiu $t1, $0, function
+        0x00000000,                 // nop at RETURN_ADDRESS
+    });
+}
+} // namespace
+
+TEST(BiosHle, testMemcpyRunsNatively) {
+    auto ps = Playstation();
+    ps.initialize();
+    ps.biosHle().setEnabled(true);
+    writeString(ps, DATA_ADDRESS, "kernel");
+
+    auto *state = ps.cpu().getCpuState();
+    state->setRegister(A0, DATA_ADDRESS + 0x100);
+    state->setRegister(A1, DATA_ADDRESS);
+    state->setRegister(A2, 7);
+    prepareCall(ps, 0xA0, 0x2A);
+
+    // jal, delay slot and the native call
+    EXPECT_EQ(ps.execute(3), 3u);
+    EXPECT_EQ(state->getProgramCounter(), RETURN_ADDRESS);
+    EXPECT_EQ(state->getRegister(V0), DATA_ADDRESS + 0x100);
+    EXPECT_EQ(ps.memory().u32(DATA_ADDRESS + 0x100), 0x6E72656Bu);
+    EXPECT_EQ(ps.biosHle().calls(), 1u);
+
+    // strcmp of the copy, then through step()
+    state->setRegister(A0, DATA_ADDRESS);
+    state->setRegister(A1, DATA_ADDRESS + 0x100);
+    prepareCall(ps, 0xA0, 0x17);
+    ps.cpu().step();
+    ps.cpu().step();
+    ps.cpu().step();
+    EXPECT_EQ(state->getProgramCounter(), RETURN_ADDRESS);
+    EXPECT_EQ(state->getRegister(V0), 0u);
+    EXPECT_EQ(ps.biosHle().calls(), 2u);
+}
+
+TEST(BiosHle, testUnsupportedCallsRunTheBios) {
+    auto ps = Playstation();
+    ps.initialize();
+    ps.biosHle().setEnabled(true);
+    auto *state = ps.cpu().getCpuState();
+
+    // Unknown function
+    prepareCall(ps, 0xA0, 0x70);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000A4u);
+
+    // Destination outside of RAM
+    state->setRegister(A0, 0x1F800000);
+    state->setRegister(A1, DATA_ADDRESS);
+    state->setRegister(A2, 4);
+    prepareCall(ps, 0xA0, 0x2A);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000A4u);
+
+    // HLE disabled
+    ps.biosHle().setEnabled(false);
+    state->setRegister(A0, DATA_ADDRESS + 0x100);
+    prepareCall(ps, 0xA0, 0x2A);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000A4u);
+    EXPECT_EQ(ps.biosHle().calls(), 0u);
+}
+
+TEST(BiosHle, testFallbackKeepsPendingLoads) {
+    auto ps = Playstation();
+    ps.initialize();
+    ps.biosHle().setEnabled(true);
+    ps.memory().u32Write(DATA_ADDRESS, 0x1234);
+    // Stand-in for the BIOS code at the vector, reads $a0 while the load is in its slot
+    ps.memory().u32Write(0x800000A0, 0x00801021); // addu $v0, $a0, $0
+
+    auto *state = ps.cpu().getCpuState();
+    state->setRegister(A0, 7);
+    state->setRegister(T1, 0x70);
+    state->setRegister(T0, DATA_ADDRESS);
+    loadProgram(ps, {
+        0x0C000000 | (0xA0 >> 2), // jal 0xA0
+        0x8D040000,               // lw $a0, 0($t0)
+    });
+
+    // Unknown function, the BIOS runs with the load still delayed
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000A4u);
+    EXPECT_EQ(state->getRegister(V0), 7u);
+    EXPECT_EQ(state->getRegister(A0), 0x1234u);
+    EXPECT_EQ(ps.biosHle().calls(), 0u);
+}
+
+TEST(BiosHle, testTtyOutput) {
+    auto ps = Playstation();
+    ps.initialize();
+    auto tty = std::ostringstream();
+    ps.biosHle().setTtyStream(&tty);
+    auto *state = ps.cpu().getCpuState();
+
+    // putchar is captured, the BIOS still runs it without HLE
+    state->setRegister(A0, '>');
+    prepareCall(ps, 0xB0, 0x3D);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000B4u);
+    EXPECT_EQ(tty.str(), ">");
+
+    ps.biosHle().setEnabled(true);
+    writeString(ps, DATA_ADDRESS, "%s=%d %04X%% %-3c|%u %x\n");
+    writeString(ps, DATA_ADDRESS + 0x40, "value");
+    state->setRegister(A0, DATA_ADDRESS);
+    state->setRegister(A1, DATA_ADDRESS + 0x40);
+    state->setRegister(A2, static_cast<uint32_t>(-12));
+    state->setRegister(A3, 0xBEEF);
+    // The fifth and later arguments follow the home area on the stack
+    state->setRegister(SP, STACK_ADDRESS);
+    ps.memory().u32Write(STACK_ADDRESS + 0x10, 'z');
+    ps.memory().u32Write(STACK_ADDRESS + 0x14, 7);
+    ps.memory().u32Write(STACK_ADDRESS + 0x18, 0x1F);
+    prepareCall(ps, 0xA0, 0x3F);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), RETURN_ADDRESS);
+    EXPECT_EQ(tty.str(), ">value=-12 BEEF% z  |7 1f\n");
+    EXPECT_EQ(state->getRegister(V0), 25u);
+
+    // Conversions the HLE does not know are left to the BIOS
+    writeString(ps, DATA_ADDRESS, "%f\n");
+    prepareCall(ps, 0xA0, 0x3F);
+    ps.execute(3);
+    EXPECT_EQ(state->getProgramCounter(), 0x800000A4u);
+    EXPECT_EQ(tty.str(), ">value=-12 BEEF% z  |7 1f\n");
+}
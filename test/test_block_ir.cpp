@@ -0,0 +1,282 @@
+#include "test_program.hpp"
+
+#include "libps/block_cache_file.hpp"
+#include "libps/block_ir.hpp"
+#include "libps/playstation.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <vector>
+
+using BlockIr::Op;
+namespace Flags = BlockIr::Flags;
+namespace fs = std::filesystem;
+
+namespace {
+constexpr uint32_t DATA_ADDRESS = 0x80002000;
+
+const auto T1 = RegisterIndex(9);
+const auto T2 = RegisterIndex(10);
+const auto T3 = RegisterIndex(11);
+const auto T4 = RegisterIndex(12);
+
+BlockIr::Block translate(uint32_t address, const std::vector<uint32_t> &program) {
+    auto page = std::array<uint8_t, MEMORY_PAGE_SIZE>{};
+    std::memcpy(page.data() + (address & MEMORY_PAGE_MASK), program.data(), program.size() * sizeof(uint32_t));
+    return BlockIr::translate(address, page.data());
+}
+
+// Sums in RAM with loads in and out of their delay slots, and increments the
+// immediate of its own addiu whenever it starts over
+const std::vector<uint32_t> SELF_MODIFYING_COUNTER = {
+    0x3C088000, // lui $t0, 0x8000
+    0x35082000, // ori $t0, $t0, 0x2000
+    0x8D090000, // lw $t1, 0($t0)
+    0x256B0001, // addiu $t3, $t3, 1
+    0x012B4821, // addu $t1, $t1, $t3
+    0x810A0004, // lb $t2, 4($t0)
+    0x850C0000, // lh $t4, 0($t0)
+    0x014C5021, // addu $t2, $t2, $t4 (the old $t4)
+    0xAD090000, // sw $t1, 0($t0)
+    0xAD0A0004, // sw $t2, 4($t0)
+    0x00096A02, // srl $t5, $t1, 8
+    0x2DAE0064, // sltiu $t6, $t5, 100
+    0x15C0FFF3, // bnez $t6, -13
+    0x00000000, // nop
+    0xAD000000, // sw $zero, 0($t0)
+    0x3C0F8000, // lui $t7, 0x8000
+    0x8DF8100C, // lw $t8, 0x100C($t7)
+    0x00005821, // addu $t3, $zero, $zero
+    0x27180001, // addiu $t8, $t8, 1
+    0xADF8100C, // sw $t8, 0x100C($t7)
+    0x08000400, // j 0x80001000
+    0x00000000, // nop
+};
+
+void startProgram(Playstation &ps, const std::vector<uint32_t> &program) {
+    loadProgram(ps, program);
+    ps.memory().u32Write(DATA_ADDRESS, 0);
+    ps.memory().u32Write(DATA_ADDRESS + 4, 0x00030001);
+    auto *state = ps.cpu().getCpuState();
+    for (uint8_t i = 1; i < 32; i++) {
+        state->setRegister(RegisterIndex(i), 0);
+    }
+}
+} // namespace
+
+TEST(BlockIr, testConstantsArePropagated) {
+    auto block = translate(PROGRAM_ADDRESS, {
+        0x3C088001, // lui $t0, 0x8001
+        0x35082345, // ori $t0, $t0, 0x2345
+        0x8D090010, // lw $t1, 0x10($t0)
+        0x250B0004, // addiu $t3, $t0, 4
+        0x012B5021, // addu $t2, $t1, $t3
+        0x00000000, // nop
+        0x01080021, // addu $zero, $t0, $t0
+        0x03E00008, // jr $ra
+        0x8D2C0000, // lw $t4, 0($t1)
+        0x3C0D0001, // lui $t5, 1
+    });
+
+    // The block ends with the delay slot
+    ASSERT_EQ(block.code.size(), 9u);
+    EXPECT_EQ(block.code[0].op, Op::Constant);
+    EXPECT_EQ(block.code[0].imm, 0x80010000u);
+    EXPECT_EQ(block.code[1].op, Op::Constant);
+    EXPECT_EQ(block.code[1].rd, 8);
+    EXPECT_EQ(block.code[1].imm, 0x80012345u);
+    EXPECT_EQ(block.code[2].op, Op::LoadWord);
+    EXPECT_TRUE(block.code[2].flags & Flags::ConstantAddress);
+    EXPECT_EQ(block.code[2].imm, 0x80012355u);
+    EXPECT_EQ(block.code[3].op, Op::Constant);
+    EXPECT_EQ(block.code[3].imm, 0x80012349u);
+    // The loaded register is not known
+    EXPECT_EQ(block.code[4].op, Op::Add);
+    EXPECT_EQ(block.code[5].op, Op::Nop);
+    EXPECT_EQ(block.code[6].op, Op::Nop);
+    EXPECT_EQ(block.code[7].op, Op::Generic);
+    EXPECT_EQ(block.code[8].op, Op::LoadWord);
+    EXPECT_FALSE(block.code[8].flags & Flags::ConstantAddress);
+}
+
+TEST(BlockIr, testDelaySlotsAreResolved) {
+    auto block = translate(PROGRAM_ADDRESS, {
+        0x3C088000, // lui $t0, 0x8000
+        0x8D092000, // lw $t1, 0x2000($t0)
+        0x25080004, // addiu $t0, $t0, 4
+        0x8D0A2000, // lw $t2, 0x2000($t0)
+        0x014A5021, // addu $t2, $t2, $t2
+        0x01005821, // addu $t3, $t0, $zero
+        0x016B5821, // addu $t3, $t3, $t3
+        0x1000FFF9, // b -7
+        0x8D0C0000, // lw $t4, 0($t0)
+    });
+
+    ASSERT_EQ(block.code.size(), 9u);
+    // Anything may be pending when the block is entered
+    EXPECT_EQ(block.code[0].flags & (Flags::CancelsLoad | Flags::RetireLoads | Flags::RetireBranch),
+              Flags::CancelsLoad | Flags::RetireLoads | Flags::RetireBranch);
+    // The next instruction does not read $t1
+    EXPECT_TRUE(block.code[1].flags & Flags::LoadResolvable);
+    EXPECT_TRUE(block.code[2].flags & Flags::CancelsLoad);
+    EXPECT_TRUE(block.code[2].flags & Flags::RetireLoads);
+    // The next instruction reads the old $t2
+    EXPECT_FALSE(block.code[3].flags & Flags::LoadResolvable);
+    EXPECT_TRUE(block.code[4].flags & Flags::CancelsLoad);
+    EXPECT_TRUE(block.code[4].flags & Flags::RetireLoads);
+    // Two instructions after the last load nothing is pending anymore
+    EXPECT_EQ(block.code[5].op, Op::Constant);
+    EXPECT_EQ(block.code[5].flags, 0);
+    EXPECT_EQ(block.code[6].flags, 0);
+    EXPECT_EQ(block.code[7].flags, Flags::RetireBranch);
+    // The delay slot is followed by the branch target
+    EXPECT_FALSE(block.code[8].flags & Flags::LoadResolvable);
+    EXPECT_TRUE(block.code[8].flags & Flags::RetireBranch);
+}
+
+TEST(BlockIr, testBlocksStopAtKernelCallVectors) {
+    auto block = translate(0x80000090, std::vector<uint32_t>(16, 0));
+    EXPECT_EQ(block.code.size(), 4u);
+    block = translate(0x800000A0, std::vector<uint32_t>(16, 0));
+    EXPECT_EQ(block.code.size(), 4u);
+    // Or at the end of the page
+    block = translate(PROGRAM_ADDRESS + MEMORY_PAGE_SIZE - 8, {});
+    EXPECT_EQ(block.code.size(), 2u);
+}
+
+TEST(BlockIr, testCachedInterpreterMatchesInterpreter) {
+    auto run = [](bool cached, bool idleSkipping) {
+        auto ps = Playstation();
+        ps.initialize();
+        ps.setCachedInterpreter(cached);
+        ps.setIdleLoopSkipping(idleSkipping);
+        startProgram(ps, SELF_MODIFYING_COUNTER);
+        std::vector<uint64_t> hashes;
+        for (int i = 0; i < 4; i++) {
+            ps.runFrame();
+            hashes.push_back(ps.stateHash());
+        }
+        // Reads through the bus are charged to the CPU, so they come after the hashes
+        hashes.push_back(ps.memory().u32(DATA_ADDRESS));
+        hashes.push_back(ps.memory().u32(DATA_ADDRESS + 4));
+        hashes.push_back(ps.memory().u32(PROGRAM_ADDRESS + 12));
+        return hashes;
+    };
+
+    auto expected = run(false, true);
+    // The program modified itself
+    EXPECT_GT(expected.back(), 0x256B0001u);
+    EXPECT_EQ(run(true, true), expected);
+    EXPECT_EQ(run(true, false), run(false, false));
+}
+
+TEST(BlockIr, testLoadsStayPendingAcrossBlocks) {
+    for (auto cached : {false, true}) {
+        auto ps = Playstation();
+        ps.initialize();
+        ps.setCachedInterpreter(cached);
+        startProgram(ps, {
+            0x3C088000, // lui $t0, 0x8000
+            0x08000404, // j 0x80001010
+            0x8D092000, // lw $t1, 0x2000($t0)
+            0x00000000, // nop
+            0x24090005, // addiu $t1, $zero, 5 (cancels the load)
+            0x8D0A2000, // lw $t2, 0x2000($t0)
+            0x01405821, // addu $t3, $t2, $zero (the old $t2)
+            0x1000FFFF, // b .
+            0x00000000, // nop
+        });
+        ps.memory().u32Write(DATA_ADDRESS, 0x1234);
+        ps.execute(12);
+
+        const auto *state = ps.cpu().getCpuState();
+        EXPECT_EQ(state->getRegister(T1), 5u) << "cached " << cached;
+        EXPECT_EQ(state->getRegister(T2), 0x1234u) << "cached " << cached;
+        EXPECT_EQ(state->getRegister(T3), 0u) << "cached " << cached;
+    }
+}
+
+TEST(BlockIr, testWrittenBlocksAreDropped) {
+    auto ps = Playstation();
+    ps.initialize();
+    ps.setCachedInterpreter(true);
+    startProgram(ps, SELF_MODIFYING_COUNTER);
+    ps.execute(20);
+    EXPECT_GT(ps.cpu().blockCache().size(), 0u);
+
+    ps.memory().u32Write(PROGRAM_ADDRESS + 0x800, 0);
+    EXPECT_EQ(ps.cpu().blockCache().size(), 0u);
+}
+
+TEST(BlockIr, testBreakpointsStopInsideBlocks) {
+    auto run = [](bool cached) {
+        auto ps = Playstation();
+        ps.initialize();
+        ps.setCachedInterpreter(cached);
+        startProgram(ps, SELF_MODIFYING_COUNTER);
+        // Right after the load of $t4, which is written late then
+        ps.cpu().breakpoints().add(PROGRAM_ADDRESS + 28);
+        ps.execute(100);
+        EXPECT_TRUE(ps.cpu().debugStop());
+        const auto *state = ps.cpu().getCpuState();
+        EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 28);
+        EXPECT_EQ(state->getRegister(T4), 0u);
+        return std::vector<uint64_t>{state->getRegister(T2), state->pendingLoad(0).value, ps.cpu().cycles(), ps.stateHash()};
+    };
+    EXPECT_EQ(run(true), run(false));
+}
+
+TEST(BlockIr, testStoredBlocksAreReused) {
+    auto path = fs::temp_directory_path() / "test_block_ir_reused.psbc";
+    auto run = [&path](bool load, bool save) {
+        auto ps = Playstation();
+        ps.initialize();
+        ps.setCachedInterpreter(true);
+        if (load) {
+            ps.loadBlockCache(path.string());
+        }
+        startProgram(ps, SELF_MODIFYING_COUNTER);
+        ps.runFrame();
+        if (save) {
+            ps.saveBlockCache(path.string());
+        }
+        return std::make_pair(ps.stateHash(), ps.cpu().blockCache().loaded());
+    };
+
+    auto [expected, none] = run(false, true);
+    EXPECT_EQ(none, 0u);
+    auto [hash, loaded] = run(true, false);
+    fs::remove(path);
+    EXPECT_EQ(hash, expected);
+    EXPECT_GT(loaded, 0u);
+}
+
+TEST(BlockIr, testStoredBlocksNeedTheirCode) {
+    auto path = fs::temp_directory_path() / "test_block_ir_code.psbc";
+    auto page = std::array<uint8_t, MEMORY_PAGE_SIZE>{};
+    std::memcpy(page.data() + (PROGRAM_ADDRESS & MEMORY_PAGE_MASK), SELF_MODIFYING_COUNTER.data(),
+                SELF_MODIFYING_COUNTER.size() * sizeof(uint32_t));
+    auto block = BlockIr::translate(PROGRAM_ADDRESS, page.data());
+    BlockCacheFile::write(path.string(), 1234, {&block});
+
+    auto file = BlockCacheFile(path.string(), 1234);
+    EXPECT_EQ(file.size(), 1u);
+    auto stored = file.block(PROGRAM_ADDRESS, page.data());
+    ASSERT_TRUE(stored.has_value());
+    ASSERT_EQ(stored->code.size(), block.code.size());
+    for (size_t i = 0; i < block.code.size(); i++) {
+        EXPECT_EQ(stored->code[i].op, block.code[i].op);
+        EXPECT_EQ(stored->code[i].flags, block.code[i].flags);
+        EXPECT_EQ(stored->code[i].imm, block.code[i].imm);
+    }
+    EXPECT_FALSE(file.block(PROGRAM_ADDRESS + 4, page.data()).has_value());
+
+    // The immediate of the addiu changed
+    page[(PROGRAM_ADDRESS & MEMORY_PAGE_MASK) + 12] = 2;
+    EXPECT_FALSE(file.block(PROGRAM_ADDRESS, page.data()).has_value());
+
+    EXPECT_THROW(BlockCacheFile(path.string(), 4321), std::runtime_error);
+    fs::remove(path);
+}
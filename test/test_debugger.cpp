@@ -0,0 +1,228 @@
+#include "test_program.hpp"
+
+#include "libps/breakpoints.hpp"
+#include "libps/gdb_server.hpp"
+#include "libps/gdb_stub.hpp"
+#include "libps/memory.hpp"
+#include "libps/playstation.hpp"
+#include "libps/ram.hpp"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Two delay slot branches around a store to 0x200 and a load from 0x100
+const std::vector<uint32_t> PROGRAM = {
+    0x24010001, // 1000: addiu $1, $0, 1
+    0x10000002, // 1004: beq $0, $0, 0x1010
+    0x24210001, // 1008: addiu $1, $1, 1
+    0x24210010, // 100c: addiu $1, $1, 0x10
+    0xAC010200, // 1010: sw $1, 0x200($0)
+    0x8C020100, // 1014: lw $2, 0x100($0)
+    0x1000FFFF, // 1018: beq $0, $0, 0x1018
+    0x00000000, // 101c: nop
+};
+
+void startProgram(Playstation &ps) {
+    ps.initialize();
+    loadProgram(ps, PROGRAM);
+}
+
+struct WatchpointHit {
+    uint32_t address;
+    bool write;
+};
+
+class RecordingListener : public IWatchpointListener {
+public:
+    std::vector<WatchpointHit> hits;
+
+    void watchpointHit(const Watchpoint &, uint32_t address, bool write) override {
+        hits.push_back({address, write});
+    }
+};
+} // namespace
+
+TEST(Debugger, testBreakpointPages) {
+    auto breakpoints = Breakpoints();
+    EXPECT_FALSE(breakpoints.pageHasBreakpoints(0x80001010));
+
+    breakpoints.add(0x00001010);
+    breakpoints.add(0x80001ffc);
+    // All mirrors of the physical address
+    EXPECT_TRUE(breakpoints.contains(0x80001010));
+    EXPECT_TRUE(breakpoints.contains(0xA0001010));
+    EXPECT_FALSE(breakpoints.contains(0x80001014));
+    EXPECT_TRUE(breakpoints.pageHasBreakpoints(0x80001000));
+    EXPECT_FALSE(breakpoints.pageHasBreakpoints(0x80002000));
+
+    // The page stays marked until its last breakpoint is removed
+    EXPECT_TRUE(breakpoints.remove(0x80001010));
+    EXPECT_FALSE(breakpoints.remove(0x80001010));
+    EXPECT_TRUE(breakpoints.pageHasBreakpoints(0x80001000));
+    EXPECT_TRUE(breakpoints.remove(0x00001ffc));
+    EXPECT_FALSE(breakpoints.pageHasBreakpoints(0x80001000));
+    EXPECT_EQ(breakpoints.size(), 0u);
+}
+
+TEST(Debugger, testWatchpointsBypassPageTable) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto listener = RecordingListener();
+    memory.setWatchpointListener(&listener);
+
+    memory.addWatchpoint(Watchpoint{0x80000200, 4, WatchpointType::Write});
+    memory.u32Write(0xA0000200, 0x1234);
+    memory.u32Write(0x00000204, 0x5678);
+    EXPECT_EQ(memory.u32(0x80000200), 0x1234u);
+    memory.u8Write(0x00000203, 0xFF);
+
+    ASSERT_EQ(listener.hits.size(), 2u);
+    EXPECT_EQ(listener.hits[0].address, 0xA0000200u);
+    EXPECT_TRUE(listener.hits[0].write);
+    EXPECT_EQ(listener.hits[1].address, 0x00000203u);
+
+    // Debugger accesses are not reported
+    EXPECT_TRUE(memory.debugWrite(0x80000200, 0x42));
+    EXPECT_EQ(memory.debugRead(0x80000200), 0x42);
+    EXPECT_FALSE(memory.debugRead(0x1F000000 - 4).has_value());
+    // Registers that pop a FIFO when read are left alone, status registers are shown
+    EXPECT_FALSE(memory.debugRead(0x1F801040).has_value());
+    EXPECT_FALSE(memory.debugRead(0x1F801820).has_value());
+    EXPECT_EQ(memory.debugRead(0x1F801060), 0x88);
+    EXPECT_EQ(listener.hits.size(), 2u);
+
+    EXPECT_TRUE(memory.removeWatchpoint(Watchpoint{0x00000200, 4, WatchpointType::Write}));
+    EXPECT_FALSE(memory.removeWatchpoint(Watchpoint{0x00000200, 4, WatchpointType::Write}));
+    memory.u32Write(0x80000200, 0);
+    EXPECT_EQ(listener.hits.size(), 2u);
+
+    memory.addWatchpoint(Watchpoint{0x1F800010, 2, WatchpointType::Read});
+    memory.u16Write(0x1F800010, 0xBEEF);
+    EXPECT_EQ(memory.u16(0x9F800010), 0xBEEFu);
+    ASSERT_EQ(listener.hits.size(), 3u);
+    EXPECT_FALSE(listener.hits[2].write);
+}
+
+TEST(Debugger, testStepOverDelaySlot) {
+    auto ps = Playstation();
+    startProgram(ps);
+    const auto *state = ps.cpu().getCpuState();
+
+    ps.step();
+    EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 0x4);
+
+    // The branch and its delay slot are a single step, even with a breakpoint in the slot
+    ps.cpu().breakpoints().add(PROGRAM_ADDRESS + 0x8);
+    ps.step();
+    EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 0x10);
+    EXPECT_EQ(state->getRegister(1), 2u);
+    EXPECT_FALSE(ps.cpu().debugStop().has_value());
+}
+
+TEST(Debugger, testBreakpointAndWatchpointStops) {
+    auto ps = Playstation();
+    startProgram(ps);
+    const auto *state = ps.cpu().getCpuState();
+
+    ps.cpu().breakpoints().add(PROGRAM_ADDRESS + 0x10);
+    ps.memory().addWatchpoint(Watchpoint{0x100, 4, WatchpointType::Read});
+
+    EXPECT_EQ(ps.execute(1000), 3u);
+    ASSERT_TRUE(ps.cpu().debugStop().has_value());
+    EXPECT_EQ(ps.cpu().debugStop()->reason, DebugStop::Reason::Breakpoint);
+    EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 0x10);
+
+    // Resuming executes the instruction under the breakpoint, the load stops after it completed
+    ps.cpu().resume();
+    EXPECT_EQ(ps.execute(1000), 2u);
+    ASSERT_TRUE(ps.cpu().debugStop().has_value());
+    EXPECT_EQ(ps.cpu().debugStop()->reason, DebugStop::Reason::Watchpoint);
+    EXPECT_EQ(ps.cpu().debugStop()->address, 0x100u);
+    EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 0x18);
+    EXPECT_EQ(ps.memory().u32(0x200), 2u);
+}
+
+TEST(Debugger, testGdbPackets) {
+    auto ps = Playstation();
+    startProgram(ps);
+    auto stub = GdbStub(&ps);
+
+    EXPECT_EQ(GdbStub::frame("OK"), "$OK#9a");
+    EXPECT_EQ(stub.handlePacket("qSupported:multiprocess+"), "PacketSize=1000");
+    EXPECT_EQ(stub.handlePacket("?"), "S05");
+    EXPECT_EQ(stub.handlePacket("g").size(), GdbStub::REGISTER_COUNT * 8);
+    EXPECT_EQ(stub.handlePacket("p25"), "00100080");
+    EXPECT_EQ(stub.handlePacket("vMustReplyEmpty"), "");
+
+    EXPECT_EQ(stub.handlePacket("Z0,80001014,4"), "OK");
+    EXPECT_EQ(stub.handlePacket("c"), "S05");
+    EXPECT_EQ(stub.handlePacket("p25"), "14100080");
+    EXPECT_EQ(stub.handlePacket("p1"), "02000000");
+    EXPECT_EQ(stub.handlePacket("m80000200,4"), "02000000");
+
+    EXPECT_EQ(stub.handlePacket("M80000100,2:abcd"), "OK");
+    EXPECT_EQ(ps.memory().u16(0x100), 0xCDABu);
+    EXPECT_EQ(stub.handlePacket("P2=78563412"), "OK");
+    EXPECT_EQ(ps.cpu().getCpuState()->getRegister(2), 0x12345678u);
+
+    EXPECT_EQ(stub.handlePacket("Z3,100,4"), "OK");
+    EXPECT_EQ(stub.handlePacket("s"), "T05rwatch:00000100;");
+    EXPECT_EQ(stub.handlePacket("p25"), "18100080");
+    EXPECT_EQ(stub.handlePacket("z3,100,4"), "OK");
+    EXPECT_EQ(stub.handlePacket("z0,80001014,4"), "OK");
+
+    EXPECT_EQ(stub.handlePacket("D"), "OK");
+    EXPECT_FALSE(stub.attached());
+    EXPECT_FALSE(stub.killed());
+}
+
+TEST(Debugger, testGdbServerRejectsInvalidPorts) {
+    auto ps = Playstation();
+    auto stub = GdbStub(&ps);
+    EXPECT_THROW(GdbServer::serve(stub, "gdb"), std::runtime_error);
+    EXPECT_THROW(GdbServer::serve(stub, "2345x"), std::runtime_error);
+    EXPECT_THROW(GdbServer::serve(stub, "70000"), std::runtime_error);
+}
+
+#ifndef _WIN32
+TEST(Debugger, testGdbServerDetachesWhenConnectionCloses) {
+    auto ps = Playstation();
+    startProgram(ps);
+    auto stub = GdbStub(&ps);
+    auto path = (std::filesystem::temp_directory_path() / "test_gdb_server.sock").string();
+
+    // Continues the endless loop at the end of the program and hangs up
+    auto client = std::thread([&path]() {
+        auto address = sockaddr_un{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+        auto socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        // The server may not be listening yet
+        while (connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(socket);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        }
+        auto packet = GdbStub::frame("c");
+        send(socket, packet.data(), packet.size(), 0);
+        char ack;
+        recv(socket, &ack, 1, 0);
+        close(socket);
+    });
+
+    GdbServer::serve(stub, "unix:" + path);
+    client.join();
+    std::filesystem::remove(path);
+    EXPECT_FALSE(stub.attached());
+    EXPECT_FALSE(stub.killed());
+}
+#endif
@@ -0,0 +1,46 @@
+#include "libps/disassembler.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+std::string disassemble(uint32_t raw, uint32_t address = 0x80001000) {
+    char buffer[Disassembler::MAX_LENGTH];
+    auto length = Disassembler::disassemble(raw, address, buffer, sizeof(buffer));
+    EXPECT_EQ(length, std::char_traits<char>::length(buffer));
+    return buffer;
+}
+} // namespace
+
+TEST(Disassembler, testOperandFormats) {
+    EXPECT_EQ(disassemble(0x00000000), "nop");
+    EXPECT_EQ(disassemble(0x27BDFFE8), "addiu $29, $29, -0x18");
+    EXPECT_EQ(disassemble(0x3C011F80), "lui $1, 0x1f80");
+    EXPECT_EQ(disassemble(0x34210010), "ori $1, $1, 0x10");
+    EXPECT_EQ(disassemble(0x00641021), "addu $2, $3, $4");
+    EXPECT_EQ(disassemble(0x00021100), "sll $2, $2, 4");
+    EXPECT_EQ(disassemble(0x8FBF0014), "lw $31, 0x14($29)");
+    EXPECT_EQ(disassemble(0xAC20FFFC), "sw $0, -0x4($1)");
+    EXPECT_EQ(disassemble(0x03E00008), "jr $31");
+    EXPECT_EQ(disassemble(0x0C000400, 0x00000000), "jal 0x00001000");
+    EXPECT_EQ(disassemble(0x1443FFFF), "bne $2, $3, 0x80001000");
+    EXPECT_EQ(disassemble(0x04110002), "bgezal $0, 0x8000100c");
+    EXPECT_EQ(disassemble(0x0000000C), "syscall 0x0");
+}
+
+TEST(Disassembler, testCoprocessors) {
+    EXPECT_EQ(disassemble(0x408C6000), "mtc0 $12, cop0_$12");
+    EXPECT_EQ(disassemble(0x42000010), "rfe");
+    EXPECT_EQ(disassemble(0x42000011), "illegal 0x42000011");
+    EXPECT_EQ(disassemble(0x48C20800), "ctc2 $2, cop2c_$1");
+    EXPECT_EQ(disassemble(0x4A180001), "rtps 0x180001");
+    EXPECT_EQ(disassemble(0xC8410004), "lwc2 cop2_$1, 0x4($2)");
+    EXPECT_EQ(disassemble(0xFC000000), "illegal 0xfc000000");
+}
+
+TEST(Disassembler, testTruncation) {
+    char buffer[8];
+    auto length = Disassembler::disassemble(0x27BDFFE8, 0, buffer, sizeof(buffer));
+    EXPECT_EQ(length, 7u);
+    EXPECT_STREQ(buffer, "addiu $");
+}
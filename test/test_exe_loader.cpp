@@ -0,0 +1,166 @@
+#include "libps/playstation.hpp"
+#include "libps/romheader.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr uint32_t ENTRY_POINT = 0x80010000;
+constexpr uint32_t BSS_ADDRESS = 0x80020000;
+constexpr uint32_t BSS_SIZE = 0x100;
+
+constexpr uint32_t PROGRAM[] = {
+    0x2402002A, // addiu $2, $0, 42
+    0x1000FFFF, // beq $0, $0, -1
+    0x00000000, // nop
+    0x00000000, // nop
+};
+
+void putWord(ByteBuffer &data, uint32_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+ByteBuffer buildExecutable() {
+    auto data = ByteBuffer(RomHeader::SIZE + 0x800, 0);
+    std::memcpy(data.data(), RomHeader::MAGIC, sizeof(RomHeader::MAGIC));
+    putWord(data, 0x10, ENTRY_POINT);
+    putWord(data, 0x14, 0x8001F000);
+    putWord(data, 0x18, ENTRY_POINT);
+    putWord(data, 0x1C, 0x800);
+    putWord(data, 0x28, BSS_ADDRESS);
+    putWord(data, 0x2C, BSS_SIZE);
+    putWord(data, 0x30, 0x801FFF00);
+    putWord(data, 0x34, 0xF0);
+    for (uint32_t i = 0; i < std::size(PROGRAM); i++) {
+        putWord(data, RomHeader::SIZE + i * 4, PROGRAM[i]);
+    }
+    return data;
+}
+
+fs::path writeFile(const std::string &name, const ByteBuffer &data) {
+    auto path = fs::temp_directory_path() / name;
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(data.data()), data.size());
+    return path;
+}
+
+// Loads an executable behind a BIOS which jumps straight to the shell
+void loadBehindBios(Playstation &ps) {
+    auto bios = ByteBuffer(512 * 1024, 0);
+    putWord(bios, 0, 0x3C088003); // lui $8, 0x8003
+    putWord(bios, 4, 0x01000008); // jr $8
+    auto biosPath = writeFile("test_exe_loader.bios", bios);
+    auto exePath = writeFile("test_exe_loader_hook.exe", buildExecutable());
+
+    ps.initialize();
+    ps.intializeBios(biosPath.string());
+    ps.loadExecutable(exePath.string(), false);
+    fs::remove(biosPath);
+    fs::remove(exePath);
+}
+
+void fillBss(Playstation &ps) {
+    for (uint32_t i = 0; i < BSS_SIZE; i += 4) {
+        ps.memory().u32Write(BSS_ADDRESS + i, 0xDEADBEEF);
+    }
+}
+
+void expectStarted(Playstation &ps) {
+    auto *state = ps.cpu().getCpuState();
+    EXPECT_EQ(state->getRegister(RegisterIndex(2)), 42u);
+    EXPECT_EQ(state->getRegister(RegisterIndex(28)), 0x8001F000u);
+    EXPECT_EQ(state->getRegister(RegisterIndex(29)), 0x801FFFF0u);
+    EXPECT_EQ(state->getRegister(RegisterIndex(30)), 0x801FFFF0u);
+    EXPECT_EQ(ps.memory().u32(ENTRY_POINT), PROGRAM[0]);
+    for (uint32_t i = 0; i < BSS_SIZE; i += 4) {
+        ASSERT_EQ(ps.memory().u32(BSS_ADDRESS + i), 0u);
+    }
+}
+} // namespace
+
+TEST(ExeLoader, testParseHeader) {
+    auto data = buildExecutable();
+    auto header = RomHeader::parse(data);
+    EXPECT_EQ(header.pc, ENTRY_POINT);
+    EXPECT_EQ(header.textAddress, ENTRY_POINT);
+    EXPECT_EQ(header.textSize, 0x800u);
+    EXPECT_EQ(header.bssSize, BSS_SIZE);
+
+    data.resize(data.size() - 1);
+    EXPECT_THROW(RomHeader::parse(data), std::runtime_error);
+
+    data = buildExecutable();
+    data[3] = 'Y';
+    EXPECT_THROW(RomHeader::parse(data), std::runtime_error);
+}
+
+TEST(ExeLoader, testRejectsSegmentsPastRam) {
+    auto ps = Playstation();
+    ps.initialize();
+
+    // The end of the BSS wraps around to 0
+    auto data = buildExecutable();
+    putWord(data, 0x28, 0x80000010);
+    putWord(data, 0x2C, 0xFFFFFFF0);
+    auto path = writeFile("test_exe_loader_bss.exe", data);
+    EXPECT_THROW(ps.loadExecutable(path.string(), true), std::runtime_error);
+
+    data = buildExecutable();
+    putWord(data, 0x18, 0x801FFC00);
+    writeFile("test_exe_loader_bss.exe", data);
+    EXPECT_THROW(ps.loadExecutable(path.string(), true), std::runtime_error);
+    fs::remove(path);
+}
+
+TEST(ExeLoader, testSkipBios) {
+    auto path = writeFile("test_exe_loader_skip.exe", buildExecutable());
+    auto ps = Playstation();
+    ps.initialize();
+    fillBss(ps);
+
+    ps.loadExecutable(path.string(), true);
+    fs::remove(path);
+    EXPECT_EQ(ps.cpu().getCpuState()->getProgramCounter(), ENTRY_POINT);
+
+    ps.execute(4);
+    expectStarted(ps);
+}
+
+TEST(ExeLoader, testStartsWhenBiosReachesShell) {
+    auto ps = Playstation();
+    loadBehindBios(ps);
+    fillBss(ps);
+    EXPECT_EQ(ps.cpu().getCpuState()->getProgramCounter(), 0xBFC00000u);
+
+    EXPECT_EQ(ps.execute(10), 10u);
+    expectStarted(ps);
+    EXPECT_FALSE(ps.cpu().debugStop());
+    EXPECT_EQ(ps.cpu().breakpoints().size(), 0u);
+}
+
+TEST(ExeLoader, testShellHookIsNotABreakpoint) {
+    auto ps = Playstation();
+    loadBehindBios(ps);
+    fillBss(ps);
+    EXPECT_EQ(ps.cpu().breakpoints().size(), 0u);
+
+    // A breakpoint of the debugger at the shell entry stops there first
+    ps.cpu().breakpoints().add(0x80030000);
+    ps.execute(10);
+    ASSERT_TRUE(ps.cpu().debugStop());
+    EXPECT_EQ(ps.cpu().debugStop()->reason, DebugStop::Reason::Breakpoint);
+    EXPECT_EQ(ps.cpu().getCpuState()->getProgramCounter(), 0x80030000u);
+    EXPECT_TRUE(ps.executablePending());
+
+    // Detaching clears the breakpoints, the executable still starts
+    ps.cpu().breakpoints().clear();
+    ps.cpu().resume();
+    ps.execute(10);
+    expectStarted(ps);
+    EXPECT_FALSE(ps.executablePending());
+}
@@ -0,0 +1,146 @@
+#include "libps/gte.hpp"
+#include "libps/gte_math.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+constexpr uint32_t RTPS = 0x0180001;
+constexpr uint32_t NCLIP = 0x1400006;
+constexpr uint32_t AVSZ3 = 0x158002D;
+constexpr uint32_t SQR_SF = 0x0A80428;
+
+Gte createGte() {
+    auto gte = Gte();
+    gte.reset();
+    return gte;
+}
+} // namespace
+
+TEST(Gte, testMatrixVectorProductsMatchScalar) {
+    auto random = std::mt19937(1234);
+
+    for (int i = 0; i < 1000; i++) {
+        int16_t matrix[9];
+        int16_t vector[3];
+        for (auto &value : matrix) {
+            value = static_cast<int16_t>(random());
+        }
+        for (auto &value : vector) {
+            value = static_cast<int16_t>(random());
+        }
+
+        int32_t products[9];
+        int32_t scalar[9];
+        GteMath::matrixVectorProducts(matrix, vector, products);
+        GteMath::matrixVectorProductsScalar(matrix, vector, scalar);
+
+        for (int j = 0; j < 9; j++) {
+            EXPECT_EQ(products[j], scalar[j]) << "iteration " << i << " element " << j;
+        }
+    }
+}
+
+TEST(Gte, testRtpsProjectsVertex) {
+    auto gte = createGte();
+    // Identity rotation, translated 1000 units along z
+    gte.setControlRegister(0, 0x1000);
+    gte.setControlRegister(2, 0x1000);
+    gte.setControlRegister(4, 0x1000);
+    gte.setControlRegister(7, 1000);
+    gte.setControlRegister(26, 1000);
+    gte.setControlRegister(24, 160 << 16);
+    gte.setControlRegister(25, 120 << 16);
+
+    gte.setDataRegister(0, (50 << 16) | 100);
+    gte.setDataRegister(1, 0);
+    gte.execute(RTPS);
+
+    EXPECT_EQ(gte.getDataRegister(25), 100u);
+    EXPECT_EQ(gte.getDataRegister(26), 50u);
+    EXPECT_EQ(gte.getDataRegister(27), 1000u);
+    EXPECT_EQ(gte.getDataRegister(19), 1000u);
+    EXPECT_EQ(gte.getDataRegister(14), (170u << 16) | 260u);
+    EXPECT_EQ(gte.getControlRegister(31), 0u);
+}
+
+TEST(Gte, testRtpsDivideOverflow) {
+    auto gte = createGte();
+    gte.setControlRegister(0, 0x1000);
+    gte.setControlRegister(2, 0x1000);
+    gte.setControlRegister(4, 0x1000);
+    gte.setControlRegister(7, 400);
+    gte.setControlRegister(26, 1000);
+
+    gte.execute(RTPS);
+
+    auto flag = gte.getControlRegister(31);
+    EXPECT_TRUE(flag & GteFlags::DivideOverflow);
+    EXPECT_TRUE(flag & GteFlags::Error);
+}
+
+TEST(Gte, testNclip) {
+    auto gte = createGte();
+    gte.setDataRegister(12, 0);
+    gte.setDataRegister(13, 10);
+    gte.setDataRegister(14, 10 << 16);
+
+    gte.execute(NCLIP);
+
+    EXPECT_EQ(gte.getDataRegister(24), 100u);
+}
+
+TEST(Gte, testAvsz3) {
+    auto gte = createGte();
+    gte.setControlRegister(29, 0x555);
+    gte.setDataRegister(17, 300);
+    gte.setDataRegister(18, 300);
+    gte.setDataRegister(19, 300);
+
+    gte.execute(AVSZ3);
+
+    EXPECT_EQ(gte.getDataRegister(24), 0x555u * 900);
+    EXPECT_EQ(gte.getDataRegister(7), (0x555u * 900) >> 12);
+}
+
+TEST(Gte, testSqrSaturatesWithLm) {
+    auto gte = createGte();
+    gte.setDataRegister(9, 0x1000);
+    gte.setDataRegister(10, static_cast<uint32_t>(-0x8000));
+    gte.setDataRegister(11, 0x2000);
+
+    gte.execute(SQR_SF);
+
+    EXPECT_EQ(gte.getDataRegister(9), 0x1000u);
+    EXPECT_EQ(gte.getDataRegister(10), 0x7FFFu);
+    EXPECT_EQ(gte.getDataRegister(11), 0x4000u);
+    EXPECT_EQ(gte.getControlRegister(31), GteFlags::IR2Saturated | GteFlags::Error);
+}
+
+TEST(Gte, testRegisterQuirks) {
+    auto gte = createGte();
+
+    // H is unsigned but reads back sign extended
+    gte.setControlRegister(26, 0x8000);
+    EXPECT_EQ(gte.getControlRegister(26), 0xFFFF8000u);
+
+    gte.setDataRegister(30, 0xFFFF0000);
+    EXPECT_EQ(gte.getDataRegister(31), 16u);
+    gte.setDataRegister(30, 0);
+    EXPECT_EQ(gte.getDataRegister(31), 32u);
+
+    gte.setDataRegister(28, 0x7FFF);
+    EXPECT_EQ(gte.getDataRegister(9), 0xF80u);
+    EXPECT_EQ(gte.getDataRegister(29), 0x7FFFu);
+
+    gte.setDataRegister(15, 1);
+    gte.setDataRegister(15, 2);
+    EXPECT_EQ(gte.getDataRegister(13), 1u);
+    EXPECT_EQ(gte.getDataRegister(14), 2u);
+    EXPECT_EQ(gte.getDataRegister(15), 2u);
+
+    gte.setControlRegister(31, 0xFFFFFFFF);
+    EXPECT_EQ(gte.getControlRegister(31), 0xFFFFF000u);
+    gte.setControlRegister(31, 0x1000);
+    EXPECT_EQ(gte.getControlRegister(31), 0x1000u);
+}
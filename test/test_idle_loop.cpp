@@ -0,0 +1,136 @@
+#include "test_program.hpp"
+
+#include "libps/playstation.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+constexpr uint32_t FLAG_ADDRESS = 0x80002000;
+
+const auto T0 = RegisterIndex(8);
+const auto T1 = RegisterIndex(9);
+const auto T2 = RegisterIndex(10);
+
+void writeProgram(Playstation &ps, const std::vector<uint32_t> &program) {
+    loadProgram(ps, program);
+    ps.memory().u32Write(FLAG_ADDRESS, 0);
+    ps.cpu().getCpuState()->setRegister(T1, 0);
+}
+
+// Waits until the word at FLAG_ADDRESS is set in $t1, then spins on the last branch
+const std::vector<uint32_t> WAIT_FOR_FLAG = {
+    0x3C088000, // lui $t0, 0x8000
+    0x8D092000, // lw $t1, 0x2000($t0)
+    0x00000000, // nop
+    0x1120FFFC, // beqz $t1, -4
+    0x00000000, // nop
+    0x1000FFFF, // b .
+    0x00000000, // nop
+};
+} // namespace
+
+TEST(IdleLoop, testPollingLoopSkipsToTheNextEvent) {
+    auto ps = Playstation();
+    ps.initialize();
+    writeProgram(ps, WAIT_FOR_FLAG);
+
+    constexpr uint64_t eventCycle = 100000;
+    uint64_t firedAt = 0;
+    ps.scheduler().setCallback(Scheduler::Event::SioTransfer, [&ps, &firedAt](uint64_t) {
+        firedAt = ps.cpu().cycles();
+        ps.memory().u32Write(FLAG_ADDRESS, 1);
+    });
+    ps.scheduler().schedule(Scheduler::Event::SioTransfer, eventCycle);
+
+    // Waiting takes far fewer instructions than the cycles until the event
+    auto *state = ps.cpu().getCpuState();
+    uint64_t instructions = 0;
+    while (state->getRegister(T1) == 0 && instructions < eventCycle) {
+        instructions += ps.execute(64);
+    }
+    EXPECT_EQ(state->getRegister(T1), 1u);
+    EXPECT_LT(instructions, eventCycle / 20);
+    EXPECT_GE(firedAt, eventCycle);
+    EXPECT_LT(firedAt, eventCycle + 200);
+    EXPECT_GT(ps.idleCycles(), eventCycle / 2);
+
+    // The branch to itself waits for an interrupt, a pending one is not skipped over
+    auto idleCycles = ps.idleCycles();
+    ps.execute(1000);
+    EXPECT_GT(ps.idleCycles(), idleCycles);
+    ps.interruptController().request(Interrupt::VBlank);
+    ps.interruptController().u32Write(4, 1);
+    idleCycles = ps.idleCycles();
+    ps.execute(1000);
+    EXPECT_EQ(ps.idleCycles(), idleCycles);
+}
+
+TEST(IdleLoop, testSkippingKeepsTheResult) {
+    auto run = [](bool skipping) {
+        auto ps = Playstation();
+        ps.initialize();
+        ps.setIdleLoopSkipping(skipping);
+        writeProgram(ps, WAIT_FOR_FLAG);
+        ps.scheduler().setCallback(Scheduler::Event::SioTransfer, [&ps](uint64_t) {
+            ps.memory().u32Write(FLAG_ADDRESS, 1);
+        });
+        ps.scheduler().schedule(Scheduler::Event::SioTransfer, 20000);
+        while (ps.cpu().getCpuState()->getRegister(T1) == 0) {
+            ps.execute(64);
+        }
+        return std::make_pair(ps.cpu().getCpuState()->getRegister(T1), ps.idleCycles());
+    };
+
+    auto [skippedValue, skippedCycles] = run(true);
+    auto [value, cycles] = run(false);
+    EXPECT_EQ(skippedValue, value);
+    EXPECT_GT(skippedCycles, 0u);
+    EXPECT_EQ(cycles, 0u);
+}
+
+TEST(IdleLoop, testLoopsDoingWorkRun) {
+    auto ps = Playstation();
+    ps.initialize();
+
+    // Counting loop, $t0 is carried from one iteration to the next
+    writeProgram(ps, {
+                         0x2508FFFF, // addiu $t0, $t0, -1
+                         0x1500FFFE, // bnez $t0, -2
+                         0x00000000, // nop
+                         0x1000FFFF, // b .
+                         0x00000000, // nop
+                     });
+    ps.cpu().getCpuState()->setRegister(T0, 1000);
+    ps.execute(999);
+    EXPECT_EQ(ps.cpu().getCpuState()->getRegister(T0), 667u);
+    EXPECT_EQ(ps.idleCycles(), 0u);
+
+    // Reads of the SIO data register at 0x1F801040 pop the receive FIFO
+    writeProgram(ps, {
+                         0x3C081F80, // lui $t0, 0x1F80
+                         0x81091040, // lb $t1, 0x1040($t0)
+                         0x1000FFFD, // b -3
+                         0x00000000, // nop
+                     });
+    ps.execute(1000);
+    EXPECT_EQ(ps.idleCycles(), 0u);
+}
+
+TEST(IdleLoop, testOverwrittenLoopIsAnalyzedAgain) {
+    auto ps = Playstation();
+    ps.initialize();
+    writeProgram(ps, WAIT_FOR_FLAG);
+    ps.cpu().getCpuState()->setRegister(T2, 0);
+    ps.scheduler().setCallback(Scheduler::Event::SioTransfer, [](uint64_t) {});
+    ps.scheduler().schedule(Scheduler::Event::SioTransfer, 1000000);
+    ps.execute(640);
+    EXPECT_GT(ps.idleCycles(), 0u);
+
+    // The delay slot now counts in $t2, so the loop does work
+    ps.memory().u32Write(PROGRAM_ADDRESS + 16, 0x254A0001); // addiu $t2, $t2, 1
+    auto idleCycles = ps.idleCycles();
+    ps.execute(640);
+    EXPECT_EQ(ps.idleCycles(), idleCycles);
+    EXPECT_GT(ps.cpu().getCpuState()->getRegister(T2), 100u);
+}
@@ -8,11 +8,13 @@
 using testing::_;
 using testing::Return;
 
+namespace {
 class MockMemory : public Memory {
 public:
     MOCK_METHOD(uint32_t, u32, (uint32_t address), (override));
     MOCK_METHOD(void, u32Write, (uint32_t address, uint32_t value), (override));
 };
+} // namespace
 
 TEST(LoadDelaySlot, testLoadDelaySlotNextRead) {
     spdlog::set_level(spdlog::level::trace);
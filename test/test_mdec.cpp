@@ -0,0 +1,263 @@
+#include "libps/dma.hpp"
+#include "libps/interrupt_controller.hpp"
+#include "libps/mdec.hpp"
+#include "libps/mdec_dsp.hpp"
+#include "libps/memory.hpp"
+#include "libps/ram.hpp"
+#include "libps/scheduler.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr uint32_t DMA_MDEC_IN = 0x1F801080;
+constexpr uint32_t DMA_MDEC_OUT = 0x1F801090;
+constexpr uint32_t DMA_CONTROL = 0x1F8010F0;
+constexpr uint32_t DMA_INTERRUPT = 0x1F8010F4;
+constexpr uint32_t MDEC_DATA = 0x1F801820;
+constexpr uint32_t MDEC_CONTROL = 0x1F801824;
+
+constexpr uint32_t INPUT_ADDRESS = 0x8000;
+constexpr uint32_t OUTPUT_ADDRESS = 0x10000;
+
+// Standard IDCT scale table of the PSX libraries
+constexpr uint16_t SCALE_TABLE[64] = {
+    0x5A82, 0x5A82, 0x5A82, 0x5A82, 0x5A82, 0x5A82, 0x5A82, 0x5A82,
+    0x7D8A, 0x6A6D, 0x471C, 0x18F8, 0xE707, 0xB8E3, 0x9592, 0x8275,
+    0x7641, 0x30FB, 0xCF04, 0x89BE, 0x89BE, 0xCF04, 0x30FB, 0x7641,
+    0x6A6D, 0xE707, 0x8275, 0xB8E3, 0x471C, 0x7D8A, 0x18F8, 0x9592,
+    0x5A82, 0xA57D, 0xA57D, 0x5A82, 0x5A82, 0xA57D, 0xA57D, 0x5A82,
+    0x471C, 0x8275, 0x18F8, 0x6A6D, 0x9592, 0xE707, 0x7D8A, 0xB8E3,
+    0x30FB, 0x89BE, 0x7641, 0xCF04, 0xCF04, 0x7641, 0x89BE, 0x30FB,
+    0x18F8, 0xB8E3, 0x6A6D, 0x8275, 0x7D8A, 0x9592, 0x471C, 0xE707};
+
+std::array<int16_t, 64> scaleTable() {
+    std::array<int16_t, 64> table;
+    for (uint32_t i = 0; i < 64; i++) {
+        table[i] = static_cast<int16_t>(static_cast<int16_t>(SCALE_TABLE[i]) / 8);
+    }
+    return table;
+}
+
+// Run length data of a macroblock: DC only blocks in Cr, Cb, Y1..Y4 order
+std::vector<uint16_t> macroblock(std::initializer_list<int16_t> dc) {
+    std::vector<uint16_t> data;
+    for (auto value : dc) {
+        data.push_back(static_cast<uint16_t>((1 << 10) | (value & 0x3FF)));
+        data.push_back(MdecDsp::END_OF_BLOCK);
+    }
+    return data;
+}
+
+// Devices around the MDEC with a manual clock
+class MdecHarness {
+public:
+    uint64_t now = 0;
+    Memory memory;
+    Scheduler scheduler;
+    InterruptController interrupts;
+    Mdec mdec{&scheduler};
+    Dma dma{&memory, &interrupts, &mdec};
+
+    MdecHarness() {
+        scheduler.setClock([this]() { return now; });
+        memory.setRam(std::make_unique<Ram>());
+        memory.setDma(&dma);
+        memory.setMdec(&mdec);
+        memory.setInterruptController(&interrupts);
+        memory.u32Write(DMA_CONTROL, 0x88);
+
+        memory.u32Write(MDEC_DATA, 0x40000001);
+        for (uint32_t i = 0; i < 32; i++) {
+            memory.u32Write(MDEC_DATA, 0x02020202);
+        }
+        memory.u32Write(MDEC_DATA, 0x60000000);
+        for (uint32_t i = 0; i < 64; i += 2) {
+            memory.u32Write(MDEC_DATA, SCALE_TABLE[i] | (SCALE_TABLE[i + 1] << 16));
+        }
+    }
+
+    // Copies a decode command and its data to RAM, returns the number of words
+    uint32_t storeCommand(uint32_t command, const std::vector<uint16_t> &data) {
+        auto words = static_cast<uint32_t>(data.size() / 2);
+        memory.u32Write(INPUT_ADDRESS, command | words);
+        for (uint32_t i = 0; i < words; i++) {
+            memory.u32Write(INPUT_ADDRESS + 4 + i * 4, data[i * 2] | (data[i * 2 + 1] << 16));
+        }
+        return words + 1;
+    }
+
+    void advance(uint64_t cycles) {
+        now += cycles;
+        scheduler.run(now);
+    }
+};
+} // namespace
+
+TEST(Mdec, testIdctMatchesScalar) {
+    auto engine = std::mt19937(41);
+    auto coefficient = std::uniform_int_distribution<int>(-1024, 1023);
+    auto scale = std::uniform_int_distribution<int>(INT16_MIN / 8, INT16_MAX / 8);
+
+    for (int round = 0; round < 200; round++) {
+        auto table = scaleTable();
+        if (round % 2) {
+            for (auto &value : table) {
+                value = static_cast<int16_t>(scale(engine));
+            }
+        }
+        alignas(32) int16_t block[64];
+        for (auto &value : block) {
+            value = static_cast<int16_t>(coefficient(engine));
+        }
+
+        alignas(32) int16_t expected[64];
+        alignas(32) int16_t actual[64];
+        MdecDsp::idctScalar(block, table.data(), expected);
+        MdecDsp::idct(block, table.data(), actual);
+        for (uint32_t i = 0; i < 64; i++) {
+            ASSERT_EQ(actual[i], expected[i]) << "round " << round << " index " << i;
+            ASSERT_GE(actual[i], -128);
+            ASSERT_LE(actual[i], 127);
+        }
+    }
+}
+
+TEST(Mdec, testYuvToRgbMatchesScalar) {
+    auto engine = std::mt19937(42);
+    auto sample = std::uniform_int_distribution<int>(-128, 127);
+
+    for (int round = 0; round < 100; round++) {
+        alignas(32) int16_t blocks[6][64];
+        for (auto &block : blocks) {
+            for (auto &value : block) {
+                value = static_cast<int16_t>(sample(engine));
+            }
+        }
+
+        uint8_t expected[16 * 16 * 3];
+        uint8_t actual[16 * 16 * 3];
+        auto signedOutput = round % 2 == 0;
+        MdecDsp::yuvToRgbScalar(blocks[0], blocks[1], blocks[2], signedOutput, expected);
+        MdecDsp::yuvToRgb(blocks[0], blocks[1], blocks[2], signedOutput, actual);
+        for (uint32_t i = 0; i < sizeof(expected); i++) {
+            ASSERT_EQ(actual[i], expected[i]) << "round " << round << " index " << i;
+        }
+    }
+}
+
+TEST(Mdec, testDecodeBlock) {
+    uint8_t quantTable[64];
+    for (uint32_t i = 0; i < 64; i++) {
+        quantTable[i] = static_cast<uint8_t>(i + 1);
+    }
+    std::vector<uint16_t> data = {
+        MdecDsp::END_OF_BLOCK,       // padding
+        (2 << 10) | 0x3FF,           // DC -1, quantization scale 2
+        (0 << 10) | 5,               // index 1
+        (7 << 10) | 0x200,           // index 9, clamped to -1024
+        MdecDsp::END_OF_BLOCK,       // end of block
+        (0 << 10) | 0x100,           // unquantized block, in natural order
+        (62 << 10) | 3,              // index 63
+        MdecDsp::END_OF_BLOCK,       // end of block
+        (1 << 10) | 1,               // incomplete block
+    };
+    EXPECT_EQ(MdecDsp::countBlocks(data.data(), data.data() + data.size()), 2u);
+
+    const auto *position = data.data();
+    const auto *end = data.data() + data.size();
+    int16_t block[64];
+    ASSERT_TRUE(MdecDsp::decodeBlock(position, end, quantTable, block));
+    EXPECT_EQ(position, data.data() + 5);
+    EXPECT_EQ(block[0], -1);
+    // index 1 is natural index 1, index 9 is natural index 24
+    EXPECT_EQ(block[1], (5 * 2 * 2 + 4) / 8);
+    EXPECT_EQ(block[24], -1024);
+
+    ASSERT_TRUE(MdecDsp::decodeBlock(position, end, quantTable, block));
+    EXPECT_EQ(block[0], 0x200);
+    EXPECT_EQ(block[63], 6);
+    EXPECT_EQ(block[1], 0);
+
+    EXPECT_FALSE(MdecDsp::decodeBlock(position, end, quantTable, block));
+}
+
+TEST(Mdec, testDmaWaitsForDecode) {
+    auto harness = MdecHarness();
+    auto &memory = harness.memory;
+    // 24 bit, unsigned: a macroblock of zeroes is grey
+    auto words = harness.storeCommand(0x30000000, macroblock({0, 0, 0, 0, 0, 0}));
+
+    memory.u32Write(MDEC_CONTROL, Mdec::DataInEnable | Mdec::DataOutEnable);
+    memory.u32Write(DMA_INTERRUPT, Dma::MasterEnable | (1 << 17));
+
+    // The output channel is started first, like games do
+    memory.u32Write(DMA_MDEC_OUT, OUTPUT_ADDRESS);
+    memory.u32Write(DMA_MDEC_OUT + 4, (6 << 16) | 0x20);
+    memory.u32Write(DMA_MDEC_OUT + 8, 0x01000200);
+    memory.u32Write(DMA_MDEC_IN, INPUT_ADDRESS);
+    memory.u32Write(DMA_MDEC_IN + 4, (1 << 16) | words);
+    memory.u32Write(DMA_MDEC_IN + 8, 0x01000201);
+
+    EXPECT_FALSE(harness.dma.busy(Dma::Channel::MdecIn));
+    EXPECT_TRUE(harness.dma.busy(Dma::Channel::MdecOut));
+    EXPECT_TRUE(memory.u32(MDEC_CONTROL) & Mdec::CommandBusy);
+
+    harness.advance(6 * Mdec::CYCLES_PER_BLOCK - 1);
+    EXPECT_TRUE(harness.dma.busy(Dma::Channel::MdecOut));
+    EXPECT_EQ(harness.interrupts.status(), 0u);
+
+    harness.advance(1);
+    EXPECT_FALSE(harness.dma.busy(Dma::Channel::MdecOut));
+    for (uint32_t i = 0; i < 16 * 16 * 3 / 4; i++) {
+        ASSERT_EQ(memory.u32(OUTPUT_ADDRESS + i * 4), 0x80808080u);
+    }
+    EXPECT_EQ(memory.u32(DMA_MDEC_OUT), OUTPUT_ADDRESS + 16 * 16 * 3);
+
+    // Channel flag, master flag and IRQ3
+    EXPECT_TRUE(memory.u32(DMA_INTERRUPT) & (1 << 25));
+    EXPECT_TRUE(memory.u32(DMA_INTERRUPT) & Dma::MasterFlag);
+    EXPECT_EQ(harness.interrupts.status(), 1u << static_cast<uint8_t>(Interrupt::Dma));
+    memory.u32Write(DMA_INTERRUPT, Dma::MasterEnable | (1 << 17) | (1 << 25));
+    EXPECT_FALSE(memory.u32(DMA_INTERRUPT) & Dma::MasterFlag);
+
+    auto status = memory.u32(MDEC_CONTROL);
+    EXPECT_TRUE(status & Mdec::DataOutEmpty);
+    EXPECT_FALSE(status & Mdec::CommandBusy);
+    EXPECT_EQ(status & 0xFFFF, 0xFFFFu);
+}
+
+TEST(Mdec, testCpuReadsMatchReferenceDecode) {
+    auto harness = MdecHarness();
+    auto &memory = harness.memory;
+    auto data = macroblock({-40, 25, 60, -100, 7, 120});
+    auto more = macroblock({12, -12, -60, 0, 90, -5});
+    data.insert(data.end(), more.begin(), more.end());
+
+    // 15 bit with bit 15 set, signed
+    constexpr uint32_t command = 0x20000000 | (3 << 27) | (1 << 26) | (1 << 25);
+    auto job = MdecJob();
+    job.command = command;
+    job.input = data;
+    job.quantTables.fill(2);
+    job.scaleTable = scaleTable();
+    MdecWorker::decode(job);
+    ASSERT_EQ(job.output.size(), 2u * 16 * 16 * 2 / 4);
+
+    memory.u32Write(MDEC_DATA, command | static_cast<uint32_t>(data.size() / 2));
+    for (uint32_t i = 0; i < data.size(); i += 2) {
+        memory.u32Write(MDEC_DATA, data[i] | (data[i + 1] << 16));
+    }
+    EXPECT_EQ((memory.u32(MDEC_CONTROL) >> 23) & 0xF, 0xFu);
+    EXPECT_TRUE(memory.u32(MDEC_CONTROL) & Mdec::DataOutEmpty);
+
+    harness.advance(12 * Mdec::CYCLES_PER_BLOCK);
+    for (auto expected : job.output) {
+        ASSERT_FALSE(memory.u32(MDEC_CONTROL) & Mdec::DataOutEmpty);
+        auto word = memory.u32(MDEC_DATA);
+        ASSERT_EQ(word, expected);
+        ASSERT_EQ(word & 0x80008000, 0x80008000u);
+    }
+    EXPECT_TRUE(memory.u32(MDEC_CONTROL) & Mdec::DataOutEmpty);
+}
@@ -0,0 +1,243 @@
+#include "libps/instruction_cache.hpp"
+#include "libps/memory.hpp"
+#include "libps/ram.hpp"
+#include "libutils/mapped_memory.hpp"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+class CodeWrites
+    : public ICodeWriteListener {
+public:
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+    virtual void codeWritten(uint32_t offset, uint32_t size) override {
+        ranges.emplace_back(offset, size);
+    }
+};
+
+class WatchpointHits
+    : public IWatchpointListener {
+public:
+    uint32_t hits = 0;
+
+    virtual void watchpointHit(const Watchpoint &, uint32_t, bool) override {
+        hits++;
+    }
+};
+} // namespace
+
+TEST(Memory, testRamMirrors) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+
+    memory.u32Write(0x00001000, 0x12345678);
+    EXPECT_EQ(memory.u32(0x80001000), 0x12345678u);
+    EXPECT_EQ(memory.u16(0xA0001002), 0x1234u);
+    EXPECT_EQ(memory.u8(0xA0001000), 0x78u);
+}
+
+TEST(Memory, testScratchpad) {
+    auto memory = Memory();
+
+    memory.u32Write(0x1F800000, 0xCAFEBABE);
+    memory.u16Write(0x9F8003FE, 0xBEEF);
+    EXPECT_EQ(memory.u32(0x9F800000), 0xCAFEBABEu);
+    EXPECT_EQ(memory.u16(0x1F8003FE), 0xBEEFu);
+
+    // Not accessible through KSEG1 and not mirrored past 1 KiB
+    EXPECT_THROW(memory.u32(0xBF800010), NotImplemented);
+    EXPECT_THROW(memory.u32(0x1F800400), NotImplemented);
+}
+
+TEST(Memory, testCacheControlRegister) {
+    auto memory = Memory();
+
+    memory.u32Write(0xFFFE0130, 0x0001E988);
+    EXPECT_EQ(memory.cacheControl(), 0x0001E988u);
+    EXPECT_EQ(memory.u32(0xFFFE0130), 0x0001E988u);
+}
+
+TEST(Memory, testHardwareRegisterDispatch) {
+    auto memory = Memory();
+    // Ram does not allow accesses that end at its last byte
+    auto device = Ram(32);
+    memory.mapIo(&device, 0x100, 16);
+
+    // The device sees offsets from its first register, in every width and mirror
+    memory.u32Write(0x1F801104, 0x12345678);
+    memory.u16Write(0x9F80110A, 0xBEEF);
+    memory.u8Write(0xBF80110F, 0x42);
+    EXPECT_EQ(device.u32(4), 0x12345678u);
+    EXPECT_EQ(device.u16(10), 0xBEEFu);
+    EXPECT_EQ(device.u8(15), 0x42u);
+    EXPECT_EQ(memory.u8(0x1F801105), 0x56u);
+    EXPECT_EQ(memory.u16(0x1F80110A), 0xBEEFu);
+
+    // Unmapped registers read as zero, the bus keeps its own registers
+    EXPECT_EQ(memory.u32(0x1F801110), 0u);
+    memory.u32Write(0x1F801060, 0x00000888);
+    EXPECT_EQ(memory.u32(0x1F801060), 0x00000888u);
+    EXPECT_EQ(memory.u32(0x1F801000), 0x1F000000u);
+    memory.u8Write(0x1F801062, 0x55);
+    EXPECT_EQ(memory.u32(0x1F801060), 0x55u);
+    EXPECT_EQ(memory.u8(0x1F801063), 0x55u);
+    EXPECT_EQ(memory.u32(0x1F801010), 0x0013243Fu);
+
+    // A device can see other offsets than the window, like the bus for its RAM size register
+    memory.mapIo(&device, 0x120, 4, 8);
+    memory.u32Write(0x1F801120, 0xCAFEF00D);
+    EXPECT_EQ(device.u32(8), 0xCAFEF00Du);
+
+    EXPECT_THROW(memory.mapIo(&device, 0x102, 16), std::runtime_error);
+    EXPECT_THROW(memory.mapIo(&device, 0x1FF8, 16), std::runtime_error);
+}
+
+TEST(Memory, testCodeWriteProtection) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto writes = CodeWrites();
+    memory.setCodeWriteListener(&writes);
+
+    EXPECT_TRUE(memory.protectCode(0x80003010));
+    EXPECT_FALSE(memory.protectCode(0xBFC00000));
+    memory.u32Write(0x80004000, 1);
+    EXPECT_TRUE(writes.ranges.empty());
+
+    // Any mirror of the page, the protection is gone afterwards
+    memory.u8Write(0xA0003FFF, 2);
+    memory.u8Write(0x00003000, 3);
+    ASSERT_EQ(writes.ranges.size(), 1u);
+    EXPECT_EQ(writes.ranges[0], std::make_pair(0x3000u, MEMORY_PAGE_SIZE));
+    EXPECT_EQ(memory.u8(0x80003FFF), 2u);
+    EXPECT_EQ(memory.u8(0x80003000), 3u);
+
+    // Writes that bypass the bus are reported by their writer
+    memory.protectCode(0x00003000);
+    memory.ramWritten(0x2FFC, 4);
+    EXPECT_EQ(writes.ranges.size(), 1u);
+    memory.ramWritten(0x2FFC, 8);
+    EXPECT_EQ(writes.ranges.size(), 2u);
+
+    // A watched page stays out of the page tables once it is unprotected
+    memory.protectCode(0x00003000);
+    memory.addWatchpoint({0x3100, 4, WatchpointType::Write});
+    memory.u32Write(0x00003000, 4);
+    EXPECT_EQ(writes.ranges.size(), 3u);
+    auto watchpoints = WatchpointHits();
+    memory.setWatchpointListener(&watchpoints);
+    memory.u32Write(0x80003100, 5);
+    EXPECT_EQ(watchpoints.hits, 1u);
+}
+
+TEST(Memory, testRestoreKeepsUnchangedCode) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto writes = CodeWrites();
+    memory.setCodeWriteListener(&writes);
+    memory.u32Write(0x80003000, 1);
+    memory.u32Write(0x80005000, 2);
+    auto snapshot = Memory::Snapshot();
+    memory.save(snapshot);
+
+    // Only the code page that changed since the save is reported, and the data comes back
+    // The second page is written and protected again, as after translating the new code
+    EXPECT_TRUE(memory.protectCode(0x80003000));
+    memory.u32Write(0x80005000, 7);
+    EXPECT_TRUE(memory.protectCode(0x80005000));
+    memory.u32Write(0x80007000, 3);
+    writes.ranges.clear();
+    memory.restore(snapshot);
+    ASSERT_EQ(writes.ranges.size(), 1u);
+    EXPECT_EQ(writes.ranges[0].first, 0x5000u);
+    EXPECT_EQ(memory.u32(0x80005000), 2u);
+    EXPECT_EQ(memory.u32(0x80007000), 0u);
+
+    // The unchanged page is still protected
+    memory.u32Write(0x80003000, 4);
+    ASSERT_EQ(writes.ranges.size(), 2u);
+    EXPECT_EQ(writes.ranges[1].first, 0x3000u);
+}
+
+TEST(InstructionCache, testHitsAndInvalidation) {
+    auto cache = InstructionCache();
+
+    EXPECT_FALSE(cache.fetch(0x80000008));
+    // The line is filled from the missed word to the end of the line
+    EXPECT_TRUE(cache.fetch(0x8000000C));
+    EXPECT_FALSE(cache.fetch(0x80000000));
+    EXPECT_TRUE(cache.fetch(0x80000004));
+
+    // KUSEG and KSEG0 share lines, a different tag evicts them
+    EXPECT_TRUE(cache.fetch(0x00000008));
+    EXPECT_FALSE(cache.fetch(0x80001008));
+    EXPECT_FALSE(cache.fetch(0x80000008));
+
+    cache.invalidate(0x80000000);
+    EXPECT_FALSE(cache.fetch(0x80000008));
+
+    EXPECT_EQ(cache.hits(), 3u);
+    EXPECT_EQ(cache.misses(), 5u);
+}
+
+#ifdef __linux__
+namespace {
+// Locked memory of the process in KiB
+uint64_t lockedKilobytes() {
+    auto status = std::ifstream("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmLck:")) {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+}
+} // namespace
+
+TEST(MappedBuffer, testLockPolicyLeavesPageTablesAlone) {
+    auto policy = MappingPolicy();
+    policy.locked = true;
+    auto before = lockedKilobytes();
+    MappedBuffer::setPolicy(policy);
+    // Only the scratchpad of the bus is guest memory
+    auto memory = Memory();
+    auto locked = lockedKilobytes() - before;
+    auto buffer = MappedBuffer(1024 * 1024, false);
+    auto unlocked = lockedKilobytes() - before;
+    MappedBuffer::setPolicy(MappingPolicy());
+
+    EXPECT_LT(locked, 64u);
+    EXPECT_EQ(unlocked, locked);
+}
+#endif
+
+TEST(MappedBuffer, testHugePagePolicyAlignsBuffers) {
+    auto policy = MappingPolicy();
+    policy.hugePages = true;
+    MappedBuffer::setPolicy(policy);
+    auto ram = Ram();
+    MappedBuffer::setPolicy(MappingPolicy());
+
+    // The guest sees the size it asked for, zero filled
+    EXPECT_EQ(ram.size(), 2u * 1024 * 1024);
+    ASSERT_NE(ram.data(), nullptr);
+#if defined(__linux__)
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ram.data()) % MappedBuffer::HUGE_PAGE_SIZE, 0u);
+#endif
+    EXPECT_EQ(ram.u32(0x1FFFF0), 0u);
+    ram.u32Write(0x1FFFF0, 0x12345678);
+    EXPECT_EQ(ram.u32(0x1FFFF0), 0x12345678u);
+
+    // Moved buffers unmap the whole rounded mapping
+    MappedBuffer::setPolicy(policy);
+    auto buffer = MappedBuffer(100);
+    MappedBuffer::setPolicy(MappingPolicy());
+    auto moved = std::move(buffer);
+    EXPECT_EQ(moved.size(), 100u);
+    EXPECT_EQ(buffer.data(), nullptr);
+}
@@ -0,0 +1,219 @@
+#include "libps/cpu.hpp"
+#include "libps/memory.hpp"
+#include "libps/ram.hpp"
+
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+
+struct RegisterValue {
+    uint8_t index;
+    uint32_t value;
+};
+
+struct OpcodeTestVector {
+    const char *name;
+    uint32_t instruction;
+    RegisterValue registers[4];
+    uint32_t hi;
+    uint32_t lo;
+    uint32_t sr;
+    uint32_t memory;
+
+    RegisterValue expectedRegisters[4];
+    uint32_t expectedHi;
+    uint32_t expectedLo;
+    uint32_t expectedSr;
+    uint32_t expectedMemory;
+    uint32_t expectedPc;
+    uint32_t expectedCause;
+    uint32_t expectedBadVaddr;
+    uint32_t expectedEpc;
+};
+
+// Generated together with the dispatch tables by scripts/create_opcode_table.py
+#include "opcode_vectors.inc"
+
+namespace {
+void resetCpu(CPU &cpu) {
+    cpu.initializeState();
+
+    auto cpuState = cpu.getCpuState();
+    for (uint8_t i = 1; i < 32; i++) {
+        cpuState->setRegister(RegisterIndex(i), 0);
+    }
+}
+} // namespace
+
+// Runs each instruction followed by a nop and compares against the reference model
+TEST(Opcodes, testGeneratedVectors) {
+    spdlog::set_level(spdlog::level::off);
+
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto cpu = CPU();
+    cpu.setMemory(&memory);
+
+    for (const auto &vector : OPCODE_TEST_VECTORS) {
+        SCOPED_TRACE(fmt::format("{} {:#010x}", vector.name, vector.instruction));
+
+        resetCpu(cpu);
+        auto cpuState = cpu.getCpuState();
+        for (const auto &r : vector.registers) {
+            cpuState->setRegister(RegisterIndex(r.index), r.value);
+        }
+        cpuState->setHi(vector.hi);
+        cpuState->setLo(vector.lo);
+        cpuState->setRegisterCop0(Cop0Registers::SR, vector.sr);
+        cpuState->setProgramCounter(OPCODE_TEST_CODE_ADDRESS);
+
+        memory.u32Write(OPCODE_TEST_CODE_ADDRESS, vector.instruction);
+        memory.u32Write(OPCODE_TEST_CODE_ADDRESS + 4, 0);
+        memory.u32Write(OPCODE_TEST_DATA_ADDRESS, vector.memory);
+
+        cpu.step();
+        cpu.step();
+        // A jump to a misaligned address faults when its target is fetched
+        if (cpuState->getProgramCounter() % 4 != 0) {
+            cpu.step();
+        }
+
+        uint32_t expectedRegisters[32] = {};
+        for (const auto &r : vector.expectedRegisters) {
+            expectedRegisters[r.index] = r.value;
+        }
+        for (uint8_t i = 0; i < 32; i++) {
+            EXPECT_EQ(cpuState->getRegister(RegisterIndex(i)), expectedRegisters[i]) << "$" << int(i);
+        }
+
+        EXPECT_EQ(cpuState->getHi(), vector.expectedHi);
+        EXPECT_EQ(cpuState->getLo(), vector.expectedLo);
+        EXPECT_EQ(cpuState->getProgramCounter(), vector.expectedPc);
+        EXPECT_EQ(memory.u32(OPCODE_TEST_DATA_ADDRESS), vector.expectedMemory);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::SR), vector.expectedSr);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::CAUSE), vector.expectedCause);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::BadVaddr), vector.expectedBadVaddr);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::EPC), vector.expectedEpc);
+    }
+}
+
+TEST(Opcodes, testExceptionInBranchDelaySlot) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto cpu = CPU();
+    cpu.setMemory(&memory);
+    resetCpu(cpu);
+
+    // j 0x80003000; syscall
+    memory.u32Write(0x80001000, 0x02 << 26 | (0x3000 >> 2));
+    memory.u32Write(0x80001004, 0x0C);
+    cpu.getCpuState()->setProgramCounter(0x80001000);
+
+    cpu.step();
+    EXPECT_TRUE(cpu.step());
+
+    auto cpuState = cpu.getCpuState();
+    EXPECT_EQ(cpuState->getProgramCounter(), 0x80000080u);
+    EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::EPC), 0x80001000u);
+    EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::CAUSE), Cop0Registers::BranchDelay | 0x08 << 2);
+}
+
+TEST(Opcodes, testUnalignedLoadPair) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto cpu = CPU();
+    cpu.setMemory(&memory);
+    resetCpu(cpu);
+
+    memory.u32Write(0x80002000, 0x44332211);
+    memory.u32Write(0x80002004, 0x88776655);
+
+    // lwr $2, 1($1); lwl $2, 4($1); nop
+    // The second load merges with the first one still in its delay slot.
+    memory.u32Write(0x80001000, 0x26 << 26 | 1 << 21 | 2 << 16 | 1);
+    memory.u32Write(0x80001004, 0x22 << 26 | 1 << 21 | 2 << 16 | 4);
+    memory.u32Write(0x80001008, 0);
+    cpu.getCpuState()->setRegister(RegisterIndex(1), 0x80002000);
+    cpu.getCpuState()->setProgramCounter(0x80001000);
+
+    for (int i = 0; i < 3; i++) {
+        cpu.step();
+    }
+
+    EXPECT_EQ(cpu.getCpuState()->getRegister(RegisterIndex(2)), 0x55443322u);
+}
+
+// The threaded loop has to match stepping instruction by instruction, including cycles
+TEST(Opcodes, testThreadedLoopMatchesStep) {
+    const uint32_t program[] = {
+        0x2401000A, // addiu $1, $0, 10
+        0x00001021, // addu $2, $0, $0
+        0x8C830000, // loop: lw $3, 0($4)
+        0x00411021, // addu $2, $2, $1
+        0x2421FFFF, // addiu $1, $1, -1
+        0x1420FFFC, // bne $1, $0, loop
+        0xAC820004, // sw $2, 4($4)
+        0x0000000C, // syscall
+    };
+
+    for (auto cacheControl : {0u, static_cast<uint32_t>(CacheControl::CodeCacheEnable)}) {
+        Memory memories[2];
+        CPU cpus[2];
+        for (int i = 0; i < 2; i++) {
+            memories[i].setRam(std::make_unique<Ram>());
+            memories[i].u32Write(0xFFFE0130, cacheControl);
+            memories[i].u32Write(0x80002000, 7);
+            for (uint32_t j = 0; j < std::size(program); j++) {
+                memories[i].u32Write(0x80001000 + j * 4, program[j]);
+            }
+
+            cpus[i].setMemory(&memories[i]);
+            resetCpu(cpus[i]);
+            cpus[i].getCpuState()->setRegister(RegisterIndex(4), 0x80002000);
+            cpus[i].getCpuState()->setProgramCounter(0x80001000);
+        }
+
+        // Stops right after the syscall raised its exception
+        auto result = cpus[0].run(1000);
+        EXPECT_EQ(result.instructions, 53u);
+        for (uint32_t i = 0; i < result.instructions; i++) {
+            cpus[1].step();
+        }
+
+        auto threaded = cpus[0].getCpuState();
+        auto stepped = cpus[1].getCpuState();
+        EXPECT_EQ(threaded->getProgramCounter(), 0x80000080u);
+        EXPECT_EQ(threaded->getProgramCounter(), stepped->getProgramCounter());
+        for (uint8_t i = 1; i < 5; i++) {
+            EXPECT_EQ(threaded->getRegister(RegisterIndex(i)), stepped->getRegister(RegisterIndex(i)));
+        }
+        EXPECT_EQ(threaded->getRegister(RegisterIndex(2)), 55u);
+        EXPECT_EQ(memories[0].u32(0x80002004), 55u);
+        EXPECT_EQ(cpus[0].cycles(), cpus[1].cycles());
+        EXPECT_EQ(result.cycles, cpus[0].cycles());
+    }
+}
+
+// Both backends of run() fault on the fetch of a misaligned jump target like step() does
+TEST(Opcodes, testMisalignedFetchRaisesAddressError) {
+    for (auto cached : {false, true}) {
+        auto memory = Memory();
+        memory.setRam(std::make_unique<Ram>());
+        memory.u32Write(0x80001000, 0x01000008); // jr $8
+        memory.u32Write(0x80001004, 0x24090001); // addiu $9, $0, 1
+        auto cpu = CPU();
+        cpu.setMemory(&memory);
+        cpu.setCachedInterpreter(cached);
+        resetCpu(cpu);
+        auto cpuState = cpu.getCpuState();
+        cpuState->setRegister(RegisterIndex(8), 0x80001102);
+        cpuState->setProgramCounter(0x80001000);
+
+        auto result = cpu.run(1000);
+        EXPECT_EQ(result.instructions, 3u);
+        EXPECT_EQ(cpuState->getProgramCounter(), 0x80000080u);
+        EXPECT_EQ(cpuState->getRegister(RegisterIndex(9)), 1u);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::CAUSE), static_cast<uint32_t>(ExceptionCause::AddressErrorLoad) << 2);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::EPC), 0x80001102u);
+        EXPECT_EQ(cpuState->getRegisterCop0(Cop0Registers::BadVaddr), 0x80001102u);
+    }
+}
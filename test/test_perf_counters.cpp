@@ -0,0 +1,64 @@
+#include "libps/cpu.hpp"
+#include "libps/memory.hpp"
+#include "libps/perf_counters.hpp"
+#include "libps/ram.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(PerfCounters, testCacheLinePadding) {
+    EXPECT_EQ(alignof(PerfCounters::CpuCounters), PerfCounters::CACHE_LINE_SIZE);
+    EXPECT_EQ(offsetof(PerfCounters::CpuCounters, loadDelayInvalidations) % PerfCounters::CACHE_LINE_SIZE, 0u);
+    EXPECT_EQ(sizeof(PerfCounters::SegmentCounters), PerfCounters::CACHE_LINE_SIZE);
+}
+
+TEST(PerfCounters, testPrometheusText) {
+    auto snapshot = PerfCounters::Snapshot();
+    snapshot.cpu.opcodes[0x23] = 12;
+    snapshot.cpu.loadDelayInvalidations = 3;
+    snapshot.memory.segments[static_cast<size_t>(MemorySegment::BIOS)].reads = 7;
+
+    auto text = PerfCounters::prometheusText(snapshot);
+    EXPECT_NE(text.find("# TYPE ps_cpu_opcode_executions_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("ps_cpu_opcode_executions_total{opcode=\"0x23\"} 12\n"), std::string::npos);
+    EXPECT_EQ(text.find("opcode=\"0x00\""), std::string::npos);
+    EXPECT_NE(text.find("ps_cpu_load_delay_invalidations_total 3\n"), std::string::npos);
+    EXPECT_NE(text.find("ps_memory_reads_total{segment=\"bios\"} 7\n"), std::string::npos);
+    EXPECT_NE(text.find("ps_memory_writes_total{segment=\"ram\"} 0\n"), std::string::npos);
+}
+
+#ifdef PS_PERF_COUNTERS
+TEST(PerfCounters, testCounting) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    auto cpu = CPU();
+    cpu.setMemory(&memory);
+    cpu.initializeState();
+
+    // lw $1, 0($0); addiu $1, $0, 1; sh $1, 0x1f800000 (scratchpad)
+    memory.u32Write(0x80001000, 0x23 << 26 | 1 << 16);
+    memory.u32Write(0x80001004, 0x09 << 26 | 1 << 16 | 1);
+    memory.u32Write(0x80001008, 0x29 << 26 | 2 << 21 | 1 << 16);
+    cpu.getCpuState()->setRegister(RegisterIndex(2), 0x1F800000);
+    cpu.getCpuState()->setProgramCounter(0x80001000);
+
+    for (int i = 0; i < 3; i++) {
+        cpu.step();
+    }
+
+    const auto &cpuCounters = cpu.perfCounters();
+    EXPECT_EQ(cpuCounters.opcodes[0x23], 1u);
+    EXPECT_EQ(cpuCounters.opcodes[0x09], 1u);
+    EXPECT_EQ(cpuCounters.opcodes[0x29], 1u);
+    EXPECT_EQ(cpuCounters.loadDelayInvalidations, 1u);
+
+    const auto &ram = memory.perfCounters().segments[static_cast<size_t>(MemorySegment::RAM)];
+    // Three instruction fetches and the load, plus the setup writes
+    EXPECT_EQ(ram.reads, 4u);
+    EXPECT_EQ(ram.bytesRead, 16u);
+    EXPECT_EQ(ram.writes, 3u);
+
+    const auto &scratchpad = memory.perfCounters().segments[static_cast<size_t>(MemorySegment::SCRATCHPAD)];
+    EXPECT_EQ(scratchpad.writes, 1u);
+    EXPECT_EQ(scratchpad.bytesWritten, 2u);
+}
+#endif
@@ -0,0 +1,82 @@
+#include "libps/memory.hpp"
+#include "libps/profiler.hpp"
+#include "libps/ram.hpp"
+#include "libps/symbol_map.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+class WatchpointCount
+    : public IWatchpointListener {
+public:
+    uint32_t hits = 0;
+
+    virtual void watchpointHit(const Watchpoint &, uint32_t, bool) override {
+        hits++;
+    }
+};
+} // namespace
+
+TEST(Profiler, testSamplingInterval) {
+    auto profiler = Profiler();
+
+    for (int i = 0; i < 1000; i++) {
+        profiler.advance(0x80010000, 64);
+    }
+    profiler.advance(0x80020000, Profiler::SAMPLE_INTERVAL);
+
+    EXPECT_EQ(profiler.samples(), 64000 / Profiler::SAMPLE_INTERVAL + 1);
+
+    auto top = profiler.top(10);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].address, 0x80010000u);
+    EXPECT_EQ(top[0].samples, 6u);
+    EXPECT_EQ(top[1].address, 0x80020000u);
+    EXPECT_EQ(top[1].samples, 1u);
+}
+
+TEST(Profiler, testFixedTableDropsOverflow) {
+    auto profiler = Profiler();
+
+    for (uint32_t i = 0; i < Profiler::SLOT_COUNT + 100; i++) {
+        profiler.sample(0x80000000 + i * 4);
+    }
+
+    EXPECT_EQ(profiler.samples(), Profiler::SLOT_COUNT + 100u);
+    EXPECT_GE(profiler.dropped(), 100u);
+    EXPECT_EQ(profiler.top(Profiler::SLOT_COUNT * 2).size() + profiler.dropped(), profiler.samples());
+}
+
+TEST(Profiler, testReportLeavesTheBusAlone) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    memory.u32Write(0x80010000, 0x2401000A); // addiu $1, $0, 10
+    memory.takeAccessCycles();
+    auto watchpoints = WatchpointCount();
+    memory.setWatchpointListener(&watchpoints);
+    memory.addWatchpoint(Watchpoint{0x80010000, 4, WatchpointType::Read});
+
+    auto profiler = Profiler();
+    profiler.sample(0x80010000);
+    profiler.sample(0x1F000000);
+    profiler.report(10, &memory, nullptr);
+    EXPECT_EQ(memory.takeAccessCycles(), 0u);
+    EXPECT_EQ(watchpoints.hits, 0u);
+}
+
+TEST(SymbolMap, testParseAndLookup) {
+    auto symbols = SymbolMap();
+    symbols.parse(
+        "  Address  Names alphabetical\r\n"
+        "  80010000 main\r\n"
+        "  80010100      _start_loop\n"
+        "80020000 VSync ; comment\n"
+        "not a symbol line\n");
+
+    EXPECT_EQ(symbols.size(), 3u);
+    EXPECT_EQ(symbols.lookup(0x8000FFFC), nullptr);
+    EXPECT_EQ(symbols.lookup(0x80010000)->name, "main");
+    EXPECT_EQ(symbols.lookup(0x800100FC)->name, "main");
+    EXPECT_EQ(symbols.lookup(0x80010104)->name, "_start_loop");
+    EXPECT_EQ(symbols.lookup(0x80030000)->name, "VSync");
+}
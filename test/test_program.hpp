@@ -0,0 +1,17 @@
+#pragma once
+
+#include "libps/playstation.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Where the CPU tests place their code, clear of the kernel area and the data the programs use
+constexpr uint32_t PROGRAM_ADDRESS = 0x80001000;
+
+// Writes the instructions to RAM and points the CPU at the first one
+inline void loadProgram(Playstation &ps, const std::vector<uint32_t> &program, uint32_t address = PROGRAM_ADDRESS) {
+    for (uint32_t i = 0; i < program.size(); i++) {
+        ps.memory().u32Write(address + i * 4, program[i]);
+    }
+    ps.cpu().getCpuState()->setProgramCounter(address);
+}
@@ -0,0 +1,120 @@
+#include "libps/replay.hpp"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+std::vector<uint8_t> readLog(const fs::path &path) {
+    auto size = fs::file_size(path);
+    auto file = std::ifstream(path, std::ios::binary);
+    auto data = std::vector<uint8_t>(size);
+    file.read(reinterpret_cast<char *>(data.data()), size);
+    return data;
+}
+
+// Records a few controller polls and two checkpoints, returns the log
+std::vector<uint8_t> recordSession(const fs::path &path) {
+    auto replay = Replay();
+    replay.startRecording(path.string());
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 100, 0xFFFF), 0xFFFFu);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 200, 0xFFFF), 0xFFFFu);
+    EXPECT_EQ(replay.input(InputSource::Controller, 1, 200, 0x1234), 0x1234u);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 300, 0xFFBF), 0xFFBFu);
+    replay.checkpoint(1000, 0x0123456789ABCDEF);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 5000000000, 0xFFFF), 0xFFFFu);
+    replay.checkpoint(6000000000, 42);
+    replay.stop();
+    return readLog(path);
+}
+} // namespace
+
+TEST(Replay, testPlaybackReturnsRecordedInputs) {
+    auto path = fs::temp_directory_path() / "test_replay_playback.psr";
+    auto log = recordSession(path);
+    fs::remove(path);
+
+    // Unchanged polls are not logged: 4 inputs and 2 checkpoints
+    EXPECT_EQ(Replay::parse(log).size(), 6u);
+
+    auto replay = Replay();
+    replay.startPlayback(log);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 100, 0), 0xFFFFu);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 200, 0), 0xFFFFu);
+    EXPECT_EQ(replay.input(InputSource::Controller, 1, 200, 0), 0x1234u);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 300, 0), 0xFFBFu);
+    EXPECT_TRUE(replay.checkpoint(1000, 0x0123456789ABCDEF));
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 4000000000, 0), 0xFFBFu);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 5000000000, 0), 0xFFFFu);
+    EXPECT_TRUE(replay.checkpoint(6000000000, 42));
+    EXPECT_TRUE(replay.finished());
+    EXPECT_EQ(replay.desyncs(), 0u);
+
+    // Sources which were never recorded keep their live value
+    EXPECT_EQ(replay.input(InputSource::CdTiming, 0, 7000000000, 77), 77u);
+}
+
+TEST(Replay, testReadsInTheSameCycleKeepTheirOrder) {
+    auto path = fs::temp_directory_path() / "test_replay_same_cycle.psr";
+    auto recorder = Replay();
+    recorder.startRecording(path.string());
+    recorder.input(InputSource::Controller, 0, 10, 1);
+    recorder.input(InputSource::Controller, 0, 10, 2);
+    recorder.input(InputSource::Controller, 0, 10, 3);
+    recorder.stop();
+
+    auto replay = Replay();
+    replay.startPlayback(readLog(path));
+    fs::remove(path);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 10, 0), 1u);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 10, 0), 2u);
+    EXPECT_EQ(replay.input(InputSource::Controller, 0, 10, 0), 3u);
+}
+
+TEST(Replay, testCheckpointDetectsDivergence) {
+    auto path = fs::temp_directory_path() / "test_replay_divergence.psr";
+    auto log = recordSession(path);
+    fs::remove(path);
+
+    auto replay = Replay();
+    replay.startPlayback(log);
+    EXPECT_FALSE(replay.checkpoint(1000, 0));
+    EXPECT_EQ(replay.desyncs(), 1u);
+
+    // A checkpoint at a cycle the recording never reached counts as well
+    replay.startPlayback(log);
+    EXPECT_FALSE(replay.checkpoint(2000, 0x0123456789ABCDEF));
+}
+
+TEST(Replay, testTruncatedLogKeepsCompleteRecords) {
+    auto path = fs::temp_directory_path() / "test_replay_truncated.psr";
+    auto log = recordSession(path);
+    fs::remove(path);
+
+    // The last checkpoint is cut in half as if the recording process crashed
+    log.resize(log.size() - 4);
+    auto records = Replay::parse(log);
+    ASSERT_EQ(records.size(), 5u);
+    EXPECT_EQ(records[4].cycle, 5000000000u);
+    EXPECT_EQ(records[4].value, 0xFFFFu);
+
+    log.resize(Replay::HEADER_SIZE - 1);
+    EXPECT_THROW(Replay::parse(log), std::runtime_error);
+}
+
+TEST(Replay, testUnknownChannelIsRejected) {
+    auto path = fs::temp_directory_path() / "test_replay_channel.psr";
+    auto log = recordSession(path);
+    fs::remove(path);
+    // Only the header is kept, followed by an input record for source 2, which this version does not know
+    log.resize(Replay::HEADER_SIZE);
+    for (uint8_t byte : {Replay::RECORD_INPUT, uint8_t(10), uint8_t(0x20), uint8_t(1)}) {
+        log.push_back(byte);
+    }
+    EXPECT_THROW(Replay::parse(log), std::runtime_error);
+
+    log[Replay::HEADER_SIZE + 2] = 0x1F;
+    ASSERT_EQ(Replay::parse(log).size(), 1u);
+    EXPECT_EQ(Replay::parse(log)[0].channel, 0x1Fu);
+}
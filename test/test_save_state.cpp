@@ -0,0 +1,193 @@
+#include "test_program.hpp"
+
+#include "libps/audio_sink.hpp"
+#include "libps/playstation.hpp"
+#include "libps/run_ahead.hpp"
+#include "libps/shared_snapshot.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+constexpr uint32_t COUNTER_ADDRESS = 0x80002000;
+constexpr uint32_t EVENT_ADDRESS = 0x80002004;
+constexpr uint32_t MDEC_DATA = 0x1F801820;
+constexpr uint32_t MDEC_STATUS = 0x1F801824;
+
+// Counts in RAM forever
+void startCounter(Playstation &ps) {
+    loadProgram(ps, {
+        0x3C088000, // lui $t0, 0x8000
+        0x8D092000, // lw $t1, 0x2000($t0)
+        0x00000000, // nop
+        0x25290001, // addiu $t1, $t1, 1
+        0xAD092000, // sw $t1, 0x2000($t0)
+        0x1000FFFB, // b -5
+        0x00000000, // nop
+    });
+    ps.memory().u32Write(COUNTER_ADDRESS, 0);
+}
+} // namespace
+
+TEST(SaveState, testRestoreRepeatsExecution) {
+    auto ps = Playstation();
+    ps.initialize();
+    startCounter(ps);
+    ps.scheduler().setCallback(Scheduler::Event::SioTransfer, [&ps](uint64_t cycle) {
+        ps.memory().u32Write(EVENT_ADDRESS, static_cast<uint32_t>(cycle));
+    });
+
+    ps.runFrame();
+    ps.runFrame();
+    ps.scheduler().schedule(Scheduler::Event::SioTransfer, Timing::FRAME_CYCLES * 3 + 100);
+    // Reads through the bus are charged to the CPU, so they come before the save
+    auto savedCounter = ps.memory().u32(COUNTER_ADDRESS);
+    auto state = SaveState();
+    ps.saveState(state);
+
+    for (int i = 0; i < 3; i++) {
+        ps.runFrame();
+    }
+    auto hash = ps.stateHash();
+    auto counter = ps.memory().u32(COUNTER_ADDRESS);
+    EXPECT_GT(counter, savedCounter);
+    EXPECT_EQ(ps.memory().u32(EVENT_ADDRESS), Timing::FRAME_CYCLES * 3 + 100);
+
+    ps.loadState(state);
+    EXPECT_EQ(ps.memory().u32(COUNTER_ADDRESS), savedCounter);
+    EXPECT_EQ(ps.memory().u32(EVENT_ADDRESS), 0u);
+    EXPECT_TRUE(ps.scheduler().scheduled(Scheduler::Event::SioTransfer));
+
+    // The same state can be loaded again and leads to the same result
+    for (int repeat = 0; repeat < 2; repeat++) {
+        ps.loadState(state);
+        for (int i = 0; i < 3; i++) {
+            ps.runFrame();
+        }
+        EXPECT_EQ(ps.stateHash(), hash);
+        EXPECT_EQ(ps.memory().u32(COUNTER_ADDRESS), counter);
+        EXPECT_EQ(ps.memory().u32(EVENT_ADDRESS), Timing::FRAME_CYCLES * 3 + 100);
+    }
+}
+
+TEST(SaveState, testRunAheadPresentsFutureFrames) {
+    constexpr uint32_t frames = 4;
+    constexpr uint32_t ahead = 2;
+
+    auto plain = Playstation();
+    plain.initialize();
+    auto plainAudio = HashAudioSink();
+    plain.setAudioSink(&plainAudio);
+    startCounter(plain);
+    std::vector<uint64_t> plainHashes;
+    for (uint32_t i = 0; i < frames + ahead; i++) {
+        plain.runFrame();
+        plainHashes.push_back(plain.stateHash());
+    }
+
+    auto ps = Playstation();
+    ps.initialize();
+    auto audio = HashAudioSink();
+    ps.setAudioSink(&audio);
+    startCounter(ps);
+    auto runAhead = RunAhead(&ps, ahead);
+    std::vector<uint64_t> presented;
+    for (uint32_t i = 0; i < frames; i++) {
+        EXPECT_TRUE(runAhead.runFrame([&presented](Playstation &presentedPs) {
+            presented.push_back(presentedPs.stateHash());
+        }));
+        EXPECT_EQ(ps.stateHash(), plainHashes[i]);
+    }
+
+    ASSERT_EQ(presented.size(), size_t(frames));
+    for (uint32_t i = 0; i < frames; i++) {
+        EXPECT_EQ(presented[i], plainHashes[i + ahead]);
+    }
+    EXPECT_EQ(ps.audioSink(), &audio);
+
+    // Only the real frames were heard
+    for (uint32_t i = 0; i < ahead; i++) {
+        ps.runFrame();
+    }
+    ps.setAudioSink(nullptr);
+    plain.setAudioSink(nullptr);
+    EXPECT_EQ(audio.frames(), plainAudio.frames());
+    EXPECT_EQ(audio.hash(), plainAudio.hash());
+}
+
+TEST(SaveState, testClonesShareTheSnapshot) {
+    auto ps = Playstation();
+    ps.initialize();
+    startCounter(ps);
+    ps.runFrame();
+    ps.runFrame();
+
+    auto snapshot = SharedSnapshot(ps);
+    auto first = snapshot.clone();
+    auto second = snapshot.clone();
+    EXPECT_EQ(first->stateHash(), ps.stateHash());
+    for (int i = 0; i < 3; i++) {
+        ps.runFrame();
+        first->runFrame();
+        second->runFrame();
+    }
+    EXPECT_EQ(first->stateHash(), ps.stateHash());
+    EXPECT_EQ(second->stateHash(), ps.stateHash());
+    EXPECT_EQ(first->memory().u32(COUNTER_ADDRESS), ps.memory().u32(COUNTER_ADDRESS));
+
+    // Writes stay in the instance that made them
+    first->memory().u32Write(EVENT_ADDRESS, 1);
+    EXPECT_EQ(second->memory().u32(EVENT_ADDRESS), 0u);
+    EXPECT_EQ(snapshot.clone()->memory().u32(EVENT_ADDRESS), 0u);
+    EXPECT_EQ(ps.memory().u32(EVENT_ADDRESS), 0u);
+}
+
+TEST(SaveState, testClonesReadDecodedMdecOutput) {
+    auto ps = Playstation();
+    ps.initialize();
+    startCounter(ps);
+    // 24 bit decode of a macroblock with DC only blocks
+    ps.memory().u32Write(MDEC_DATA, 0x30000000 | 6);
+    for (int i = 0; i < 6; i++) {
+        ps.memory().u32Write(MDEC_DATA, 0xFE000400);
+    }
+    ps.runFrame();
+
+    auto snapshot = SharedSnapshot(ps);
+    auto clone = snapshot.clone();
+    auto status = ps.memory().u32(MDEC_STATUS);
+    EXPECT_FALSE(status & Mdec::DataOutEmpty);
+    EXPECT_EQ(clone->memory().u32(MDEC_STATUS), status);
+    for (int i = 0; i < 16 * 16 * 3 / 4; i++) {
+        ASSERT_EQ(clone->memory().u32(MDEC_DATA), ps.memory().u32(MDEC_DATA));
+    }
+    EXPECT_EQ(clone->memory().u32(MDEC_STATUS), ps.memory().u32(MDEC_STATUS));
+    EXPECT_TRUE(ps.memory().u32(MDEC_STATUS) & Mdec::DataOutEmpty);
+}
+
+#ifndef _WIN32
+TEST(SaveState, testForkedClonesRunInTheirOwnProcess) {
+    auto ps = Playstation();
+    ps.initialize();
+    startCounter(ps);
+    ps.runFrame();
+
+    auto snapshot = SharedSnapshot(ps);
+    auto expected = snapshot.clone();
+    expected->runFrame();
+    expected->runFrame();
+    auto hash = expected->stateHash();
+
+    auto pid = snapshot.fork([hash](Playstation &forked) {
+        forked.runFrame();
+        forked.runFrame();
+        return forked.stateHash() == hash ? 0 : 1;
+    });
+    EXPECT_EQ(SharedSnapshot::wait(pid), 0);
+
+    pid = snapshot.fork([](Playstation &) -> int {
+        throw std::runtime_error("Job failed");
+    });
+    EXPECT_EQ(SharedSnapshot::wait(pid), SharedSnapshot::FORK_JOB_FAILED);
+}
+#endif
@@ -0,0 +1,260 @@
+#include "test_program.hpp"
+
+#include "libps/interrupt_controller.hpp"
+#include "libps/memory_card.hpp"
+#include "libps/playstation.hpp"
+#include "libps/replay.hpp"
+#include "libps/scheduler.hpp"
+#include "libps/sio.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr uint32_t JOY_DATA = 0x0;
+constexpr uint32_t JOY_STAT = 0x4;
+constexpr uint32_t JOY_MODE = 0x8;
+constexpr uint32_t JOY_CTRL = 0xA;
+constexpr uint32_t JOY_BAUD = 0xE;
+
+constexpr uint16_t CONTROL_SELECTED = Sio::TxEnable | Sio::Select | Sio::AckInterruptEnable;
+
+// SIO with a manual clock, every exchange runs the scheduler past the transfer
+class SioHarness {
+public:
+    uint64_t now = 0;
+    Scheduler scheduler;
+    InterruptController interrupts;
+    Sio sio;
+
+    explicit SioHarness(Replay *replay = nullptr)
+        : sio(&scheduler, &interrupts, replay) {
+        scheduler.setClock([this]() { return now; });
+        sio.u16Write(JOY_MODE, 0x000D);
+        sio.u16Write(JOY_BAUD, 0x0088);
+    }
+
+    void select(uint32_t port) {
+        sio.u16Write(JOY_CTRL, CONTROL_SELECTED | (port ? Sio::PortSelect : 0));
+    }
+
+    void deselect() {
+        sio.u16Write(JOY_CTRL, 0);
+    }
+
+    // Returns the received byte, ack tells whether the device asked for more
+    uint8_t exchange(uint8_t value, bool *ack = nullptr) {
+        interrupts.u32Write(0, 0);
+        sio.u16Write(JOY_CTRL, sio.u16(JOY_CTRL) | Sio::Acknowledge);
+
+        sio.u8Write(JOY_DATA, value);
+        EXPECT_FALSE(sio.u32(JOY_STAT) & Sio::TxFinished);
+        now += 0x88 * 8;
+        scheduler.run(now);
+        EXPECT_TRUE(sio.u32(JOY_STAT) & Sio::RxNotEmpty);
+        auto received = sio.u8(JOY_DATA);
+
+        now += Sio::ACK_DELAY_CYCLES;
+        scheduler.run(now);
+        auto acked = (sio.u32(JOY_STAT) & Sio::AckLevel) != 0;
+        EXPECT_EQ(acked, (interrupts.status() & (1 << static_cast<uint8_t>(Interrupt::ControllerMemoryCard))) != 0);
+        if (ack) {
+            *ack = acked;
+        }
+        return received;
+    }
+};
+
+std::vector<uint8_t> pollPad(SioHarness &harness, uint32_t port) {
+    std::vector<uint8_t> reply;
+    harness.select(port);
+    for (uint8_t value : {0x01, 0x42, 0x00, 0x00, 0x00}) {
+        reply.push_back(harness.exchange(value));
+    }
+    harness.deselect();
+    return reply;
+}
+
+void writeSector(SioHarness &harness, uint16_t sector, const uint8_t *data, uint8_t &end) {
+    harness.select(0);
+    harness.exchange(0x81);
+    harness.exchange('W');
+    harness.exchange(0x00);
+    harness.exchange(0x00);
+    harness.exchange(static_cast<uint8_t>(sector >> 8));
+    harness.exchange(static_cast<uint8_t>(sector));
+    uint8_t checksum = static_cast<uint8_t>(sector >> 8) ^ static_cast<uint8_t>(sector);
+    for (uint32_t i = 0; i < MEMORY_CARD_SECTOR_SIZE; i++) {
+        checksum ^= data[i];
+        harness.exchange(data[i]);
+    }
+    harness.exchange(checksum);
+    EXPECT_EQ(harness.exchange(0x00), 0x5C);
+    EXPECT_EQ(harness.exchange(0x00), 0x5D);
+    bool ack;
+    end = harness.exchange(0x00, &ack);
+    EXPECT_FALSE(ack);
+    harness.deselect();
+}
+} // namespace
+
+TEST(Sio, testSchedulerRunsEventsInOrder) {
+    uint64_t now = 0;
+    auto scheduler = Scheduler();
+    scheduler.setClock([&now]() { return now; });
+
+    std::vector<int> order;
+    scheduler.setCallback(Scheduler::Event::SioTransfer, [&](uint64_t cycle) {
+        order.push_back(1);
+        EXPECT_EQ(cycle, 200u);
+    });
+    scheduler.setCallback(Scheduler::Event::SioAck, [&](uint64_t) { order.push_back(2); });
+
+    scheduler.scheduleIn(Scheduler::Event::SioTransfer, 200);
+    scheduler.schedule(Scheduler::Event::SioAck, 100);
+    EXPECT_EQ(scheduler.nextCycle(), 100u);
+
+    scheduler.run(99);
+    EXPECT_TRUE(order.empty());
+    scheduler.run(500);
+    EXPECT_EQ(order, (std::vector<int>{2, 1}));
+    EXPECT_EQ(scheduler.nextCycle(), Scheduler::NEVER);
+
+    scheduler.schedule(Scheduler::Event::SioAck, 600);
+    scheduler.cancel(Scheduler::Event::SioAck);
+    scheduler.run(1000);
+    EXPECT_EQ(order.size(), 2u);
+}
+
+TEST(Sio, testControllerPoll) {
+    auto harness = SioHarness();
+    harness.sio.controller(0).setPressed(Controller::Cross | Controller::Start);
+
+    auto reply = pollPad(harness, 0);
+    EXPECT_EQ(reply, (std::vector<uint8_t>{0xFF, 0x41, 0x5A, 0xF7, 0xBF}));
+
+    // Nothing is plugged into the second port's memory card slot
+    harness.select(1);
+    bool ack;
+    EXPECT_EQ(harness.exchange(0x81, &ack), 0xFF);
+    EXPECT_FALSE(ack);
+}
+
+TEST(Sio, testControllerInputIsRecorded) {
+    auto path = fs::temp_directory_path() / "test_sio_controller.psr";
+    auto replay = Replay();
+    replay.startRecording(path.string());
+    {
+        auto harness = SioHarness(&replay);
+        harness.sio.controller(1).setPressed(Controller::Circle);
+        pollPad(harness, 1);
+        pollPad(harness, 1);
+        harness.sio.controller(1).setPressed(0);
+        pollPad(harness, 1);
+    }
+    replay.stop();
+
+    auto data = std::vector<uint8_t>(fs::file_size(path));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char *>(data.data()), data.size());
+    fs::remove(path);
+    EXPECT_EQ(Replay::parse(data).size(), 2u);
+
+    // Playback ignores the live buttons
+    replay.startPlayback(data);
+    auto harness = SioHarness(&replay);
+    harness.sio.controller(1).setPressed(Controller::Square);
+    EXPECT_EQ(pollPad(harness, 1)[3], 0xFF);
+    EXPECT_EQ(pollPad(harness, 1)[4], 0xDF);
+    EXPECT_EQ(pollPad(harness, 1)[4], 0xFF);
+    EXPECT_EQ(replay.desyncs(), 0u);
+}
+
+TEST(Sio, testMemoryCardWriteBack) {
+    auto path = fs::temp_directory_path() / "test_sio_memory_card.mcd";
+    fs::remove(path);
+
+    uint8_t data[MEMORY_CARD_SECTOR_SIZE];
+    for (uint32_t i = 0; i < MEMORY_CARD_SECTOR_SIZE; i++) {
+        data[i] = static_cast<uint8_t>(i * 3);
+    }
+
+    {
+        auto harness = SioHarness();
+        harness.sio.insertMemoryCard(0, path.string());
+        ASSERT_EQ(fs::file_size(path), MEMORY_CARD_SIZE);
+
+        uint8_t end;
+        writeSector(harness, 0x123, data, end);
+        EXPECT_EQ(end, 'G');
+        writeSector(harness, 0x400, data, end);
+        EXPECT_EQ(end, 0xFF);
+
+        // Read it back through the card
+        harness.select(0);
+        harness.exchange(0x81);
+        EXPECT_EQ(harness.exchange('R'), 0x00);
+        harness.exchange(0x00);
+        harness.exchange(0x00);
+        harness.exchange(0x01);
+        harness.exchange(0x23);
+        EXPECT_EQ(harness.exchange(0x00), 0x5C);
+        EXPECT_EQ(harness.exchange(0x00), 0x5D);
+        EXPECT_EQ(harness.exchange(0x00), 0x01);
+        EXPECT_EQ(harness.exchange(0x00), 0x23);
+        for (uint32_t i = 0; i < MEMORY_CARD_SECTOR_SIZE; i++) {
+            ASSERT_EQ(harness.exchange(0x00), data[i]);
+        }
+        harness.exchange(0x00);
+        EXPECT_EQ(harness.exchange(0x00), 'G');
+        harness.deselect();
+
+        harness.sio.memoryCard(0)->writer()->flush();
+        EXPECT_EQ(harness.sio.memoryCard(0)->writer()->batches(), 1u);
+    }
+
+    auto image = std::vector<uint8_t>(MEMORY_CARD_SIZE);
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char *>(image.data()), image.size());
+    fs::remove(path);
+    EXPECT_TRUE(std::equal(data, data + MEMORY_CARD_SECTOR_SIZE, image.begin() + 0x123 * MEMORY_CARD_SECTOR_SIZE));
+    EXPECT_EQ(image[0], 'M');
+    EXPECT_EQ(image[1], 'C');
+}
+
+TEST(Sio, testInterruptIsTakenBetweenInstructions) {
+    auto ps = Playstation();
+    ps.initialize();
+    loadProgram(ps, {
+        0x00000000, // nop
+        0x4A180001, // rtps
+        0x00000000, // nop
+    });
+
+    auto *state = ps.cpu().getCpuState();
+    // IM2 unmasks the hardware interrupt line
+    constexpr uint32_t interruptMask2 = 1 << 10;
+    state->setRegisterCop0Unchecked(Cop0Registers::SR, Cop0Registers::Cop2Enable | interruptMask2 | Cop0Registers::InterruptEnable);
+
+    ps.memory().u32Write(0x1F801074, 1 << static_cast<uint8_t>(Interrupt::ControllerMemoryCard));
+    ps.interruptController().request(Interrupt::ControllerMemoryCard);
+
+    // The GTE command runs before the interrupt is taken
+    ps.execute(1);
+    EXPECT_EQ(state->getProgramCounter(), PROGRAM_ADDRESS + 4);
+    ps.execute(1);
+    EXPECT_EQ(state->getProgramCounter(), 0x80000080u);
+    EXPECT_EQ(state->getRegisterCop0(Cop0Registers::EPC), PROGRAM_ADDRESS + 8);
+    auto cause = state->getRegisterCop0(Cop0Registers::CAUSE);
+    EXPECT_EQ((cause >> 2) & 0x1F, static_cast<uint32_t>(ExceptionCause::Interrupt));
+    EXPECT_TRUE(cause & Cop0Registers::HardwareInterrupt);
+    // Interrupts are disabled inside the handler
+    EXPECT_FALSE(state->getRegisterCop0(Cop0Registers::SR) & Cop0Registers::InterruptEnable);
+
+    // Acknowledging in I_STAT drops the line
+    ps.memory().u32Write(0x1F801070, 0);
+    ps.execute(1);
+    EXPECT_FALSE(state->getRegisterCop0(Cop0Registers::CAUSE) & Cop0Registers::HardwareInterrupt);
+}
@@ -0,0 +1,119 @@
+#include "libps/audio_sink.hpp"
+#include "libps/spu.hpp"
+#include "libps/spu_dsp.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+class CaptureAudioSink : public AudioSink {
+public:
+    std::vector<int16_t> samples;
+
+    virtual void write(const int16_t *data, size_t frames) override {
+        samples.insert(samples.end(), data, data + frames * 2);
+    }
+};
+} // namespace
+
+TEST(Spu, testAdpcmDecodeMatchesScalar) {
+    auto random = std::mt19937(1234);
+
+    for (int header = 0; header < 0x80; header++) {
+        uint8_t block[SpuDsp::ADPCM_BLOCK_SIZE];
+        for (auto &byte : block) {
+            byte = static_cast<uint8_t>(random());
+        }
+        block[0] = static_cast<uint8_t>(header);
+
+        auto history = SpuDsp::AdpcmHistory{static_cast<int16_t>(random()), static_cast<int16_t>(random())};
+        auto scalarHistory = history;
+
+        int16_t decoded[SpuDsp::ADPCM_SAMPLES_PER_BLOCK];
+        int16_t scalar[SpuDsp::ADPCM_SAMPLES_PER_BLOCK];
+        SpuDsp::decodeAdpcmBlock(block, decoded, history);
+        SpuDsp::decodeAdpcmBlockScalar(block, scalar, scalarHistory);
+
+        for (uint32_t i = 0; i < SpuDsp::ADPCM_SAMPLES_PER_BLOCK; i++) {
+            EXPECT_EQ(decoded[i], scalar[i]) << "header " << header << " sample " << i;
+        }
+        EXPECT_EQ(history.old, scalarHistory.old);
+        EXPECT_EQ(history.older, scalarHistory.older);
+    }
+}
+
+TEST(Spu, testMixMatchesScalar) {
+    auto random = std::mt19937(42);
+    auto next = [&]() { return static_cast<int16_t>(random()); };
+
+    for (int iteration = 0; iteration < 100; iteration++) {
+        SpuDsp::VoiceLanes lanes = {};
+        for (uint32_t lane = 0; lane < SPU_VOICE_COUNT; lane++) {
+            for (int tap = 0; tap < 4; tap++) {
+                lanes.gauss[tap][lane] = next();
+                lanes.samples[tap][lane] = next();
+            }
+            lanes.envelope[lane] = next() & 0x7FFF;
+            lanes.volumeLeft[lane] = next();
+            lanes.volumeRight[lane] = next();
+            lanes.reverbMask[lane] = (random() & 1) ? -1 : 0;
+        }
+
+        auto scalar = lanes;
+        SpuDsp::interpolate(lanes);
+        SpuDsp::interpolateScalar(scalar);
+        auto result = SpuDsp::mix(lanes);
+        auto scalarResult = SpuDsp::mixScalar(scalar);
+
+        for (uint32_t lane = 0; lane < SpuDsp::VOICE_LANES; lane++) {
+            EXPECT_EQ(lanes.interpolated[lane], scalar.interpolated[lane]);
+            EXPECT_EQ(lanes.output[lane], scalar.output[lane]);
+        }
+        EXPECT_EQ(result.left, scalarResult.left);
+        EXPECT_EQ(result.right, scalarResult.right);
+        EXPECT_EQ(result.reverbLeft, scalarResult.reverbLeft);
+        EXPECT_EQ(result.reverbRight, scalarResult.reverbRight);
+    }
+}
+
+TEST(Spu, testVoicePlaysAndStops) {
+    auto spu = Spu();
+    auto sink = CaptureAudioSink();
+    spu.setAudioSink(&sink);
+
+    // Upload one block (filter 0, shift 0, loop end without repeat) at address 0x1000
+    spu.u16Write(0x1A6, 0x1000 / 8);
+    spu.u16Write(0x1A8, 0x0100);
+    for (int i = 0; i < 7; i++) {
+        spu.u16Write(0x1A8, 0x7777);
+    }
+
+    // Enable, unmute, full main volume
+    spu.u16Write(0x1AA, 0xC000);
+    spu.u16Write(0x180, 0x3FFF);
+    spu.u16Write(0x182, 0x3FFF);
+
+    // Voice 0: full volume, 44.1 kHz, fastest attack
+    spu.u16Write(0x000, 0x3FFF);
+    spu.u16Write(0x002, 0x3FFF);
+    spu.u16Write(0x004, 0x1000);
+    spu.u16Write(0x006, 0x1000 / 8);
+    spu.u16Write(0x008, 0x000F);
+    spu.u16Write(0x00A, 0x0000);
+    spu.u16Write(0x188, 0x0001);
+
+    EXPECT_EQ(spu.adsrPhase(0), Spu::AdsrPhase::Attack);
+
+    spu.tick(SPU_CYCLES_PER_SAMPLE * 16);
+    spu.flush();
+
+    ASSERT_EQ(sink.samples.size(), 32u);
+    auto nonZero = std::count_if(sink.samples.begin(), sink.samples.end(), [](auto x) { return x != 0; });
+    EXPECT_GT(nonZero, 0);
+
+    // After the only block ended without repeat, the voice is muted and reports ENDX
+    spu.tick(SPU_CYCLES_PER_SAMPLE * 28);
+    EXPECT_EQ(spu.adsrPhase(0), Spu::AdsrPhase::Off);
+    EXPECT_EQ(spu.u16(0x19C) & 1, 1);
+}
@@ -0,0 +1,95 @@
+#include "libps/bios.hpp"
+#include "libps/cpu.hpp"
+#include "libps/memory.hpp"
+#include "libps/ram.hpp"
+#include "libps/timing.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using testing::Return;
+
+namespace {
+class MockMemory : public Memory {
+public:
+    MOCK_METHOD(uint32_t, u32, (uint32_t address), (override));
+    MOCK_METHOD(void, u32Write, (uint32_t address, uint32_t value), (override));
+};
+} // namespace
+
+TEST(Timing, testBiosAccessTimes) {
+    // Delay/size and common delay as set up by the BIOS, 8 bit bus
+    auto times = Timing::calculateAccessTimes(0x0013243F, 0x00031125);
+    EXPECT_EQ(times.byte, 6u);
+    EXPECT_EQ(times.halfword, 12u);
+    EXPECT_EQ(times.word, 24u);
+}
+
+TEST(Timing, testMultiplyCycles) {
+    EXPECT_EQ(Timing::multiplyCycles(0x7FF, false), 6u);
+    EXPECT_EQ(Timing::multiplyCycles(0xFFFFF, false), 9u);
+    EXPECT_EQ(Timing::multiplyCycles(0x100000, false), 13u);
+    EXPECT_EQ(Timing::multiplyCycles(0xFFFFFFFF, true), 6u);
+    EXPECT_EQ(Timing::multiplyCycles(0xFFFFFFFF, false), 13u);
+}
+
+TEST(Timing, testMemoryAccessCycles) {
+    auto memory = Memory();
+    memory.setRam(std::make_unique<Ram>());
+    memory.setBios(std::make_unique<BIOS>(ByteBuffer(512 * 1024)));
+
+    memory.u32(0xBFC00000);
+    EXPECT_EQ(memory.takeAccessCycles(), 24u);
+    memory.u8(0x9FC00000);
+    EXPECT_EQ(memory.takeAccessCycles(), 6u);
+
+    memory.u32(0x80000000);
+    memory.u32Write(0x80000000, 0);
+    EXPECT_EQ(memory.takeAccessCycles(), Timing::RAM_READ_CYCLES);
+
+    memory.u32(0x1F800000);
+    EXPECT_EQ(memory.takeAccessCycles(), 0u);
+
+    // Switching the BIOS to a 16 bit bus through its delay/size register
+    memory.u32Write(0x1F801010, 0x0013343F);
+    EXPECT_EQ(memory.takeAccessCycles(), 0u);
+    memory.u32(0xBFC00000);
+    EXPECT_EQ(memory.takeAccessCycles(), 12u);
+}
+
+TEST(Timing, testMultiplyInterlock) {
+    auto memory = MockMemory();
+
+    // mult $1, $2
+    uint32_t multInstruction = 1 << 21 | 2 << 16 | 0x18;
+    // mflo $3
+    uint32_t mfloInstruction = 3 << 11 | 0x12;
+    // j 0xBFC00000
+    uint32_t jumpInstruction = 0x02 << 26 | (0xFC00000 >> 2);
+
+    ON_CALL(memory, u32)
+        .WillByDefault(Return(0));
+    ON_CALL(memory, u32(0xBFC00000))
+        .WillByDefault(Return(multInstruction));
+    ON_CALL(memory, u32(0xBFC00004))
+        .WillByDefault(Return(mfloInstruction));
+    ON_CALL(memory, u32(0xBFC00008))
+        .WillByDefault(Return(jumpInstruction));
+
+    auto cpu = CPU();
+    cpu.initializeState();
+    cpu.setMemory(&memory);
+
+    // The block ends after the delay slot of the jump
+    auto block = cpu.runBlock(64);
+    EXPECT_EQ(block.instructions, 4u);
+
+    // $1 = 0xDEADBEEF takes the slowest path through the multiplier, mflo
+    // stalls until it is done.
+    EXPECT_EQ(block.cycles, 13u + 1 + 1 + 1);
+    EXPECT_EQ(cpu.cycles(), block.cycles);
+
+    auto cpuState = cpu.getCpuState();
+    EXPECT_EQ(cpuState->getRegister(RegisterIndex(3)), 0xDEADBEEFu * 0xDEADBEEFu);
+    EXPECT_EQ(cpuState->getProgramCounter(), 0xBFC00000u);
+}